@@ -0,0 +1,187 @@
+/**
+ * @file delete-heavy churn benchmarks
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "picobench/picobench.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using picobench::state;
+
+PICOBENCH_SUITE("churn");
+
+namespace {
+
+/* counts the allocations of A */
+template <class A> struct counting_allocator {
+  static const bool bulk_release = A::bulk_release;
+
+  void *allocate(std::size_t size) {
+    ++n_allocations;
+    return alloc_.allocate(size);
+  }
+
+  void deallocate(void *p, std::size_t size) { alloc_.deallocate(p, size); }
+
+  /* keeps the inner nodes of A on their cache lines */
+  void *allocate(std::size_t size, std::size_t alignment) {
+    ++n_allocations;
+    return art::allocate_aligned(alloc_, size, alignment, 0);
+  }
+
+  void deallocate(void *p, std::size_t size, std::size_t alignment) {
+    art::deallocate_aligned(alloc_, p, size, alignment, 0);
+  }
+
+  static std::size_t n_allocations;
+  A alloc_;
+};
+
+template <class A> std::size_t counting_allocator<A>::n_allocations = 0;
+
+/*
+ * Every one of n_groups inner nodes starts with n_children children, the
+ * capacity of a node type. Every operation toggles one more child of a random
+ * node, so the nodes' number of children alternates around the threshold
+ * between two node types, which grows and shrinks the nodes unless their
+ * shrink threshold is lower than n_children (see ART_NODE_16_SHRINK_THRESHOLD
+ * and friends). Prints the allocations per operation, i.e. the leaves plus
+ * the nodes reallocated by grow and shrink.
+ */
+void art_churn(state &s, int n_children, const char *name) {
+  using allocator = counting_allocator<art::pool_allocator>;
+  const int n_groups = 1000;
+  art::art<int, allocator> m;
+  int v = 1;
+  char key[3];
+  for (int g = 0; g < n_groups; ++g) {
+    key[0] = static_cast<char>(g >> 8);
+    key[1] = static_cast<char>(g);
+    for (int c = 0; c < n_children; ++c) {
+      key[2] = static_cast<char>(c);
+      m.set(key, sizeof(key), &v);
+    }
+  }
+  std::vector<bool> has_extra_child(n_groups, false);
+  std::mt19937_64 rng(0);
+  std::size_t n_allocations = allocator::n_allocations;
+  for (auto i __attribute__((unused)) : s) {
+    int g = rng() % n_groups;
+    key[0] = static_cast<char>(g >> 8);
+    key[1] = static_cast<char>(g);
+    key[2] = static_cast<char>(n_children);
+    if (has_extra_child[g]) {
+      m.del(key, sizeof(key));
+    } else {
+      m.set(key, sizeof(key), &v);
+    }
+    has_extra_child[g] = !has_extra_child[g];
+  }
+  std::cerr << name << ": "
+            << static_cast<double>(allocator::n_allocations - n_allocations) /
+                   s.iterations()
+            << " allocations/op" << std::endl;
+}
+
+} // namespace
+
+static void art_churn_node_16(state &s) {
+  art_churn(s, 4, "art_churn_node_16");
+}
+PICOBENCH(art_churn_node_16);
+
+static void art_churn_node_48(state &s) {
+  art_churn(s, 16, "art_churn_node_48");
+}
+PICOBENCH(art_churn_node_48);
+
+static void art_churn_node_256(state &s) {
+  art_churn(s, 48, "art_churn_node_256");
+}
+PICOBENCH(art_churn_node_256);
+
+/*
+ * Every operation toggles a key differing from one of n_groups keys only in
+ * its last byte, which splits the other key's leaf below a new parent with
+ * a long prefix and merges them again.
+ */
+static void art_churn_long_keys(state &s) {
+  using allocator = counting_allocator<art::pool_allocator>;
+  const int n_groups = 1000;
+  art::art<int, allocator> m;
+  int v = 1;
+  std::vector<std::string> keys;
+  for (int g = 0; g < n_groups; ++g) {
+    keys.push_back("tenant/" + std::to_string(g) +
+                   "/users/0123456789abcdef/sessions/0");
+    m.set(keys.back().c_str(), &v);
+    keys.back().back() = '1';
+  }
+  std::vector<bool> has_other_key(n_groups, false);
+  std::mt19937_64 rng(0);
+  std::size_t n_allocations = allocator::n_allocations;
+  for (auto i __attribute__((unused)) : s) {
+    int g = rng() % n_groups;
+    if (has_other_key[g]) {
+      m.del(keys[g].c_str());
+    } else {
+      m.set(keys[g].c_str(), &v);
+    }
+    has_other_key[g] = !has_other_key[g];
+  }
+  std::cerr << "art_churn_long_keys: "
+            << static_cast<double>(allocator::n_allocations - n_allocations) /
+                   s.iterations()
+            << " allocations/op" << std::endl;
+}
+PICOBENCH(art_churn_long_keys);
+
+/*
+ * Iterates a tree whose keys were inserted in random order and mostly
+ * deleted again, so that the remaining nodes are scattered across the pool,
+ * optionally after compacting it. Prints the bytes compact reclaimed.
+ */
+void art_scan_after_churn(state &s, bool compact, const char *name) {
+  art::art<int> m;
+  int v = 1;
+  std::mt19937_64 rng(0);
+  std::vector<std::string> keys;
+  for (int i = 0; i < 1000000; ++i) {
+    keys.push_back(std::to_string(rng()));
+    m.set(keys.back().c_str(), &v);
+  }
+  for (std::size_t i = 0; i < keys.size(); ++i) {
+    if (i % 8 != 0) {
+      m.del(keys[i].c_str());
+    }
+  }
+  if (compact) {
+    std::cerr << name << ": " << m.compact() << " bytes reclaimed"
+              << std::endl;
+  }
+  auto it = m.begin(), it_end = m.end();
+  std::uintptr_t sum = 0;
+  for (auto i __attribute__((unused)) : s) {
+    if (++it == it_end) {
+      it = m.begin();
+    }
+    sum += reinterpret_cast<std::uintptr_t>(*it);
+  }
+  s.set_result(sum);
+}
+
+static void art_scan_after_churn(state &s) {
+  art_scan_after_churn(s, false, "art_scan_after_churn");
+}
+PICOBENCH(art_scan_after_churn);
+
+static void art_scan_after_compact(state &s) {
+  art_scan_after_churn(s, true, "art_scan_after_compact");
+}
+PICOBENCH(art_scan_after_compact);
@@ -0,0 +1,161 @@
+/**
+ * @file concurrent microbenchmarks
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "picobench/picobench.hpp"
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+using picobench::state;
+using std::atomic;
+using std::hash;
+using std::mt19937_64;
+using std::mutex;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::unique_lock;
+using std::vector;
+
+PICOBENCH_SUITE("concurrent");
+
+/*
+ * n_readers threads look up and n_writers threads insert and delete keys
+ * until s.iterations() operations are done in total. Half of the keys are
+ * inserted upfront.
+ */
+template <class Get, class Set, class Del>
+static uintptr_t run_threads(state &s, int n_readers, int n_writers,
+                             const vector<string> &keys, Get get, Set set,
+                             Del del) {
+  int n_threads = n_readers + n_writers;
+  int n_ops = s.iterations() / n_threads;
+  atomic<uintptr_t> sum(0);
+  vector<thread> threads;
+  s.start_timer();
+  for (int t = 0; t < n_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      mt19937_64 rng(t);
+      uintptr_t local_sum = 0;
+      for (int i = 0; i < n_ops; ++i) {
+        const string &k = keys[rng() % keys.size()];
+        if (t < n_readers) {
+          local_sum += reinterpret_cast<uintptr_t>(get(k));
+        } else if (i % 2 == 0) {
+          set(k);
+        } else {
+          del(k);
+        }
+      }
+      sum += local_sum;
+    });
+  }
+  for (auto &th : threads) {
+    th.join();
+  }
+  s.stop_timer();
+  return sum;
+}
+
+/* decimal strings, which share their first bytes but are spread across the
+ * shards of sharded_art by its hash routing */
+static vector<string> make_keys(state &s) {
+  vector<string> keys;
+  hash<uint32_t> h;
+  mt19937_64 rng(0);
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(to_string(h(rng())));
+  }
+  return keys;
+}
+
+template <class M, int n_readers, int n_writers>
+static void art_concurrent(state &s) {
+  M m;
+  int v = 1;
+  vector<string> keys = make_keys(s);
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    m.set(keys[i].c_str(), &v);
+  }
+  s.set_result(run_threads(
+      s, n_readers, n_writers, keys,
+      [&](const string &k) { return m.get(k.c_str()); },
+      [&](const string &k) { m.set(k.c_str(), &v); },
+      [&](const string &k) { m.del(k.c_str()); }));
+}
+
+template <int n_readers, int n_writers> static void art_mutex(state &s) {
+  art::art<int> m;
+  mutex mtx;
+  int v = 1;
+  vector<string> keys = make_keys(s);
+  for (size_t i = 0; i < keys.size(); i += 2) {
+    m.set(keys[i].c_str(), &v);
+  }
+  s.set_result(run_threads(
+      s, n_readers, n_writers, keys,
+      [&](const string &k) {
+        unique_lock<mutex> lock(mtx);
+        return m.get(k.c_str());
+      },
+      [&](const string &k) {
+        unique_lock<mutex> lock(mtx);
+        m.set(k.c_str(), &v);
+      },
+      [&](const string &k) {
+        unique_lock<mutex> lock(mtx);
+        m.del(k.c_str());
+      }));
+}
+
+static void art_olc_r3_w1(state &s) {
+  art_concurrent<art::olc_art<int>, 3, 1>(s);
+}
+PICOBENCH(art_olc_r3_w1);
+
+static void art_rowex_r3_w1(state &s) {
+  art_concurrent<art::rowex_art<int>, 3, 1>(s);
+}
+PICOBENCH(art_rowex_r3_w1);
+
+static void art_sharded_r3_w1(state &s) {
+  art_concurrent<art::sharded_art<int, 16>, 3, 1>(s);
+}
+PICOBENCH(art_sharded_r3_w1);
+
+static void art_mutex_r3_w1(state &s) { art_mutex<3, 1>(s); }
+PICOBENCH(art_mutex_r3_w1);
+
+static void art_olc_r1_w3(state &s) {
+  art_concurrent<art::olc_art<int>, 1, 3>(s);
+}
+PICOBENCH(art_olc_r1_w3);
+
+static void art_rowex_r1_w3(state &s) {
+  art_concurrent<art::rowex_art<int>, 1, 3>(s);
+}
+PICOBENCH(art_rowex_r1_w3);
+
+static void art_sharded_r1_w3(state &s) {
+  art_concurrent<art::sharded_art<int, 16>, 1, 3>(s);
+}
+PICOBENCH(art_sharded_r1_w3);
+
+static void art_mutex_r1_w3(state &s) { art_mutex<1, 3>(s); }
+PICOBENCH(art_mutex_r1_w3);
+
+/* writers only, on 16 shards or behind one mutex */
+static void art_sharded_r0_w4(state &s) {
+  art_concurrent<art::sharded_art<int, 16>, 0, 4>(s);
+}
+PICOBENCH(art_sharded_r0_w4);
+
+static void art_mutex_r0_w4(state &s) { art_mutex<0, 4>(s); }
+PICOBENCH(art_mutex_r0_w4);
@@ -4,6 +4,7 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
 #include <map>
 #include <random>
@@ -22,6 +23,7 @@ static void art_delete_sparse(state &s) {
     m.set(std::to_string(g1()).c_str(), &v);
   }
   std::mt19937_64 g2(0);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     m.del(std::to_string(g2()).c_str());
   }
@@ -36,6 +38,7 @@ static void red_black_delete_sparse(state &s) {
     m[std::to_string(g1()).c_str()] = v;
   }
   std::mt19937_64 g2(0);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     m.erase(m.find(std::to_string(g2())));
   }
@@ -50,6 +53,7 @@ static void hashmap_delete_sparse(state &s) {
     m[std::to_string(g1())] = v;
   }
   std::mt19937_64 g2(0);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     m.erase(m.find(std::to_string(g2())));
   }
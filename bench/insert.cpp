@@ -4,13 +4,18 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
+#include <algorithm>
 #include <functional>
 #include <map>
+#include <memory>
 #include <random>
 #include <string>
 #include <unordered_map>
 #include <queue>
+#include <utility>
+#include <vector>
 
 using picobench::state;
 
@@ -20,16 +25,42 @@ static void art_insert_sparse(state &s) {
   art::art<int> m;
   int v = 1;
   std::mt19937_64 rng(0);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     m.set(std::to_string(rng()).c_str(), &v);
   }
 }
 PICOBENCH(art_insert_sparse);
 
+static void art_bulk_load_sparse(state &s) {
+  int v = 1;
+  std::mt19937_64 rng(0);
+  std::vector<std::string> keys;
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(std::to_string(rng()));
+  }
+  /* digits and the terminator sort the same as signed and unsigned chars */
+  std::sort(keys.begin(), keys.end());
+  std::vector<std::pair<const char *, int *>> pairs;
+  for (const std::string &k : keys) {
+    pairs.emplace_back(k.c_str(), &v);
+  }
+  /* the tree outlives the timed section, so its teardown isn't counted */
+  std::unique_ptr<art::art<int>> m;
+  s.start_timer();
+  {
+    bench::perf_scope counters(__func__, s.iterations());
+    m.reset(new art::art<int>(pairs.begin(), pairs.end()));
+  }
+  s.stop_timer();
+}
+PICOBENCH(art_bulk_load_sparse);
+
 static void red_black_insert_sparse(state &s) {
   std::map<std::string, int> m;
   int v = 1;
   std::mt19937_64 rng(0);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     m[std::to_string(rng())] = v;
   }
@@ -41,6 +72,7 @@ static void hashmap_insert_sparse(state &s) {
   int v = 1;
   std::random_device rd;
   std::mt19937_64 g(rd());
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     m[std::to_string(g())] = v;
   }
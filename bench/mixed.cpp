@@ -44,6 +44,21 @@ static void art_mixed_sparse(state &s) {
 }
 PICOBENCH(art_mixed_sparse);
 
+static void art_mixed_sparse_insert_if_absent(state &s) {
+  art::art<int> m;
+  fast_zipf rng(10000000);
+  hash<uint32_t> h;
+  string k;
+  int v = 1;
+  for (auto i __attribute__((unused)) : s) {
+    k = to_string(h(rng()));
+    if (m.insert_if_absent(k.c_str(), &v) != nullptr) {
+      m.del(k.c_str());
+    }
+  }
+}
+PICOBENCH(art_mixed_sparse_insert_if_absent);
+
 static void red_black_mixed_sparse(state &s) {
   map<string, int *> m;
   fast_zipf rng(10000000);
@@ -4,6 +4,7 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
 
 using namespace art;
@@ -12,6 +13,7 @@ using picobench::state;
 PICOBENCH_SUITE("node_16");
 
 static void node_16_constructor(state &s) {
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     node_16<int> n;
   }
@@ -24,6 +26,7 @@ static void node_16_find_child(state &s) {
   for (int i = 0; i < 16; ++i) {
     n.set_child((i * 17) - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     auto child_out __attribute__((unused)) = n.find_child(((rand() % 16) * 17) - 128);
   }
@@ -31,23 +34,28 @@ static void node_16_find_child(state &s) {
 PICOBENCH(node_16_find_child);
 
 static void node_16_set_child(state &s) {
-  auto n = new node_16<int>();
+  heap_allocator alloc;
+  auto n = make<node_16<int>>(alloc);
   leaf_node<int> child(nullptr);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     if (n->is_full()) {
-      delete n;
-      n = new node_16<int>();
+      destroy(alloc, n);
+      n = make<node_16<int>>(alloc);
     }
     n->set_child(((rand() % 16) * 17) - 128, &child);
   }
+  destroy(alloc, n);
 }
 PICOBENCH(node_16_set_child);
 
 static void node_16_grow(state &s) {
+  heap_allocator alloc;
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto *n = new node_16<int>();
-    auto *new_n = n->grow();
-    delete new_n;
+    auto *n = make<node_16<int>>(alloc);
+    auto *new_n = n->grow(alloc);
+    new_n->destroy(alloc);
   }
 }
 PICOBENCH(node_16_grow);
@@ -58,6 +66,7 @@ static void node_16_next_partial_key(state &s) {
   for (int i = 0; i < 16; ++i) {
     n.set_child((i * 17) - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     auto next_partial_key __attribute__((unused)) = n.next_partial_key((rand() % 256) - 128);
   }
@@ -70,6 +79,7 @@ static void node_16_prev_partial_key(state &s) {
   for (int i = 0; i < 16; ++i) {
     n.set_child((i * 17) - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     auto prev_partial_key __attribute__((unused)) = n.prev_partial_key((rand() % 256) - 128);
   }
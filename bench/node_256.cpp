@@ -4,6 +4,7 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
 
 using namespace art;
@@ -12,6 +13,7 @@ using picobench::state;
 PICOBENCH_SUITE("node_256");
 
 static void node_256_constructor(state &s) {
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     node_256<int> n;
   }
@@ -24,22 +26,26 @@ static void node_256_find_child(state &s) {
   for (int i = 0; i < 256; ++i) {
     n.set_child(i - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto child = n.find_child((rand() % 256) - 128);
+    auto child __attribute__((unused)) = n.find_child((rand() % 256) - 128);
   }
 }
 PICOBENCH(node_256_find_child);
 
 static void node_256_set_child(state &s) {
-  node_256<int> *n = new node_256<int>();
+  heap_allocator alloc;
+  auto n = make<node_256<int>>(alloc);
   leaf_node<int> child(nullptr);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     if (n->is_full()) {
-      delete n;
-      n = new node_256<int>();
+      destroy(alloc, n);
+      n = make<node_256<int>>(alloc);
     }
     n->set_child((rand() % 256) - 128, &child);
   }
+  destroy(alloc, n);
 }
 PICOBENCH(node_256_set_child);
 
@@ -49,8 +55,9 @@ static void node_256_next_partial_key(state &s) {
   for (int i = 0; i < 256; ++i) {
     n.set_child(i - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto next_partial_key = n.next_partial_key((rand() % 256) - 128);
+    auto next_partial_key __attribute__((unused)) = n.next_partial_key((rand() % 256) - 128);
   }
 }
 PICOBENCH(node_256_next_partial_key);
@@ -61,8 +68,9 @@ static void node_256_prev_partial_key(state &s) {
   for (int i = 0; i < 256; ++i) {
     n.set_child(i - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto prev_partial_key = n.prev_partial_key((rand() % 256) - 128);
+    auto prev_partial_key __attribute__((unused)) = n.prev_partial_key((rand() % 256) - 128);
   }
 }
 PICOBENCH(node_256_prev_partial_key);
@@ -4,6 +4,7 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
 
 using namespace art;
@@ -12,6 +13,7 @@ using picobench::state;
 PICOBENCH_SUITE("node_4");
 
 static void node_4_constructor(state &s) {
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     node_4<int> n;
   }
@@ -32,7 +34,8 @@ static void node_4_find_child(state &s) {
   n.set_child(127, &c3);
 
   char partial_keys[] = {-128, -43, 42, 127};
-  node<int> **child = nullptr;
+  node<int> **child __attribute__((unused)) = nullptr;
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     child = n.find_child(partial_keys[rand() % 4]);
   }
@@ -40,27 +43,32 @@ static void node_4_find_child(state &s) {
 PICOBENCH(node_4_find_child);
 
 static void node_4_set_child(state &s) {
-  auto n = new node_4<int>();
+  heap_allocator alloc;
+  auto n = make<node_4<int>>(alloc);
   leaf_node<int> child(nullptr);
   char partial_keys[] = {-128, -43, 42, 127};
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     if (n->is_full()) {
-      delete n;
-      n = new node_4<int>();
+      destroy(alloc, n);
+      n = make<node_4<int>>(alloc);
     }
 
     n->set_child(partial_keys[rand() % 4], &child);
   }
+  destroy(alloc, n);
 }
 PICOBENCH(node_4_set_child);
 
 static void node_4_grow(state &s) {
   inner_node<int> *n = nullptr;
   inner_node<int> *new_n = nullptr;
+  heap_allocator alloc;
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    n = new node_4<int>();
-    new_n = n->grow();
-    delete new_n;
+    n = make<node_4<int>>(alloc);
+    new_n = n->grow(alloc);
+    new_n->destroy(alloc);
   }
 }
 PICOBENCH(node_4_grow);
@@ -78,8 +86,9 @@ static void node_4_next_partial_key(state &s) {
   n.set_child(42, &c2);
   n.set_child(127, &c3);
 
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto next_partial_key = n.next_partial_key((rand() % 256) - 128);
+    auto next_partial_key __attribute__((unused)) = n.next_partial_key((rand() % 256) - 128);
   }
 }
 PICOBENCH(node_4_next_partial_key);
@@ -97,8 +106,9 @@ static void node_4_prev_partial_key(state &s) {
   n.set_child(42, &c2);
   n.set_child(127, &c3);
 
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto prev_partial_key = n.prev_partial_key((rand() % 256) - 128);
+    auto prev_partial_key __attribute__((unused)) = n.prev_partial_key((rand() % 256) - 128);
   }
 }
 PICOBENCH(node_4_prev_partial_key);
@@ -4,8 +4,10 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
 #include <cmath>
+#include <vector>
 
 using namespace art;
 using picobench::state;
@@ -13,6 +15,7 @@ using picobench::state;
 PICOBENCH_SUITE("node_48");
 
 static void node_48_constructor(state &s) {
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     node_48<int> n;
   }
@@ -25,30 +28,36 @@ static void node_48_find_child(state &s) {
   for (int i = 0; i < 48; ++i) {
     n.set_child(std::floor(5.4468 * i) - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto child = n.find_child(std::floor(5.4468 * (rand() % 48)) - 128);
+    auto child __attribute__((unused)) = n.find_child(std::floor(5.4468 * (rand() % 48)) - 128);
   }
 }
 PICOBENCH(node_48_find_child);
 
 static void node_48_set_child(state &s) {
-  node_48<int> *n = new node_48<int>();
+  heap_allocator alloc;
+  auto n = make<node_48<int>>(alloc);
   leaf_node<int> child(nullptr);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     if (n->is_full()) {
-      delete n;
-      n = new node_48<int>();
+      destroy(alloc, n);
+      n = make<node_48<int>>(alloc);
     }
     n->set_child((rand() % 256) - 128, &child);
   }
+  destroy(alloc, n);
 }
 PICOBENCH(node_48_set_child);
 
 static void node_48_grow(state &s) {
+  heap_allocator alloc;
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    node_48<int> *n = new node_48<int>();
-    node<int> *new_n = n->grow();
-    delete new_n;
+    node_48<int> *n = make<node_48<int>>(alloc);
+    inner_node<int> *new_n = n->grow(alloc);
+    new_n->destroy(alloc);
   }
 }
 PICOBENCH(node_48_grow);
@@ -59,8 +68,9 @@ static void node_48_next_partial_key(state &s) {
   for (int i = 0; i < 48; ++i) {
     n.set_child(std::floor(5.4468 * i) - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto next_partial_key = n.next_partial_key((rand() % 256) - 128);
+    auto next_partial_key __attribute__((unused)) = n.next_partial_key((rand() % 256) - 128);
   }
 }
 PICOBENCH(node_48_next_partial_key);
@@ -71,8 +81,33 @@ static void node_48_prev_partial_key(state &s) {
   for (int i = 0; i < 48; ++i) {
     n.set_child(std::floor(5.4468 * i) - 128, &child);
   }
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
-    auto prev_partial_key = n.prev_partial_key((rand() % 256) - 128);
+    auto prev_partial_key __attribute__((unused)) = n.prev_partial_key((rand() % 256) - 128);
   }
 }
 PICOBENCH(node_48_prev_partial_key);
+
+/* lookups in many nodes, which are in the cache less often */
+static void node_48_find_child_cold(state &s) {
+  pool_allocator alloc;
+  leaf_node<int> child(nullptr);
+  std::vector<node_48<int> *> nodes;
+  for (int i = 0; i < 1 << 16; ++i) {
+    nodes.push_back(make<node_48<int>>(alloc));
+    for (int j = 0; j < 48; ++j) {
+      nodes.back()->set_child(std::floor(5.4468 * j) - 128, &child);
+    }
+    /* e.g. a prefix of the node */
+    alloc.allocate(24);
+  }
+  std::size_t n = 0;
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i __attribute__((unused)) : s) {
+    node<int> **c = nodes[rand() % nodes.size()]->find_child(
+        std::floor(5.4468 * (rand() % 48)) - 128);
+    n += c != nullptr;
+  }
+  s.set_result(n);
+}
+PICOBENCH(node_48_find_child_cold);
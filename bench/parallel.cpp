@@ -0,0 +1,75 @@
+/**
+ * @file parallel traversal benchmarks
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "picobench/picobench.hpp"
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+
+using picobench::state;
+using std::hash;
+using std::mt19937_64;
+using std::to_string;
+
+PICOBENCH_SUITE("parallel");
+
+namespace {
+
+using tree = art::art<int, art::heap_allocator>;
+
+std::unique_ptr<tree> make_tree(state &s) {
+  std::unique_ptr<tree> m(new tree([](int *v) { delete v; }));
+  hash<uint64_t> h;
+  mt19937_64 rng(0);
+  for (auto i : s) {
+    delete m->set(to_string(h(rng())).c_str(), new int(i));
+  }
+  return m;
+}
+
+} // namespace
+
+static void art_teardown(state &s) {
+  auto m = make_tree(s);
+  s.start_timer();
+  m.reset();
+  s.stop_timer();
+}
+PICOBENCH(art_teardown);
+
+static void art_parallel_clear(state &s) {
+  auto m = make_tree(s);
+  s.start_timer();
+  m->parallel_clear();
+  s.stop_timer();
+}
+PICOBENCH(art_parallel_clear);
+
+static void art_sum(state &s) {
+  auto m = make_tree(s);
+  long sum = 0;
+  s.start_timer();
+  for (auto it = m->begin(), it_end = m->end(); it != it_end; ++it) {
+    sum += **it;
+  }
+  s.stop_timer();
+  s.set_result(sum);
+}
+PICOBENCH(art_sum);
+
+static void art_parallel_sum(state &s) {
+  auto m = make_tree(s);
+  s.start_timer();
+  long sum = m->parallel_reduce(
+      0L, [](int *v) { return static_cast<long>(*v); },
+      [](long a, long b) { return a + b; });
+  s.stop_timer();
+  s.set_result(sum);
+}
+PICOBENCH(art_parallel_sum);
@@ -0,0 +1,210 @@
+/**
+ * @file hardware performance counters of the benchmarks
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ *
+ * Counts instructions, last level cache misses, data TLB misses and branch
+ * misses of the calling thread with Linux's perf_event_open. Counting is
+ * enabled by setting the ART_PERF_COUNTERS environment variable. The events
+ * must be permitted by kernel.perf_event_paranoid, and are usually missing
+ * in virtual machines and containers, in which case they are reported as
+ * unavailable.
+ */
+
+#ifndef ART_BENCH_PERF_COUNTERS_HPP
+#define ART_BENCH_PERF_COUNTERS_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+
+#if defined(__linux__)
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+class perf_counters {
+public:
+  static const int n_events = 4;
+
+  /**
+   * Opens the events if counting is enabled.
+   */
+  perf_counters();
+  perf_counters(const perf_counters &) = delete;
+  perf_counters &operator=(const perf_counters &) = delete;
+  ~perf_counters();
+
+  /**
+   * Determines if the ART_PERF_COUNTERS environment variable is set.
+   */
+  static bool enabled();
+
+  static const char *name(int event);
+
+  void start();
+  void stop();
+
+  /**
+   * Returns the number of events between the last start and stop, scaled
+   * up if the kernel multiplexed the counter, or -1 if the event is
+   * unavailable.
+   */
+  double count(int event) const;
+
+  /**
+   * Prints the events per operation to stderr, if counting is enabled.
+   */
+  void report(const char *label, std::size_t n_ops) const;
+
+private:
+  int fds_[n_events];
+  double counts_[n_events];
+};
+
+/**
+ * Counts the events from construction to destruction, i.e. the rest of the
+ * enclosing scope, and reports them. Constructed right before the timed
+ * loop of a benchmark, e.g.
+ *
+ *   perf_scope counters(__func__, s.iterations());
+ *   for (auto i : s) {
+ */
+class perf_scope {
+public:
+  perf_scope(const char *label, std::size_t n_ops);
+  ~perf_scope();
+
+private:
+  perf_counters counters_;
+  const char *label_;
+  std::size_t n_ops_;
+};
+
+#if defined(__linux__)
+inline perf_counters::perf_counters() {
+  static const std::uint32_t types[n_events] = {
+      PERF_TYPE_HARDWARE, PERF_TYPE_HARDWARE, PERF_TYPE_HW_CACHE,
+      PERF_TYPE_HARDWARE};
+  static const std::uint64_t configs[n_events] = {
+      PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES,
+      PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+          (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+      PERF_COUNT_HW_BRANCH_MISSES};
+  perf_event_attr attr;
+  for (int i = 0; i < n_events; ++i) {
+    fds_[i] = -1;
+    counts_[i] = -1;
+    if (!enabled()) {
+      continue;
+    }
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = types[i];
+    attr.config = configs[i];
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format =
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds_[i] = syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+  }
+}
+
+inline perf_counters::~perf_counters() {
+  for (int fd : fds_) {
+    if (fd != -1) {
+      close(fd);
+    }
+  }
+}
+
+inline void perf_counters::start() {
+  for (int fd : fds_) {
+    if (fd != -1) {
+      ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+      ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+}
+
+inline void perf_counters::stop() {
+  /* value, time enabled, time running */
+  std::uint64_t values[3];
+  for (int i = 0; i < n_events; ++i) {
+    if (fds_[i] != -1) {
+      ioctl(fds_[i], PERF_EVENT_IOC_DISABLE, 0);
+    }
+  }
+  for (int i = 0; i < n_events; ++i) {
+    counts_[i] = -1;
+    if (fds_[i] != -1 && read(fds_[i], values, sizeof(values)) ==
+                             static_cast<ssize_t>(sizeof(values))) {
+      counts_[i] = values[2] == 0 ? 0
+                                  : static_cast<double>(values[0]) *
+                                        values[1] / values[2];
+    }
+  }
+}
+#else
+inline perf_counters::perf_counters() {
+  for (int i = 0; i < n_events; ++i) {
+    fds_[i] = -1;
+    counts_[i] = -1;
+  }
+}
+
+inline perf_counters::~perf_counters() {}
+
+inline void perf_counters::start() {}
+
+inline void perf_counters::stop() {}
+#endif
+
+inline bool perf_counters::enabled() {
+  return std::getenv("ART_PERF_COUNTERS") != nullptr;
+}
+
+inline const char *perf_counters::name(int event) {
+  static const char *const names[n_events] = {"instructions", "LLC misses",
+                                              "dTLB misses", "branch misses"};
+  return names[event];
+}
+
+inline double perf_counters::count(int event) const { return counts_[event]; }
+
+inline void perf_counters::report(const char *label,
+                                  std::size_t n_ops) const {
+  if (!enabled()) {
+    return;
+  }
+  std::fprintf(stderr, "%s:", label);
+  for (int i = 0; i < n_events; ++i) {
+    if (counts_[i] < 0) {
+      std::fprintf(stderr, " %s unavailable", name(i));
+    } else {
+      std::fprintf(stderr, " %.2f %s/op",
+                   n_ops == 0 ? 0 : counts_[i] / n_ops, name(i));
+    }
+    std::fprintf(stderr, i + 1 < n_events ? "," : "\n");
+  }
+}
+
+inline perf_scope::perf_scope(const char *label, std::size_t n_ops)
+    : label_(label), n_ops_(n_ops) {
+  counters_.start();
+}
+
+inline perf_scope::~perf_scope() {
+  counters_.stop();
+  counters_.report(label_, n_ops_);
+}
+
+} // namespace bench
+
+#endif
@@ -4,7 +4,9 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
+#include <algorithm>
 #include <functional>
 #include <map>
 #include <queue>
@@ -12,6 +14,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 
 using picobench::state;
 using std::string;
@@ -20,6 +23,7 @@ using std::hash;
 using std::mt19937_64;
 using std::map;
 using std::unordered_map;
+using std::vector;
 
 PICOBENCH_SUITE("query sparse uniform");
 
@@ -33,9 +37,17 @@ static void art_q_s_u(state &s) {
     m.set(to_string(h(rng1())).c_str(), v_ptr);
   }
   mt19937_64 rng2(0);
+  vector<string> keys;
   for (auto i __attribute__((unused)) : s) {
-    v_ptr = m.get(to_string(h(rng2())).c_str());
+    keys.push_back(to_string(h(rng2())));
   }
+  uintptr_t sum = 0;
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    /* consume the result, the lookups are otherwise optimized away */
+    sum += reinterpret_cast<uintptr_t>(m.get(keys[i].c_str()));
+  }
+  s.set_result(sum);
 }
 PICOBENCH(art_q_s_u)
   /* .iterations({4000000}) */
@@ -50,8 +62,13 @@ static void red_black_q_s_u(state &s) {
     m[to_string(h(rng1()))] = v;
   }
   mt19937_64 rng2(0);
+  vector<string> keys;
   for (auto i __attribute__((unused)) : s) {
-    v = m[to_string(h(rng2()))];
+    keys.push_back(to_string(h(rng2())));
+  }
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    v = m[keys[i]];
   }
 }
 PICOBENCH(red_black_q_s_u)
@@ -67,10 +84,109 @@ static void hashmap_q_s_u(state &s) {
     m[to_string(h(rng1()))] = v;
   }
   mt19937_64 rng2(0);
+  vector<string> keys;
   for (auto i __attribute__((unused)) : s) {
-    v = m[to_string(h(rng2()))];
+    keys.push_back(to_string(h(rng2())));
+  }
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    v = m[keys[i]];
   }
 }
 PICOBENCH(hashmap_q_s_u)
   /* .iterations({4000000}) */
   ;
+
+static void art_q_s_u_multi(state &s) {
+  art::art<int> m;
+  hash<uint32_t> h;
+  int v = 1;
+  int *v_ptr = &v;
+  mt19937_64 rng1(0);
+  for (auto i __attribute__((unused)) : s) {
+    m.set(to_string(h(rng1())).c_str(), v_ptr);
+  }
+  mt19937_64 rng2(0);
+  vector<string> keys;
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(to_string(h(rng2())));
+  }
+  vector<const char *> key_ptrs;
+  for (const string &k : keys) {
+    key_ptrs.push_back(k.c_str());
+  }
+  /* request handlers look up batches of keys */
+  const size_t batch_len = 64;
+  int *values[batch_len];
+  uintptr_t sum = 0;
+  s.start_timer();
+  {
+    bench::perf_scope counters(__func__, s.iterations());
+    for (size_t i = 0; i < key_ptrs.size(); i += batch_len) {
+      size_t n = std::min(batch_len, key_ptrs.size() - i);
+      m.multi_get(key_ptrs.data() + i, n, values);
+      for (size_t j = 0; j < n; ++j) {
+        sum += reinterpret_cast<uintptr_t>(values[j]);
+      }
+    }
+  }
+  s.stop_timer();
+  s.set_result(sum);
+}
+PICOBENCH(art_q_s_u_multi)
+  /* .iterations({4000000}) */
+  ;
+
+/*
+ * Every key has its own value, which is read by every lookup. art stores
+ * pointers to values allocated one by one, value_art stores the values in
+ * their leaves. The keys are looked up in random order.
+ */
+static void delete_value(int *v) { delete v; }
+
+static void art_q_s_u_deref(state &s) {
+  art::art<int> m(delete_value);
+  hash<uint32_t> h;
+  mt19937_64 rng1(0);
+  for (auto i : s) {
+    /* frees the value replaced by a duplicate key */
+    delete m.set(to_string(h(rng1())).c_str(), new int(i));
+  }
+  mt19937_64 rng2(0);
+  vector<string> keys;
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(to_string(h(rng2())));
+  }
+  /* not in the order of the allocations */
+  std::shuffle(keys.begin(), keys.end(), rng2);
+  uintptr_t sum = 0;
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    sum += *m.get(keys[i].c_str());
+  }
+  s.set_result(sum);
+}
+PICOBENCH(art_q_s_u_deref);
+
+static void art_value_q_s_u(state &s) {
+  art::value_art<int> m;
+  hash<uint32_t> h;
+  mt19937_64 rng1(0);
+  for (auto i : s) {
+    m.set(to_string(h(rng1())).c_str(), i);
+  }
+  mt19937_64 rng2(0);
+  vector<string> keys;
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(to_string(h(rng2())));
+  }
+  /* not in the order of the allocations */
+  std::shuffle(keys.begin(), keys.end(), rng2);
+  uintptr_t sum = 0;
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    sum += *m.get(keys[i].c_str());
+  }
+  s.set_result(sum);
+}
+PICOBENCH(art_value_q_s_u);
@@ -4,6 +4,7 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
 #include <functional>
 #include <map>
@@ -12,6 +13,7 @@
 #include <string>
 #include <unordered_map>
 #include <utility>
+#include <vector>
 #include <cstring>
 
 using picobench::state;
@@ -21,6 +23,7 @@ using std::mt19937_64;
 using std::string;
 using std::to_string;
 using std::unordered_map;
+using std::vector;
 
 PICOBENCH_SUITE("query sparse uniform base 64 keys");
 
@@ -36,14 +39,47 @@ static void art_q_s_u(state &s) {
     m.set(to_base64(to_string(h(rng1()))).c_str(), v_ptr);
   }
   mt19937_64 rng2(0);
+  vector<string> keys;
   for (auto i __attribute__((unused)) : s) {
-    v_ptr = m.get(to_base64(to_string(h(rng2()))).c_str());
+    keys.push_back(to_base64(to_string(h(rng2()))));
   }
+  uintptr_t sum = 0;
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    /* consume the result, the lookups are otherwise optimized away */
+    sum += reinterpret_cast<uintptr_t>(m.get(keys[i].c_str()));
+  }
+  s.set_result(sum);
 }
 PICOBENCH(art_q_s_u)
 /* .iterations({4000000}) */
 ;
 
+static void art_bucket_q_s_u(state &s) {
+  art::bucket_art<int> m;
+  hash<uint32_t> h;
+  int v = 1;
+  int *v_ptr = &v;
+  mt19937_64 rng1(0);
+  for (auto i __attribute__((unused)) : s) {
+    m.set(to_base64(to_string(h(rng1()))).c_str(), v_ptr);
+  }
+  mt19937_64 rng2(0);
+  vector<string> keys;
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(to_base64(to_string(h(rng2()))));
+  }
+  uintptr_t sum = 0;
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    sum += reinterpret_cast<uintptr_t>(m.get(keys[i].c_str()));
+  }
+  s.set_result(sum);
+}
+PICOBENCH(art_bucket_q_s_u)
+/* .iterations({4000000}) */
+;
+
 static void red_black_q_s_u(state &s) {
   map<string, int> m;
   hash<uint32_t> h;
@@ -53,8 +89,13 @@ static void red_black_q_s_u(state &s) {
     m[to_base64(to_string(h(rng1())))] = v;
   }
   mt19937_64 rng2(0);
+  vector<string> keys;
   for (auto i __attribute__((unused)) : s) {
-    v = m[to_base64(to_string(h(rng2())))];
+    keys.push_back(to_base64(to_string(h(rng2()))));
+  }
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    v = m[keys[i]];
   }
 }
 PICOBENCH(red_black_q_s_u)
@@ -70,8 +111,13 @@ static void hashmap_q_s_u(state &s) {
     m[to_base64(to_string(h(rng1())))] = v;
   }
   mt19937_64 rng2(0);
+  vector<string> keys;
   for (auto i __attribute__((unused)) : s) {
-    v = m[to_base64(to_string(h(rng2())))];
+    keys.push_back(to_base64(to_string(h(rng2()))));
+  }
+  bench::perf_scope counters(__func__, s.iterations());
+  for (auto i : s) {
+    v = m[keys[i]];
   }
 }
 PICOBENCH(hashmap_q_s_u)
@@ -0,0 +1,78 @@
+/**
+ * @file query microbenchmarks with integer keys
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "picobench/picobench.hpp"
+#include <cstdint>
+#include <map>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+using picobench::state;
+using std::mt19937_64;
+using std::map;
+using std::unordered_map;
+using std::vector;
+
+PICOBENCH_SUITE("query sparse uniform integer keys");
+
+static void art_q_s_u_int(state &s) {
+  art::int_art<uint64_t, int> m;
+  int v = 1;
+  int *v_ptr = &v;
+  mt19937_64 rng1(0);
+  for (auto i __attribute__((unused)) : s) {
+    m.set(rng1(), v_ptr);
+  }
+  mt19937_64 rng2(0);
+  vector<uint64_t> keys;
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(rng2());
+  }
+  uintptr_t sum = 0;
+  for (auto i : s) {
+    /* consume the result, the lookups are otherwise optimized away */
+    sum += reinterpret_cast<uintptr_t>(m.get(keys[i]));
+  }
+  s.set_result(sum);
+}
+PICOBENCH(art_q_s_u_int);
+
+static void red_black_q_s_u_int(state &s) {
+  map<uint64_t, int> m;
+  int v = 1;
+  mt19937_64 rng1(0);
+  for (auto i __attribute__((unused)) : s) {
+    m[rng1()] = v;
+  }
+  mt19937_64 rng2(0);
+  vector<uint64_t> keys;
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(rng2());
+  }
+  for (auto i : s) {
+    v = m[keys[i]];
+  }
+}
+PICOBENCH(red_black_q_s_u_int);
+
+static void hashmap_q_s_u_int(state &s) {
+  unordered_map<uint64_t, int> m;
+  int v = 1;
+  mt19937_64 rng1(0);
+  for (auto i __attribute__((unused)) : s) {
+    m[rng1()] = v;
+  }
+  mt19937_64 rng2(0);
+  vector<uint64_t> keys;
+  for (auto i __attribute__((unused)) : s) {
+    keys.push_back(rng2());
+  }
+  for (auto i : s) {
+    v = m[keys[i]];
+  }
+}
+PICOBENCH(hashmap_q_s_u_int);
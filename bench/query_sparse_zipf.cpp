@@ -4,6 +4,7 @@
  */
 
 #include "art.hpp"
+#include "perf_counters.hpp"
 #include "picobench/picobench.hpp"
 #include "zipf.hpp"
 #include <functional>
@@ -32,6 +33,7 @@ static void art_q_s_z(state &s) {
     m.set(to_string(h(rng1())).c_str(), v_ptr);
   }
   fast_zipf rng2(1000000);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     v_ptr = m.get(to_string(h(rng2())).c_str());
   }
@@ -47,6 +49,7 @@ static void red_black_q_s_z(state &s) {
     m[to_string(h(rng1()))] = v;
   }
   fast_zipf rng2(1000000);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     v = m[to_string(h(rng2()))];
   }
@@ -62,6 +65,7 @@ static void hashmap_q_s_z(state &s) {
     m[to_string(h(rng1()))] = v;
   }
   fast_zipf rng2(1000000);
+  bench::perf_scope counters(__func__, s.iterations());
   for (auto i __attribute__((unused)) : s) {
     v = m[to_string(h(rng2()))];
   }
@@ -0,0 +1,387 @@
+/**
+ * @file YCSB-style benchmark driver
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ *
+ * Loads keys from a file with one key per line, e.g. URLs, emails, integer
+ * ids or Wikipedia titles, or generates random ones, and runs the YCSB core
+ * workloads on art::art, std::map and std::unordered_map:
+ *
+ *   A: 50% reads, 50% updates
+ *   B: 95% reads, 5% updates
+ *   C: 100% reads
+ *   D: 95% reads of the latest keys, 5% inserts
+ *   E: 95% scans of 1 to 100 keys, 5% inserts
+ *   F: 50% reads, 50% read-modify-writes
+ *
+ * Reads and updates pick keys with a zipf distribution over the loaded keys
+ * (which are shuffled, so the hot keys are spread over the key space) or a
+ * uniform one. Every run is executed in its own process, so that the peak
+ * RSS belongs to a single structure. For every run, the driver prints the
+ * throughput, the 50th, 99th and 99.9th percentile and maximum latency of
+ * an operation, the peak RSS, which includes the keys, and the RSS growth
+ * per key while loading (and the allocated bytes per key for art). With
+ * ART_PERF_COUNTERS set, the hardware events per operation are printed to
+ * stderr, see perf_counters.hpp.
+ *
+ *   ycsb [--keys FILE] [--n N] [--ops N] [--workload A-F|all]
+ *        [--structure art|map|unordered_map|all]
+ *        [--distribution zipf|uniform] [--skew S] [--seed S]
+ */
+
+#include "art.hpp"
+#include "perf_counters.hpp"
+#include "zipf.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+namespace {
+
+/* keeps the reads from being optimized away */
+volatile std::uintptr_t sink;
+
+struct options {
+  string keys_file;
+  std::size_t n = 1000000;
+  std::size_t n_ops = 1000000;
+  string workloads = "ABCDEF";
+  vector<string> structures = {"art", "map", "unordered_map"};
+  bool zipf = true;
+  double skew = 0.99;
+  uint32_t seed = 0;
+};
+
+struct workload {
+  char name;
+  double read, update, insert, scan, read_modify_write;
+  /* reads prefer the latest inserted keys */
+  bool latest;
+};
+
+const workload workloads[] = {
+    {'A', 0.5, 0.5, 0, 0, 0, false},    {'B', 0.95, 0.05, 0, 0, 0, false},
+    {'C', 1, 0, 0, 0, 0, false},        {'D', 0.95, 0, 0.05, 0, 0, true},
+    {'E', 0, 0, 0.05, 0.95, 0, false},  {'F', 0.5, 0, 0, 0, 0.5, false},
+};
+
+/*
+ * The structures under test, with the same interface. scan visits up to n
+ * keys from the given one and returns false if the structure has no order.
+ */
+struct art_index {
+  static const char *name() { return "art"; }
+  void insert(const string &key, int *value) { m_.set(key.c_str(), value); }
+  int *read(const string &key) { return m_.get(key.c_str()); }
+  bool scan(const string &key, int n, std::uintptr_t &sum) {
+    auto it = m_.begin(key.c_str()), it_end = m_.end();
+    for (int i = 0; i < n && it != it_end; ++i, ++it) {
+      sum += reinterpret_cast<std::uintptr_t>(*it);
+    }
+    return true;
+  }
+  double bytes_per_key() const { return m_.stats().bytes_per_key(); }
+
+  art::art<int> m_;
+};
+
+struct map_index {
+  static const char *name() { return "map"; }
+  void insert(const string &key, int *value) { m_[key] = value; }
+  int *read(const string &key) {
+    auto it = m_.find(key);
+    return it != m_.end() ? it->second : nullptr;
+  }
+  bool scan(const string &key, int n, std::uintptr_t &sum) {
+    auto it = m_.lower_bound(key);
+    for (int i = 0; i < n && it != m_.end(); ++i, ++it) {
+      sum += reinterpret_cast<std::uintptr_t>(it->second);
+    }
+    return true;
+  }
+  /* not known without a counting allocator */
+  double bytes_per_key() const { return -1; }
+
+  std::map<string, int *> m_;
+};
+
+struct unordered_map_index {
+  static const char *name() { return "unordered_map"; }
+  void insert(const string &key, int *value) { m_[key] = value; }
+  int *read(const string &key) {
+    auto it = m_.find(key);
+    return it != m_.end() ? it->second : nullptr;
+  }
+  bool scan(const string &, int, std::uintptr_t &) { return false; }
+  double bytes_per_key() const { return -1; }
+
+  std::unordered_map<string, int *> m_;
+};
+
+/* resident set size in bytes */
+std::size_t current_rss() {
+  long pages = 0, resident = 0;
+  FILE *f = std::fopen("/proc/self/statm", "r");
+  if (f != nullptr) {
+    if (std::fscanf(f, "%ld %ld", &pages, &resident) != 2) {
+      resident = 0;
+    }
+    std::fclose(f);
+  }
+  return static_cast<std::size_t>(resident) * sysconf(_SC_PAGESIZE);
+}
+
+/* peak resident set size in bytes */
+std::size_t peak_rss() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  /* kilobytes on Linux */
+  return static_cast<std::size_t>(usage.ru_maxrss) * 1024;
+}
+
+/* random keys like user ids, used without a key file */
+vector<string> generate_keys(std::size_t n, uint32_t seed) {
+  std::mt19937_64 g(seed);
+  vector<string> keys;
+  keys.reserve(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    keys.push_back("user" + std::to_string(g()));
+  }
+  return keys;
+}
+
+vector<string> load_keys(const options &opts) {
+  vector<string> keys;
+  if (opts.keys_file.empty()) {
+    keys = generate_keys(opts.n, opts.seed);
+  } else {
+    std::ifstream file(opts.keys_file);
+    if (!file) {
+      throw std::runtime_error("cannot open " + opts.keys_file);
+    }
+    string line;
+    while (keys.size() < opts.n && std::getline(file, line)) {
+      if (!line.empty()) {
+        keys.push_back(line);
+      }
+    }
+  }
+  /* duplicates would be updates instead of inserts */
+  std::sort(keys.begin(), keys.end());
+  keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+  std::shuffle(keys.begin(), keys.end(), std::mt19937_64(opts.seed));
+  return keys;
+}
+
+double percentile(const vector<uint32_t> &sorted, double p) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  std::size_t i = static_cast<std::size_t>(p * (sorted.size() - 1));
+  return sorted[i];
+}
+
+/*
+ * Loads all but the keys reserved for inserts, then runs the workload and
+ * prints one line. Returns false if the structure can't run the workload.
+ */
+template <class Index>
+bool run(const options &opts, const vector<string> &keys, const workload &w) {
+  /* inserts take the keys after the loaded ones */
+  std::size_t n_inserts = static_cast<std::size_t>(w.insert * opts.n_ops);
+  if (n_inserts >= keys.size()) {
+    throw std::runtime_error("not enough keys for the inserts");
+  }
+  std::size_t n_loaded = keys.size() - n_inserts;
+  int value = 1;
+  std::size_t rss_before = current_rss();
+  Index index;
+  for (std::size_t i = 0; i < n_loaded; ++i) {
+    index.insert(keys[i], &value);
+  }
+  std::size_t rss_growth = current_rss() - rss_before;
+
+  fast_zipf zipf(n_loaded, opts.skew, opts.seed);
+  std::mt19937_64 g(opts.seed);
+  std::uniform_real_distribution<double> op_dist(0, 1);
+  std::uniform_int_distribution<int> scan_len_dist(1, 100);
+  auto next_rank = [&]() -> std::size_t {
+    std::size_t rank = opts.zipf ? zipf() : g() % n_loaded;
+    return std::min(rank, n_loaded - 1);
+  };
+
+  vector<uint32_t> latencies;
+  latencies.reserve(opts.n_ops);
+  std::size_t n_keys = n_loaded;
+  std::uintptr_t sum = 0;
+  double op;
+  using clock = std::chrono::steady_clock;
+  bench::perf_counters counters;
+  counters.start();
+  clock::time_point begin = clock::now(), op_begin, op_end;
+  for (std::size_t i = 0; i < opts.n_ops; ++i) {
+    op = op_dist(g);
+    op_begin = clock::now();
+    if (op < w.read) {
+      /* the latest keys are ranked by their distance from the last one */
+      const string &key =
+          w.latest ? keys[n_keys - 1 - std::min(next_rank(), n_keys - 1)]
+                   : keys[next_rank()];
+      sum += reinterpret_cast<std::uintptr_t>(index.read(key));
+    } else if (op < w.read + w.update) {
+      index.insert(keys[next_rank()], &value);
+    } else if (op < w.read + w.update + w.insert) {
+      index.insert(keys[n_keys < keys.size() ? n_keys++ : next_rank()],
+                   &value);
+    } else if (op < w.read + w.update + w.insert + w.scan) {
+      if (!index.scan(keys[next_rank()], scan_len_dist(g), sum)) {
+        return false;
+      }
+    } else {
+      const string &key = keys[next_rank()];
+      int *old_value = index.read(key);
+      index.insert(key, old_value != nullptr ? old_value : &value);
+    }
+    op_end = clock::now();
+    latencies.push_back(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(op_end - op_begin)
+            .count());
+  }
+  double seconds =
+      std::chrono::duration<double>(clock::now() - begin).count();
+  counters.stop();
+  std::sort(latencies.begin(), latencies.end());
+
+  char alloc_bytes_per_key[16] = "-";
+  if (index.bytes_per_key() >= 0) {
+    std::snprintf(alloc_bytes_per_key, sizeof(alloc_bytes_per_key), "%.1f",
+                  index.bytes_per_key());
+  }
+  std::printf("%-14s %c %10zu %12.0f %8.0f %8.0f %8.0f %10u %10.1f %10.1f "
+              "%10s\n",
+              Index::name(), w.name, n_loaded, opts.n_ops / seconds,
+              percentile(latencies, 0.5), percentile(latencies, 0.99),
+              percentile(latencies, 0.999), latencies.back(),
+              peak_rss() / 1048576.0,
+              static_cast<double>(rss_growth) / n_loaded,
+              alloc_bytes_per_key);
+  std::fflush(stdout);
+  /* includes the timing of every operation */
+  counters.report((string(Index::name()) + ' ' + w.name).c_str(), opts.n_ops);
+  sink = sum;
+  return true;
+}
+
+/* runs the workload in a child process, which owns the peak RSS */
+void run_isolated(const options &opts, const vector<string> &keys,
+                  const string &structure, const workload &w) {
+  std::fflush(stdout);
+  pid_t pid = fork();
+  if (pid < 0) {
+    throw std::runtime_error("fork failed");
+  }
+  if (pid == 0) {
+    bool ran;
+    if (structure == "art") {
+      ran = run<art_index>(opts, keys, w);
+    } else if (structure == "map") {
+      ran = run<map_index>(opts, keys, w);
+    } else {
+      ran = run<unordered_map_index>(opts, keys, w);
+    }
+    if (!ran) {
+      std::printf("%-14s %c (unordered, no scans)\n", structure.c_str(),
+                  w.name);
+    }
+    std::fflush(stdout);
+    std::_Exit(0);
+  }
+  int status;
+  waitpid(pid, &status, 0);
+}
+
+options parse(int argc, char *argv[]) {
+  options opts;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (i + 1 == argc) {
+      throw std::invalid_argument("missing value of " + arg);
+    }
+    string value = argv[++i];
+    if (arg == "--keys") {
+      opts.keys_file = value;
+    } else if (arg == "--n") {
+      opts.n = std::stoull(value);
+    } else if (arg == "--ops") {
+      opts.n_ops = std::stoull(value);
+    } else if (arg == "--workload") {
+      opts.workloads = value == "all" ? "ABCDEF" : value;
+    } else if (arg == "--structure") {
+      if (value != "all") {
+        opts.structures = {value};
+      }
+    } else if (arg == "--distribution") {
+      opts.zipf = value == "zipf";
+    } else if (arg == "--skew") {
+      opts.skew = std::stod(value);
+    } else if (arg == "--seed") {
+      opts.seed = std::stoul(value);
+    } else {
+      throw std::invalid_argument("unknown option " + arg);
+    }
+  }
+  for (char w : opts.workloads) {
+    if (w < 'A' || w > 'F') {
+      throw std::invalid_argument(string("unknown workload ") + w);
+    }
+  }
+  for (const string &s : opts.structures) {
+    if (s != "art" && s != "map" && s != "unordered_map") {
+      throw std::invalid_argument("unknown structure " + s);
+    }
+  }
+  return opts;
+}
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  try {
+    options opts = parse(argc, argv);
+    vector<string> keys = load_keys(opts);
+    std::printf("%zu keys from %s, %zu operations, %s\n", keys.size(),
+                opts.keys_file.empty() ? "the generator"
+                                       : opts.keys_file.c_str(),
+                opts.n_ops,
+                opts.zipf ? ("zipf " + std::to_string(opts.skew)).c_str()
+                          : "uniform");
+    std::printf("%-14s %c %10s %12s %8s %8s %8s %10s %10s %10s %10s\n",
+                "structure", 'W', "keys", "ops/s", "p50 ns", "p99 ns",
+                "p999 ns", "max ns", "peak MB", "rss B/key", "alloc B/key");
+    for (char name : opts.workloads) {
+      for (const string &structure : opts.structures) {
+        run_isolated(opts, keys, structure, workloads[name - 'A']);
+      }
+    }
+  } catch (const std::exception &e) {
+    std::cerr << e.what() << std::endl;
+    return 1;
+  }
+  return 0;
+}
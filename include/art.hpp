@@ -6,15 +6,36 @@
 #ifndef ART_HPP
 #define ART_HPP
 
+#include "art/allocator.hpp"
 #include "art/art.hpp"
+#include "art/boxed_leaves.hpp"
+#include "art/bucket_art.hpp"
 #include "art/child_it.hpp"
+#include "art/durable_art.hpp"
+#include "art/epoch_allocator.hpp"
+#include "art/inline_leaves.hpp"
 #include "art/inner_node.hpp"
+#include "art/int_art.hpp"
+#include "art/key_encoder.hpp"
+#include "art/leaf_bucket.hpp"
 #include "art/leaf_node.hpp"
 #include "art/node.hpp"
 #include "art/node_16.hpp"
 #include "art/node_256.hpp"
 #include "art/node_4.hpp"
 #include "art/node_48.hpp"
+#include "art/olc_art.hpp"
+#include "art/optimistic_lock.hpp"
+#include "art/parallel.hpp"
+#include "art/persistent_art.hpp"
+#include "art/rowex_art.hpp"
+#include "art/shared_allocator.hpp"
+#include "art/sharded_art.hpp"
+#include "art/snapshot.hpp"
+#include "art/sync_art.hpp"
+#include "art/tagged_leaves.hpp"
 #include "art/tree_it.hpp"
+#include "art/tree_stats.hpp"
+#include "art/value_art.hpp"
 
 #endif
@@ -0,0 +1,565 @@
+/**
+ * @file allocator header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_ALLOCATOR_HPP
+#define ART_ALLOCATOR_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+#ifndef ART_CACHE_LINE_SIZE
+#define ART_CACHE_LINE_SIZE 64
+#endif
+
+namespace art {
+
+static const std::size_t cache_line_size = ART_CACHE_LINE_SIZE;
+
+static_assert(cache_line_size >= 64 &&
+                  (cache_line_size & (cache_line_size - 1)) == 0,
+              "ART_CACHE_LINE_SIZE must be a power of two of at least 64");
+
+/*
+ * Allocation policy for the nodes and prefixes of a tree.
+ *
+ * A policy is any class that provides:
+ *
+ *   void *allocate(std::size_t size);
+ *   void deallocate(void *p, std::size_t size);
+ *   static const bool bulk_release;
+ *
+ * allocate returns memory aligned for any node type and deallocate receives
+ * the size that was passed to allocate. An allocator that owns all of its
+ * memory and releases it on destruction sets bulk_release, so that the tree
+ * can skip the per node teardown.
+ *
+ * A policy may additionally provide
+ *
+ *   void *allocate(std::size_t size, std::size_t alignment);
+ *   void deallocate(void *p, std::size_t size, std::size_t alignment);
+ *
+ * which make and destroy use for the types whose allocation_alignment is
+ * greater than their alignof, e.g. to place the inner nodes on cache lines.
+ * Policies without them allocate such types at their natural alignment.
+ *
+ * A policy may also provide
+ *
+ *   std::size_t reserved_bytes() const;
+ *
+ * the number of bytes it holds from the system, including freed blocks it
+ * keeps for reuse, which art::compact reports the reduction of, and
+ *
+ *   void adopt(A &other);
+ *
+ * which takes over the memory of another instance, so that the blocks it
+ * allocated may be deallocated to this one, which art::merge uses to link
+ * the nodes of the other tree by pointer instead of copying them.
+ */
+
+/**
+ * Alignment at which make allocates instances of N, if the allocator
+ * supports it. Specialized for the inner nodes, see node_4.
+ */
+template <class N>
+struct allocation_alignment
+    : std::integral_constant<std::size_t, alignof(N)> {};
+
+template <class A>
+auto allocate_aligned(A &alloc, std::size_t size, std::size_t alignment, int)
+    -> decltype(alloc.allocate(size, alignment)) {
+  return alloc.allocate(size, alignment);
+}
+
+template <class A>
+void *allocate_aligned(A &alloc, std::size_t size, std::size_t /* alignment */,
+                       long) {
+  return alloc.allocate(size);
+}
+
+template <class A>
+auto deallocate_aligned(A &alloc, void *p, std::size_t size,
+                        std::size_t alignment, int)
+    -> decltype(alloc.deallocate(p, size, alignment)) {
+  alloc.deallocate(p, size, alignment);
+}
+
+template <class A>
+void deallocate_aligned(A &alloc, void *p, std::size_t size,
+                        std::size_t /* alignment */, long) {
+  alloc.deallocate(p, size);
+}
+
+/**
+ * Returns the bytes held by the allocator, see reserved_bytes above, or the
+ * given number of bytes in use if the allocator doesn't report them.
+ */
+template <class A>
+auto reserved_bytes(const A &alloc, std::size_t /* in_use */, int)
+    -> decltype(alloc.reserved_bytes()) {
+  return alloc.reserved_bytes();
+}
+
+template <class A>
+std::size_t reserved_bytes(const A & /* alloc */, std::size_t in_use, long) {
+  return in_use;
+}
+
+/**
+ * Lets alloc take over the memory of other, see adopt above, and returns
+ * true, or returns false if the allocator can't.
+ */
+template <class A>
+auto adopt(A &alloc, A &other, int) -> decltype(alloc.adopt(other), bool()) {
+  alloc.adopt(other);
+  return true;
+}
+
+template <class A> bool adopt(A & /* alloc */, A & /* other */, long) {
+  return false;
+}
+
+/**
+ * Allocates memory of the given size and alignment, a power of two, from
+ * the system. Released with aligned_delete.
+ */
+inline void *aligned_new(std::size_t size, std::size_t alignment) {
+  void *p;
+  if (posix_memalign(&p, std::max(alignment, sizeof(void *)), size) != 0) {
+    throw std::bad_alloc();
+  }
+  return p;
+}
+
+inline void aligned_delete(void *p) { std::free(p); }
+
+/**
+ * Allocates and constructs an instance of N.
+ */
+template <class N, class A, class... Args> N *make(A &alloc, Args &&... args) {
+  return new (allocate_aligned(alloc, sizeof(N),
+                               allocation_alignment<N>::value, 0))
+      N(std::forward<Args>(args)...);
+}
+
+/**
+ * Destructs and deallocates an instance of N that was created by make.
+ */
+template <class N, class A> void destroy(A &alloc, N *n) {
+  n->~N();
+  deallocate_aligned(alloc, n, sizeof(N), allocation_alignment<N>::value, 0);
+}
+
+/**
+ * Allocator that forwards every request to the global operator new.
+ */
+class heap_allocator {
+public:
+  static const bool bulk_release = false;
+
+  void *allocate(std::size_t size);
+  void deallocate(void *p, std::size_t size);
+  void *allocate(std::size_t size, std::size_t alignment);
+  void deallocate(void *p, std::size_t size, std::size_t alignment);
+
+  /**
+   * Does nothing, as the blocks of every heap_allocator are released by the
+   * global operator delete.
+   */
+  void adopt(heap_allocator &other);
+};
+
+/**
+ * Tells if the allocator policy A may be called by several threads at
+ * once, which lets art::parallel_clear deallocate nodes in parallel.
+ * Policies are assumed not to be unless specialized.
+ */
+template <class A> struct is_thread_safe_allocator : std::false_type {};
+
+template <> struct is_thread_safe_allocator<heap_allocator> : std::true_type {};
+
+inline void *heap_allocator::allocate(std::size_t size) {
+  return ::operator new(size);
+}
+
+inline void heap_allocator::deallocate(void *p, std::size_t /* size */) {
+  ::operator delete(p);
+}
+
+inline void *heap_allocator::allocate(std::size_t size,
+                                      std::size_t alignment) {
+  if (alignment <= alignof(std::max_align_t)) {
+    return allocate(size);
+  }
+  return aligned_new(size, alignment);
+}
+
+inline void heap_allocator::deallocate(void *p, std::size_t size,
+                                       std::size_t alignment) {
+  if (alignment <= alignof(std::max_align_t)) {
+    deallocate(p, size);
+  } else {
+    aligned_delete(p);
+  }
+}
+
+inline void heap_allocator::adopt(heap_allocator & /* other */) {}
+
+/**
+ * Size-class pool allocator.
+ *
+ * Requests are rounded up to a multiple of 8 bytes and served from the
+ * freelist of their size class, or carved out of the current chunk if the
+ * freelist is empty. Memory is only returned to the system when the pool
+ * is released or destroyed, which takes time linear in the number of chunks.
+ * Requests larger than max_size bypass the size classes but are still
+ * released together with the pool.
+ *
+ * Requests with an alignment, up to cache_line_size, are carved out at the
+ * next aligned address, handing the skipped bytes to their size class, and
+ * are reused through separate freelists, so that freed aligned blocks only
+ * serve aligned requests. Requests larger than max_size are always aligned
+ * to a cache line.
+ */
+class pool_allocator {
+public:
+  static const bool bulk_release = true;
+
+  static const std::size_t granularity = 8;
+  static const std::size_t max_size = 4096;
+  static const std::size_t chunk_size = 64 * 1024;
+
+  pool_allocator() = default;
+  pool_allocator(const pool_allocator &other) = delete;
+  pool_allocator &operator=(const pool_allocator &other) = delete;
+
+  /**
+   * Takes over the chunks of the other pool, which is left empty.
+   */
+  pool_allocator(pool_allocator &&other) noexcept;
+  pool_allocator &operator=(pool_allocator &&other) noexcept;
+  ~pool_allocator();
+
+  void *allocate(std::size_t size);
+  void deallocate(void *p, std::size_t size);
+
+  /**
+   * @throws std::bad_alloc if alignment is greater than cache_line_size.
+   */
+  void *allocate(std::size_t size, std::size_t alignment);
+  void deallocate(void *p, std::size_t size, std::size_t alignment);
+
+  /**
+   * Releases every chunk back to the system.
+   * All memory previously returned by allocate becomes invalid.
+   */
+  void release();
+
+  /**
+   * Number of chunks currently held by the pool.
+   */
+  std::size_t n_chunks() const;
+
+  /**
+   * Bytes of the chunks and large blocks held by the pool.
+   */
+  std::size_t reserved_bytes() const;
+
+  /**
+   * Takes over the chunks, large blocks and freed blocks of the other pool,
+   * which is left empty, so that the memory allocated by the other pool may
+   * be deallocated to this one and is released with it. Takes time linear
+   * in the number of blocks the other pool holds.
+   */
+  void adopt(pool_allocator &other);
+
+private:
+  static const std::size_t n_classes = max_size / granularity;
+
+  struct free_block {
+    free_block *next_;
+  };
+
+  /* header of chunks and large blocks, which keeps them aligned */
+  struct block {
+    block *prev_;
+    block *next_;
+    char padding_[cache_line_size - 2 * sizeof(block *)];
+  };
+
+  static std::size_t size_class(std::size_t size);
+
+  void *allocate_large(std::size_t size);
+  void deallocate_large(void *p, std::size_t size);
+  void new_chunk();
+
+  /* forgets the blocks of the pool, which another pool took over */
+  void forget();
+
+  static void splice(free_block *&list, free_block *other);
+
+  free_block *free_lists_[n_classes] = {};
+  free_block *aligned_free_lists_[n_classes] = {};
+  block *chunks_ = nullptr;
+  block *large_blocks_ = nullptr;
+  char *cur_ = nullptr;
+  char *end_ = nullptr;
+  std::size_t n_chunks_ = 0;
+  std::size_t large_bytes_ = 0;
+};
+
+inline pool_allocator::pool_allocator(pool_allocator &&other) noexcept {
+  *this = std::move(other);
+}
+
+inline pool_allocator &
+pool_allocator::operator=(pool_allocator &&other) noexcept {
+  if (this != &other) {
+    release();
+    std::copy(other.free_lists_, other.free_lists_ + n_classes, free_lists_);
+    std::copy(other.aligned_free_lists_, other.aligned_free_lists_ + n_classes,
+              aligned_free_lists_);
+    chunks_ = other.chunks_;
+    large_blocks_ = other.large_blocks_;
+    cur_ = other.cur_;
+    end_ = other.end_;
+    n_chunks_ = other.n_chunks_;
+    large_bytes_ = other.large_bytes_;
+    other.forget();
+  }
+  return *this;
+}
+
+inline pool_allocator::~pool_allocator() { release(); }
+
+inline std::size_t pool_allocator::size_class(std::size_t size) {
+  return (size + granularity - 1) / granularity - 1;
+}
+
+inline void *pool_allocator::allocate(std::size_t size) {
+  if (size == 0) {
+    size = 1;
+  }
+  if (size > max_size) {
+    return allocate_large(size);
+  }
+  std::size_t c = size_class(size);
+  free_block *head = free_lists_[c];
+  if (head != nullptr) {
+    /* freelist pop */
+    free_lists_[c] = head->next_;
+    return head;
+  }
+  std::size_t rounded = (c + 1) * granularity;
+  if (static_cast<std::size_t>(end_ - cur_) < rounded) {
+    new_chunk();
+  }
+  void *p = cur_;
+  cur_ += rounded;
+  return p;
+}
+
+inline void pool_allocator::deallocate(void *p, std::size_t size) {
+  if (p == nullptr) {
+    return;
+  }
+  if (size == 0) {
+    size = 1;
+  }
+  if (size > max_size) {
+    deallocate_large(p, size);
+    return;
+  }
+  std::size_t c = size_class(size);
+  free_block *b = static_cast<free_block *>(p);
+  b->next_ = free_lists_[c];
+  free_lists_[c] = b;
+}
+
+inline void *pool_allocator::allocate(std::size_t size,
+                                      std::size_t alignment) {
+  if (alignment <= granularity) {
+    return allocate(size);
+  }
+  if (alignment > cache_line_size) {
+    throw std::bad_alloc();
+  }
+  if (size > max_size) {
+    return allocate_large(size);
+  }
+  std::size_t c = size_class(size);
+  free_block *head = aligned_free_lists_[c];
+  if (head != nullptr) {
+    aligned_free_lists_[c] = head->next_;
+    return head;
+  }
+  std::size_t rounded = (c + 1) * granularity;
+  std::size_t padding =
+      (alignment - reinterpret_cast<std::uintptr_t>(cur_) % alignment) %
+      alignment;
+  if (static_cast<std::size_t>(end_ - cur_) < padding + rounded) {
+    /* chunks start at a cache line */
+    new_chunk();
+    padding = 0;
+  }
+  if (padding != 0) {
+    deallocate(cur_, padding);
+    cur_ += padding;
+  }
+  void *p = cur_;
+  cur_ += rounded;
+  return p;
+}
+
+inline void pool_allocator::deallocate(void *p, std::size_t size,
+                                       std::size_t alignment) {
+  if (p == nullptr || alignment <= granularity || size > max_size) {
+    deallocate(p, size);
+    return;
+  }
+  std::size_t c = size_class(size);
+  free_block *b = static_cast<free_block *>(p);
+  b->next_ = aligned_free_lists_[c];
+  aligned_free_lists_[c] = b;
+}
+
+inline void pool_allocator::release() {
+  while (chunks_ != nullptr) {
+    block *next = chunks_->next_;
+    aligned_delete(chunks_);
+    chunks_ = next;
+  }
+  while (large_blocks_ != nullptr) {
+    block *next = large_blocks_->next_;
+    aligned_delete(large_blocks_);
+    large_blocks_ = next;
+  }
+  std::fill(free_lists_, free_lists_ + n_classes, nullptr);
+  std::fill(aligned_free_lists_, aligned_free_lists_ + n_classes, nullptr);
+  cur_ = end_ = nullptr;
+  n_chunks_ = 0;
+  large_bytes_ = 0;
+}
+
+inline void pool_allocator::adopt(pool_allocator &other) {
+  if (this == &other) {
+    return;
+  }
+  /* keep the current chunk with more room, hand the rest of the other one
+   * to the size classes */
+  char *cur = other.cur_, *end = other.end_;
+  if (end - cur > end_ - cur_) {
+    std::swap(cur, cur_);
+    std::swap(end, end_);
+  }
+  for (std::size_t size; static_cast<std::size_t>(end - cur) >= granularity;
+       cur += size) {
+    size = end - cur;
+    size = size > max_size ? max_size : size;
+    deallocate(cur, size);
+  }
+  for (std::size_t c = 0; c < n_classes; ++c) {
+    splice(free_lists_[c], other.free_lists_[c]);
+    splice(aligned_free_lists_[c], other.aligned_free_lists_[c]);
+  }
+  if (other.chunks_ != nullptr) {
+    block *last = other.chunks_;
+    while (last->next_ != nullptr) {
+      last = last->next_;
+    }
+    last->next_ = chunks_;
+    chunks_ = other.chunks_;
+  }
+  if (other.large_blocks_ != nullptr) {
+    block *last = other.large_blocks_;
+    while (last->next_ != nullptr) {
+      last = last->next_;
+    }
+    last->next_ = large_blocks_;
+    if (large_blocks_ != nullptr) {
+      large_blocks_->prev_ = last;
+    }
+    large_blocks_ = other.large_blocks_;
+  }
+  n_chunks_ += other.n_chunks_;
+  large_bytes_ += other.large_bytes_;
+  other.forget();
+}
+
+inline std::size_t pool_allocator::n_chunks() const { return n_chunks_; }
+
+inline std::size_t pool_allocator::reserved_bytes() const {
+  return n_chunks_ * chunk_size + large_bytes_;
+}
+
+inline void pool_allocator::new_chunk() {
+  /* hand the tail of the current chunk to its size class */
+  std::size_t tail = end_ - cur_;
+  if (tail >= granularity) {
+    deallocate(cur_, tail);
+  }
+  block *c = static_cast<block *>(aligned_new(chunk_size, cache_line_size));
+  c->prev_ = nullptr;
+  c->next_ = chunks_;
+  chunks_ = c;
+  cur_ = reinterpret_cast<char *>(c) + sizeof(block);
+  end_ = reinterpret_cast<char *>(c) + chunk_size;
+  ++n_chunks_;
+}
+
+inline void pool_allocator::forget() {
+  std::fill(free_lists_, free_lists_ + n_classes, nullptr);
+  std::fill(aligned_free_lists_, aligned_free_lists_ + n_classes, nullptr);
+  chunks_ = large_blocks_ = nullptr;
+  cur_ = end_ = nullptr;
+  n_chunks_ = large_bytes_ = 0;
+}
+
+inline void pool_allocator::splice(free_block *&list, free_block *other) {
+  if (other == nullptr) {
+    return;
+  }
+  free_block *last = other;
+  while (last->next_ != nullptr) {
+    last = last->next_;
+  }
+  last->next_ = list;
+  list = other;
+}
+
+inline void *pool_allocator::allocate_large(std::size_t size) {
+  block *b = static_cast<block *>(
+      aligned_new(sizeof(block) + size, cache_line_size));
+  b->prev_ = nullptr;
+  b->next_ = large_blocks_;
+  if (large_blocks_ != nullptr) {
+    large_blocks_->prev_ = b;
+  }
+  large_blocks_ = b;
+  large_bytes_ += sizeof(block) + size;
+  return b + 1;
+}
+
+inline void pool_allocator::deallocate_large(void *p, std::size_t size) {
+  block *b = static_cast<block *>(p) - 1;
+  if (b->prev_ != nullptr) {
+    b->prev_->next_ = b->next_;
+  } else {
+    large_blocks_ = b->next_;
+  }
+  if (b->next_ != nullptr) {
+    b->next_->prev_ = b->prev_;
+  }
+  large_bytes_ -= sizeof(block) + size;
+  aligned_delete(b);
+}
+
+} // namespace art
+
+#endif
@@ -6,21 +6,85 @@
 #ifndef ART_ART_HPP
 #define ART_ART_HPP
 
+#include "allocator.hpp"
+#include "boxed_leaves.hpp"
+#include "inline_leaves.hpp"
 #include "leaf_node.hpp"
 #include "inner_node.hpp"
 #include "node.hpp"
+#include "node_16.hpp"
+#include "node_256.hpp"
 #include "node_4.hpp"
+#include "node_48.hpp"
+#include "parallel.hpp"
+#include "tagged_leaves.hpp"
 #include "tree_it.hpp"
+#include "tree_stats.hpp"
 #include <algorithm>
+#include <cstddef>
+#include <cstring>
 #include <functional>
+#include <iosfwd>
 #include <iostream>
 #include <stack>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
 
 namespace art {
 
-template <class T> class art {
+/**
+ * Adaptive radix tree.
+ *
+ * @tparam T - The type of the values, which are stored by pointer.
+ * @tparam A - The allocator used for nodes and prefixes, see allocator.
+ * @tparam K - Optional key extractor, see tagged_leaves. Without one, every
+ * value is stored in a separately allocated leaf_node<T> holding the rest of
+ * its key. With one, values are stored in their parent's child slot and
+ * their keys are read through the extractor instead. inline_values stores
+ * the values themselves in the leaves and is meant for value_art: set,
+ * update and del can't return the old value by pointer, and the free
+ * function would be passed a value in a leaf, so they don't compile with it.
+ *
+ * Keys are byte strings. The `const char *` overloads take NUL-terminated
+ * keys and treat the terminator as the last byte of the key, so that no key
+ * is a prefix of another. The overloads taking an explicit length (or a
+ * `std::string_view` with C++17) use exactly the given bytes, which may
+ * contain zeros, and don't scan the key. Since a key ending in an inner node
+ * has no place to store its value, the keys of a tree must be prefix-free:
+ * no key may be a proper prefix of another key. Fixed length keys like
+ * big-endian integers always are.
+ */
+template <class T, class A = pool_allocator, class K = void> class art {
+  using leaves_type = typename std::conditional<
+      std::is_void<K>::value, boxed_leaves<T>,
+      typename std::conditional<std::is_same<K, inline_values>::value,
+                                inline_leaves<T>,
+                                tagged_leaves<T, K>>::type>::type;
+  static const bool has_inline_values = std::is_same<K, inline_values>::value;
+
 public:
-  art(std::function<void(T*)> free_fn=nullptr) : root_(nullptr), free_(free_fn) {}
+  art() : root_(nullptr) {}
+  art(std::function<void(T*)> free_fn) : root_(nullptr), free_(free_fn) {
+    static_assert(!has_inline_values, "inline values are not freed by pointer");
+  }
+
+  /**
+   * Creates a tree from a sorted range of (key, value) pairs, see
+   * bulk_load.
+   */
+  template <class It> art(It first, It last) : art() {
+    bulk_load(first, last);
+  }
+  template <class It>
+  art(It first, It last, std::function<void(T *)> free_fn) : art(free_fn) {
+    bulk_load(first, last);
+  }
 
   ~art();
 
@@ -32,6 +96,11 @@ public:
    */
   T *get(const char *key) const;
 
+  /**
+   * Finds the value associated with the given key of key_len bytes.
+   */
+  T *get(const char *key, std::size_t key_len) const;
+
   /**
    * Associates the given key with the given value.
    * If another value is already associated with the given key,
@@ -44,6 +113,14 @@ public:
    */
   T *set(const char *key, T *value);
 
+  /**
+   * Associates the given key of key_len bytes with the given value.
+   *
+   * @throws std::invalid_argument if the key is a proper prefix of a key in
+   * the tree or the other way around, the tree is left unchanged.
+   */
+  T *set(const char *key, std::size_t key_len, T *value);
+
   /**
    * Deletes the given key and returns it's associated value.
    * The associated value is returned,
@@ -55,6 +132,112 @@ public:
    */
   T *del(const char *key);
 
+  /**
+   * Deletes the given key of key_len bytes and returns it's associated value.
+   */
+  T *del(const char *key, std::size_t key_len);
+
+  /*
+   * The following functions find the key and insert it if it is missing in
+   * a single descent, like set. They throw std::invalid_argument like set.
+   */
+
+  /**
+   * Returns a pointer to the value associated with the given key. A missing
+   * key is inserted with a nullptr, which the caller is expected to replace
+   * through the returned pointer. The pointer stays valid until the key is
+   * deleted. Only available without a key extractor, since tagged leaves
+   * have no value slot.
+   */
+  T **find_or_insert(const char *key);
+  T **find_or_insert(const char *key, std::size_t key_len);
+
+  /**
+   * Associates the given key with the given value unless the key is present.
+   *
+   * @return a nullptr if the key was inserted or the value already
+   * associated with the key, which is left unchanged.
+   */
+  T *insert_if_absent(const char *key, T *value);
+  T *insert_if_absent(const char *key, std::size_t key_len, T *value);
+
+  /**
+   * Associates the given key with `fn(old_value)`, where the old value is
+   * the value associated with the key or a nullptr if the key is missing,
+   * in which case fn must not return a nullptr.
+   *
+   * @return the old value.
+   */
+  template <class F> T *update(const char *key, F fn);
+  template <class F> T *update(const char *key, std::size_t key_len, F fn);
+
+#if __cplusplus >= 201703L
+  T *get(std::string_view key) const;
+  T *set(std::string_view key, T *value);
+  T *del(std::string_view key);
+  T **find_or_insert(std::string_view key);
+  T *insert_if_absent(std::string_view key, T *value);
+  template <class F> T *update(std::string_view key, F fn);
+#endif
+
+  /**
+   * Number of lookups multi_get keeps in flight.
+   */
+  static const int multi_get_width = 16;
+
+  /**
+   * Finds the values associated with n keys at once, like n calls of get.
+   *
+   * Up to multi_get_width lookups are interleaved: each one descends a
+   * single level and prefetches the next node before the following lookup
+   * takes its turn, so the cache misses of different lookups overlap
+   * instead of being waited for one after another.
+   *
+   * @param keys - The keys to find.
+   * @param key_lens - The number of bytes of every key, or a nullptr if the
+   * keys are NUL-terminated.
+   * @param n - The number of keys.
+   * @param values - Receives the value associated with every key or a
+   * nullptr.
+   */
+  void multi_get(const char *const *keys, const std::size_t *key_lens,
+                 std::size_t n, T **values) const;
+  void multi_get(const char *const *keys, std::size_t n, T **values) const;
+
+  /**
+   * Associates n keys with the given values, like n calls of set in the
+   * given order.
+   *
+   * The paths of every multi_get_width keys are first prefetched through
+   * multi_get, and then the values are set on the warm paths.
+   *
+   * @param old_values - Receives the value previously associated with every
+   * key or a nullptr.
+   * @throws std::invalid_argument if a key is a proper prefix of a key in
+   * the tree or the other way around. The keys before it are set.
+   */
+  void multi_set(const char *const *keys, const std::size_t *key_lens,
+                 std::size_t n, T *const *values, T **old_values);
+  void multi_set(const char *const *keys, std::size_t n, T *const *values,
+                 T **old_values);
+
+  /**
+   * Builds the tree from a range of (key, value) pairs sorted in the
+   * tree's lexicographic order, i.e. by bytes compared as signed chars.
+   *
+   * The tree is built bottom-up in a single pass: every inner node is
+   * created with its final type and prefix, so nothing is descended,
+   * grown or split. The keys of the pairs' first members are either
+   * NUL-terminated `const char *`, whose terminator is part of the key
+   * like in set, or std::string (std::string_view with C++17), which are
+   * used as they are. The values are the pairs' second members.
+   *
+   * @throws std::logic_error if the tree is not empty.
+   * @throws std::invalid_argument if the keys are not sorted, not unique or
+   * not prefix-free, the tree is left unchanged.
+   */
+  template <class It> void bulk_load(It first, It last);
+
   /**
    * Forward iterator that traverses the tree in lexicographic order.
    */
@@ -67,19 +250,351 @@ public:
   tree_it<T> begin(const char *key);
 
   /**
-   * Iterator to the end of the lexicographic order.
+   * Forward iterator that traverses the tree in lexicographic order starting
+   * from the first key not less than the given key_len bytes.
+   */
+  tree_it<T> begin(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  tree_it<T> begin(std::string_view key);
+#endif
+
+  /**
+   * Iterator at the last key, which is decremented to traverse the tree in
+   * descending order until it equals end().
+   */
+  tree_it<T> last();
+
+  /**
+   * Iterator at the last key not greater than the given key, including its
+   * terminator, so that the key itself is found.
+   */
+  tree_it<T> last(const char *key);
+
+  /**
+   * Iterator at the last key not greater than the given key_len bytes.
+   */
+  tree_it<T> last(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  tree_it<T> last(std::string_view key);
+#endif
+
+  /**
+   * Iterator to the end of the lexicographic order, decrementing it yields
+   * the last key.
    */
   tree_it<T> end();
 
+  /*
+   * Scans visit the keys of a range in lexicographic order. The visitor is
+   * called as `bool visitor(const std::string &key, T *value)` and returns
+   * false to stop the scan. The key is only valid during the call. Bounds
+   * passed as `const char *` are NUL-terminated and don't include the
+   * terminator, like begin(const char *).
+   */
+
+  /**
+   * Visits every key starting with the given prefix of prefix_len bytes.
+   */
+  template <class F>
+  void scan_prefix(const char *prefix, std::size_t prefix_len,
+                   F visitor) const;
+  template <class F> void scan_prefix(const char *prefix, F visitor) const;
+
+  /**
+   * Visits every key not less than lo and less than hi.
+   */
+  template <class F>
+  void scan_range(const char *lo, std::size_t lo_len, const char *hi,
+                  std::size_t hi_len, F visitor) const;
+  template <class F>
+  void scan_range(const char *lo, const char *hi, F visitor) const;
+
+  /**
+   * Counts the keys starting with the given prefix of prefix_len bytes.
+   * Only the path to the prefix is compared, the subtree below is counted
+   * without looking at keys.
+   */
+  std::size_t count_prefix(const char *prefix, std::size_t prefix_len) const;
+  std::size_t count_prefix(const char *prefix) const;
+
+  /**
+   * Counts the keys not less than lo and less than hi. Only the paths to
+   * lo and hi are compared, subtrees in between are counted without
+   * looking at keys. With ART_SUBTREE_COUNTS, inner nodes know the number
+   * of keys below them, so this takes O(key length * fan-out) time instead
+   * of time linear in the number of keys in the range.
+   */
+  std::size_t count_range(const char *lo, std::size_t lo_len, const char *hi,
+                          std::size_t hi_len) const;
+  std::size_t count_range(const char *lo, const char *hi) const;
+
+  /**
+   * Counts the keys less than the given key_len bytes, i.e. the position of
+   * the key in lexicographic order if it is in the tree, like
+   * count_range("", key).
+   */
+  std::size_t rank(const char *key, std::size_t key_len) const;
+  std::size_t rank(const char *key) const;
+
+  /**
+   * Iterator at the key at position k in lexicographic order, counting from
+   * 0, or end() if the tree has at most k keys. With ART_SUBTREE_COUNTS,
+   * takes O(key length * fan-out) time, otherwise the subtrees before the
+   * key are counted leaf by leaf.
+   */
+  tree_it<T> select(std::size_t k);
+
+#if __cplusplus >= 201703L
+  template <class F> void scan_prefix(std::string_view prefix, F visitor) const;
+  template <class F>
+  void scan_range(std::string_view lo, std::string_view hi, F visitor) const;
+  std::size_t count_prefix(std::string_view prefix) const;
+  std::size_t count_range(std::string_view lo, std::string_view hi) const;
+  std::size_t rank(std::string_view key) const;
+#endif
+
+  /**
+   * Returns the shape and memory usage of the tree. The statistics are
+   * kept up to date by every modification, so this is cheap.
+   */
+  const tree_stats &stats() const;
+
+  /*
+   * The parallel operations split the tree into subtrees, which n_threads
+   * threads, including the calling one, take from each other as they run
+   * out of work, see parallel_walk. The callbacks are called concurrently
+   * and in no particular order, and must not throw.
+   */
+
+  /**
+   * Calls `visitor(const std::string &key, T *value)` for every key.
+   */
+  template <class F>
+  void parallel_for_each(
+      F visitor,
+      unsigned n_threads = std::thread::hardware_concurrency()) const;
+
+  /**
+   * Folds the values into identity with `R combine(R, R)`, after mapping
+   * them with `R map(T *value)`. combine must be associative and
+   * commutative.
+   */
+  template <class R, class F, class C>
+  R parallel_reduce(
+      R identity, F map, C combine,
+      unsigned n_threads = std::thread::hardware_concurrency()) const;
+
+  /**
+   * Counts the values for which `bool pred(T *value)` holds.
+   */
+  template <class P>
+  std::size_t parallel_count(
+      P pred, unsigned n_threads = std::thread::hardware_concurrency()) const;
+
+  /**
+   * Deletes every key, freeing the values like the destructor, and
+   * releases the nodes in parallel. Allocators that are not thread-safe,
+   * see is_thread_safe_allocator, release on one thread, unless they
+   * release in bulk, in which case the memory is kept until the tree is
+   * destroyed and only the values are freed in parallel.
+   */
+  void parallel_clear(unsigned n_threads = std::thread::hardware_concurrency());
+
+  /**
+   * Moves every node to a new allocator in depth-first order, so that the
+   * nodes of a subtree are next to each other in memory and siblings
+   * follow each other, and then releases the previous allocator, e.g. the
+   * chunks of a pool that churn left partly unused. Takes time linear in
+   * the number of nodes and holds both copies while it runs. Invalidates
+   * iterators and pointers into leaves. The allocator must be default
+   * constructible and move assignable.
+   *
+   * @return the number of bytes reclaimed, i.e. by which reserved_bytes of
+   * the allocator (or the bytes in use) decreased.
+   */
+  std::size_t compact();
+
+  /**
+   * Moves the keys of the other tree into this tree, which is left empty.
+   * Both trees are descended together only where they have keys with a
+   * common prefix: a subtree of the other tree that shares no key prefix
+   * with this tree is linked in as is, compressed prefixes are split where
+   * the trees diverge, and a node that gains children is grown directly to
+   * its final type. For a key in both trees, the value becomes
+   * `T *conflict(T *mine, T *theirs)`, which must not throw; the value not
+   * returned is left to conflict, e.g. to free it. This tree's free
+   * function applies to the values taken over, see the constructor.
+   *
+   * The other tree's nodes are linked by pointer if the allocator can take
+   * over the other tree's allocator, see adopt in allocator.hpp, and are
+   * copied to this tree's allocator first otherwise. Invalidates iterators
+   * of both trees.
+   *
+   * @throws std::invalid_argument if a key of one tree is a proper prefix
+   * of a key of the other, in which case neither tree is modified.
+   */
+  template <class F> void merge(art<T, A, K> &&other, F conflict);
+
 private:
+  template <class U, class B, class L>
+  friend void serialize(const art<U, B, L> &tree, std::ostream &out);
+  template <class U, class B> friend class value_art;
+
+  void destroy_node(node<T> *n);
+
+  /**
+   * Deletes the given key, see del.
+   *
+   * @param old_value - Receives the value of the deleted leaf unless it is a
+   * nullptr. With inline_values, the value was destroyed with the leaf.
+   * @return true if the key existed.
+   */
+  bool erase(const char *key, std::size_t key_len, T **old_value);
+
+  /**
+   * Copies the subtree n, whose prefix starts at the given depth, to
+   * new_alloc in depth-first order and releases its nodes.
+   */
+  node<T> *compact(node<T> *n, int depth, A &new_alloc);
+
+  /**
+   * Returns the bytes that node n, at the given depth, contributes to the
+   * keys below it, i.e. the prefix of an inner node or the rest of the key
+   * of a leaf, without the first skip bytes.
+   */
+  const char *merge_label(node<T> *n, int depth, int skip, int &len) const;
+
+  /**
+   * Throws std::invalid_argument if merging the subtree theirs into the
+   * subtree mine would make a key a proper prefix of another. The labels of
+   * both, without their first mine_skip and theirs_skip bytes, start at the
+   * given depth.
+   */
+  void check_merge(node<T> *mine, int mine_skip, node<T> *theirs,
+                   int theirs_skip, int depth) const;
+
+  /**
+   * Merges the subtree theirs of the other tree into the subtree mine,
+   * whose labels start at the given depth, and returns the merged subtree.
+   */
+  template <class F>
+  node<T> *merge(node<T> *mine, node<T> *theirs, int depth, F &conflict);
+
+  /**
+   * Drops the first len bytes of the node's label, as it moves len bytes
+   * further down the tree.
+   */
+  void move_down(node<T> *n, int len);
+
+  /**
+   * Grows the node to hold n_children children, see inner_node::grow_to.
+   */
+  inner_node<T> *grow_to(inner_node<T> *n, int n_children);
+
+  /**
+   * Sets the leaf count of n to the sum of its children's. Does nothing
+   * without ART_SUBTREE_COUNTS.
+   */
+  static void recount(inner_node<T> *n);
+
+  /**
+   * Resets the statistics of the empty tree, keeping the events.
+   */
+  void clear_stats();
+
+  /**
+   * Destroys every node and frees the values, see ~art.
+   */
+  void destroy_tree();
+
+  /**
+   * Finds the leaf of the given key or inserts one with the value returned
+   * by make_value(), which is only called if the key is missing.
+   *
+   * @param inserted - Set to true if the leaf was inserted.
+   * @return the child slot of the leaf.
+   */
+  template <class F>
+  node<T> **upsert(const char *key, std::size_t key_len, F make_value,
+                   bool &inserted);
+
+  /**
+   * Adds (sign 1) or removes (sign -1) the given node's type, size, prefix
+   * and fan-out to or from the statistics. Nodes are removed before and
+   * added again after they are modified.
+   */
+  void track(const node<T> *n, int sign);
+
+  static void prefetch(const node<T> *n);
+
+  struct bulk_entry {
+    const char *key_;
+    int key_len_;
+    T *value_;
+  };
+
+  static const char *bulk_key(const char *key, int &key_len);
+  static const char *bulk_key(const std::string &key, int &key_len);
+#if __cplusplus >= 201703L
+  static const char *bulk_key(std::string_view key, int &key_len);
+#endif
+
+  /**
+   * Builds the subtree of the n sorted entries, whose first depth bytes
+   * are the path to the subtree.
+   */
+  node<T> *bulk_build(const bulk_entry *entries, std::size_t n, int depth);
+
+  /**
+   * Compares keys in the order of the tree, i.e., bytes as signed chars.
+   */
+  static bool key_less(const char *a, std::size_t a_len, const char *b,
+                       std::size_t b_len);
+
+  /**
+   * Counts the keys of the subtree n, whose prefix starts at the given
+   * depth, that are in [lo, hi). on_lo (on_hi) tells if the path to n
+   * equals the first depth bytes of lo (hi); a subtree off both paths is
+   * entirely in the range.
+   */
+  std::size_t count_range(node<T> *n, int depth, const char *lo, int lo_len,
+                          bool on_lo, const char *hi, int hi_len,
+                          bool on_hi) const;
+
+  /**
+   * Counts the leaves of the subtree n, in constant time with
+   * ART_SUBTREE_COUNTS.
+   */
+  static std::size_t count_leaves(node<T> *n);
+
+  /**
+   * Adds delta to the leaf counts of the inner nodes on the path of the
+   * given key, after the key's leaf was inserted (delta 1) or deleted
+   * (delta -1). Does nothing without ART_SUBTREE_COUNTS.
+   */
+  void count_path(const char *key, int key_len, int delta);
+
   node<T> *root_ = nullptr;
   std::function<void(T*)> free_;
+  A alloc_;
+  leaves_type leaves_;
+  tree_stats stats_;
 };
 
-template <class T> art<T>::~art() {
+template <class T, class A, class K> art<T, A, K>::~art() {
+  destroy_tree();
+}
+
+template <class T, class A, class K> void art<T, A, K>::destroy_tree() {
   if (root_ == nullptr) {
     return;
   }
+  if (A::bulk_release && !free_ && leaves_type::trivially_destructible) {
+    /* nothing to visit, the allocator releases all nodes at once */
+    return;
+  }
   std::stack<node<T> *> node_stack;
   node_stack.push(root_);
   node<T> *cur;
@@ -88,34 +603,556 @@ template <class T> art<T>::~art() {
   while (!node_stack.empty()) {
     cur = node_stack.top();
     node_stack.pop();
-    if (!cur->is_leaf()) {
+    if (!is_leaf(cur)) {
       cur_inner = static_cast<inner_node<T>*>(cur);
       for (it = cur_inner->begin(), it_end = cur_inner->end(); it != it_end; ++it) {
-        node_stack.push(*cur_inner->find_child(*it));
+        node_stack.push(*it.child());
       }
     } else if (free_) {
-      leaf_node<T> *leaf = static_cast<leaf_node<T>*>(cur);
-      free_(leaf->value_);
+      free_(leaf_value(cur));
+    }
+
+    if (!A::bulk_release ||
+        (is_leaf(cur) && !leaves_type::trivially_destructible)) {
+      destroy_node(cur);
+    }
+  }
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::destroy_node(node<T> *n) {
+  if (is_leaf(n)) {
+    leaves_.destroy(n, alloc_);
+  } else {
+    n->free_prefix(alloc_);
+    static_cast<inner_node<T> *>(n)->destroy(alloc_);
+  }
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::track(const node<T> *n, int sign) {
+  /* sign converts to a size_t, subtracting wraps around like it should */
+  if (is_leaf(n)) {
+    stats_.n_leaves += sign;
+    stats_.memory_bytes += sign * leaves_.size(n);
+    return;
+  }
+  std::size_t size;
+  switch (n->type_) {
+  case node_type::node_4:
+    stats_.n_node_4 += sign;
+    size = sizeof(node_4<T>);
+    break;
+  case node_type::node_16:
+    stats_.n_node_16 += sign;
+    size = sizeof(node_16<T>);
+    break;
+  case node_type::node_48:
+    stats_.n_node_48 += sign;
+    size = sizeof(node_48<T>);
+    break;
+  default:
+    stats_.n_node_256 += sign;
+    size = sizeof(node_256<T>);
+    break;
+  }
+  size += n->heap_prefix_size();
+  stats_.memory_bytes += sign * size;
+  stats_.prefix_bytes += sign * n->prefix_len_;
+  stats_.fan_out[static_cast<const inner_node<T> *>(n)->n_children()] += sign;
+}
+
+template <class T, class A, class K>
+const tree_stats &art<T, A, K>::stats() const {
+  return stats_;
+}
+
+template <class T, class A, class K>
+template <class F>
+void art<T, A, K>::parallel_for_each(F visitor, unsigned n_threads) const {
+  const leaves_type &leaves = leaves_;
+  parallel_walk<true>(
+      root_, n_threads,
+      [&](unsigned, node<T> *leaf, int depth, std::string &path) {
+        int len;
+        const char *bytes = leaves.key(leaf, depth, len);
+        path.resize(depth);
+        path.append(bytes, len);
+        visitor(static_cast<const std::string &>(path), leaf_value(leaf));
+      },
+      [](unsigned, inner_node<T> *) {});
+}
+
+template <class T, class A, class K>
+template <class R, class F, class C>
+R art<T, A, K>::parallel_reduce(R identity, F map, C combine,
+                                unsigned n_threads) const {
+  /* padded, so that the workers don't write to the same cache line */
+  struct accumulator {
+    R value_;
+    char padding_[64];
+  };
+  n_threads = n_threads == 0 ? 1 : n_threads;
+  std::vector<accumulator> accumulators(n_threads,
+                                        accumulator{identity, {}});
+  parallel_walk<false>(
+      root_, n_threads,
+      [&](unsigned worker, node<T> *leaf, int, std::string &) {
+        R &acc = accumulators[worker].value_;
+        acc = combine(acc, map(leaf_value(leaf)));
+      },
+      [](unsigned, inner_node<T> *) {});
+  R result = identity;
+  for (const accumulator &acc : accumulators) {
+    result = combine(result, acc.value_);
+  }
+  return result;
+}
+
+template <class T, class A, class K>
+template <class P>
+std::size_t art<T, A, K>::parallel_count(P pred, unsigned n_threads) const {
+  return parallel_reduce(
+      std::size_t(0),
+      [&pred](T *value) -> std::size_t { return pred(value) ? 1 : 0; },
+      [](std::size_t a, std::size_t b) { return a + b; }, n_threads);
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::parallel_clear(unsigned n_threads) {
+  if (root_ == nullptr) {
+    return;
+  }
+  if (A::bulk_release && leaves_type::trivially_destructible) {
+    if (free_) {
+      parallel_walk<false>(
+          root_, n_threads,
+          [this](unsigned, node<T> *leaf, int, std::string &) {
+            free_(leaf_value(leaf));
+          },
+          [](unsigned, inner_node<T> *) {});
+    }
+  } else if (is_thread_safe_allocator<A>::value) {
+    parallel_walk<false>(
+        root_, n_threads,
+        [this](unsigned, node<T> *leaf, int, std::string &) {
+          if (free_) {
+            free_(leaf_value(leaf));
+          }
+          destroy_node(leaf);
+        },
+        [this](unsigned, inner_node<T> *n) { destroy_node(n); });
+  } else {
+    destroy_tree();
+  }
+  root_ = nullptr;
+  clear_stats();
+}
+
+template <class T, class A, class K> void art<T, A, K>::clear_stats() {
+  tree_stats events;
+  events.n_grows = stats_.n_grows;
+  events.n_shrinks = stats_.n_shrinks;
+  events.n_prefix_splits = stats_.n_prefix_splits;
+  stats_ = events;
+}
+
+template <class T, class A, class K> std::size_t art<T, A, K>::compact() {
+  std::size_t before = reserved_bytes(alloc_, stats_.memory_bytes, 0);
+  A new_alloc;
+  if (root_ != nullptr) {
+    root_ = compact(root_, 0, new_alloc);
+  }
+  /* releases the previous allocator's memory */
+  alloc_ = std::move(new_alloc);
+  std::size_t after = reserved_bytes(alloc_, stats_.memory_bytes, 0);
+  return before > after ? before - after : 0;
+}
+
+template <class T, class A, class K>
+node<T> *art<T, A, K>::compact(node<T> *n, int depth, A &new_alloc) {
+  track(n, -1);
+  node<T> *copy;
+  if (is_leaf(n)) {
+    int len;
+    const char *key = leaves_.key(n, depth, len);
+    /* inline leaves move their value */
+    copy = leaves_.make(key, len, leaf_value(n), new_alloc);
+    leaves_.destroy(n, alloc_);
+  } else {
+    auto inner = static_cast<inner_node<T> *>(n)->relocate(alloc_, new_alloc);
+    int child_depth = depth + inner->prefix_len_ + 1;
+    node<T> **child;
+    for (int slot = inner->next_slot(-1), n_slots = inner->n_slots();
+         slot < n_slots; slot = inner->next_slot(slot)) {
+      child = inner->slot_child(slot);
+      *child = compact(*child, child_depth, new_alloc);
+    }
+    copy = inner;
+  }
+  track(copy, 1);
+  return copy;
+}
+
+template <class T, class A, class K>
+template <class F>
+void art<T, A, K>::merge(art<T, A, K> &&other, F conflict) {
+  if (&other == this || other.root_ == nullptr) {
+    return;
+  }
+  if (root_ != nullptr) {
+    check_merge(root_, 0, other.root_, 0, 0);
+  }
+  if (!adopt(alloc_, other.alloc_, 0)) {
+    other.root_ = other.compact(other.root_, 0, alloc_);
+  }
+  stats_.add_shape(other.stats_);
+  root_ = root_ == nullptr ? other.root_
+                           : merge(root_, other.root_, 0, conflict);
+  other.root_ = nullptr;
+  other.clear_stats();
+}
+
+template <class T, class A, class K>
+const char *art<T, A, K>::merge_label(node<T> *n, int depth, int skip,
+                                      int &len) const {
+  const char *label;
+  if (is_leaf(n)) {
+    label = leaves_.key(n, depth, len);
+  } else {
+    label = n->prefix();
+    len = n->prefix_len_;
+  }
+  len -= skip;
+  return label + skip;
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::check_merge(node<T> *mine, int mine_skip, node<T> *theirs,
+                               int theirs_skip, int depth) const {
+  int mine_len, theirs_len;
+  const char *mine_label =
+      merge_label(mine, depth - mine_skip, mine_skip, mine_len);
+  const char *theirs_label =
+      merge_label(theirs, depth - theirs_skip, theirs_skip, theirs_len);
+  int len = std::min(mine_len, theirs_len), common = 0;
+  while (common < len && mine_label[common] == theirs_label[common]) {
+    ++common;
+  }
+  if (common < len) {
+    /* the subtrees diverge */
+    return;
+  }
+  node<T> **child;
+  if (mine_len == theirs_len) {
+    if (is_leaf(mine) != is_leaf(theirs)) {
+      throw std::invalid_argument("merged keys must be prefix-free");
+    }
+    if (is_leaf(mine)) {
+      /* the same key */
+      return;
+    }
+    auto mine_inner = static_cast<inner_node<T> *>(mine);
+    auto theirs_inner = static_cast<inner_node<T> *>(theirs);
+    for (int slot = theirs_inner->next_slot(-1),
+             n_slots = theirs_inner->n_slots();
+         slot < n_slots; slot = theirs_inner->next_slot(slot)) {
+      child = mine_inner->find_child(theirs_inner->slot_partial_key(slot));
+      if (child != nullptr) {
+        check_merge(*child, 0, *theirs_inner->slot_child(slot), 0,
+                    depth + len + 1);
+      }
+    }
+    return;
+  }
+  /* the shorter label ends within the longer one, which continues below
+   * the shorter one's node */
+  bool mine_shorter = mine_len < theirs_len;
+  node<T> *shorter = mine_shorter ? mine : theirs;
+  if (is_leaf(shorter)) {
+    throw std::invalid_argument("merged keys must be prefix-free");
+  }
+  child = static_cast<inner_node<T> *>(shorter)->find_child(
+      (mine_shorter ? theirs_label : mine_label)[len]);
+  if (child == nullptr) {
+    return;
+  }
+  if (mine_shorter) {
+    check_merge(*child, 0, theirs, theirs_skip + len + 1, depth + len + 1);
+  } else {
+    check_merge(mine, mine_skip + len + 1, *child, 0, depth + len + 1);
+  }
+}
+
+template <class T, class A, class K>
+template <class F>
+node<T> *art<T, A, K>::merge(node<T> *mine, node<T> *theirs, int depth,
+                             F &conflict) {
+  int mine_len, theirs_len;
+  const char *mine_label = merge_label(mine, depth, 0, mine_len);
+  const char *theirs_label = merge_label(theirs, depth, 0, theirs_len);
+  int len = std::min(mine_len, theirs_len), common = 0;
+  while (common < len && mine_label[common] == theirs_label[common]) {
+    ++common;
+  }
+
+  if (common < len) {
+    /* the labels diverge, a new node takes their common prefix */
+    char mine_key = mine_label[common], theirs_key = theirs_label[common];
+    auto parent = make<node_4<T>>(alloc_);
+    track(mine, -1);
+    track(theirs, -1);
+    if (is_leaf(mine)) {
+      leaves_.split(mine, *parent, mine_label, common, alloc_);
+      stats_.depth_sum += common + 1;
+    } else {
+      mine->split_prefix(*parent, common, alloc_);
+    }
+    move_down(theirs, common + 1);
+    parent->set_child(mine_key, mine);
+    parent->set_child(theirs_key, theirs);
+    recount(parent);
+    track(mine, 1);
+    track(theirs, 1);
+    track(parent, 1);
+    return parent;
+  }
+
+  if (mine_len == theirs_len && is_leaf(mine)) {
+    /* the same key, theirs is a leaf too, see check_merge */
+    T *value = conflict(leaf_value(mine), leaf_value(theirs));
+    if (value != leaf_value(mine)) {
+      leaves_.set_value(mine, value);
+    }
+    track(theirs, -1);
+    stats_.depth_sum -= depth;
+    leaves_.destroy(theirs, alloc_);
+    return mine;
+  }
+
+  if (mine_len == theirs_len) {
+    /* the same prefix, the children are merged by partial key */
+    auto mine_inner = static_cast<inner_node<T> *>(mine);
+    auto theirs_inner = static_cast<inner_node<T> *>(theirs);
+    int n_children = mine_inner->n_children();
+    for (int slot = theirs_inner->next_slot(-1),
+             n_slots = theirs_inner->n_slots();
+         slot < n_slots; slot = theirs_inner->next_slot(slot)) {
+      if (mine_inner->find_child(theirs_inner->slot_partial_key(slot)) ==
+          nullptr) {
+        ++n_children;
+      }
+    }
+    track(mine_inner, -1);
+    mine_inner = grow_to(mine_inner, n_children);
+    char partial_key;
+    node<T> **child;
+    for (int slot = theirs_inner->next_slot(-1),
+             n_slots = theirs_inner->n_slots();
+         slot < n_slots; slot = theirs_inner->next_slot(slot)) {
+      partial_key = theirs_inner->slot_partial_key(slot);
+      child = mine_inner->find_child(partial_key);
+      if (child != nullptr) {
+        *child = merge(*child, *theirs_inner->slot_child(slot),
+                       depth + len + 1, conflict);
+      } else {
+        mine_inner->set_child(partial_key, *theirs_inner->slot_child(slot));
+      }
+    }
+    recount(mine_inner);
+    track(mine_inner, 1);
+    track(theirs_inner, -1);
+    theirs_inner->free_prefix(alloc_);
+    theirs_inner->destroy(alloc_);
+    return mine_inner;
+  }
+
+  /* the shorter label ends within the longer one, whose node moves below
+   * the shorter one's node, an inner node, see check_merge */
+  bool mine_shorter = mine_len < theirs_len;
+  auto parent = static_cast<inner_node<T> *>(mine_shorter ? mine : theirs);
+  node<T> *child = mine_shorter ? theirs : mine;
+  char partial_key = (mine_shorter ? theirs_label : mine_label)[len];
+  track(child, -1);
+  move_down(child, len + 1);
+  track(child, 1);
+  track(parent, -1);
+  node<T> **slot = parent->find_child(partial_key);
+  if (slot != nullptr) {
+    *slot = mine_shorter ? merge(*slot, child, depth + len + 1, conflict)
+                         : merge(child, *slot, depth + len + 1, conflict);
+  } else {
+    parent = grow_to(parent, parent->n_children() + 1);
+    parent->set_child(partial_key, child);
+  }
+  recount(parent);
+  track(parent, 1);
+  return parent;
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::move_down(node<T> *n, int len) {
+  if (is_leaf(n)) {
+    leaves_.trim(n, len, alloc_);
+    stats_.depth_sum += len;
+  } else {
+    n->set_prefix(n->prefix() + len, n->prefix_len_ - len, alloc_);
+  }
+}
+
+template <class T, class A, class K>
+inner_node<T> *art<T, A, K>::grow_to(inner_node<T> *n, int n_children) {
+  inner_node<T> *grown = n->grow_to(n_children, alloc_);
+  if (grown != n) {
+    ++stats_.n_grows;
+  }
+  return grown;
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::recount(inner_node<T> *n) {
+#if defined(ART_SUBTREE_COUNTS)
+  std::size_t count = 0;
+  for (int slot = n->next_slot(-1), n_slots = n->n_slots(); slot < n_slots;
+       slot = n->next_slot(slot)) {
+    count += count_leaves(*n->slot_child(slot));
+  }
+  n->n_leaves_ = count;
+#else
+  (void)n;
+#endif
+}
+
+template <class T, class A, class K>
+const char *art<T, A, K>::bulk_key(const char *key, int &key_len) {
+  key_len = std::strlen(key) + 1;
+  return key;
+}
+
+template <class T, class A, class K>
+const char *art<T, A, K>::bulk_key(const std::string &key, int &key_len) {
+  key_len = key.size();
+  return key.data();
+}
+
+#if __cplusplus >= 201703L
+template <class T, class A, class K>
+const char *art<T, A, K>::bulk_key(std::string_view key, int &key_len) {
+  key_len = key.size();
+  return key.data();
+}
+#endif
+
+template <class T, class A, class K>
+template <class It>
+void art<T, A, K>::bulk_load(It first, It last) {
+  if (root_ != nullptr) {
+    throw std::logic_error("bulk_load requires an empty tree");
+  }
+  std::vector<bulk_entry> entries;
+  bulk_entry e;
+  for (; first != last; ++first) {
+    e.key_ = bulk_key(first->first, e.key_len_);
+    e.value_ = first->second;
+    if (!entries.empty()) {
+      const bulk_entry &prev = entries.back();
+      /* in sorted order, a key that has a prefix in the range directly
+       * follows it or another key with that prefix */
+      if (prev.key_len_ <= e.key_len_ &&
+          std::memcmp(prev.key_, e.key_, prev.key_len_) == 0) {
+        throw std::invalid_argument("keys must be prefix-free");
+      }
+      if (!key_less(prev.key_, prev.key_len_, e.key_, e.key_len_)) {
+        throw std::invalid_argument("keys must be sorted");
+      }
+    }
+    entries.push_back(e);
+  }
+  if (!entries.empty()) {
+    root_ = bulk_build(entries.data(), entries.size(), 0);
+  }
+}
+
+template <class T, class A, class K>
+node<T> *art<T, A, K>::bulk_build(const bulk_entry *entries, std::size_t n,
+                                  int depth) {
+  if (n == 1) {
+    node<T> *leaf = leaves_.make(entries->key_ + depth,
+                                 entries->key_len_ - depth, entries->value_,
+                                 alloc_);
+    track(leaf, 1);
+    stats_.depth_sum += depth;
+    return leaf;
+  }
+
+  /* the first and the last key share the prefix of all keys */
+  const char *first = entries->key_, *last = entries[n - 1].key_;
+  int prefix_len = 0;
+  while (first[depth + prefix_len] == last[depth + prefix_len]) {
+    ++prefix_len;
+  }
+  int partial_key_depth = depth + prefix_len, n_children = 1;
+  for (std::size_t i = 1; i < n; ++i) {
+    if (entries[i].key_[partial_key_depth] !=
+        entries[i - 1].key_[partial_key_depth]) {
+      ++n_children;
     }
+  }
 
-    if (cur->prefix_ != nullptr) {
-      delete[] cur->prefix_;
+  inner_node<T> *n_inner;
+  if (n_children <= 4) {
+    n_inner = make<node_4<T>>(alloc_);
+  } else if (n_children <= 16) {
+    n_inner = make<node_16<T>>(alloc_);
+  } else if (n_children <= 48) {
+    n_inner = make<node_48<T>>(alloc_);
+  } else {
+    n_inner = make<node_256<T>>(alloc_);
+  }
+  n_inner->set_prefix(first + depth, prefix_len, alloc_);
+#if defined(ART_SUBTREE_COUNTS)
+  n_inner->n_leaves_ = n;
+#endif
+
+  /* one child per run of entries with the same partial key */
+  std::size_t run_begin = 0, i;
+  char partial_key;
+  while (run_begin < n) {
+    partial_key = entries[run_begin].key_[partial_key_depth];
+    i = run_begin + 1;
+    while (i < n && entries[i].key_[partial_key_depth] == partial_key) {
+      ++i;
     }
-    delete cur;
+    n_inner->set_child(partial_key, bulk_build(entries + run_begin,
+                                               i - run_begin,
+                                               partial_key_depth + 1));
+    run_begin = i;
   }
+  track(n_inner, 1);
+  return n_inner;
 }
 
-template <class T> T *art<T>::get(const char *key) const {
+template <class T, class A, class K>
+T *art<T, A, K>::get(const char *key) const {
+  return get(key, std::strlen(key) + 1);
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::get(const char *key, std::size_t len) const {
   node<T> *cur = root_, **child;
-  int depth = 0, key_len = std::strlen(key) + 1;
+  int depth = 0, key_len = len;
   while (cur != nullptr) {
+    if (is_leaf(cur)) {
+      return leaves_.matches(cur, key, depth, key_len) ? leaf_value(cur)
+                                                       : nullptr;
+    }
     if (cur->prefix_len_ != cur->check_prefix(key + depth, key_len - depth)) {
       /* prefix mismatch */
       return nullptr;
     }
-    if (cur->prefix_len_ == key_len - depth) {
-      /* exact match */
-      return cur->is_leaf() ? static_cast<leaf_node<T>*>(cur)->value_ : nullptr;
+    if (cur->prefix_len_ >= key_len - depth) {
+      /* the key ends in an inner node, which has no value */
+      return nullptr;
     }
     child = static_cast<inner_node<T>*>(cur)->find_child(key[depth + cur->prefix_len_]);
     depth += (cur->prefix_len_ + 1);
@@ -124,34 +1161,181 @@ template <class T> T *art<T>::get(const char *key) const {
   return nullptr;
 }
 
-template <class T> T *art<T>::set(const char *key, T *value) {
-  int key_len = std::strlen(key) + 1, depth = 0, prefix_match_len;
-  if (root_ == nullptr) {
-    root_ = new leaf_node<T>(value);
-    root_->prefix_ = new char[key_len];
-    std::copy(key, key + key_len + 1, root_->prefix_);
-    root_->prefix_len_ = key_len;
+template <class T, class A, class K>
+void art<T, A, K>::prefetch(const node<T> *n) {
+#if defined(__GNUC__)
+  __builtin_prefetch(n);
+#else
+  (void)n;
+#endif
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::multi_get(const char *const *keys,
+                             const std::size_t *key_lens, std::size_t n,
+                             T **values) const {
+  struct lookup {
+    std::size_t i;
+    const char *key;
+    int key_len;
+    int depth;
+    node<T> *cur;
+  };
+  lookup group[multi_get_width];
+  int n_active = 0, g = 0;
+  std::size_t next = 0;
+  auto start = [&](lookup &l) {
+    l.i = next;
+    l.key = keys[next];
+    l.key_len = key_lens != nullptr ? key_lens[next]
+                                    : std::strlen(keys[next]) + 1;
+    l.depth = 0;
+    l.cur = root_;
+    ++next;
+  };
+  while (n_active < multi_get_width && next < n) {
+    start(group[n_active++]);
+  }
+
+  node<T> *cur, **child;
+  T *value;
+  bool is_done;
+  while (n_active > 0) {
+    /* one level of the lookup whose node was prefetched in its last turn */
+    lookup &l = group[g];
+    cur = l.cur;
+    value = nullptr;
+    is_done = true;
+    if (cur == nullptr) {
+      /* no such key */
+    } else if (is_leaf(cur)) {
+      if (leaves_.matches(cur, l.key, l.depth, l.key_len)) {
+        value = leaf_value(cur);
+      }
+    } else if (cur->prefix_len_ ==
+                   cur->check_prefix(l.key + l.depth, l.key_len - l.depth) &&
+               cur->prefix_len_ < l.key_len - l.depth) {
+      child = static_cast<inner_node<T> *>(cur)->find_child(
+          l.key[l.depth + cur->prefix_len_]);
+      l.depth += cur->prefix_len_ + 1;
+      if (child != nullptr) {
+        l.cur = *child;
+        prefetch(l.cur);
+        is_done = false;
+      }
+    }
+    if (is_done) {
+      values[l.i] = value;
+      if (next < n) {
+        start(l);
+      } else {
+        /* the last lookup takes the finished one's turn */
+        l = group[--n_active];
+        if (g == n_active) {
+          g = 0;
+        }
+        continue;
+      }
+    }
+    if (++g == n_active) {
+      g = 0;
+    }
+  }
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::multi_get(const char *const *keys, std::size_t n,
+                             T **values) const {
+  multi_get(keys, nullptr, n, values);
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::multi_set(const char *const *keys,
+                             const std::size_t *key_lens, std::size_t n,
+                             T *const *values, T **old_values) {
+  std::size_t batch_len;
+  for (std::size_t i = 0; i < n; i += multi_get_width) {
+    batch_len = std::min<std::size_t>(multi_get_width, n - i);
+    multi_get(keys + i, key_lens != nullptr ? key_lens + i : nullptr,
+              batch_len, old_values + i);
+    for (std::size_t j = i; j < i + batch_len; ++j) {
+      old_values[j] =
+          set(keys[j],
+              key_lens != nullptr ? key_lens[j] : std::strlen(keys[j]) + 1,
+              values[j]);
+    }
+  }
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::multi_set(const char *const *keys, std::size_t n,
+                             T *const *values, T **old_values) {
+  multi_set(keys, nullptr, n, values, old_values);
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::set(const char *key, T *value) {
+  return set(key, std::strlen(key) + 1, value);
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::set(const char *key, std::size_t len, T *value) {
+  static_assert(!has_inline_values, "the old value is overwritten, see "
+                                    "value_art::set");
+  bool inserted;
+  node<T> **slot =
+      upsert(key, len, [value]() { return value; }, inserted);
+  if (inserted) {
     return nullptr;
   }
+  T *old_value = leaf_value(*slot);
+  leaves_.set_value(*slot, value);
+  return old_value;
+}
+
+template <class T, class A, class K>
+template <class F>
+node<T> **art<T, A, K>::upsert(const char *key, std::size_t len,
+                               F make_value, bool &inserted) {
+  int key_len = len, depth = 0, prefix_match_len, cur_len;
+  inserted = true;
+  if (root_ == nullptr) {
+    root_ = leaves_.make(key, key_len, make_value(), alloc_);
+    track(root_, 1);
+    return &root_;
+  }
 
   node<T> **cur = &root_, **child;
   inner_node<T> **cur_inner;
+  const char *cur_prefix;
   char child_partial_key;
   bool is_prefix_match;
 
   while (true) {
+    /* prefix of an inner node or the rest of a leaf's key */
+    if (is_leaf(*cur)) {
+      cur_prefix = leaves_.key(*cur, depth, cur_len);
+    } else {
+      cur_prefix = (**cur).prefix();
+      cur_len = (**cur).prefix_len_;
+    }
+
     /* number of bytes of the current node's prefix that match the key */
-    prefix_match_len = (**cur).check_prefix(key + depth, key_len - depth);
+    prefix_match_len = 0;
+    while (prefix_match_len < cur_len &&
+           prefix_match_len < key_len - depth &&
+           cur_prefix[prefix_match_len] == key[depth + prefix_match_len]) {
+      ++prefix_match_len;
+    }
 
     /* true if the current node's prefix matches with a part of the key */
-    is_prefix_match = (std::min<int>((**cur).prefix_len_, key_len - depth)) ==
+    is_prefix_match = (std::min<int>(cur_len, key_len - depth)) ==
                       prefix_match_len;
 
-    if (is_prefix_match && (**cur).prefix_len_ == key_len - depth) {
+    if (is_prefix_match && cur_len == key_len - depth && is_leaf(*cur)) {
       /* exact match:
        * => "replace"
-       * => replace value of current node.
-       * => return old value to caller to handle.
+       * => the caller replaces the value of the current node.
        *        _                             _
        *        |                             |
        *       (aa)                          (aa)
@@ -162,10 +1346,15 @@ template <class T> T *art<T>::set(const char *key, T *value) {
        */
 
       /* cur must be a leaf */
-      auto cur_leaf = static_cast<leaf_node<T>*>(*cur);
-      T *old_value = cur_leaf->value_;
-      cur_leaf->value_ = value;
-      return old_value;
+      inserted = false;
+      return cur;
+    }
+
+    if (is_prefix_match &&
+        (is_leaf(*cur) || cur_len >= key_len - depth)) {
+      /* the key ends within the current node or the current leaf's key ends
+       * within the key, i.e. one of them is a proper prefix of the other */
+      throw std::invalid_argument("keys must be prefix-free");
     }
 
     if (!is_prefix_match) {
@@ -185,35 +1374,35 @@ template <class T> T *art<T>::set(const char *key, T *value) {
        *                        /|\      /|\
        */
 
-      auto new_parent = new node_4<T>();
-      new_parent->prefix_ = new char[prefix_match_len];
-      std::copy((**cur).prefix_, (**cur).prefix_ + prefix_match_len,
-                new_parent->prefix_);
-      new_parent->prefix_len_ = prefix_match_len;
-      new_parent->set_child((**cur).prefix_[prefix_match_len], *cur);
-
-      // TODO(rafaelkallis): shrink?
-      /* memmove((**cur).prefix_, (**cur).prefix_ + prefix_match_len + 1, */
-      /*         (**cur).prefix_len_ - prefix_match_len - 1); */
-      /* (**cur).prefix_len_ -= prefix_match_len + 1; */
-
-      auto old_prefix = (**cur).prefix_;
-      auto old_prefix_len = (**cur).prefix_len_;
-      (**cur).prefix_ = new char[old_prefix_len - prefix_match_len - 1];
-      (**cur).prefix_len_ = old_prefix_len - prefix_match_len - 1;
-      std::copy(old_prefix + prefix_match_len + 1, old_prefix + old_prefix_len,
-                (**cur).prefix_);
-      delete old_prefix;
-
-      auto new_node = new leaf_node<T>(value);
-      new_node->prefix_ = new char[key_len - depth - prefix_match_len - 1];
-      std::copy(key + depth + prefix_match_len + 1, key + key_len,
-                new_node->prefix_);
-      new_node->prefix_len_ = key_len - depth - prefix_match_len - 1;
+      track(*cur, -1);
+      auto new_parent = make<node_4<T>>(alloc_);
+      new_parent->set_child(cur_prefix[prefix_match_len], *cur);
+#if defined(ART_SUBTREE_COUNTS)
+      /* the new leaf is counted with the rest of the path */
+      new_parent->n_leaves_ = count_leaves(*cur);
+#endif
+      /* the new parent may take over the current node's prefix */
+      if (is_leaf(*cur)) {
+        leaves_.split(*cur, *new_parent, cur_prefix, prefix_match_len,
+                      alloc_);
+        stats_.depth_sum += prefix_match_len + 1;
+      } else {
+        (**cur).split_prefix(*new_parent, prefix_match_len, alloc_);
+        ++stats_.n_prefix_splits;
+      }
+      track(*cur, 1);
+
+      auto new_node = leaves_.make(key + depth + prefix_match_len + 1,
+                                   key_len - depth - prefix_match_len - 1,
+                                   make_value(), alloc_);
       new_parent->set_child(key[depth + prefix_match_len], new_node);
+      track(new_parent, 1);
+      track(new_node, 1);
+      stats_.depth_sum += depth + prefix_match_len + 1;
 
       *cur = new_parent;
-      return nullptr;
+      count_path(key, key_len, 1);
+      return new_parent->find_child(key[depth + prefix_match_len]);
     }
 
     /* must be inner node */
@@ -233,17 +1422,21 @@ template <class T> T *art<T>::set(const char *key, T *value) {
        *   (a)->v1               (a)->v1 +()->v2
        */
 
+      track(*cur, -1);
       if ((**cur_inner).is_full()) {
-        *cur_inner = (**cur_inner).grow();
+        *cur_inner = (**cur_inner).grow(alloc_);
+        ++stats_.n_grows;
       }
 
-      auto new_node = new leaf_node<T>(value);
-      new_node->prefix_ = new char[key_len - depth - (**cur).prefix_len_ - 1];
-      std::copy(key + depth + (**cur).prefix_len_ + 1, key + key_len,
-                new_node->prefix_);
-      new_node->prefix_len_ = key_len - depth - (**cur).prefix_len_ - 1;
+      auto new_node = leaves_.make(key + depth + (**cur).prefix_len_ + 1,
+                                   key_len - depth - (**cur).prefix_len_ - 1,
+                                   make_value(), alloc_);
       (**cur_inner).set_child(child_partial_key, new_node);
-      return nullptr;
+      track(*cur, 1);
+      track(new_node, 1);
+      stats_.depth_sum += depth + (**cur).prefix_len_ + 1;
+      count_path(key, key_len, 1);
+      return (**cur_inner).find_child(child_partial_key);
     }
 
     /* propagate down and repeat:
@@ -259,12 +1452,80 @@ template <class T> T *art<T>::set(const char *key, T *value) {
   }
 }
 
-template <class T> T *art<T>::del(const char *key) {
-  int depth = 0, key_len = std::strlen(key) + 1;
+template <class T, class A, class K>
+T **art<T, A, K>::find_or_insert(const char *key) {
+  return find_or_insert(key, std::strlen(key) + 1);
+}
 
-  if (root_ == nullptr) {
+template <class T, class A, class K>
+T **art<T, A, K>::find_or_insert(const char *key, std::size_t key_len) {
+  static_assert(std::is_void<K>::value,
+                "values of tagged leaves have no slot to point to");
+  bool inserted;
+  node<T> **slot =
+      upsert(key, key_len, []() { return static_cast<T *>(nullptr); },
+             inserted);
+  return &static_cast<leaf_node<T> *>(*slot)->value_;
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::insert_if_absent(const char *key, T *value) {
+  return insert_if_absent(key, std::strlen(key) + 1, value);
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::insert_if_absent(const char *key, std::size_t key_len,
+                                  T *value) {
+  bool inserted;
+  node<T> **slot =
+      upsert(key, key_len, [value]() { return value; }, inserted);
+  return inserted ? nullptr : leaf_value(*slot);
+}
+
+template <class T, class A, class K>
+template <class F>
+T *art<T, A, K>::update(const char *key, F fn) {
+  return update(key, std::strlen(key) + 1, fn);
+}
+
+template <class T, class A, class K>
+template <class F>
+T *art<T, A, K>::update(const char *key, std::size_t key_len, F fn) {
+  static_assert(!has_inline_values, "the old value is overwritten, see "
+                                    "value_art::set");
+  bool inserted;
+  node<T> **slot = upsert(
+      key, key_len, [&fn]() { return fn(static_cast<T *>(nullptr)); },
+      inserted);
+  if (inserted) {
     return nullptr;
   }
+  T *old_value = leaf_value(*slot);
+  leaves_.set_value(*slot, fn(old_value));
+  return old_value;
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::del(const char *key) {
+  return del(key, std::strlen(key) + 1);
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::del(const char *key, std::size_t len) {
+  static_assert(!has_inline_values, "the old value is destroyed, see "
+                                    "value_art::del");
+  T *old_value = nullptr;
+  erase(key, len, &old_value);
+  return old_value;
+}
+
+template <class T, class A, class K>
+bool art<T, A, K>::erase(const char *key, std::size_t len, T **old_value) {
+  int depth = 0, key_len = len;
+
+  if (root_ == nullptr) {
+    return false;
+  }
 
   /* pointer to parent, current and child node */
   node<T> **cur = &root_;
@@ -274,20 +1535,19 @@ template <class T> T *art<T>::del(const char *key) {
   char cur_partial_key = 0;
 
   while (cur != nullptr) {
-    if ((**cur).prefix_len_ !=
-        (**cur).check_prefix(key + depth, key_len - depth)) {
-      /* prefix mismatch => key doesn't exist */
-
-      return nullptr;
-    }
+    if (is_leaf(*cur)) {
+      if (!leaves_.matches(*cur, key, depth, key_len)) {
+        /* key mismatch => key doesn't exist */
+        return false;
+      }
 
-    if (key_len == depth + (**cur).prefix_len_) {
       /* exact match */
-      if (!(**cur).is_leaf()) {
-        return nullptr;
+      if (old_value != nullptr) {
+        *old_value = leaf_value(*cur);
       }
-      auto value = static_cast<leaf_node<T>*>(*cur)->value_;
       auto n_siblings = par != nullptr ? (**par).n_children() - 1 : 0;
+      track(*cur, -1);
+      stats_.depth_sum -= depth;
 
       if (n_siblings == 0) {
         /*
@@ -301,10 +1561,7 @@ template <class T> T *art<T>::del(const char *key) {
          *   *(aa)->v2
          */
 
-        if ((**cur).prefix_ != nullptr) {
-          delete[](**cur).prefix_;
-        }
-        delete (*cur);
+        destroy_node(*cur);
         *cur = nullptr;
 
       } else if (n_siblings == 1) {
@@ -321,33 +1578,24 @@ template <class T> T *art<T>::del(const char *key) {
          */
 
         /* find sibling */
-        auto sibling_partial_key = (**par).next_partial_key(0);
+        auto sibling_partial_key = (**par).next_partial_key(-128);
         if (sibling_partial_key == cur_partial_key) {
           sibling_partial_key = (**par).next_partial_key(cur_partial_key + 1);
         }
         auto sibling = *(**par).find_child(sibling_partial_key);
 
-        auto old_prefix = sibling->prefix_;
-        auto old_prefix_len = sibling->prefix_len_;
-
-        sibling->prefix_ = new char[(**par).prefix_len_ + 1 + old_prefix_len];
-        sibling->prefix_len_ = (**par).prefix_len_ + 1 + old_prefix_len;
-        std::copy((**par).prefix_, (**par).prefix_ + (**par).prefix_len_,
-                  sibling->prefix_);
-        sibling->prefix_[(**par).prefix_len_] = sibling_partial_key;
-        std::copy(old_prefix, old_prefix + old_prefix_len,
-                  sibling->prefix_ + (**par).prefix_len_ + 1);
-        if (old_prefix != nullptr) {
-          delete[] old_prefix;
-        }
-        if ((**cur).prefix_ != nullptr) {
-          delete[](**cur).prefix_;
+        track(sibling, -1);
+        track(*par, -1);
+        /* the sibling may take over the parent's prefix */
+        if (is_leaf(sibling)) {
+          stats_.depth_sum -= (**par).prefix_len_ + 1;
+          leaves_.prepend(sibling, **par, sibling_partial_key, alloc_);
+        } else {
+          sibling->prepend_prefix(**par, sibling_partial_key, alloc_);
         }
-        delete (*cur);
-        if ((**par).prefix_ != nullptr) {
-          delete[](**par).prefix_;
-        }
-        delete (*par);
+        track(sibling, 1);
+        destroy_node(*cur);
+        destroy_node(*par);
 
         /* this looks crazy, but I know what I'm doing */
         *par = static_cast<inner_node<T>*>(sibling);
@@ -363,17 +1611,29 @@ template <class T> T *art<T>::del(const char *key) {
          *           *()->v1
          */
 
-        if ((**cur).prefix_ != nullptr) {
-          delete[](**cur).prefix_;
-        }
-        delete (*cur);
+        destroy_node(*cur);
+        track(*par, -1);
         (**par).del_child(cur_partial_key);
         if ((**par).is_underfull()) {
-          *par = (**par).shrink();
+          *par = (**par).shrink(alloc_);
+          ++stats_.n_shrinks;
         }
+        track(*par, 1);
       }
 
-      return value;
+      count_path(key, key_len, -1);
+      return true;
+    }
+
+    if ((**cur).prefix_len_ !=
+        (**cur).check_prefix(key + depth, key_len - depth)) {
+      /* prefix mismatch => key doesn't exist */
+      return false;
+    }
+
+    if (key_len - depth <= (**cur).prefix_len_) {
+      /* the key ends in an inner node, which has no value */
+      return false;
     }
 
     /* propagate down and repeat */
@@ -382,18 +1642,396 @@ template <class T> T *art<T>::del(const char *key) {
     par = reinterpret_cast<inner_node<T>**>(cur);
     cur = (**par).find_child(cur_partial_key);
   }
-  return nullptr;
+  return false;
+}
+
+template <class T, class A, class K> tree_it<T> art<T, A, K>::begin() {
+  return tree_it<T>::min(this->root_, leaves_);
+}
+
+template <class T, class A, class K>
+tree_it<T> art<T, A, K>::begin(const char *key) {
+  return begin(key, std::strlen(key));
+}
+
+template <class T, class A, class K>
+tree_it<T> art<T, A, K>::begin(const char *key, std::size_t key_len) {
+  return tree_it<T>::greater_equal(this->root_, key, key_len, leaves_);
+}
+
+template <class T, class A, class K> tree_it<T> art<T, A, K>::last() {
+  return tree_it<T>::max(this->root_, leaves_);
+}
+
+template <class T, class A, class K>
+tree_it<T> art<T, A, K>::last(const char *key) {
+  return last(key, std::strlen(key) + 1);
+}
+
+template <class T, class A, class K>
+tree_it<T> art<T, A, K>::last(const char *key, std::size_t key_len) {
+  return tree_it<T>::less_equal(this->root_, key, key_len, leaves_);
+}
+
+#if __cplusplus >= 201703L
+template <class T, class A, class K>
+T *art<T, A, K>::get(std::string_view key) const {
+  return get(key.data(), key.size());
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::set(std::string_view key, T *value) {
+  return set(key.data(), key.size(), value);
+}
+
+template <class T, class A, class K>
+T **art<T, A, K>::find_or_insert(std::string_view key) {
+  return find_or_insert(key.data(), key.size());
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::insert_if_absent(std::string_view key, T *value) {
+  return insert_if_absent(key.data(), key.size(), value);
+}
+
+template <class T, class A, class K>
+template <class F>
+T *art<T, A, K>::update(std::string_view key, F fn) {
+  return update(key.data(), key.size(), fn);
+}
+
+template <class T, class A, class K>
+T *art<T, A, K>::del(std::string_view key) {
+  return del(key.data(), key.size());
+}
+
+template <class T, class A, class K>
+tree_it<T> art<T, A, K>::begin(std::string_view key) {
+  return begin(key.data(), key.size());
 }
 
-template <class T> tree_it<T> art<T>::begin() {
-  return tree_it<T>::min(this->root_);
+template <class T, class A, class K>
+tree_it<T> art<T, A, K>::last(std::string_view key) {
+  return last(key.data(), key.size());
+}
+#endif
+
+template <class T, class A, class K> tree_it<T> art<T, A, K>::end() {
+  return tree_it<T>::end(this->root_, leaves_);
+}
+
+template <class T, class A, class K>
+bool art<T, A, K>::key_less(const char *a, std::size_t a_len, const char *b,
+                            std::size_t b_len) {
+  std::size_t n = std::min(a_len, b_len);
+  for (std::size_t i = 0; i < n; ++i) {
+    if (a[i] != b[i]) {
+      return a[i] < b[i];
+    }
+  }
+  return a_len < b_len;
+}
+
+template <class T, class A, class K>
+template <class F>
+void art<T, A, K>::scan_prefix(const char *prefix, std::size_t prefix_len,
+                               F visitor) const {
+  auto it = tree_it<T>::greater_equal(this->root_, prefix, prefix_len,
+                                      leaves_);
+  for (auto it_end = tree_it<T>(); it != it_end; ++it) {
+    const std::string &key = it.key();
+    if (key.size() < prefix_len ||
+        std::memcmp(key.data(), prefix, prefix_len) != 0) {
+      /* past the keys starting with the prefix */
+      return;
+    }
+    if (!visitor(key, *it)) {
+      return;
+    }
+  }
 }
 
-template <class T> tree_it<T> art<T>::begin(const char *key) {
-  return tree_it<T>::greater_equal(this->root_, key);
+template <class T, class A, class K>
+template <class F>
+void art<T, A, K>::scan_prefix(const char *prefix, F visitor) const {
+  scan_prefix(prefix, std::strlen(prefix), visitor);
 }
 
-template <class T> tree_it<T> art<T>::end() { return tree_it<T>(); }
+template <class T, class A, class K>
+template <class F>
+void art<T, A, K>::scan_range(const char *lo, std::size_t lo_len,
+                              const char *hi, std::size_t hi_len,
+                              F visitor) const {
+  auto it = tree_it<T>::greater_equal(this->root_, lo, lo_len, leaves_);
+  for (auto it_end = tree_it<T>(); it != it_end; ++it) {
+    const std::string &key = it.key();
+    if (!key_less(key.data(), key.size(), hi, hi_len)) {
+      return;
+    }
+    if (!visitor(key, *it)) {
+      return;
+    }
+  }
+}
+
+template <class T, class A, class K>
+template <class F>
+void art<T, A, K>::scan_range(const char *lo, const char *hi,
+                              F visitor) const {
+  scan_range(lo, std::strlen(lo), hi, std::strlen(hi), visitor);
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::count_prefix(const char *prefix,
+                                       std::size_t prefix_len) const {
+  node<T> *cur = root_;
+  int depth = 0, len = prefix_len, cur_prefix_len, i;
+  const char *cur_prefix;
+  while (cur != nullptr) {
+    if (is_leaf(cur)) {
+      cur_prefix = leaves_.key(cur, depth, cur_prefix_len);
+    } else {
+      cur_prefix = cur->prefix();
+      cur_prefix_len = cur->prefix_len_;
+    }
+    for (i = 0; i < cur_prefix_len; ++i) {
+      if (depth + i == len) {
+        /* the prefix ends within the node's prefix */
+        return count_leaves(cur);
+      }
+      if (cur_prefix[i] != prefix[depth + i]) {
+        return 0;
+      }
+    }
+    depth += cur_prefix_len;
+    if (depth == len) {
+      return count_leaves(cur);
+    }
+    if (is_leaf(cur)) {
+      /* the leaf's key is shorter than the prefix */
+      return 0;
+    }
+    node<T> **child =
+        static_cast<inner_node<T> *>(cur)->find_child(prefix[depth]);
+    cur = child != nullptr ? *child : nullptr;
+    ++depth;
+  }
+  return 0;
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::count_prefix(const char *prefix) const {
+  return count_prefix(prefix, std::strlen(prefix));
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::count_range(const char *lo, std::size_t lo_len,
+                                      const char *hi,
+                                      std::size_t hi_len) const {
+  if (root_ == nullptr || !key_less(lo, lo_len, hi, hi_len)) {
+    return 0;
+  }
+  return count_range(root_, 0, lo, lo_len, true, hi, hi_len, true);
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::count_range(const char *lo, const char *hi) const {
+  return count_range(lo, std::strlen(lo), hi, std::strlen(hi));
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::rank(const char *key, std::size_t key_len) const {
+  return count_range("", 0, key, key_len);
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::rank(const char *key) const {
+  return rank(key, std::strlen(key));
+}
+
+template <class T, class A, class K>
+tree_it<T> art<T, A, K>::select(std::size_t k) {
+  if (k >= stats_.n_leaves) {
+    return end();
+  }
+  /* descends into the child whose subtree holds the k-th key, collecting
+   * the key to seek to */
+  std::string key;
+  node<T> *cur = root_, *child;
+  inner_node<T> *cur_inner;
+  std::size_t n;
+  int slot, len;
+  while (!is_leaf(cur)) {
+    cur_inner = static_cast<inner_node<T> *>(cur);
+    key.append(cur->prefix(), cur->prefix_len_);
+    for (slot = cur_inner->next_slot(-1);; slot = cur_inner->next_slot(slot)) {
+      child = *cur_inner->slot_child(slot);
+      n = count_leaves(child);
+      if (k < n) {
+        break;
+      }
+      k -= n;
+    }
+    key.push_back(cur_inner->slot_partial_key(slot));
+    cur = child;
+  }
+  const char *rest = leaves_.key(cur, key.size(), len);
+  key.append(rest, len);
+  return begin(key.data(), key.size());
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::count_range(node<T> *n, int depth, const char *lo,
+                                      int lo_len, bool on_lo, const char *hi,
+                                      int hi_len, bool on_hi) const {
+  if (!on_lo && !on_hi) {
+    return count_leaves(n);
+  }
+
+  int prefix_len, i;
+  const char *prefix;
+  if (is_leaf(n)) {
+    prefix = leaves_.key(n, depth, prefix_len);
+  } else {
+    prefix = n->prefix();
+    prefix_len = n->prefix_len_;
+  }
+  for (i = 0; i < prefix_len && (on_lo || on_hi); ++i) {
+    if (on_lo) {
+      if (depth + i == lo_len || prefix[i] > lo[depth + i]) {
+        /* every key of the subtree is greater than lo */
+        on_lo = false;
+      } else if (prefix[i] < lo[depth + i]) {
+        return 0;
+      }
+    }
+    if (on_hi) {
+      if (depth + i == hi_len || prefix[i] > hi[depth + i]) {
+        /* every key of the subtree is greater or equal to hi */
+        return 0;
+      } else if (prefix[i] < hi[depth + i]) {
+        on_hi = false;
+      }
+    }
+  }
+  depth += prefix_len;
+
+  if (is_leaf(n)) {
+    /* the leaf's key is a prefix of lo or hi, or equal to it */
+    if (on_lo && depth < lo_len) {
+      return 0;
+    }
+    if (on_hi && depth == hi_len) {
+      return 0;
+    }
+    return 1;
+  }
+
+  /* the keys of the subtree are longer than depth bytes */
+  if (on_hi && depth == hi_len) {
+    return 0;
+  }
+  if (on_lo && depth == lo_len) {
+    on_lo = false;
+  }
+  if (!on_lo && !on_hi) {
+    return count_leaves(n);
+  }
+
+  auto cur = static_cast<inner_node<T> *>(n);
+  std::size_t count = 0;
+  bool child_on_lo, child_on_hi;
+  char partial_key;
+  for (int slot = cur->next_slot(-1), n_slots = cur->n_slots();
+       slot < n_slots; slot = cur->next_slot(slot)) {
+    partial_key = cur->slot_partial_key(slot);
+    if (on_lo && partial_key < lo[depth]) {
+      continue;
+    }
+    if (on_hi && partial_key > hi[depth]) {
+      break;
+    }
+    child_on_lo = on_lo && partial_key == lo[depth];
+    child_on_hi = on_hi && partial_key == hi[depth];
+    count += count_range(*cur->slot_child(slot), depth + 1, lo, lo_len,
+                         child_on_lo, hi, hi_len, child_on_hi);
+  }
+  return count;
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::count_leaves(node<T> *n) {
+  if (is_leaf(n)) {
+    return 1;
+  }
+  auto cur = static_cast<inner_node<T> *>(n);
+#if defined(ART_SUBTREE_COUNTS)
+  return cur->n_leaves_;
+#else
+  std::size_t count = 0;
+  for (int slot = cur->next_slot(-1), n_slots = cur->n_slots();
+       slot < n_slots; slot = cur->next_slot(slot)) {
+    count += count_leaves(*cur->slot_child(slot));
+  }
+  return count;
+#endif
+}
+
+template <class T, class A, class K>
+void art<T, A, K>::count_path(const char *key, int key_len, int delta) {
+#if defined(ART_SUBTREE_COUNTS)
+  /* the inner nodes whose prefix the key passes, i.e. the ancestors of the
+   * key's leaf. After a deletion, a node that replaced its parent isn't on
+   * the path, since its prefix holds its own partial key. */
+  node<T> *cur = root_, **child;
+  int depth = 0;
+  while (cur != nullptr && !is_leaf(cur) &&
+         cur->prefix_len_ == cur->check_prefix(key + depth, key_len - depth) &&
+         cur->prefix_len_ < key_len - depth) {
+    /* delta converts to a size_t, subtracting wraps around like in track */
+    static_cast<inner_node<T> *>(cur)->n_leaves_ += delta;
+    child = static_cast<inner_node<T> *>(cur)->find_child(
+        key[depth + cur->prefix_len_]);
+    depth += cur->prefix_len_ + 1;
+    cur = child != nullptr ? *child : nullptr;
+  }
+#else
+  (void)key;
+  (void)key_len;
+  (void)delta;
+#endif
+}
+
+#if __cplusplus >= 201703L
+template <class T, class A, class K>
+template <class F>
+void art<T, A, K>::scan_prefix(std::string_view prefix, F visitor) const {
+  scan_prefix(prefix.data(), prefix.size(), visitor);
+}
+
+template <class T, class A, class K>
+template <class F>
+void art<T, A, K>::scan_range(std::string_view lo, std::string_view hi,
+                              F visitor) const {
+  scan_range(lo.data(), lo.size(), hi.data(), hi.size(), visitor);
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::count_prefix(std::string_view prefix) const {
+  return count_prefix(prefix.data(), prefix.size());
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::count_range(std::string_view lo,
+                                      std::string_view hi) const {
+  return count_range(lo.data(), lo.size(), hi.data(), hi.size());
+}
+
+template <class T, class A, class K>
+std::size_t art<T, A, K>::rank(std::string_view key) const {
+  return rank(key.data(), key.size());
+}
+#endif
 
 } // namespace art
 
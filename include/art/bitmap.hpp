@@ -0,0 +1,108 @@
+/**
+ * @file bitmap header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_BITMAP_HPP
+#define ART_BITMAP_HPP
+
+#include <cstdint>
+
+namespace art {
+
+/**
+ * Presence bitmap of the 256 child slots of a node_48 or node_256.
+ *
+ * Finding the next or previous present slot scans at most four words with
+ * count trailing / leading zeros, instead of up to 256 slots.
+ */
+class bitmap {
+public:
+  void set(int i);
+  void reset(int i);
+  bool test(int i) const;
+
+  /**
+   * Returns the smallest present index that is greater or equal to i,
+   * or -1 if there is none.
+   */
+  int next(int i) const;
+
+  /**
+   * Returns the greatest present index that is less or equal to i,
+   * or -1 if there is none.
+   */
+  int prev(int i) const;
+
+private:
+  static int ctz(uint64_t word);
+  static int clz(uint64_t word);
+
+  uint64_t words_[4] = {0, 0, 0, 0};
+};
+
+inline void bitmap::set(int i) { words_[i >> 6] |= uint64_t(1) << (i & 63); }
+
+inline void bitmap::reset(int i) {
+  words_[i >> 6] &= ~(uint64_t(1) << (i & 63));
+}
+
+inline bool bitmap::test(int i) const {
+  return (words_[i >> 6] >> (i & 63)) & 1;
+}
+
+inline int bitmap::next(int i) const {
+  int w = i >> 6;
+  /* clear the bits below i */
+  uint64_t word = words_[w] & (~uint64_t(0) << (i & 63));
+  while (word == 0) {
+    if (++w == 4) {
+      return -1;
+    }
+    word = words_[w];
+  }
+  return (w << 6) + ctz(word);
+}
+
+inline int bitmap::prev(int i) const {
+  int w = i >> 6;
+  /* clear the bits above i */
+  uint64_t word = words_[w] & (~uint64_t(0) >> (63 - (i & 63)));
+  while (word == 0) {
+    if (--w < 0) {
+      return -1;
+    }
+    word = words_[w];
+  }
+  return (w << 6) + 63 - clz(word);
+}
+
+inline int bitmap::ctz(uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_ctzll(word);
+#else
+  int n = 0;
+  while ((word & 1) == 0) {
+    word >>= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+inline int bitmap::clz(uint64_t word) {
+#if defined(__GNUC__)
+  return __builtin_clzll(word);
+#else
+  int n = 0;
+  while ((word & (uint64_t(1) << 63)) == 0) {
+    word <<= 1;
+    ++n;
+  }
+  return n;
+#endif
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,170 @@
+/**
+ * @file boxed leaves header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_BOXED_LEAVES_HPP
+#define ART_BOXED_LEAVES_HPP
+
+#include "allocator.hpp"
+#include "leaf_node.hpp"
+#include "node.hpp"
+#include <cstddef>
+#include <cstring>
+
+namespace art {
+
+/**
+ * Leaf policy of trees without a key extractor.
+ *
+ * Every value is stored in a leaf_node<T>, which holds the remaining bytes of
+ * its key as the prefix.
+ */
+template <class T> class boxed_leaves {
+public:
+  /* the tree must visit every leaf on destruction unless this is set */
+  static const bool trivially_destructible = true;
+
+  /**
+   * Creates a leaf for the given value.
+   *
+   * @param key - The remaining bytes of the key.
+   * @param key_len - The number of remaining bytes of the key.
+   * @param value - The value of the leaf.
+   * @param alloc - The allocator of the tree.
+   */
+  template <class A>
+  node<T> *make(const char *key, int key_len, T *value, A &alloc) const;
+
+  /**
+   * Determines if the leaf reached at the given depth holds the given key.
+   */
+  bool matches(const node<T> *leaf, const char *key, int depth,
+               int key_len) const;
+
+  /**
+   * Returns the remaining bytes of the leaf's key at the given depth.
+   *
+   * @param len - Set to the number of remaining bytes.
+   */
+  const char *key(const node<T> *leaf, int depth, int &len) const;
+
+  /**
+   * Drops the first n remaining bytes of the leaf's key, used when the leaf
+   * moves n levels down.
+   */
+  template <class A> void trim(node<T> *leaf, int n, A &alloc) const;
+
+  /**
+   * Sets the prefix of the leaf's new parent to the first prefix_len
+   * remaining bytes of the leaf's key, given as prefix, and moves the leaf
+   * prefix_len + 1 levels down. See node::split_prefix.
+   */
+  template <class A>
+  void split(node<T> *leaf, node<T> &parent, const char *prefix,
+             int prefix_len, A &alloc) const;
+
+  /**
+   * Prepends the given bytes to the remaining bytes of the leaf's key, used
+   * when the leaf replaces its parent.
+   */
+  template <class A>
+  void prepend(node<T> *leaf, const char *prefix, int prefix_len,
+               char partial_key, A &alloc) const;
+
+  /**
+   * Prepends the parent's prefix and the partial key to the remaining bytes
+   * of the leaf's key, which may take over the parent's prefix, see
+   * node::prepend_prefix(node<T> &, char, A &).
+   */
+  template <class A>
+  void prepend(node<T> *leaf, node<T> &parent, char partial_key,
+               A &alloc) const;
+
+  /**
+   * Replaces the value of the leaf stored in the given child slot.
+   */
+  void set_value(node<T> *&slot, T *value) const;
+
+  /**
+   * Returns the number of bytes allocated for the leaf, including its key.
+   */
+  std::size_t size(const node<T> *leaf) const;
+
+  template <class A> void destroy(node<T> *leaf, A &alloc) const;
+};
+
+template <class T> const bool boxed_leaves<T>::trivially_destructible;
+
+template <class T>
+template <class A>
+node<T> *boxed_leaves<T>::make(const char *key, int key_len, T *value,
+                               A &alloc) const {
+  auto leaf = ::art::make<leaf_node<T>>(alloc, value);
+  leaf->set_prefix(key, key_len, alloc);
+  return leaf;
+}
+
+template <class T>
+bool boxed_leaves<T>::matches(const node<T> *leaf, const char *key, int depth,
+                              int key_len) const {
+  return leaf->prefix_len_ == key_len - depth &&
+         std::memcmp(leaf->prefix(), key + depth, leaf->prefix_len_) == 0;
+}
+
+template <class T>
+const char *boxed_leaves<T>::key(const node<T> *leaf, int /* depth */,
+                                 int &len) const {
+  len = leaf->prefix_len_;
+  return leaf->prefix();
+}
+
+template <class T>
+template <class A>
+void boxed_leaves<T>::trim(node<T> *leaf, int n, A &alloc) const {
+  leaf->set_prefix(leaf->prefix() + n, leaf->prefix_len_ - n, alloc);
+}
+
+template <class T>
+template <class A>
+void boxed_leaves<T>::split(node<T> *leaf, node<T> &parent,
+                            const char * /* prefix */, int prefix_len,
+                            A &alloc) const {
+  leaf->split_prefix(parent, prefix_len, alloc);
+}
+
+template <class T>
+template <class A>
+void boxed_leaves<T>::prepend(node<T> *leaf, const char *prefix,
+                              int prefix_len, char partial_key,
+                              A &alloc) const {
+  leaf->prepend_prefix(prefix, prefix_len, partial_key, alloc);
+}
+
+template <class T>
+template <class A>
+void boxed_leaves<T>::prepend(node<T> *leaf, node<T> &parent,
+                              char partial_key, A &alloc) const {
+  leaf->prepend_prefix(parent, partial_key, alloc);
+}
+
+template <class T>
+void boxed_leaves<T>::set_value(node<T> *&slot, T *value) const {
+  static_cast<leaf_node<T> *>(slot)->value_ = value;
+}
+
+template <class T>
+std::size_t boxed_leaves<T>::size(const node<T> *leaf) const {
+  return sizeof(leaf_node<T>) + leaf->heap_prefix_size();
+}
+
+template <class T>
+template <class A>
+void boxed_leaves<T>::destroy(node<T> *leaf, A &alloc) const {
+  leaf->free_prefix(alloc);
+  ::art::destroy(alloc, static_cast<leaf_node<T> *>(leaf));
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,552 @@
+/**
+ * @file adaptive radix tree with leaf buckets
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_BUCKET_ART_HPP
+#define ART_BUCKET_ART_HPP
+
+#include "allocator.hpp"
+#include "inner_node.hpp"
+#include "leaf_bucket.hpp"
+#include "node.hpp"
+#include "node_16.hpp"
+#include "node_256.hpp"
+#include "node_4.hpp"
+#include "node_48.hpp"
+#include "tree_stats.hpp"
+#include <cstddef>
+#include <cstring>
+#include <stack>
+#include <stdexcept>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace art {
+
+/**
+ * Adaptive radix tree whose fringe consists of leaf buckets.
+ *
+ * Where an art stores every key in its own leaf, below inner nodes that
+ * often have only a few children, a bucket_art stores up to
+ * leaf_bucket::capacity keys that share the path to a child slot in one
+ * leaf_bucket. A full bucket bursts into an inner node, whose children are
+ * buckets again, when another key is inserted, and a bucket whose parent
+ * is left with no other child replaces the parent. Sparse keys like long
+ * random strings therefore need a fraction of the inner nodes and
+ * allocations, at the cost of copying a bucket on every insertion and
+ * deletion.
+ *
+ * Keys and values are the same as for art, the tree doesn't free the
+ * values.
+ *
+ * @tparam T - The type of the values, which are stored by pointer.
+ * @tparam A - The allocator used for buckets, nodes and prefixes.
+ */
+template <class T, class A = pool_allocator> class bucket_art {
+public:
+  bucket_art() = default;
+  bucket_art(const bucket_art<T, A> &other) = delete;
+  bucket_art<T, A> &operator=(const bucket_art<T, A> &other) = delete;
+  ~bucket_art();
+
+  /**
+   * Finds the value associated with the given key, see art::get.
+   */
+  T *get(const char *key) const;
+  T *get(const char *key, std::size_t key_len) const;
+
+  /**
+   * Associates the given key with the given value, see art::set.
+   *
+   * @return the previously associated value or a nullptr.
+   * @throws std::invalid_argument if the key is a proper prefix of a key in
+   * the tree or the other way around, the tree is left unchanged.
+   */
+  T *set(const char *key, T *value);
+  T *set(const char *key, std::size_t key_len, T *value);
+
+  /**
+   * Deletes the given key, see art::del.
+   *
+   * @return the value associated with the key or a nullptr.
+   */
+  T *del(const char *key);
+  T *del(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  T *get(std::string_view key) const;
+  T *set(std::string_view key, T *value);
+  T *del(std::string_view key);
+#endif
+
+  /**
+   * Visits every key in lexicographic order, calling
+   * `bool visitor(const std::string &key, T *value)`, which returns false to
+   * stop, see art::scan_prefix.
+   */
+  template <class F> void scan(F visitor) const;
+
+  /**
+   * Returns the shape and memory usage of the tree, see art::stats. Buckets
+   * are counted in n_buckets, their keys in n_leaves.
+   */
+  const tree_stats &stats() const;
+
+private:
+  using bucket = leaf_bucket<T>;
+  using entry = typename bucket::entry;
+
+  static bool is_bucket(const node<T> *n);
+
+  node<T> *make_bucket(const char *key, int key_len, T *value);
+
+  /**
+   * Replaces the full bucket at the given depth by an inner node with the
+   * bucket's keys and the given key, which is inserted at index i, in new
+   * buckets below it.
+   */
+  node<T> *burst(bucket *b, int i, const char *key, int key_len, T *value,
+                 int depth);
+
+  template <class F>
+  bool scan(node<T> *n, int depth, std::string &path, F &visitor) const;
+
+  /**
+   * Adds (sign 1) or removes (sign -1) the given node to or from the
+   * statistics, see art::track.
+   */
+  void track(const node<T> *n, int sign);
+
+  void destroy_node(node<T> *n);
+
+  node<T> *root_ = nullptr;
+  A alloc_;
+  tree_stats stats_;
+};
+
+template <class T, class A> bucket_art<T, A>::~bucket_art() {
+  if (root_ == nullptr || A::bulk_release) {
+    /* buckets don't own their values, the allocator releases the nodes */
+    return;
+  }
+  std::stack<node<T> *> node_stack;
+  node_stack.push(root_);
+  node<T> *cur;
+  inner_node<T> *cur_inner;
+  int slot, n_slots;
+  while (!node_stack.empty()) {
+    cur = node_stack.top();
+    node_stack.pop();
+    if (!is_bucket(cur)) {
+      cur_inner = static_cast<inner_node<T> *>(cur);
+      for (slot = cur_inner->next_slot(-1), n_slots = cur_inner->n_slots();
+           slot < n_slots; slot = cur_inner->next_slot(slot)) {
+        node_stack.push(*cur_inner->slot_child(slot));
+      }
+    }
+    destroy_node(cur);
+  }
+}
+
+template <class T, class A>
+bool bucket_art<T, A>::is_bucket(const node<T> *n) {
+  return n->type_ == node_type::bucket;
+}
+
+template <class T, class A>
+node<T> *bucket_art<T, A>::make_bucket(const char *key, int key_len,
+                                       T *value) {
+  entry e{key, key_len, value};
+  return bucket::make(&e, 1, nullptr, 0, 0, alloc_);
+}
+
+template <class T, class A>
+void bucket_art<T, A>::destroy_node(node<T> *n) {
+  if (is_bucket(n)) {
+    static_cast<bucket *>(n)->destroy(alloc_);
+  } else {
+    n->free_prefix(alloc_);
+    static_cast<inner_node<T> *>(n)->destroy(alloc_);
+  }
+}
+
+template <class T, class A>
+void bucket_art<T, A>::track(const node<T> *n, int sign) {
+  /* sign converts to a size_t, subtracting wraps around like it should */
+  if (is_bucket(n)) {
+    auto b = static_cast<const bucket *>(n);
+    stats_.n_buckets += sign;
+    stats_.n_leaves += sign * b->n_keys();
+    stats_.memory_bytes += sign * b->size();
+    return;
+  }
+  std::size_t size;
+  switch (n->type_) {
+  case node_type::node_4:
+    stats_.n_node_4 += sign;
+    size = sizeof(node_4<T>);
+    break;
+  case node_type::node_16:
+    stats_.n_node_16 += sign;
+    size = sizeof(node_16<T>);
+    break;
+  case node_type::node_48:
+    stats_.n_node_48 += sign;
+    size = sizeof(node_48<T>);
+    break;
+  default:
+    stats_.n_node_256 += sign;
+    size = sizeof(node_256<T>);
+    break;
+  }
+  size += n->heap_prefix_size();
+  stats_.memory_bytes += sign * size;
+  stats_.prefix_bytes += sign * n->prefix_len_;
+  stats_.fan_out[static_cast<const inner_node<T> *>(n)->n_children()] += sign;
+}
+
+template <class T, class A>
+const tree_stats &bucket_art<T, A>::stats() const {
+  return stats_;
+}
+
+template <class T, class A>
+T *bucket_art<T, A>::get(const char *key) const {
+  return get(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+T *bucket_art<T, A>::get(const char *key, std::size_t len) const {
+  node<T> *cur = root_, **child;
+  int depth = 0, key_len = len, i;
+  while (cur != nullptr) {
+    if (is_bucket(cur)) {
+      auto b = static_cast<bucket *>(cur);
+      i = b->find(key + depth, key_len - depth);
+      return i >= 0 ? b->value(i) : nullptr;
+    }
+    if (cur->prefix_len_ != cur->check_prefix(key + depth, key_len - depth) ||
+        cur->prefix_len_ >= key_len - depth) {
+      /* prefix mismatch or the key ends in an inner node */
+      return nullptr;
+    }
+    child = static_cast<inner_node<T> *>(cur)->find_child(
+        key[depth + cur->prefix_len_]);
+    depth += cur->prefix_len_ + 1;
+    cur = child != nullptr ? *child : nullptr;
+  }
+  return nullptr;
+}
+
+template <class T, class A>
+T *bucket_art<T, A>::set(const char *key, T *value) {
+  return set(key, std::strlen(key) + 1, value);
+}
+
+template <class T, class A>
+T *bucket_art<T, A>::set(const char *key, std::size_t len, T *value) {
+  int key_len = len, depth = 0, prefix_match_len, i;
+  if (root_ == nullptr) {
+    root_ = make_bucket(key, key_len, value);
+    track(root_, 1);
+    return nullptr;
+  }
+
+  node<T> **cur = &root_, **child;
+  inner_node<T> *cur_inner;
+  char child_partial_key;
+  while (true) {
+    if (is_bucket(*cur)) {
+      auto b = static_cast<bucket *>(*cur);
+      const char *rest = key + depth;
+      int rest_len = key_len - depth;
+      i = b->find(rest, rest_len);
+      if (i >= 0) {
+        T *old_value = b->value(i);
+        b->value(i) = value;
+        return old_value;
+      }
+      i = b->lower_bound(rest, rest_len);
+      /* in key order, a key with a prefix in the bucket directly follows
+       * it and the keys it is a prefix of directly follow the key */
+      if (b->is_prefix_related(i - 1, rest, rest_len) ||
+          b->is_prefix_related(i, rest, rest_len)) {
+        throw std::invalid_argument("keys must be prefix-free");
+      }
+      track(b, -1);
+      if (b->n_keys() < bucket::capacity) {
+        *cur = b->insert(i, rest, rest_len, value, alloc_);
+        track(*cur, 1);
+        stats_.depth_sum += depth;
+      } else {
+        *cur = burst(b, i, rest, rest_len, value, depth);
+      }
+      return nullptr;
+    }
+
+    prefix_match_len = (**cur).check_prefix(key + depth, key_len - depth);
+    if (prefix_match_len == key_len - depth) {
+      /* the key ends within the current node */
+      throw std::invalid_argument("keys must be prefix-free");
+    }
+
+    if (prefix_match_len < (**cur).prefix_len_) {
+      /* prefix mismatch, see art::set: the new parent takes over the
+       * matching part of the prefix */
+      track(*cur, -1);
+      auto new_parent = make<node_4<T>>(alloc_);
+      new_parent->set_child((**cur).prefix()[prefix_match_len], *cur);
+      (**cur).split_prefix(*new_parent, prefix_match_len, alloc_);
+      ++stats_.n_prefix_splits;
+      track(*cur, 1);
+
+      node<T> *new_bucket =
+          make_bucket(key + depth + prefix_match_len + 1,
+                      key_len - depth - prefix_match_len - 1, value);
+      new_parent->set_child(key[depth + prefix_match_len], new_bucket);
+      track(new_parent, 1);
+      track(new_bucket, 1);
+      stats_.depth_sum += depth + prefix_match_len + 1;
+      *cur = new_parent;
+      return nullptr;
+    }
+
+    cur_inner = static_cast<inner_node<T> *>(*cur);
+    child_partial_key = key[depth + prefix_match_len];
+    child = cur_inner->find_child(child_partial_key);
+    if (child == nullptr) {
+      /* no child with the next partial key, the key gets its own bucket */
+      track(cur_inner, -1);
+      if (cur_inner->is_full()) {
+        cur_inner = cur_inner->grow(alloc_);
+        *cur = cur_inner;
+        ++stats_.n_grows;
+      }
+      node<T> *new_bucket =
+          make_bucket(key + depth + prefix_match_len + 1,
+                      key_len - depth - prefix_match_len - 1, value);
+      cur_inner->set_child(child_partial_key, new_bucket);
+      track(cur_inner, 1);
+      track(new_bucket, 1);
+      stats_.depth_sum += depth + prefix_match_len + 1;
+      return nullptr;
+    }
+
+    depth += prefix_match_len + 1;
+    cur = child;
+  }
+}
+
+template <class T, class A>
+node<T> *bucket_art<T, A>::burst(bucket *b, int i, const char *key,
+                                 int key_len, T *value, int depth) {
+  const int n = bucket::capacity + 1;
+  entry entries[n];
+  for (int j = 0; j < b->n_keys(); ++j) {
+    entries[j < i ? j : j + 1] = b->at(j);
+  }
+  entries[i] = entry{key, key_len, value};
+
+  /* the first and the last key share the prefix of all keys, and differ
+   * before either ends since the keys are prefix-free */
+  const char *first = entries[0].key_, *last = entries[n - 1].key_;
+  int prefix_len = 0;
+  while (first[prefix_len] == last[prefix_len]) {
+    ++prefix_len;
+  }
+  int n_children = 1;
+  for (int j = 1; j < n; ++j) {
+    if (entries[j].key_[prefix_len] != entries[j - 1].key_[prefix_len]) {
+      ++n_children;
+    }
+  }
+
+  inner_node<T> *n_inner;
+  if (n_children <= 4) {
+    n_inner = make<node_4<T>>(alloc_);
+  } else if (n_children <= 16) {
+    n_inner = make<node_16<T>>(alloc_);
+  } else {
+    n_inner = make<node_48<T>>(alloc_);
+  }
+  n_inner->set_prefix(first, prefix_len, alloc_);
+
+  /* one bucket per run of keys with the same partial key */
+  int run_begin = 0, run_end;
+  char partial_key;
+  node<T> *child;
+  while (run_begin < n) {
+    partial_key = entries[run_begin].key_[prefix_len];
+    run_end = run_begin + 1;
+    while (run_end < n && entries[run_end].key_[prefix_len] == partial_key) {
+      ++run_end;
+    }
+    child = bucket::make(entries + run_begin, run_end - run_begin, nullptr, 0,
+                         prefix_len + 1, alloc_);
+    n_inner->set_child(partial_key, child);
+    track(child, 1);
+    run_begin = run_end;
+  }
+  track(n_inner, 1);
+  ++stats_.n_bursts;
+  stats_.depth_sum += n * (depth + prefix_len + 1) - (n - 1) * depth;
+
+  /* the entries point into the bucket */
+  b->destroy(alloc_);
+  return n_inner;
+}
+
+template <class T, class A> T *bucket_art<T, A>::del(const char *key) {
+  return del(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+T *bucket_art<T, A>::del(const char *key, std::size_t len) {
+  int depth = 0, key_len = len, i;
+  if (root_ == nullptr) {
+    return nullptr;
+  }
+
+  node<T> **cur = &root_, **par = nullptr, **child;
+  inner_node<T> *par_inner;
+  char cur_partial_key = 0;
+  while (true) {
+    if (is_bucket(*cur)) {
+      auto b = static_cast<bucket *>(*cur);
+      i = b->find(key + depth, key_len - depth);
+      if (i < 0) {
+        return nullptr;
+      }
+      T *value = b->value(i);
+      track(b, -1);
+      stats_.depth_sum -= depth;
+
+      if (b->n_keys() > 1) {
+        *cur = b->erase(i, alloc_);
+        track(*cur, 1);
+        return value;
+      }
+
+      /* the bucket's last key, the bucket is deleted like a leaf */
+      par_inner = par != nullptr ? static_cast<inner_node<T> *>(*par) : nullptr;
+      int n_siblings = par_inner != nullptr ? par_inner->n_children() - 1 : 0;
+      if (n_siblings == 0) {
+        b->destroy(alloc_);
+        *cur = nullptr;
+      } else if (n_siblings == 1) {
+        /* the sibling replaces the parent */
+        char sibling_partial_key = par_inner->next_partial_key(-128);
+        if (sibling_partial_key == cur_partial_key) {
+          sibling_partial_key = par_inner->next_partial_key(cur_partial_key + 1);
+        }
+        node<T> *sibling = *par_inner->find_child(sibling_partial_key);
+        track(sibling, -1);
+        track(par_inner, -1);
+        if (is_bucket(sibling)) {
+          auto sibling_bucket = static_cast<bucket *>(sibling);
+          stats_.depth_sum -=
+              sibling_bucket->n_keys() * (par_inner->prefix_len_ + 1);
+          sibling = sibling_bucket->prepend(par_inner->prefix(),
+                                            par_inner->prefix_len_,
+                                            sibling_partial_key, alloc_);
+        } else {
+          sibling->prepend_prefix(*par_inner, sibling_partial_key, alloc_);
+        }
+        track(sibling, 1);
+        b->destroy(alloc_);
+        destroy_node(par_inner);
+        *par = sibling;
+      } else {
+        b->destroy(alloc_);
+        track(par_inner, -1);
+        par_inner->del_child(cur_partial_key);
+        if (par_inner->is_underfull()) {
+          *par = par_inner->shrink(alloc_);
+          ++stats_.n_shrinks;
+        }
+        track(*par, 1);
+      }
+      return value;
+    }
+
+    if ((**cur).prefix_len_ !=
+            (**cur).check_prefix(key + depth, key_len - depth) ||
+        (**cur).prefix_len_ >= key_len - depth) {
+      return nullptr;
+    }
+    cur_partial_key = key[depth + (**cur).prefix_len_];
+    child = static_cast<inner_node<T> *>(*cur)->find_child(cur_partial_key);
+    if (child == nullptr) {
+      return nullptr;
+    }
+    depth += (**cur).prefix_len_ + 1;
+    par = cur;
+    cur = child;
+  }
+}
+
+#if __cplusplus >= 201703L
+template <class T, class A>
+T *bucket_art<T, A>::get(std::string_view key) const {
+  return get(key.data(), key.size());
+}
+
+template <class T, class A>
+T *bucket_art<T, A>::set(std::string_view key, T *value) {
+  return set(key.data(), key.size(), value);
+}
+
+template <class T, class A> T *bucket_art<T, A>::del(std::string_view key) {
+  return del(key.data(), key.size());
+}
+#endif
+
+template <class T, class A>
+template <class F>
+void bucket_art<T, A>::scan(F visitor) const {
+  if (root_ != nullptr) {
+    std::string path;
+    scan(root_, 0, path, visitor);
+  }
+}
+
+template <class T, class A>
+template <class F>
+bool bucket_art<T, A>::scan(node<T> *n, int depth, std::string &path,
+                            F &visitor) const {
+  const char *key;
+  int len;
+  if (is_bucket(n)) {
+    auto b = static_cast<bucket *>(n);
+    for (int i = 0; i < b->n_keys(); ++i) {
+      key = b->key(i, len);
+      path.resize(depth);
+      path.append(key, len);
+      if (!visitor(static_cast<const std::string &>(path), b->value(i))) {
+        return false;
+      }
+    }
+    return true;
+  }
+  auto inner = static_cast<inner_node<T> *>(n);
+  int prefix_len = n->prefix_len_;
+  path.resize(depth);
+  path.append(n->prefix(), prefix_len);
+  for (int slot = inner->next_slot(-1), n_slots = inner->n_slots();
+       slot < n_slots; slot = inner->next_slot(slot)) {
+    path.resize(depth + prefix_len);
+    path.push_back(inner->slot_partial_key(slot));
+    if (!scan(*inner->slot_child(slot), depth + prefix_len + 1, path,
+              visitor)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+} // namespace art
+
+#endif
@@ -7,11 +7,20 @@
 #define ART_CHILD_IT_HPP
 
 #include <iterator>
+#include <stdexcept>
 
 namespace art {
 
+template <class T> class node;
 template <class T> class inner_node;
 
+/**
+ * Bidirectional iterator over the partial keys of a node's children.
+ *
+ * The iterator keeps the slot of the current child, so stepping is O(1) for
+ * node_4 and node_16 and a bitmap scan for node_48 and node_256, see
+ * inner_node::next_slot.
+ */
 template <class T> class child_it {
 public:
   child_it() = default;
@@ -27,7 +36,8 @@ public:
   using value_type = const char;
   using difference_type = int;
   using pointer = value_type *;
-  using reference = value_type &;
+  /* by value, std::reverse_iterator dereferences a temporary copy */
+  using reference = char;
 
   reference operator*() const;
   pointer operator->() const;
@@ -42,36 +52,44 @@ public:
   bool operator<=(const child_it &rhs) const;
   bool operator>=(const child_it &rhs) const;
 
+  /**
+   * Returns the child the iterator points at.
+   */
+  node<T> **child() const;
+
 private:
+  void seek();
+
   inner_node<T> *node_;
   char cur_partial_key_;
   int relative_index_;
+  int slot_;
 };
 
 template <class T> child_it<T>::child_it(inner_node<T> *n) : child_it<T>(n, 0) {}
 
 template <class T>
 child_it<T>::child_it(inner_node<T> *n, int relative_index)
-    : node_(n), cur_partial_key_(0), relative_index_(relative_index) {
-  if (relative_index_ < 0) {
-    /* relative_index is out of bounds, no seek */
-    return;
-  }
-
-  if (relative_index_ >= node_->n_children()) {
+    : node_(n), cur_partial_key_(0), relative_index_(relative_index),
+      slot_(-1) {
+  if (relative_index_ < 0 || relative_index_ >= node_->n_children()) {
     /* relative_index is out of bounds, no seek */
     return;
   }
 
   if (relative_index_ == node_->n_children() - 1) {
-    cur_partial_key_ = node_->prev_partial_key(127);
-    return;
+    slot_ = node_->prev_slot(node_->n_slots());
+  } else {
+    slot_ = node_->next_slot(-1);
+    for (int i = 0; i < relative_index_; ++i) {
+      slot_ = node_->next_slot(slot_);
+    }
   }
+  seek();
+}
 
-  cur_partial_key_ = node_->next_partial_key(-128);
-  for (int i = 0; i < relative_index_; ++i) {
-    cur_partial_key_ = node_->next_partial_key(cur_partial_key_ + 1);
-  }
+template <class T> void child_it<T>::seek() {
+  cur_partial_key_ = node_->slot_partial_key(slot_);
 }
 
 template <class T>
@@ -92,12 +110,19 @@ typename child_it<T>::pointer child_it<T>::operator->() const {
   return &cur_partial_key_;
 }
 
+template <class T> node<T> **child_it<T>::child() const {
+  if (relative_index_ < 0 || relative_index_ >= node_->n_children()) {
+    throw std::out_of_range("child iterator is out of range");
+  }
+
+  return node_->slot_child(slot_);
+}
+
 template <class T> child_it<T> &child_it<T>::operator++() {
   ++relative_index_;
-  if (relative_index_ == 0) {
-    cur_partial_key_ = node_->next_partial_key(-128);
-  } else if (relative_index_ < node_->n_children()) {
-    cur_partial_key_ = node_->next_partial_key(cur_partial_key_ + 1);
+  if (relative_index_ >= 0 && relative_index_ < node_->n_children()) {
+    slot_ = node_->next_slot(relative_index_ == 0 ? -1 : slot_);
+    seek();
   }
   return *this;
 }
@@ -110,10 +135,11 @@ template <class T> child_it<T> child_it<T>::operator++(int) {
 
 template <class T> child_it<T> &child_it<T>::operator--() {
   --relative_index_;
-  if (relative_index_ == node_->n_children() - 1) {
-    cur_partial_key_ = node_->prev_partial_key(127);
-  } else if (relative_index_ >= 0) {
-    cur_partial_key_ = node_->prev_partial_key(cur_partial_key_ - 1);
+  if (relative_index_ >= 0 && relative_index_ < node_->n_children()) {
+    slot_ = node_->prev_slot(relative_index_ == node_->n_children() - 1
+                                 ? node_->n_slots()
+                                 : slot_);
+    seek();
   }
   return *this;
 }
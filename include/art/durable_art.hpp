@@ -0,0 +1,945 @@
+/**
+ * @file adaptive radix tree with a redo log and checkpoints
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_DURABLE_ART_HPP
+#define ART_DURABLE_ART_HPP
+
+#include "allocator.hpp"
+#include "persistent_art.hpp"
+#include "snapshot.hpp"
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#if defined(__unix__) || defined(__APPLE__)
+namespace art {
+
+/**
+ * Tuning of the redo log and checkpoints of a durable_art.
+ */
+struct durability_options {
+  /*
+   * Group commit: the pending records are written and synced in one batch,
+   * which starts as soon as the previous batch is synced, so that writers
+   * arriving during a sync share the next one. A delay makes every batch
+   * wait for more records, unless it holds group_commit_bytes.
+   */
+  std::chrono::microseconds group_commit_delay{0};
+  std::size_t group_commit_bytes = 1 << 20;
+
+  /* set and del return once their record is synced, otherwise the last
+   * batches may be lost in a crash */
+  bool wait_for_sync = true;
+
+  /* the log and checkpoints are synced to the disk, otherwise they survive
+   * a crash of the process but not of the system */
+  bool sync = true;
+
+  /* bytes of log after which a checkpoint is written in the background, 0
+   * to only write them with durable_art::checkpoint */
+  std::size_t checkpoint_log_bytes = 64 << 20;
+};
+
+/*
+ * Log segment layout, all integers in the byte order of the writer:
+ *
+ *   header  "ARTLOG01" | uint32 sizeof(T)
+ *   records uint32 CRC-32 of the rest of the record | uint32 key_len |
+ *           uint8 kind | the key_len bytes of the key | the bytes of the
+ *           value, for a set
+ *
+ * A crash may leave a partly written record at the end of the last
+ * segment, whose checksum doesn't match, and which recovery drops.
+ */
+namespace log_format {
+
+static const char magic[8] = {'A', 'R', 'T', 'L', 'O', 'G', '0', '1'};
+static const std::size_t header_size = 12;
+static const std::size_t record_header_size = 9;
+static const uint8_t set_kind = 0;
+static const uint8_t del_kind = 1;
+
+inline const uint32_t *crc32_table() {
+  struct table {
+    table() {
+      uint32_t c;
+      for (uint32_t i = 0; i < 256; ++i) {
+        c = i;
+        for (int bit = 0; bit < 8; ++bit) {
+          c = c & 1 ? 0xedb88320 ^ (c >> 1) : c >> 1;
+        }
+        entries_[i] = c;
+      }
+    }
+    uint32_t entries_[256];
+  };
+  static const table t;
+  return t.entries_;
+}
+
+/**
+ * CRC-32 (IEEE 802.3) of the given bytes.
+ */
+inline uint32_t crc32(const char *p, std::size_t n) {
+  const uint32_t *table = crc32_table();
+  uint32_t c = 0xffffffff;
+  for (std::size_t i = 0; i < n; ++i) {
+    c = table[(c ^ static_cast<uint8_t>(p[i])) & 0xff] ^ (c >> 8);
+  }
+  return c ^ 0xffffffff;
+}
+
+/**
+ * Writes all n bytes, returns false on error.
+ */
+inline bool write_all(int fd, const char *p, std::size_t n) {
+  ssize_t written;
+  while (n > 0) {
+    written = ::write(fd, p, n);
+    if (written < 0) {
+      return false;
+    }
+    p += written;
+    n -= written;
+  }
+  return true;
+}
+
+/**
+ * Syncs the contents of the file to the disk, returns false on error.
+ */
+inline bool sync_data(int fd) {
+#if defined(__APPLE__)
+  return ::fsync(fd) == 0;
+#else
+  return ::fdatasync(fd) == 0;
+#endif
+}
+
+/**
+ * Syncs the directory, so that the files created, renamed or removed in it
+ * persist, returns false on error.
+ */
+inline bool sync_dir(const std::string &dir) {
+  int fd = ::open(dir.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return false;
+  }
+  bool synced = ::fsync(fd) == 0;
+  ::close(fd);
+  return synced;
+}
+
+/**
+ * Returns the names of the files in the directory.
+ *
+ * @throws std::runtime_error if the directory can't be opened.
+ */
+inline std::vector<std::string> list_dir(const std::string &dir) {
+  DIR *d = ::opendir(dir.c_str());
+  if (d == nullptr) {
+    throw std::runtime_error("can't open " + dir);
+  }
+  std::vector<std::string> names;
+  while (dirent *entry = ::readdir(d)) {
+    names.push_back(entry->d_name);
+  }
+  ::closedir(d);
+  return names;
+}
+
+/**
+ * Determines if the file name is the given kind of file followed by a dot
+ * and its number, e.g. log.12, and sets n to the number.
+ */
+inline bool parse_name(const std::string &name, const char *kind,
+                       uint64_t &n) {
+  std::size_t len = std::strlen(kind);
+  if (name.size() <= len + 1 || name.compare(0, len, kind) != 0 ||
+      name[len] != '.') {
+    return false;
+  }
+  n = 0;
+  for (std::size_t i = len + 1; i < name.size(); ++i) {
+    if (name[i] < '0' || name[i] > '9') {
+      return false;
+    }
+    n = n * 10 + (name[i] - '0');
+  }
+  return true;
+}
+
+} // namespace log_format
+
+/**
+ * Append-only redo log of a durable_art, which writes and syncs the
+ * appended records on a background thread in batches, see
+ * durability_options. Records are appended by one thread at a time and may
+ * be waited for by any.
+ */
+class redo_log {
+public:
+  explicit redo_log(const durability_options &options);
+  redo_log(const redo_log &other) = delete;
+  redo_log &operator=(const redo_log &other) = delete;
+
+  /**
+   * Writes the pending records and closes the segment.
+   */
+  ~redo_log();
+
+  /**
+   * Syncs the pending records to the current segment, if any, and
+   * continues in a new segment at the given path, for values of the given
+   * size.
+   *
+   * @throws std::runtime_error if the segment can't be created or the log
+   * can't be written.
+   */
+  void open(const std::string &path, uint32_t value_size);
+
+  /**
+   * Appends a record with the given value bytes, e.g. none for a del.
+   *
+   * @return the record's number, see wait.
+   * @throws std::runtime_error if the log can't be written.
+   */
+  uint64_t append(uint8_t kind, const char *key, std::size_t key_len,
+                  const void *value, std::size_t value_size);
+
+  /**
+   * Waits until the record of the given number, and every one before it,
+   * is synced.
+   *
+   * @throws std::runtime_error if the log can't be written.
+   */
+  void wait(uint64_t n);
+
+  /**
+   * Waits until every record appended so far is synced, see wait.
+   */
+  void sync();
+
+  /**
+   * Calls `visitor(uint8_t kind, const char *key, uint32_t key_len,
+   * const char *value)` for the records of the segment at the given path
+   * in order, with value unaligned and a nullptr for a del. A record that
+   * fails its checksum ends the segment, which is truncated before it.
+   *
+   * @return false if the segment was truncated.
+   * @throws std::runtime_error if the segment can't be read or truncated,
+   * isn't a log segment or holds values of another size.
+   */
+  template <class F>
+  static bool replay(const std::string &path, uint32_t value_size,
+                     F visitor);
+
+private:
+  /* the thread writing and syncing the batches */
+  void run();
+
+  /* waits until the pending records are synced, or the log failed */
+  void drain(std::unique_lock<std::mutex> &lock);
+
+  durability_options options_;
+  std::mutex mutex_;
+  /* the thread waits for records, the writers for syncs */
+  std::condition_variable pending_cv_;
+  std::condition_variable synced_cv_;
+  std::vector<char> pending_;
+  std::chrono::steady_clock::time_point first_pending_;
+  uint64_t n_appended_ = 0;
+  uint64_t n_synced_ = 0;
+  int fd_ = -1;
+  bool failed_ = false;
+  bool stop_ = false;
+  std::thread thread_;
+};
+
+/**
+ * Adaptive radix tree that survives crashes, kept in a directory of
+ * checkpoints and redo log segments.
+ *
+ * set and del modify a persistent_art and append a record to the redo
+ * log, which is written and synced in batches that concurrent writers
+ * share (group commit), see durability_options. A checkpoint writes a
+ * snapshot, see serialize, of a copy-on-write version of the tree while
+ * set and del continue, and then removes the log segments it covers, so
+ * that opening the directory loads the latest checkpoint and only replays
+ * the log written since.
+ *
+ * The directory holds the log segments log.<n>, in the order of n, and the
+ * checkpoint checkpoint.<n> of the keys of the segments before log.<n>.
+ *
+ * The tree owns copies of the values, which must be trivially copyable
+ * like those of snapshots. Every method may be called by several threads
+ * at once; they take turns on a mutex, which isn't held while waiting
+ * for syncs or writing checkpoints.
+ *
+ * @tparam T - The type of the values.
+ * @tparam A - The allocator of the nodes, which is only used under the
+ * mutex.
+ */
+template <class T, class A = heap_allocator> class durable_art {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "values of a durable_art must be trivially copyable");
+
+public:
+  /**
+   * Opens the tree kept in the given directory, which must exist, by
+   * loading the latest checkpoint and replaying the log after it. A torn
+   * record at the end of the log, left behind by a crash, is dropped. The
+   * tree is empty if the directory is.
+   *
+   * @throws std::runtime_error if the files can't be read or written, are
+   * corrupt or hold values of another size.
+   */
+  explicit durable_art(const std::string &dir,
+                       const durability_options &options =
+                           durability_options());
+  durable_art(const durable_art<T, A> &other) = delete;
+  durable_art<T, A> &operator=(const durable_art<T, A> &other) = delete;
+
+  /**
+   * Waits for a running checkpoint and writes the pending records.
+   */
+  ~durable_art();
+
+  /**
+   * Copies the value associated with the given key to value.
+   *
+   * @return false if no value is associated with the key.
+   */
+  bool get(const char *key, T &value) const;
+  bool get(const char *key, std::size_t key_len, T &value) const;
+
+  /**
+   * Associates the given key with a copy of the given value and logs it.
+   * Returns once the record is synced, see wait_for_sync.
+   *
+   * @throws std::invalid_argument if the key is a proper prefix of a key in
+   * the tree or the other way around, nothing is modified or logged.
+   * @throws std::runtime_error if the log can't be written, in which case
+   * the tree may be modified but the record is lost.
+   */
+  void set(const char *key, const T &value);
+  void set(const char *key, std::size_t key_len, const T &value);
+
+  /**
+   * Deletes the given key and logs it, like set.
+   *
+   * @return false if the key wasn't in the tree, nothing is logged then.
+   */
+  bool del(const char *key);
+  bool del(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  bool get(std::string_view key, T &value) const;
+  void set(std::string_view key, const T &value);
+  bool del(std::string_view key);
+#endif
+
+  /**
+   * Number of keys.
+   */
+  std::size_t size() const;
+
+  /**
+   * Waits until every record logged so far is synced, e.g. after writes
+   * that don't wait_for_sync.
+   *
+   * @throws std::runtime_error if the log can't be written.
+   */
+  void sync();
+
+  /**
+   * Writes a checkpoint of the current contents and removes the log
+   * segments and the checkpoint it supersedes. set and del only wait for
+   * the sync of the current log segment, which the checkpoint ends, and
+   * continue while the checkpoint is written. One checkpoint is written
+   * at a time.
+   *
+   * @throws std::runtime_error if the checkpoint can't be written, the
+   * previous one and the log are kept then.
+   */
+  void checkpoint();
+
+private:
+  /* the path of the given kind of file and its number, e.g. log.12 */
+  std::string file(const char *kind, uint64_t n) const;
+
+  /* loads the checkpoint, replays the log and starts a new segment */
+  void recover();
+
+  /* sets the value during recovery */
+  void apply_set(const char *key, std::size_t key_len,
+                 std::unique_ptr<T> value);
+
+  /* account for a record, which may start a checkpoint */
+  void logged(std::size_t record_size);
+
+  /* frees a replaced or deleted value, once the running checkpoint, which
+   * may write it, is done */
+  void retire(T *value);
+
+  /* writes the version to the checkpoint file of the given number */
+  void write_checkpoint(const persistent_art<T, A> &version, uint64_t n);
+
+  /* releases the version of the checkpoint and the retired values */
+  void end_checkpoint(persistent_art<T, A> &version);
+
+  /* removes the log segments and checkpoints before the given number */
+  void remove_before(uint64_t n);
+
+  /* the thread writing checkpoints after checkpoint_log_bytes */
+  void run_checkpoints();
+
+  void free_values();
+
+  std::string dir_;
+  durability_options options_;
+  /* guards the following members */
+  mutable std::mutex mutex_;
+  persistent_art<T, A> tree_;
+  std::size_t size_ = 0;
+  uint64_t segment_ = 0;
+  std::size_t segment_bytes_ = 0;
+  std::size_t next_checkpoint_bytes_;
+  bool checkpointing_ = false;
+  std::vector<T *> retired_;
+  bool stop_ = false;
+  std::condition_variable checkpoint_cv_;
+  /* held while a checkpoint is written */
+  std::mutex checkpoint_mutex_;
+  redo_log log_;
+  std::thread checkpointer_;
+};
+
+inline redo_log::redo_log(const durability_options &options)
+    : options_(options) {
+  thread_ = std::thread(&redo_log::run, this);
+}
+
+inline redo_log::~redo_log() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  pending_cv_.notify_one();
+  thread_.join();
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+}
+
+inline void redo_log::run() {
+  std::vector<char> batch;
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    pending_cv_.wait(lock, [this] { return stop_ || !pending_.empty(); });
+    if (pending_.empty()) {
+      /* stopped */
+      return;
+    }
+    if (!stop_ && options_.group_commit_delay.count() > 0) {
+      pending_cv_.wait_until(
+          lock, first_pending_ + options_.group_commit_delay, [this] {
+            return stop_ ||
+                   pending_.size() >= options_.group_commit_bytes;
+          });
+    }
+    batch.swap(pending_);
+    uint64_t n = n_appended_;
+    int fd = fd_;
+    lock.unlock();
+    bool synced = log_format::write_all(fd, batch.data(), batch.size()) &&
+                  (!options_.sync || log_format::sync_data(fd));
+    batch.clear();
+    lock.lock();
+    if (synced) {
+      n_synced_ = n;
+    } else {
+      failed_ = true;
+    }
+    synced_cv_.notify_all();
+  }
+}
+
+inline void redo_log::drain(std::unique_lock<std::mutex> &lock) {
+  synced_cv_.wait(lock,
+                  [this] { return n_synced_ == n_appended_ || failed_; });
+}
+
+inline void redo_log::open(const std::string &path, uint32_t value_size) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  drain(lock);
+  if (failed_) {
+    throw std::runtime_error("can't write the log");
+  }
+  int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    throw std::runtime_error("can't create " + path);
+  }
+  char header[log_format::header_size];
+  std::memcpy(header, log_format::magic, sizeof(log_format::magic));
+  std::memcpy(header + sizeof(log_format::magic), &value_size,
+              sizeof(value_size));
+  if (!log_format::write_all(fd, header, sizeof(header)) ||
+      (options_.sync && !log_format::sync_data(fd))) {
+    ::close(fd);
+    throw std::runtime_error("can't write " + path);
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+  }
+  fd_ = fd;
+}
+
+inline uint64_t redo_log::append(uint8_t kind, const char *key,
+                                 std::size_t key_len, const void *value,
+                                 std::size_t value_size) {
+  using namespace log_format;
+  uint32_t len = key_len;
+  std::size_t record_size = record_header_size + key_len + value_size;
+  std::lock_guard<std::mutex> lock(mutex_);
+  if (failed_) {
+    throw std::runtime_error("can't write the log");
+  }
+  if (pending_.empty()) {
+    first_pending_ = std::chrono::steady_clock::now();
+  }
+  pending_.resize(pending_.size() + record_size);
+  char *record = pending_.data() + pending_.size() - record_size;
+  std::memcpy(record + 4, &len, sizeof(len));
+  record[8] = kind;
+  std::memcpy(record + record_header_size, key, key_len);
+  if (value_size > 0) {
+    std::memcpy(record + record_header_size + key_len, value, value_size);
+  }
+  uint32_t crc = crc32(record + 4, record_size - 4);
+  std::memcpy(record, &crc, sizeof(crc));
+  pending_cv_.notify_one();
+  return ++n_appended_;
+}
+
+inline void redo_log::wait(uint64_t n) {
+  std::unique_lock<std::mutex> lock(mutex_);
+  synced_cv_.wait(lock, [this, n] { return n_synced_ >= n || failed_; });
+  if (n_synced_ < n) {
+    throw std::runtime_error("can't write the log");
+  }
+}
+
+inline void redo_log::sync() {
+  uint64_t n;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    n = n_appended_;
+  }
+  wait(n);
+}
+
+template <class F>
+bool redo_log::replay(const std::string &path, uint32_t value_size,
+                      F visitor) {
+  using namespace log_format;
+  std::string data;
+  {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      throw std::runtime_error("can't open " + path);
+    }
+    data.assign(std::istreambuf_iterator<char>(in),
+                std::istreambuf_iterator<char>());
+  }
+  std::size_t offset = 0, end;
+  if (data.size() >= header_size) {
+    if (std::memcmp(data.data(), magic, sizeof(magic)) != 0) {
+      throw std::runtime_error(path + " is not a log segment");
+    }
+    if (snapshot_format::read<uint32_t>(data.data() + sizeof(magic)) !=
+        value_size) {
+      throw std::runtime_error(path + " holds values of another size");
+    }
+    offset = header_size;
+  }
+  const char *record;
+  uint32_t key_len;
+  uint8_t kind;
+  while (offset >= header_size &&
+         offset + record_header_size <= data.size()) {
+    record = data.data() + offset;
+    key_len = snapshot_format::read<uint32_t>(record + 4);
+    kind = record[8];
+    end = offset + record_header_size + key_len +
+          (kind == set_kind ? value_size : 0);
+    if (kind > del_kind || end > data.size() ||
+        crc32(record + 4, end - offset - 4) !=
+            snapshot_format::read<uint32_t>(record)) {
+      break;
+    }
+    visitor(kind, record + record_header_size, key_len,
+            kind == set_kind ? record + record_header_size + key_len
+                             : nullptr);
+    offset = end;
+  }
+  if (offset == data.size()) {
+    return true;
+  }
+  /* a segment without a whole header is emptied */
+  if (::truncate(path.c_str(), offset) != 0) {
+    throw std::runtime_error("can't truncate " + path);
+  }
+  return false;
+}
+
+template <class T, class A>
+durable_art<T, A>::durable_art(const std::string &dir,
+                               const durability_options &options)
+    : dir_(dir), options_(options),
+      next_checkpoint_bytes_(options.checkpoint_log_bytes), log_(options) {
+  try {
+    recover();
+  } catch (...) {
+    free_values();
+    throw;
+  }
+  if (options_.checkpoint_log_bytes != 0) {
+    checkpointer_ = std::thread(&durable_art<T, A>::run_checkpoints, this);
+  }
+}
+
+template <class T, class A> durable_art<T, A>::~durable_art() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  checkpoint_cv_.notify_one();
+  if (checkpointer_.joinable()) {
+    checkpointer_.join();
+  }
+  /* the log holds copies of the values */
+  free_values();
+}
+
+template <class T, class A> void durable_art<T, A>::free_values() {
+  for (auto it = tree_.begin(), it_end = tree_.end(); it != it_end; ++it) {
+    delete *it;
+  }
+  for (T *value : retired_) {
+    delete value;
+  }
+  retired_.clear();
+}
+
+template <class T, class A>
+std::string durable_art<T, A>::file(const char *kind, uint64_t n) const {
+  return dir_ + "/" + kind + "." + std::to_string(n);
+}
+
+template <class T, class A> void durable_art<T, A>::recover() {
+  uint64_t n, checkpoint = 0;
+  std::vector<uint64_t> segments;
+  for (const std::string &name : log_format::list_dir(dir_)) {
+    if (log_format::parse_name(name, "log", n)) {
+      segments.push_back(n);
+    } else if (log_format::parse_name(name, "checkpoint", n)) {
+      checkpoint = std::max(checkpoint, n);
+    } else if (name.size() > 4 &&
+               name.compare(name.size() - 4, 4, ".tmp") == 0) {
+      /* a checkpoint that wasn't finished */
+      std::remove((dir_ + "/" + name).c_str());
+    }
+  }
+  if (checkpoint != 0) {
+    mapped_file f(file("checkpoint", checkpoint).c_str());
+    art_view<T> view(f.data(), f.size());
+    for (auto it = view.begin(), it_end = view.end(); it != it_end; ++it) {
+      apply_set(it.key().data(), it.key().size(),
+                std::unique_ptr<T>(new T(**it)));
+    }
+  }
+  std::sort(segments.begin(), segments.end());
+  segment_ = checkpoint;
+  bool torn = false;
+  for (uint64_t segment : segments) {
+    if (segment < checkpoint) {
+      continue;
+    }
+    if (torn) {
+      /* records after a lost one can't be applied */
+      throw std::runtime_error("corrupt log " + file("log", segment - 1));
+    }
+    torn = !redo_log::replay(
+        file("log", segment), sizeof(T),
+        [this](uint8_t kind, const char *key, uint32_t key_len,
+               const char *value) {
+          if (kind == log_format::set_kind) {
+            std::unique_ptr<T> copy(new T);
+            std::memcpy(static_cast<void *>(copy.get()), value, sizeof(T));
+            apply_set(key, key_len, std::move(copy));
+          } else if (T *old = tree_.del(key, key_len)) {
+            --size_;
+            delete old;
+          }
+        });
+    segment_ = segment;
+  }
+  log_.open(file("log", ++segment_), sizeof(T));
+  if (options_.sync && !log_format::sync_dir(dir_)) {
+    throw std::runtime_error("can't sync " + dir_);
+  }
+  remove_before(checkpoint);
+}
+
+template <class T, class A>
+void durable_art<T, A>::apply_set(const char *key, std::size_t key_len,
+                                  std::unique_ptr<T> value) {
+  T *old = tree_.set(key, key_len, value.get());
+  value.release();
+  if (old != nullptr) {
+    delete old;
+  } else {
+    ++size_;
+  }
+}
+
+template <class T, class A>
+void durable_art<T, A>::remove_before(uint64_t n) {
+  uint64_t m;
+  for (const std::string &name : log_format::list_dir(dir_)) {
+    if ((log_format::parse_name(name, "log", m) ||
+         log_format::parse_name(name, "checkpoint", m)) &&
+        m < n) {
+      std::remove((dir_ + "/" + name).c_str());
+    }
+  }
+}
+
+template <class T, class A>
+bool durable_art<T, A>::get(const char *key, T &value) const {
+  return get(key, std::strlen(key) + 1, value);
+}
+
+template <class T, class A>
+bool durable_art<T, A>::get(const char *key, std::size_t key_len,
+                            T &value) const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  T *found = tree_.get(key, key_len);
+  if (found == nullptr) {
+    return false;
+  }
+  value = *found;
+  return true;
+}
+
+template <class T, class A>
+void durable_art<T, A>::set(const char *key, const T &value) {
+  set(key, std::strlen(key) + 1, value);
+}
+
+template <class T, class A>
+void durable_art<T, A>::set(const char *key, std::size_t key_len,
+                            const T &value) {
+  std::unique_ptr<T> copy(new T(value));
+  uint64_t n;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    T *old = tree_.set(key, key_len, copy.get());
+    copy.release();
+    if (old != nullptr) {
+      retire(old);
+    } else {
+      ++size_;
+    }
+    /* appended under the lock, so the log has the order of the tree */
+    n = log_.append(log_format::set_kind, key, key_len, &value, sizeof(T));
+    logged(key_len + sizeof(T));
+  }
+  if (options_.wait_for_sync) {
+    log_.wait(n);
+  }
+}
+
+template <class T, class A> bool durable_art<T, A>::del(const char *key) {
+  return del(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+bool durable_art<T, A>::del(const char *key, std::size_t key_len) {
+  uint64_t n;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    T *old = tree_.del(key, key_len);
+    if (old == nullptr) {
+      return false;
+    }
+    retire(old);
+    --size_;
+    n = log_.append(log_format::del_kind, key, key_len, nullptr, 0);
+    logged(key_len);
+  }
+  if (options_.wait_for_sync) {
+    log_.wait(n);
+  }
+  return true;
+}
+
+#if __cplusplus >= 201703L
+template <class T, class A>
+bool durable_art<T, A>::get(std::string_view key, T &value) const {
+  return get(key.data(), key.size(), value);
+}
+
+template <class T, class A>
+void durable_art<T, A>::set(std::string_view key, const T &value) {
+  set(key.data(), key.size(), value);
+}
+
+template <class T, class A>
+bool durable_art<T, A>::del(std::string_view key) {
+  return del(key.data(), key.size());
+}
+#endif
+
+template <class T, class A> std::size_t durable_art<T, A>::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return size_;
+}
+
+template <class T, class A> void durable_art<T, A>::sync() { log_.sync(); }
+
+template <class T, class A>
+void durable_art<T, A>::logged(std::size_t record_size) {
+  segment_bytes_ += log_format::record_header_size + record_size;
+  if (options_.checkpoint_log_bytes != 0 &&
+      segment_bytes_ >= next_checkpoint_bytes_) {
+    checkpoint_cv_.notify_one();
+  }
+}
+
+template <class T, class A> void durable_art<T, A>::retire(T *value) {
+  if (checkpointing_) {
+    retired_.push_back(value);
+  } else {
+    delete value;
+  }
+}
+
+template <class T, class A> void durable_art<T, A>::checkpoint() {
+  std::lock_guard<std::mutex> one_at_a_time(checkpoint_mutex_);
+  persistent_art<T, A> version;
+  uint64_t n;
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    /* the version holds the keys of the segments before the new one */
+    n = segment_ + 1;
+    log_.open(file("log", n), sizeof(T));
+    segment_ = n;
+    segment_bytes_ = 0;
+    next_checkpoint_bytes_ = options_.checkpoint_log_bytes;
+    /* the records of the new segment are acknowledged before the checkpoint
+     * is written, so the segment's directory entry must be durable first */
+    if (options_.sync && !log_format::sync_dir(dir_)) {
+      throw std::runtime_error("can't sync " + dir_);
+    }
+    version = tree_.snapshot();
+    checkpointing_ = true;
+  }
+  try {
+    write_checkpoint(version, n);
+  } catch (...) {
+    end_checkpoint(version);
+    throw;
+  }
+  end_checkpoint(version);
+  remove_before(n);
+}
+
+template <class T, class A>
+void durable_art<T, A>::write_checkpoint(const persistent_art<T, A> &version,
+                                         uint64_t n) {
+  std::string path = file("checkpoint", n), tmp = path + ".tmp";
+  bool written;
+  {
+    std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+    serialize(version, out);
+    out.close();
+    written = static_cast<bool>(out);
+  }
+  if (written && options_.sync) {
+    int fd = ::open(tmp.c_str(), O_RDONLY);
+    written = fd >= 0 && log_format::sync_data(fd);
+    if (fd >= 0) {
+      ::close(fd);
+    }
+  }
+  if (!written || std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    throw std::runtime_error("can't write " + path);
+  }
+  if (options_.sync && !log_format::sync_dir(dir_)) {
+    throw std::runtime_error("can't sync " + dir_);
+  }
+}
+
+template <class T, class A>
+void durable_art<T, A>::end_checkpoint(persistent_art<T, A> &version) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  /* released under the lock, which guards the allocator */
+  version = persistent_art<T, A>();
+  checkpointing_ = false;
+  for (T *value : retired_) {
+    delete value;
+  }
+  retired_.clear();
+}
+
+template <class T, class A> void durable_art<T, A>::run_checkpoints() {
+  std::unique_lock<std::mutex> lock(mutex_);
+  while (true) {
+    checkpoint_cv_.wait(lock, [this] {
+      return stop_ || segment_bytes_ >= next_checkpoint_bytes_;
+    });
+    if (stop_) {
+      return;
+    }
+    lock.unlock();
+    try {
+      checkpoint();
+      lock.lock();
+    } catch (const std::exception &) {
+      /* retried once the log grew by checkpoint_log_bytes again */
+      lock.lock();
+      next_checkpoint_bytes_ = segment_bytes_ + options_.checkpoint_log_bytes;
+    }
+  }
+}
+
+} // namespace art
+#endif
+
+#endif
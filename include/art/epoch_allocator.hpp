@@ -0,0 +1,304 @@
+/**
+ * @file epoch based reclamation header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_EPOCH_ALLOCATOR_HPP
+#define ART_EPOCH_ALLOCATOR_HPP
+
+#include "allocator.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <stdexcept>
+#include <vector>
+
+namespace art {
+
+/**
+ * Assigns every live thread a small index, which is recycled when the
+ * thread exits.
+ */
+class thread_slots {
+public:
+  static const int max_threads = 128;
+
+  /**
+   * Returns the index of the calling thread.
+   *
+   * @throws std::runtime_error if more than max_threads threads are alive.
+   */
+  static int index();
+
+private:
+  struct owner {
+    owner();
+    ~owner();
+
+    int index_;
+  };
+
+  static std::mutex &mutex();
+  static std::vector<int> &free_indexes();
+  static int &n_indexes();
+};
+
+inline int thread_slots::index() {
+  static thread_local owner o;
+  return o.index_;
+}
+
+inline thread_slots::owner::owner() {
+  std::lock_guard<std::mutex> guard(mutex());
+  if (!free_indexes().empty()) {
+    index_ = free_indexes().back();
+    free_indexes().pop_back();
+  } else if (n_indexes() < max_threads) {
+    index_ = n_indexes()++;
+  } else {
+    throw std::runtime_error("too many threads");
+  }
+}
+
+inline thread_slots::owner::~owner() {
+  std::lock_guard<std::mutex> guard(mutex());
+  free_indexes().push_back(index_);
+}
+
+inline std::mutex &thread_slots::mutex() {
+  static std::mutex m;
+  return m;
+}
+
+inline std::vector<int> &thread_slots::free_indexes() {
+  static std::vector<int> v;
+  return v;
+}
+
+inline int &thread_slots::n_indexes() {
+  static int n = 0;
+  return n;
+}
+
+/**
+ * Allocator adapter with epoch based reclamation, for trees whose nodes are
+ * read concurrently with writes, see olc_art.
+ *
+ * Threads access the tree inside a guard, which announces the global epoch
+ * the thread entered in. Deallocated memory is not handed back to A right
+ * away but retired into the calling thread's limbo list, tagged with the
+ * global epoch. The global epoch only advances once every thread inside a
+ * guard has announced the current epoch, so memory retired in epoch e is
+ * unreachable for every reader once the global epoch reaches e + 2.
+ *
+ * Whenever a thread retired another collect_threshold blocks, the thread
+ * tries to advance the epoch and frees the unreachable memory of all
+ * limbo lists, including those of exited threads. This bounds the backlog
+ * to the deallocations of about two epochs, unless a thread stays inside a
+ * guard for long, e.g. because it is preempted.
+ *
+ * allocate may be called by concurrent threads, which requires A::allocate
+ * and A::deallocate to be thread-safe, e.g. heap_allocator.
+ */
+template <class A> class epoch_allocator {
+public:
+  static const bool bulk_release = false;
+  static const std::size_t collect_threshold = 64;
+
+  /**
+   * Scope in which the calling thread may read memory of the allocator.
+   * Guards may be nested.
+   */
+  class guard {
+  public:
+    explicit guard(epoch_allocator<A> &alloc);
+    guard(const guard &other) = delete;
+    guard &operator=(const guard &other) = delete;
+    ~guard();
+
+  private:
+    epoch_allocator<A> &alloc_;
+  };
+
+  epoch_allocator() = default;
+  epoch_allocator(const epoch_allocator<A> &other) = delete;
+  epoch_allocator<A> &operator=(const epoch_allocator<A> &other) = delete;
+  ~epoch_allocator();
+
+  void *allocate(std::size_t size);
+
+  /**
+   * Retires the given memory, it is handed back to A once no guard can
+   * reach it anymore.
+   */
+  void deallocate(void *p, std::size_t size);
+
+  /**
+   * Tries to advance the global epoch and frees unreachable memory.
+   */
+  void collect();
+
+  /**
+   * Hands all retired memory back to A.
+   * No thread may be inside a guard.
+   */
+  void release();
+
+  /**
+   * Number of retired blocks not yet handed back to A.
+   */
+  std::size_t n_retired() const;
+
+  /**
+   * Current global epoch.
+   */
+  uint64_t epoch() const;
+
+private:
+  struct retired_block {
+    void *p_;
+    std::size_t size_;
+    uint64_t epoch_;
+  };
+
+  /* one per thread index, on its own cache line */
+  struct alignas(64) record {
+    /* announced epoch while inside a guard, 0 otherwise */
+    std::atomic<uint64_t> epoch_{0};
+    /* only accessed by the owning thread */
+    int depth_ = 0;
+    std::size_t n_since_collect_ = 0;
+    /* held by the owning thread while retiring, by any thread collecting */
+    std::mutex limbo_mutex_;
+    std::vector<retired_block> limbo_;
+  };
+
+  void enter();
+  void exit();
+  bool try_advance();
+
+  /**
+   * Frees the blocks of the given limbo list that are unreachable.
+   * The limbo list must be locked.
+   */
+  void free_unreachable(record &r);
+
+  A alloc_;
+  std::atomic<uint64_t> epoch_{1};
+  std::atomic<std::size_t> n_retired_{0};
+  record records_[thread_slots::max_threads];
+};
+
+template <class A>
+struct is_thread_safe_allocator<epoch_allocator<A>>
+    : is_thread_safe_allocator<A> {};
+
+template <class A>
+epoch_allocator<A>::guard::guard(epoch_allocator<A> &alloc) : alloc_(alloc) {
+  alloc_.enter();
+}
+
+template <class A> epoch_allocator<A>::guard::~guard() { alloc_.exit(); }
+
+template <class A> epoch_allocator<A>::~epoch_allocator() { release(); }
+
+template <class A> void epoch_allocator<A>::enter() {
+  record &r = records_[thread_slots::index()];
+  if (r.depth_++ > 0) {
+    return;
+  }
+  uint64_t e;
+  do {
+    /* announce an epoch that is still current after the announcement */
+    e = epoch_.load();
+    r.epoch_.store(e);
+  } while (epoch_.load() != e);
+}
+
+template <class A> void epoch_allocator<A>::exit() {
+  record &r = records_[thread_slots::index()];
+  if (--r.depth_ == 0) {
+    r.epoch_.store(0, std::memory_order_release);
+  }
+}
+
+template <class A> bool epoch_allocator<A>::try_advance() {
+  uint64_t e = epoch_.load(), announced;
+  for (record &r : records_) {
+    announced = r.epoch_.load();
+    if (announced != 0 && announced != e) {
+      /* a thread may still read memory retired in the previous epoch */
+      return false;
+    }
+  }
+  return epoch_.compare_exchange_strong(e, e + 1);
+}
+
+template <class A> void epoch_allocator<A>::free_unreachable(record &r) {
+  uint64_t e = epoch_.load();
+  std::size_t n_kept = 0;
+  for (retired_block &b : r.limbo_) {
+    if (b.epoch_ + 2 <= e) {
+      alloc_.deallocate(b.p_, b.size_);
+    } else {
+      r.limbo_[n_kept++] = b;
+    }
+  }
+  n_retired_.fetch_sub(r.limbo_.size() - n_kept, std::memory_order_relaxed);
+  r.limbo_.resize(n_kept);
+}
+
+template <class A> void *epoch_allocator<A>::allocate(std::size_t size) {
+  return alloc_.allocate(size);
+}
+
+template <class A>
+void epoch_allocator<A>::deallocate(void *p, std::size_t size) {
+  if (p == nullptr) {
+    return;
+  }
+  record &r = records_[thread_slots::index()];
+  {
+    std::lock_guard<std::mutex> guard(r.limbo_mutex_);
+    r.limbo_.push_back(retired_block{p, size, epoch_.load()});
+  }
+  n_retired_.fetch_add(1, std::memory_order_relaxed);
+  if (++r.n_since_collect_ == collect_threshold) {
+    r.n_since_collect_ = 0;
+    collect();
+  }
+}
+
+template <class A> void epoch_allocator<A>::collect() {
+  try_advance();
+  for (record &r : records_) {
+    /* skip limbo lists that are being collected by another thread */
+    std::unique_lock<std::mutex> lock(r.limbo_mutex_, std::try_to_lock);
+    if (lock.owns_lock()) {
+      free_unreachable(r);
+    }
+  }
+}
+
+template <class A> void epoch_allocator<A>::release() {
+  for (record &r : records_) {
+    for (retired_block &b : r.limbo_) {
+      alloc_.deallocate(b.p_, b.size_);
+    }
+    r.limbo_.clear();
+  }
+  n_retired_.store(0);
+}
+
+template <class A> std::size_t epoch_allocator<A>::n_retired() const {
+  return n_retired_.load(std::memory_order_relaxed);
+}
+
+template <class A> uint64_t epoch_allocator<A>::epoch() const {
+  return epoch_.load();
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,104 @@
+/**
+ * @file inline leaves header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_INLINE_LEAVES_HPP
+#define ART_INLINE_LEAVES_HPP
+
+#include "allocator.hpp"
+#include "boxed_leaves.hpp"
+#include "leaf_node.hpp"
+#include "node.hpp"
+#include <cstddef>
+#include <type_traits>
+#include <utility>
+
+namespace art {
+
+/**
+ * Key extractor argument of art selecting inline_leaves, see value_art.
+ */
+struct inline_values {};
+
+/**
+ * Leaf storing its value after its header, in the same allocation.
+ *
+ * value_ points to storage_, so that the leaf is read like any other
+ * leaf_node<T>, but the value is on the leaf's cache line instead of
+ * behind a second pointer.
+ */
+template <class T> class inline_leaf : public leaf_node<T> {
+public:
+  template <class U> explicit inline_leaf(U &&value);
+
+  inline_leaf(const inline_leaf &) = delete;
+  inline_leaf &operator=(const inline_leaf &) = delete;
+
+  T storage_;
+};
+
+template <class T>
+template <class U>
+inline_leaf<T>::inline_leaf(U &&value)
+    : leaf_node<T>(nullptr), storage_(std::forward<U>(value)) {
+  this->value_ = &storage_;
+}
+
+/**
+ * Leaf policy of trees storing their values by value, see value_art.
+ *
+ * Leaves are inline_leaf<T> instances, which keep the remaining bytes of
+ * their key as the prefix like boxed_leaves. make and set_value move the
+ * pointed-to value into the leaf instead of storing the pointer.
+ */
+template <class T> class inline_leaves : public boxed_leaves<T> {
+  static_assert(alignof(T) <= alignof(void *),
+                "allocators only align leaves for pointers");
+
+public:
+  static const bool trivially_destructible =
+      std::is_trivially_destructible<T>::value;
+
+  template <class A>
+  node<T> *make(const char *key, int key_len, T *value, A &alloc) const;
+
+  void set_value(node<T> *&slot, T *value) const;
+
+  std::size_t size(const node<T> *leaf) const;
+
+  template <class A> void destroy(node<T> *leaf, A &alloc) const;
+};
+
+template <class T>
+const bool inline_leaves<T>::trivially_destructible;
+
+template <class T>
+template <class A>
+node<T> *inline_leaves<T>::make(const char *key, int key_len, T *value,
+                                A &alloc) const {
+  auto leaf = ::art::make<inline_leaf<T>>(alloc, std::move(*value));
+  leaf->set_prefix(key, key_len, alloc);
+  return leaf;
+}
+
+template <class T>
+void inline_leaves<T>::set_value(node<T> *&slot, T *value) const {
+  static_cast<inline_leaf<T> *>(slot)->storage_ = std::move(*value);
+}
+
+template <class T>
+std::size_t inline_leaves<T>::size(const node<T> *leaf) const {
+  return sizeof(inline_leaf<T>) + leaf->heap_prefix_size();
+}
+
+template <class T>
+template <class A>
+void inline_leaves<T>::destroy(node<T> *leaf, A &alloc) const {
+  leaf->free_prefix(alloc);
+  ::art::destroy(alloc, static_cast<inline_leaf<T> *>(leaf));
+}
+
+} // namespace art
+
+#endif
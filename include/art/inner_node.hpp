@@ -12,6 +12,7 @@
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <cstddef>
 #include <cstring>
 #include <iostream>
 #include <iterator>
@@ -19,18 +20,29 @@
 
 namespace art {
 
+template <class T> class node_4;
+template <class T> class node_16;
+template <class T> class node_48;
+template <class T> class node_256;
+
+/**
+ * Base class of node_4, node_16, node_48 and node_256.
+ *
+ * The methods dispatch on the node's type tag to the concrete node type,
+ * so inner nodes don't carry a vtable pointer.
+ *
+ * If ART_SUBTREE_COUNTS is defined, which must be the same in every
+ * translation unit, inner nodes also hold the number of leaves of their
+ * subtree, which art maintains for rank, select and count_range. Other
+ * trees leave it unused.
+ */
 template <class T> class inner_node : public node<T> {
 public:
-  virtual ~inner_node() = default;
-
-  inner_node() = default;
   inner_node(const inner_node<T> &other) = default;
   inner_node(inner_node<T> &&other) noexcept = default;
   inner_node<T> &operator=(const inner_node<T> &other) = default;
   inner_node<T> &operator=(inner_node<T> &&other) noexcept = default;
 
-  bool is_leaf() const override;
-
   /**
    * Finds and returns the child node identified by the given partial key.
    *
@@ -38,7 +50,7 @@ public:
    * @return Child node identified by the given partial key or
    * a null pointer of no child node is associated with the partial key.
    */
-  virtual node<T> **find_child(char partial_key) = 0;
+  node<T> **find_child(char partial_key);
 
   /**
    * Adds the given node to the node's children.
@@ -50,48 +62,127 @@ public:
    * @param partial_key - The partial key associated with the child.
    * @param child - The child node.
    */
-  virtual void set_child(char partial_key, node<T> *child) = 0;
+  void set_child(char partial_key, node<T> *child);
 
   /**
    * Deletes the child associated with the given partial key.
    *
    * @param partial_key - The partial key associated with the child.
    */
-  virtual node<T> *del_child(char partial_key) = 0;
+  node<T> *del_child(char partial_key);
 
   /**
    * Creates and returns a new node with bigger children capacity.
    * The current node gets deleted.
    *
+   * @param alloc - The allocator used for the current and the new node.
    * @return node with bigger capacity
    */
-  virtual inner_node<T> *grow() = 0;
+  template <class A> inner_node<T> *grow(A &alloc);
+
+  /**
+   * Creates and returns a node of the smallest type that holds the given
+   * number of children, with the children and prefix of this node, like
+   * grow but without the intermediate types. The current node gets deleted,
+   * unless it already holds that many children and is returned as is.
+   *
+   * @param n_children - The number of children the node must hold.
+   * @param alloc - The allocator used for the current and the new node.
+   */
+  template <class A> inner_node<T> *grow_to(int n_children, A &alloc);
 
   /**
    * Creates and returns a new node with lesser children capacity.
    * The current node gets deleted.
    *
    * @pre node must be undefull
+   * @param alloc - The allocator used for the current and the new node.
    * @return node with lesser capacity
    */
-  virtual inner_node<T> *shrink() = 0;
+  template <class A> inner_node<T> *shrink(A &alloc);
+
+  /**
+   * Creates a copy of the node of the same type, with the same children and
+   * prefix, in new_alloc. The current node and its heap prefix are released
+   * in alloc, the allocator they were created with.
+   *
+   * @return the copy
+   */
+  template <class A, class B>
+  inner_node<T> *relocate(A &alloc, B &new_alloc);
+
+  /**
+   * Takes over the number of leaves of the subtree from the node this node
+   * replaces, like move_prefix. Does nothing without ART_SUBTREE_COUNTS.
+   */
+  void copy_n_leaves(const inner_node<T> &other);
+
+  /**
+   * Destructs the node and returns its memory to the given allocator.
+   * Neither the prefix nor the children are released.
+   *
+   * @param alloc - The allocator the node was created with.
+   */
+  template <class A> void destroy(A &alloc);
 
   /**
    * Determines if the node is full, i.e. can carry no more child nodes.
    */
-  virtual bool is_full() const = 0;
+  bool is_full() const;
 
   /**
    * Determines if the node is underfull, i.e. carries less child nodes than
    * intended.
+   *
+   * A node_16, node_48 and node_256 are underfull, and shrink to the next
+   * smaller type, once deletions leave them with ART_NODE_16_SHRINK_THRESHOLD,
+   * ART_NODE_48_SHRINK_THRESHOLD and ART_NODE_256_SHRINK_THRESHOLD children.
+   * The thresholds are below the smaller type's capacity, so the shrunk node
+   * isn't full and a node whose number of children changes back and forth
+   * around that capacity doesn't reallocate on every change.
+   */
+  bool is_underfull() const;
+
+  int n_children() const;
+
+  char next_partial_key(char partial_key) const;
+
+  char prev_partial_key(char partial_key) const;
+
+  /*
+   * Slots are the positions children are stored at: the index into the
+   * sorted keys of a node_4 or node_16 and 128 + partial key for a node_48 or
+   * node_256. Stepping from one occupied slot to the next is O(1) for sorted
+   * nodes and a bitmap scan otherwise, so iterating all children is linear
+   * in their number.
    */
-  virtual bool is_underfull() const = 0;
 
-  virtual int n_children() const = 0;
+  /**
+   * Returns the number of slots, which is one past the last slot.
+   */
+  int n_slots() const;
 
-  virtual char next_partial_key(char partial_key) const = 0;
+  /**
+   * Returns the first occupied slot after the given slot, or n_slots() if
+   * there is none. Slot -1 yields the first occupied slot.
+   */
+  int next_slot(int slot) const;
 
-  virtual char prev_partial_key(char partial_key) const = 0;
+  /**
+   * Returns the last occupied slot before the given slot, or -1 if there is
+   * none. Slot n_slots() yields the last occupied slot.
+   */
+  int prev_slot(int slot) const;
+
+  /**
+   * Returns the partial key of the child in the given occupied slot.
+   */
+  char slot_partial_key(int slot) const;
+
+  /**
+   * Returns the child in the given occupied slot.
+   */
+  node<T> **slot_child(int slot);
 
   /**
    * Iterator on the first child node.
@@ -108,9 +199,351 @@ public:
    */
   child_it<T> end();
   std::reverse_iterator<child_it<T>> rend();
+
+#if defined(ART_SUBTREE_COUNTS)
+  std::size_t n_leaves_ = 0;
+#endif
+
+protected:
+  explicit inner_node(node_type type);
+
+private:
+  /* grow_to for a node of type N */
+  template <class N, class A> inner_node<T> *grow_as(A &alloc);
+
+  /* relocate for a node of type N */
+  template <class N, class A, class B>
+  inner_node<T> *relocate_as(A &alloc, B &new_alloc);
+
+  node_4<T> *as_node_4();
+  node_16<T> *as_node_16();
+  node_48<T> *as_node_48();
+  node_256<T> *as_node_256();
+  const node_4<T> *as_node_4() const;
+  const node_16<T> *as_node_16() const;
+  const node_48<T> *as_node_48() const;
+  const node_256<T> *as_node_256() const;
 };
 
-template <class T> bool inner_node<T>::is_leaf() const { return false; }
+template <class T>
+inner_node<T>::inner_node(node_type type) : node<T>(type) {}
+
+template <class T> node_4<T> *inner_node<T>::as_node_4() {
+  return static_cast<node_4<T> *>(this);
+}
+
+template <class T> node_16<T> *inner_node<T>::as_node_16() {
+  return static_cast<node_16<T> *>(this);
+}
+
+template <class T> node_48<T> *inner_node<T>::as_node_48() {
+  return static_cast<node_48<T> *>(this);
+}
+
+template <class T> node_256<T> *inner_node<T>::as_node_256() {
+  return static_cast<node_256<T> *>(this);
+}
+
+template <class T> const node_4<T> *inner_node<T>::as_node_4() const {
+  return static_cast<const node_4<T> *>(this);
+}
+
+template <class T> const node_16<T> *inner_node<T>::as_node_16() const {
+  return static_cast<const node_16<T> *>(this);
+}
+
+template <class T> const node_48<T> *inner_node<T>::as_node_48() const {
+  return static_cast<const node_48<T> *>(this);
+}
+
+template <class T> const node_256<T> *inner_node<T>::as_node_256() const {
+  return static_cast<const node_256<T> *>(this);
+}
+
+template <class T> node<T> **inner_node<T>::find_child(char partial_key) {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->find_child(partial_key);
+  case node_type::node_16:
+    return as_node_16()->find_child(partial_key);
+  case node_type::node_48:
+    return as_node_48()->find_child(partial_key);
+  default:
+    return as_node_256()->find_child(partial_key);
+  }
+}
+
+template <class T>
+void inner_node<T>::set_child(char partial_key, node<T> *child) {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->set_child(partial_key, child);
+  case node_type::node_16:
+    return as_node_16()->set_child(partial_key, child);
+  case node_type::node_48:
+    return as_node_48()->set_child(partial_key, child);
+  default:
+    return as_node_256()->set_child(partial_key, child);
+  }
+}
+
+template <class T> node<T> *inner_node<T>::del_child(char partial_key) {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->del_child(partial_key);
+  case node_type::node_16:
+    return as_node_16()->del_child(partial_key);
+  case node_type::node_48:
+    return as_node_48()->del_child(partial_key);
+  default:
+    return as_node_256()->del_child(partial_key);
+  }
+}
+
+template <class T>
+template <class A>
+inner_node<T> *inner_node<T>::grow(A &alloc) {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->grow(alloc);
+  case node_type::node_16:
+    return as_node_16()->grow(alloc);
+  case node_type::node_48:
+    return as_node_48()->grow(alloc);
+  default:
+    return as_node_256()->grow(alloc);
+  }
+}
+
+template <class T>
+template <class A>
+inner_node<T> *inner_node<T>::grow_to(int n_children, A &alloc) {
+  node_type type = n_children <= 4    ? node_type::node_4
+                   : n_children <= 16 ? node_type::node_16
+                   : n_children <= 48 ? node_type::node_48
+                                      : node_type::node_256;
+  if (type <= this->type_) {
+    return this;
+  }
+  switch (type) {
+  case node_type::node_16:
+    return grow_as<node_16<T>>(alloc);
+  case node_type::node_48:
+    return grow_as<node_48<T>>(alloc);
+  default:
+    return grow_as<node_256<T>>(alloc);
+  }
+}
+
+template <class T>
+template <class N, class A>
+inner_node<T> *inner_node<T>::grow_as(A &alloc) {
+  N *new_node = make<N>(alloc);
+  new_node->move_prefix(*this);
+  new_node->copy_n_leaves(*this);
+  for (int slot = next_slot(-1), n = n_slots(); slot < n;
+       slot = next_slot(slot)) {
+    new_node->set_child(slot_partial_key(slot), *slot_child(slot));
+  }
+  destroy(alloc);
+  return new_node;
+}
+
+template <class T>
+template <class A>
+inner_node<T> *inner_node<T>::shrink(A &alloc) {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->shrink(alloc);
+  case node_type::node_16:
+    return as_node_16()->shrink(alloc);
+  case node_type::node_48:
+    return as_node_48()->shrink(alloc);
+  default:
+    return as_node_256()->shrink(alloc);
+  }
+}
+
+template <class T>
+template <class A, class B>
+inner_node<T> *inner_node<T>::relocate(A &alloc, B &new_alloc) {
+  switch (this->type_) {
+  case node_type::node_4:
+    return relocate_as<node_4<T>>(alloc, new_alloc);
+  case node_type::node_16:
+    return relocate_as<node_16<T>>(alloc, new_alloc);
+  case node_type::node_48:
+    return relocate_as<node_48<T>>(alloc, new_alloc);
+  default:
+    return relocate_as<node_256<T>>(alloc, new_alloc);
+  }
+}
+
+template <class T>
+template <class N, class A, class B>
+inner_node<T> *inner_node<T>::relocate_as(A &alloc, B &new_alloc) {
+  /* the node types are copyable, like grow copies the children */
+  N *copy = make<N>(new_alloc, *static_cast<N *>(this));
+  ::art::destroy(alloc, static_cast<N *>(this));
+  copy->relocate_prefix(alloc, new_alloc);
+  return copy;
+}
+
+template <class T>
+void inner_node<T>::copy_n_leaves(const inner_node<T> &other) {
+#if defined(ART_SUBTREE_COUNTS)
+  n_leaves_ = other.n_leaves_;
+#else
+  (void)other;
+#endif
+}
+
+template <class T>
+template <class A>
+void inner_node<T>::destroy(A &alloc) {
+  switch (this->type_) {
+  case node_type::node_4:
+    return ::art::destroy(alloc, as_node_4());
+  case node_type::node_16:
+    return ::art::destroy(alloc, as_node_16());
+  case node_type::node_48:
+    return ::art::destroy(alloc, as_node_48());
+  default:
+    return ::art::destroy(alloc, as_node_256());
+  }
+}
+
+template <class T> bool inner_node<T>::is_full() const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->is_full();
+  case node_type::node_16:
+    return as_node_16()->is_full();
+  case node_type::node_48:
+    return as_node_48()->is_full();
+  default:
+    return as_node_256()->is_full();
+  }
+}
+
+template <class T> bool inner_node<T>::is_underfull() const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->is_underfull();
+  case node_type::node_16:
+    return as_node_16()->is_underfull();
+  case node_type::node_48:
+    return as_node_48()->is_underfull();
+  default:
+    return as_node_256()->is_underfull();
+  }
+}
+
+template <class T> int inner_node<T>::n_children() const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->n_children();
+  case node_type::node_16:
+    return as_node_16()->n_children();
+  case node_type::node_48:
+    return as_node_48()->n_children();
+  default:
+    return as_node_256()->n_children();
+  }
+}
+
+template <class T>
+char inner_node<T>::next_partial_key(char partial_key) const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->next_partial_key(partial_key);
+  case node_type::node_16:
+    return as_node_16()->next_partial_key(partial_key);
+  case node_type::node_48:
+    return as_node_48()->next_partial_key(partial_key);
+  default:
+    return as_node_256()->next_partial_key(partial_key);
+  }
+}
+
+template <class T>
+char inner_node<T>::prev_partial_key(char partial_key) const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->prev_partial_key(partial_key);
+  case node_type::node_16:
+    return as_node_16()->prev_partial_key(partial_key);
+  case node_type::node_48:
+    return as_node_48()->prev_partial_key(partial_key);
+  default:
+    return as_node_256()->prev_partial_key(partial_key);
+  }
+}
+
+template <class T> int inner_node<T>::n_slots() const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->n_slots();
+  case node_type::node_16:
+    return as_node_16()->n_slots();
+  case node_type::node_48:
+    return as_node_48()->n_slots();
+  default:
+    return as_node_256()->n_slots();
+  }
+}
+
+template <class T> int inner_node<T>::next_slot(int slot) const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->next_slot(slot);
+  case node_type::node_16:
+    return as_node_16()->next_slot(slot);
+  case node_type::node_48:
+    return as_node_48()->next_slot(slot);
+  default:
+    return as_node_256()->next_slot(slot);
+  }
+}
+
+template <class T> int inner_node<T>::prev_slot(int slot) const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->prev_slot(slot);
+  case node_type::node_16:
+    return as_node_16()->prev_slot(slot);
+  case node_type::node_48:
+    return as_node_48()->prev_slot(slot);
+  default:
+    return as_node_256()->prev_slot(slot);
+  }
+}
+
+template <class T> char inner_node<T>::slot_partial_key(int slot) const {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->slot_partial_key(slot);
+  case node_type::node_16:
+    return as_node_16()->slot_partial_key(slot);
+  case node_type::node_48:
+    return as_node_48()->slot_partial_key(slot);
+  default:
+    return as_node_256()->slot_partial_key(slot);
+  }
+}
+
+template <class T> node<T> **inner_node<T>::slot_child(int slot) {
+  switch (this->type_) {
+  case node_type::node_4:
+    return as_node_4()->slot_child(slot);
+  case node_type::node_16:
+    return as_node_16()->slot_child(slot);
+  case node_type::node_48:
+    return as_node_48()->slot_child(slot);
+  default:
+    return as_node_256()->slot_child(slot);
+  }
+}
 
 template <class T> child_it<T> inner_node<T>::begin() {
   return child_it<T>(this);
@@ -130,4 +563,9 @@ template <class T> std::reverse_iterator<child_it<T>> inner_node<T>::rend() {
 
 } // namespace art
 
+#include "node_16.hpp"
+#include "node_256.hpp"
+#include "node_4.hpp"
+#include "node_48.hpp"
+
 #endif
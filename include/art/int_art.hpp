@@ -0,0 +1,162 @@
+/**
+ * @file adaptive radix tree with integer keys
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_INT_ART_HPP
+#define ART_INT_ART_HPP
+
+#include "allocator.hpp"
+#include "art.hpp"
+#include "tree_it.hpp"
+#include <climits>
+#include <cstddef>
+#include <functional>
+#include <type_traits>
+
+namespace art {
+
+/**
+ * Adaptive radix tree with fixed-width integer keys.
+ *
+ * Keys are stored as sizeof(K) bytes, most significant byte first, so the
+ * tree is at most sizeof(K) levels deep, keys need no terminator and nothing
+ * is scanned or allocated per call. The bytes are biased such that the
+ * lexicographic order of the tree is the numeric order of the keys, for
+ * signed and unsigned K alike.
+ *
+ * @tparam K - The integer type of the keys.
+ * @tparam T - The type of the values, which are stored by pointer.
+ * @tparam A - The allocator used for nodes and prefixes, see allocator.
+ */
+template <class K, class T, class A = pool_allocator> class int_art {
+  static_assert(std::is_integral<K>::value, "keys must be integers");
+
+public:
+  static const std::size_t key_len = sizeof(K);
+
+  int_art(std::function<void(T *)> free_fn = nullptr) : tree_(free_fn) {}
+
+  /**
+   * Finds the value associated with the given key.
+   *
+   * @return the value associated with the key or a nullptr.
+   */
+  T *get(K key) const;
+
+  /**
+   * Associates the given key with the given value.
+   *
+   * @return a nullptr if no other value is associated with the key or the
+   * previously associated value.
+   */
+  T *set(K key, T *value);
+
+  /**
+   * Deletes the given key and returns it's associated value.
+   *
+   * @return the value associated with the key or a nullptr otherwise.
+   */
+  T *del(K key);
+
+  /**
+   * Forward iterator that traverses the tree in ascending key order.
+   */
+  tree_it<T> begin();
+
+  /**
+   * Forward iterator that traverses the tree in ascending key order
+   * starting from the first key not less than the given key.
+   */
+  tree_it<T> begin(K key);
+
+  /**
+   * Iterator at the greatest key, which is decremented to traverse the tree
+   * in descending key order until it equals end().
+   */
+  tree_it<T> last();
+
+  /**
+   * Iterator at the greatest key not greater than the given key.
+   */
+  tree_it<T> last(K key);
+
+  /**
+   * Iterator to the end of the key order.
+   */
+  tree_it<T> end();
+
+  /**
+   * Writes the key_len bytes under which the given key is stored.
+   */
+  static void encode(K key, char *bytes);
+
+private:
+  using unsigned_key = typename std::make_unsigned<K>::type;
+
+  art<T, A> tree_;
+};
+
+template <class K, class T, class A>
+void int_art<K, T, A>::encode(K key, char *bytes) {
+  const int n_bits = CHAR_BIT * sizeof(K);
+  unsigned_key k = static_cast<unsigned_key>(key);
+  if (std::is_signed<K>::value) {
+    /* negative keys come first */
+    k ^= static_cast<unsigned_key>(unsigned_key(1) << (n_bits - 1));
+  }
+  for (std::size_t i = 0; i < key_len; ++i) {
+    /* partial keys are compared as signed chars */
+    bytes[i] = static_cast<char>(
+        static_cast<unsigned char>(k >> (n_bits - CHAR_BIT * (i + 1))) ^ 0x80);
+  }
+}
+
+template <class K, class T, class A> T *int_art<K, T, A>::get(K key) const {
+  char bytes[key_len];
+  encode(key, bytes);
+  return tree_.get(bytes, key_len);
+}
+
+template <class K, class T, class A>
+T *int_art<K, T, A>::set(K key, T *value) {
+  char bytes[key_len];
+  encode(key, bytes);
+  return tree_.set(bytes, key_len, value);
+}
+
+template <class K, class T, class A> T *int_art<K, T, A>::del(K key) {
+  char bytes[key_len];
+  encode(key, bytes);
+  return tree_.del(bytes, key_len);
+}
+
+template <class K, class T, class A> tree_it<T> int_art<K, T, A>::begin() {
+  return tree_.begin();
+}
+
+template <class K, class T, class A>
+tree_it<T> int_art<K, T, A>::begin(K key) {
+  char bytes[key_len];
+  encode(key, bytes);
+  return tree_.begin(bytes, key_len);
+}
+
+template <class K, class T, class A> tree_it<T> int_art<K, T, A>::last() {
+  return tree_.last();
+}
+
+template <class K, class T, class A>
+tree_it<T> int_art<K, T, A>::last(K key) {
+  char bytes[key_len];
+  encode(key, bytes);
+  return tree_.last(bytes, key_len);
+}
+
+template <class K, class T, class A> tree_it<T> int_art<K, T, A>::end() {
+  return tree_.end();
+}
+
+} // namespace art
+
+#endif
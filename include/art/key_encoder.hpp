@@ -0,0 +1,409 @@
+/**
+ * @file order-preserving encoding of typed and composite keys
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_KEY_ENCODER_HPP
+#define ART_KEY_ENCODER_HPP
+
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace art {
+
+/**
+ * Encodes a sequence of values into a key whose lexicographic order in the
+ * tree is the order of the sequences, compared value by value.
+ *
+ * Integers are written most significant byte first and biased like int_art,
+ * so signed and unsigned integers of any width keep their numeric order and
+ * take sizeof bytes. Floats and doubles take 4 and 8 bytes: negative numbers
+ * come first, -0.0 is written as 0.0 and every NaN as the same NaN, which
+ * comes after infinity. Strings may hold any byte: a 0 is escaped by a
+ * second byte and strings end with a terminator that orders before every
+ * byte, so a string comes before the strings it is a prefix of.
+ *
+ * Keys of the same sequence of types are thus prefix-free and may be used
+ * together in one tree. The bytes are kept in a fixed buffer of N bytes,
+ * nothing is allocated, and may contain zeroes, so they are looked up with
+ * the length-taking overloads, e.g. `m.get(k.data(), k.size())`.
+ *
+ * @tparam N - The capacity of the buffer in bytes.
+ */
+template <std::size_t N> class key_encoder {
+public:
+  static const std::size_t capacity = N;
+
+  key_encoder() : size_(0) {}
+
+  /**
+   * Encodes the given values into the buffer, replacing its contents.
+   *
+   * @throws std::length_error if the key does not fit into N bytes.
+   */
+  template <class... Vs> key_encoder &encode(const Vs &... values);
+
+  /**
+   * Appends a value to the key.
+   *
+   * @throws std::length_error if the key does not fit into N bytes.
+   */
+  template <class I>
+  typename std::enable_if<std::is_integral<I>::value &&
+                              !std::is_same<I, bool>::value,
+                          key_encoder &>::type
+  append(I value);
+  key_encoder &append(bool value);
+  key_encoder &append(float value);
+  key_encoder &append(double value);
+  key_encoder &append(const char *value, std::size_t len);
+  key_encoder &append(const char *value);
+  key_encoder &append(const std::string &value);
+#if __cplusplus >= 201703L
+  key_encoder &append(std::string_view value);
+#endif
+
+  void clear() { size_ = 0; }
+
+  const char *data() const { return bytes_; }
+
+  std::size_t size() const { return size_; }
+
+private:
+  key_encoder &append_all() { return *this; }
+  template <class V, class... Vs>
+  key_encoder &append_all(const V &value, const Vs &... values);
+
+  template <class U> void append_bits(U bits);
+
+  char *reserve(std::size_t n);
+
+  char bytes_[N];
+  std::size_t size_;
+};
+
+/**
+ * Reads the values back from a key written by key_encoder, e.g. the key of
+ * an iterator, in the order they were appended. The key is not copied and
+ * must outlive the decoder.
+ *
+ * @throws std::invalid_argument from read if the key ends before the value.
+ */
+class key_decoder {
+public:
+  key_decoder(const char *data, std::size_t len)
+      : data_(data), end_(data + len) {}
+  explicit key_decoder(const std::string &key)
+      : key_decoder(key.data(), key.size()) {}
+  explicit key_decoder(std::string &&key) = delete;
+
+  template <class I>
+  typename std::enable_if<std::is_integral<I>::value &&
+                              !std::is_same<I, bool>::value,
+                          key_decoder &>::type
+  read(I &value);
+  key_decoder &read(bool &value);
+  key_decoder &read(float &value);
+  key_decoder &read(double &value);
+  key_decoder &read(std::string &value);
+
+  /**
+   * Whether the whole key was read.
+   */
+  bool done() const { return data_ == end_; }
+
+private:
+  template <class U> U read_bits();
+
+  const char *take(std::size_t n);
+
+  const char *data_;
+  const char *end_;
+};
+
+/**
+ * Up to Count keys of at most N bytes each, laid out for art::multi_get and
+ * art::multi_set, i.e.
+ * `m.multi_get(batch.keys(), batch.key_lens(), batch.size(), values)`.
+ *
+ * The keys point into the batch, which is therefore not copyable.
+ *
+ * @tparam Count - The capacity of the batch, multi_get keeps 16 lookups in
+ * flight.
+ */
+template <std::size_t N, std::size_t Count = 16> class key_batch {
+public:
+  static const std::size_t capacity = Count;
+
+  key_batch();
+  key_batch(const key_batch &) = delete;
+  key_batch &operator=(const key_batch &) = delete;
+
+  /**
+   * Encodes the given values into the next key of the batch.
+   *
+   * @throws std::length_error if the batch is full or the key does not fit
+   * into N bytes. The batch is unchanged then.
+   */
+  template <class... Vs> void push(const Vs &... values);
+
+  void clear() { size_ = 0; }
+
+  bool full() const { return size_ == Count; }
+
+  std::size_t size() const { return size_; }
+
+  const char *const *keys() const { return keys_; }
+
+  const std::size_t *key_lens() const { return key_lens_; }
+
+private:
+  key_encoder<N> encoders_[Count];
+  const char *keys_[Count];
+  std::size_t key_lens_[Count];
+  std::size_t size_;
+};
+
+namespace key_encoding {
+
+/* the tree compares partial keys as signed chars */
+inline char to_tree(unsigned char byte) {
+  return static_cast<char>(byte ^ 0x80);
+}
+
+inline unsigned char from_tree(char byte) {
+  return static_cast<unsigned char>(byte) ^ 0x80;
+}
+
+/* escapes a 0 in a string and ends it, both after a 0 */
+const unsigned char escape = 0xff;
+const unsigned char terminator = 0x01;
+
+template <class F> struct float_bits;
+template <> struct float_bits<float> { using type = uint32_t; };
+template <> struct float_bits<double> { using type = uint64_t; };
+
+template <class F> typename float_bits<F>::type encode_float(F value) {
+  static_assert(std::numeric_limits<F>::is_iec559, "floats must be IEEE 754");
+  using U = typename float_bits<F>::type;
+  static_assert(sizeof(U) == sizeof(F), "floats must be IEEE 754");
+  const U sign = U(1) << (CHAR_BIT * sizeof(U) - 1);
+  if (value == 0) {
+    value = 0;
+  } else if (value != value) {
+    value = std::numeric_limits<F>::quiet_NaN();
+  }
+  U bits;
+  std::memcpy(&bits, &value, sizeof(U));
+  /* positive numbers after negative ones, whose order is reversed */
+  return (bits & sign) != 0 ? static_cast<U>(~bits) : (bits | sign);
+}
+
+template <class F> F decode_float(typename float_bits<F>::type bits) {
+  using U = typename float_bits<F>::type;
+  const U sign = U(1) << (CHAR_BIT * sizeof(U) - 1);
+  bits = (bits & sign) != 0 ? (bits ^ sign) : static_cast<U>(~bits);
+  F value;
+  std::memcpy(&value, &bits, sizeof(U));
+  return value;
+}
+
+} // namespace key_encoding
+
+template <std::size_t N>
+template <class... Vs>
+key_encoder<N> &key_encoder<N>::encode(const Vs &... values) {
+  clear();
+  return append_all(values...);
+}
+
+template <std::size_t N>
+template <class V, class... Vs>
+key_encoder<N> &key_encoder<N>::append_all(const V &value,
+                                           const Vs &... values) {
+  append(value);
+  return append_all(values...);
+}
+
+template <std::size_t N>
+template <class I>
+typename std::enable_if<std::is_integral<I>::value &&
+                            !std::is_same<I, bool>::value,
+                        key_encoder<N> &>::type
+key_encoder<N>::append(I value) {
+  using U = typename std::make_unsigned<I>::type;
+  U bits = static_cast<U>(value);
+  if (std::is_signed<I>::value) {
+    /* negative values come first */
+    bits ^= static_cast<U>(U(1) << (CHAR_BIT * sizeof(U) - 1));
+  }
+  append_bits(bits);
+  return *this;
+}
+
+template <std::size_t N> key_encoder<N> &key_encoder<N>::append(bool value) {
+  *reserve(1) = key_encoding::to_tree(value ? 1 : 0);
+  return *this;
+}
+
+template <std::size_t N> key_encoder<N> &key_encoder<N>::append(float value) {
+  append_bits(key_encoding::encode_float(value));
+  return *this;
+}
+
+template <std::size_t N>
+key_encoder<N> &key_encoder<N>::append(double value) {
+  append_bits(key_encoding::encode_float(value));
+  return *this;
+}
+
+template <std::size_t N>
+key_encoder<N> &key_encoder<N>::append(const char *value, std::size_t len) {
+  std::size_t n_zeroes = 0;
+  for (std::size_t i = 0; i < len; ++i) {
+    n_zeroes += value[i] == 0;
+  }
+  char *out = reserve(len + n_zeroes + 2);
+  for (std::size_t i = 0; i < len; ++i) {
+    *out++ = key_encoding::to_tree(static_cast<unsigned char>(value[i]));
+    if (value[i] == 0) {
+      *out++ = key_encoding::to_tree(key_encoding::escape);
+    }
+  }
+  *out++ = key_encoding::to_tree(0);
+  *out = key_encoding::to_tree(key_encoding::terminator);
+  return *this;
+}
+
+template <std::size_t N>
+key_encoder<N> &key_encoder<N>::append(const char *value) {
+  return append(value, std::strlen(value));
+}
+
+template <std::size_t N>
+key_encoder<N> &key_encoder<N>::append(const std::string &value) {
+  return append(value.data(), value.size());
+}
+
+#if __cplusplus >= 201703L
+template <std::size_t N>
+key_encoder<N> &key_encoder<N>::append(std::string_view value) {
+  return append(value.data(), value.size());
+}
+#endif
+
+template <std::size_t N>
+template <class U>
+void key_encoder<N>::append_bits(U bits) {
+  const int n_bits = CHAR_BIT * sizeof(U);
+  char *out = reserve(sizeof(U));
+  for (std::size_t i = 0; i < sizeof(U); ++i) {
+    out[i] = key_encoding::to_tree(
+        static_cast<unsigned char>(bits >> (n_bits - CHAR_BIT * (i + 1))));
+  }
+}
+
+template <std::size_t N> char *key_encoder<N>::reserve(std::size_t n) {
+  if (n > N - size_) {
+    throw std::length_error("key does not fit into the encoder");
+  }
+  char *out = bytes_ + size_;
+  size_ += n;
+  return out;
+}
+
+template <class I>
+typename std::enable_if<std::is_integral<I>::value &&
+                            !std::is_same<I, bool>::value,
+                        key_decoder &>::type
+key_decoder::read(I &value) {
+  using U = typename std::make_unsigned<I>::type;
+  U bits = read_bits<U>();
+  if (std::is_signed<I>::value) {
+    bits ^= static_cast<U>(U(1) << (CHAR_BIT * sizeof(U) - 1));
+  }
+  value = static_cast<I>(bits);
+  return *this;
+}
+
+inline key_decoder &key_decoder::read(bool &value) {
+  value = key_encoding::from_tree(*take(1)) != 0;
+  return *this;
+}
+
+inline key_decoder &key_decoder::read(float &value) {
+  value = key_encoding::decode_float<float>(read_bits<uint32_t>());
+  return *this;
+}
+
+inline key_decoder &key_decoder::read(double &value) {
+  value = key_encoding::decode_float<double>(read_bits<uint64_t>());
+  return *this;
+}
+
+inline key_decoder &key_decoder::read(std::string &value) {
+  value.clear();
+  for (;;) {
+    unsigned char byte = key_encoding::from_tree(*take(1));
+    if (byte != 0) {
+      value.push_back(static_cast<char>(byte));
+      continue;
+    }
+    byte = key_encoding::from_tree(*take(1));
+    if (byte == key_encoding::terminator) {
+      return *this;
+    }
+    if (byte != key_encoding::escape) {
+      throw std::invalid_argument("key holds no encoded string");
+    }
+    value.push_back('\0');
+  }
+}
+
+template <class U> U key_decoder::read_bits() {
+  const char *in = take(sizeof(U));
+  U bits = 0;
+  for (std::size_t i = 0; i < sizeof(U); ++i) {
+    bits = static_cast<U>(bits << CHAR_BIT) | key_encoding::from_tree(in[i]);
+  }
+  return bits;
+}
+
+inline const char *key_decoder::take(std::size_t n) {
+  if (static_cast<std::size_t>(end_ - data_) < n) {
+    throw std::invalid_argument("key ends before the value");
+  }
+  const char *in = data_;
+  data_ += n;
+  return in;
+}
+
+template <std::size_t N, std::size_t Count>
+key_batch<N, Count>::key_batch() : size_(0) {
+  for (std::size_t i = 0; i < Count; ++i) {
+    keys_[i] = encoders_[i].data();
+  }
+}
+
+template <std::size_t N, std::size_t Count>
+template <class... Vs>
+void key_batch<N, Count>::push(const Vs &... values) {
+  if (full()) {
+    throw std::length_error("key batch is full");
+  }
+  key_lens_[size_] = encoders_[size_].encode(values...).size();
+  ++size_;
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,360 @@
+/**
+ * @file leaf bucket header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_LEAF_BUCKET_HPP
+#define ART_LEAF_BUCKET_HPP
+
+#include "node.hpp"
+#include "node_16.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <stdexcept>
+#include <string>
+
+namespace art {
+
+/**
+ * Fringe node of a bucket_art, which holds up to capacity keys and their
+ * values instead of a subtree of inner nodes and one leaf per key.
+ *
+ * The remaining bytes of the keys, i.e. those after the path to the bucket,
+ * are stored back to back in key order in a single allocation of exactly
+ * the required size, after the values and the end offsets of the keys:
+ *
+ *   | header | first_[16] | values_[n] | ends_[n] | key bytes |
+ *
+ * first_ holds the first remaining byte of every key, so a lookup compares
+ * it with the key's byte at once, with SSE2 or NEON like the keys of a
+ * node_16, and only compares the keys starting with that byte in full.
+ *
+ * The keys of a bucket are immutable: inserting or erasing a key creates a
+ * new bucket, which copies at most capacity keys. Values are modified in
+ * place.
+ */
+template <class T> class leaf_bucket : public node<T> {
+public:
+  static const int capacity = 16;
+
+  /**
+   * A key and its value to create a bucket from, see make.
+   */
+  struct entry {
+    const char *key_;
+    int key_len_;
+    T *value_;
+  };
+
+  /**
+   * Creates a bucket of the n given entries, which must be sorted and
+   * prefix-free. The first skip bytes of every entry's key are dropped and
+   * the head_len bytes of head are prepended instead.
+   */
+  template <class A>
+  static leaf_bucket<T> *make(const entry *entries, int n, const char *head,
+                              int head_len, int skip, A &alloc);
+
+  /**
+   * Returns the index of the given key, or -1 if the bucket doesn't hold
+   * it.
+   */
+  int find(const char *key, int key_len) const;
+
+  /**
+   * Returns the index of the first key not less than the given key, in the
+   * order of the tree, i.e. bytes compared as signed chars.
+   */
+  int lower_bound(const char *key, int key_len) const;
+
+  /**
+   * Determines if one of the given key and the key at index i is a proper
+   * prefix of the other. False if there is no key at index i.
+   */
+  bool is_prefix_related(int i, const char *key, int key_len) const;
+
+  int n_keys() const;
+
+  /**
+   * Returns the remaining bytes of the key at index i.
+   *
+   * @param len - Set to the number of bytes.
+   */
+  const char *key(int i, int &len) const;
+
+  T *&value(int i);
+  T *value(int i) const;
+
+  /**
+   * Returns the entry at index i, see make.
+   */
+  entry at(int i) const;
+
+  /**
+   * Creates a copy of the bucket with the given key inserted at index i,
+   * and destroys this bucket.
+   *
+   * @pre The bucket must not be full.
+   */
+  template <class A>
+  leaf_bucket<T> *insert(int i, const char *key, int key_len, T *value,
+                         A &alloc);
+
+  /**
+   * Creates a copy of the bucket without the key at index i, and destroys
+   * this bucket.
+   */
+  template <class A> leaf_bucket<T> *erase(int i, A &alloc);
+
+  /**
+   * Creates a copy of the bucket with the given prefix and partial key
+   * prepended to every key, used when the bucket replaces its parent, and
+   * destroys this bucket.
+   */
+  template <class A>
+  leaf_bucket<T> *prepend(const char *prefix, int prefix_len,
+                          char partial_key, A &alloc);
+
+  /**
+   * Returns the number of bytes allocated for the bucket.
+   */
+  std::size_t size() const;
+
+  template <class A> void destroy(A &alloc);
+
+private:
+  leaf_bucket(int n, std::uint32_t n_bytes);
+
+  static std::size_t size(int n, std::size_t n_bytes);
+
+  /* bit i is set if the key at index i starts with the given byte */
+  unsigned first_mask(char first) const;
+
+  T **values();
+  T *const *values() const;
+  std::uint32_t *ends();
+  const std::uint32_t *ends() const;
+  char *bytes();
+  const char *bytes() const;
+
+  std::uint8_t n_keys_;
+  std::uint32_t n_bytes_;
+  char first_[capacity];
+};
+
+template <class T> const int leaf_bucket<T>::capacity;
+
+template <class T>
+leaf_bucket<T>::leaf_bucket(int n, std::uint32_t n_bytes)
+    : node<T>(node_type::bucket), n_keys_(n), n_bytes_(n_bytes), first_() {
+  static_assert(sizeof(leaf_bucket<T>) % alignof(T *) == 0,
+                "the values follow the header");
+}
+
+template <class T>
+std::size_t leaf_bucket<T>::size(int n, std::size_t n_bytes) {
+  return sizeof(leaf_bucket<T>) + n * (sizeof(T *) + sizeof(std::uint32_t)) +
+         n_bytes;
+}
+
+template <class T>
+template <class A>
+leaf_bucket<T> *leaf_bucket<T>::make(const entry *entries, int n,
+                                     const char *head, int head_len,
+                                     int skip, A &alloc) {
+  std::size_t n_bytes = 0;
+  for (int i = 0; i < n; ++i) {
+    n_bytes += head_len + entries[i].key_len_ - skip;
+  }
+  if (n_bytes > UINT32_MAX) {
+    throw std::length_error("keys of a leaf bucket are too long");
+  }
+  auto b = new (alloc.allocate(size(n, n_bytes)))
+      leaf_bucket<T>(n, static_cast<std::uint32_t>(n_bytes));
+  char *dst = b->bytes();
+  int len;
+  for (int i = 0; i < n; ++i) {
+    len = entries[i].key_len_ - skip;
+    std::memcpy(dst, head, head_len);
+    std::memcpy(dst + head_len, entries[i].key_ + skip, len);
+    b->first_[i] = head_len + len > 0 ? dst[0] : 0;
+    dst += head_len + len;
+    b->values()[i] = entries[i].value_;
+    b->ends()[i] = dst - b->bytes();
+  }
+  return b;
+}
+
+#if defined(ART_NODE_16_SSE2)
+template <class T> unsigned leaf_bucket<T>::first_mask(char first) const {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(first),
+                                          _mm_loadu_si128((__m128i *)first_))) &
+         ((1u << n_keys_) - 1);
+}
+#elif defined(ART_NODE_16_NEON)
+template <class T> unsigned leaf_bucket<T>::first_mask(char first) const {
+  int8x16_t firsts = vld1q_s8(reinterpret_cast<const int8_t *>(first_));
+  return node_16_movemask(vceqq_s8(firsts, vdupq_n_s8(first))) &
+         ((1u << n_keys_) - 1);
+}
+#else
+template <class T> unsigned leaf_bucket<T>::first_mask(char first) const {
+  unsigned mask = 0;
+  for (int i = 0; i < n_keys_; ++i) {
+    mask |= static_cast<unsigned>(first_[i] == first) << i;
+  }
+  return mask;
+}
+#endif
+
+template <class T>
+int leaf_bucket<T>::find(const char *key, int key_len) const {
+  /* an empty key is stored with first byte 0 */
+  unsigned mask = first_mask(key_len > 0 ? key[0] : 0);
+  const char *k;
+  int len, i;
+  while (mask != 0) {
+    i = __builtin_ctz(mask);
+    k = this->key(i, len);
+    if (len == key_len && std::memcmp(k, key, len) == 0) {
+      return i;
+    }
+    mask &= mask - 1;
+  }
+  return -1;
+}
+
+template <class T>
+int leaf_bucket<T>::lower_bound(const char *key, int key_len) const {
+  const char *k;
+  int len, common, j, i = 0;
+  for (; i < n_keys_; ++i) {
+    k = this->key(i, len);
+    common = len < key_len ? len : key_len;
+    for (j = 0; j < common && k[j] == key[j]; ++j) {
+    }
+    if (j < common ? key[j] < k[j] : key_len <= len) {
+      break;
+    }
+  }
+  return i;
+}
+
+template <class T>
+bool leaf_bucket<T>::is_prefix_related(int i, const char *key,
+                                       int key_len) const {
+  if (i < 0 || i >= n_keys_) {
+    return false;
+  }
+  int len;
+  const char *k = this->key(i, len);
+  return len != key_len &&
+         std::memcmp(k, key, len < key_len ? len : key_len) == 0;
+}
+
+template <class T> int leaf_bucket<T>::n_keys() const { return n_keys_; }
+
+template <class T>
+const char *leaf_bucket<T>::key(int i, int &len) const {
+  std::uint32_t begin = i == 0 ? 0 : ends()[i - 1];
+  len = ends()[i] - begin;
+  return bytes() + begin;
+}
+
+template <class T> T *&leaf_bucket<T>::value(int i) { return values()[i]; }
+
+template <class T> T *leaf_bucket<T>::value(int i) const {
+  return values()[i];
+}
+
+template <class T>
+typename leaf_bucket<T>::entry leaf_bucket<T>::at(int i) const {
+  entry e;
+  e.key_ = key(i, e.key_len_);
+  e.value_ = value(i);
+  return e;
+}
+
+template <class T>
+template <class A>
+leaf_bucket<T> *leaf_bucket<T>::insert(int i, const char *key, int key_len,
+                                       T *value, A &alloc) {
+  entry entries[capacity];
+  for (int j = 0; j < n_keys_; ++j) {
+    entries[j < i ? j : j + 1] = at(j);
+  }
+  entries[i] = entry{key, key_len, value};
+  leaf_bucket<T> *b = make(entries, n_keys_ + 1, nullptr, 0, 0, alloc);
+  destroy(alloc);
+  return b;
+}
+
+template <class T>
+template <class A>
+leaf_bucket<T> *leaf_bucket<T>::erase(int i, A &alloc) {
+  entry entries[capacity];
+  for (int j = 0; j < n_keys_; ++j) {
+    if (j != i) {
+      entries[j < i ? j : j - 1] = at(j);
+    }
+  }
+  leaf_bucket<T> *b = make(entries, n_keys_ - 1, nullptr, 0, 0, alloc);
+  destroy(alloc);
+  return b;
+}
+
+template <class T>
+template <class A>
+leaf_bucket<T> *leaf_bucket<T>::prepend(const char *prefix, int prefix_len,
+                                        char partial_key, A &alloc) {
+  std::string head(prefix, prefix_len);
+  head.push_back(partial_key);
+  entry entries[capacity];
+  for (int j = 0; j < n_keys_; ++j) {
+    entries[j] = at(j);
+  }
+  leaf_bucket<T> *b =
+      make(entries, n_keys_, head.data(), head.size(), 0, alloc);
+  destroy(alloc);
+  return b;
+}
+
+template <class T> std::size_t leaf_bucket<T>::size() const {
+  return size(n_keys_, n_bytes_);
+}
+
+template <class T> template <class A> void leaf_bucket<T>::destroy(A &alloc) {
+  std::size_t s = size();
+  this->~leaf_bucket<T>();
+  alloc.deallocate(this, s);
+}
+
+template <class T> T **leaf_bucket<T>::values() {
+  return reinterpret_cast<T **>(this + 1);
+}
+
+template <class T> T *const *leaf_bucket<T>::values() const {
+  return reinterpret_cast<T *const *>(this + 1);
+}
+
+template <class T> std::uint32_t *leaf_bucket<T>::ends() {
+  return reinterpret_cast<std::uint32_t *>(values() + n_keys_);
+}
+
+template <class T> const std::uint32_t *leaf_bucket<T>::ends() const {
+  return reinterpret_cast<const std::uint32_t *>(values() + n_keys_);
+}
+
+template <class T> char *leaf_bucket<T>::bytes() {
+  return reinterpret_cast<char *>(ends() + n_keys_);
+}
+
+template <class T> const char *leaf_bucket<T>::bytes() const {
+  return reinterpret_cast<const char *>(ends() + n_keys_);
+}
+
+} // namespace art
+
+#endif
@@ -10,21 +10,24 @@
 
 namespace art {
 
-template <class T> class art;
-
 template <class T> class leaf_node : public node<T> {
 public:
   explicit leaf_node(T *value);
-  bool is_leaf() const override;
 
   T *value_;
 };
 
 template <class T>
-leaf_node<T>::leaf_node(T *value): value_(value) {}
+leaf_node<T>::leaf_node(T *value): node<T>(node_type::leaf), value_(value) {}
 
-template <class T> 
-bool leaf_node<T>::is_leaf() const { return true; }
+/**
+ * Returns the value of the given leaf, which is either a tagged value
+ * pointer or a leaf_node<T> instance.
+ */
+template <class T> T *leaf_value(const node<T> *n) {
+  return is_tagged(n) ? untag_leaf(n)
+                      : static_cast<const leaf_node<T> *>(n)->value_;
+}
 
 } // namespace art
 
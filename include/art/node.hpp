@@ -6,9 +6,13 @@
 #ifndef ART_NODE_HPP
 #define ART_NODE_HPP
 
+#include "allocator.hpp"
+#include "optimistic_lock.hpp"
 #include <algorithm>
 #include <array>
 #include <cassert>
+#include <climits>
+#include <cstdint>
 #include <cstring>
 #include <iostream>
 #include <iterator>
@@ -16,11 +20,26 @@
 
 namespace art {
 
+/* partial keys index the child arrays as 128 + partial_key */
+static_assert(CHAR_MIN < 0, "partial keys must be signed chars, e.g. "
+                            "compile with -fsigned-char on ARM");
+
+/**
+ * Concrete type of a node, stored in the header of every node.
+ * Used for dispatching calls without virtual functions. Buckets only occur
+ * in a bucket_art, see leaf_bucket.
+ */
+enum class node_type : uint8_t {
+  leaf,
+  node_4,
+  node_16,
+  node_48,
+  node_256,
+  bucket
+};
+
 template <class T> class node {
 public:
-  virtual ~node() = default;
-
-  node() = default;
   node(const node<T> &other) = default;
   node(node<T> &&other) noexcept = default;
   node<T> &operator=(const node<T> &other) = default;
@@ -30,7 +49,7 @@ public:
    * Determines if this node is a leaf node, i.e., contains a value.
    * Needed for downcasting a node<T> instance to a leaf_node<T> or inner_node<T> instance.
    */
-  virtual bool is_leaf() const = 0;
+  bool is_leaf() const;
 
   /**
    * Determines the number of matching bytes between the node's prefix and the key.
@@ -43,22 +62,355 @@ public:
    * prefix:  "abbbd"
    *           ^^^^*
    * index:    01234
+   *
+   * At most key_len bytes of the key are read.
    */
   int check_prefix(const char *key, int key_len) const;
 
-  char *prefix_ = nullptr;
+  /**
+   * Prefixes of up to max_inline_prefix_len bytes are stored inside the node,
+   * so that matching them doesn't touch another cache line. Longer prefixes
+   * are allocated separately and the node stores a pointer to them instead.
+   */
+  static const int max_inline_prefix_len = sizeof(char *);
+
+  /**
+   * Determines if the prefix is stored inside the node.
+   */
+  bool is_prefix_inline() const;
+
+  /**
+   * Returns the prefix bytes, either stored inline or on the heap.
+   */
+  char *prefix();
+  const char *prefix() const;
+
+  /**
+   * Number of bytes allocated for the prefix, 0 if it is inline. Heap
+   * prefixes may be larger than prefix_len_, see set_prefix.
+   */
+  int heap_prefix_size() const;
+
+  /**
+   * Replaces the prefix with the given bytes, which may overlap with the
+   * current prefix. A heap prefix that has room for the new bytes is
+   * reused, unless the new prefix fits inline or would leave more than
+   * max_heap_prefix_slack bytes unused. Otherwise the previous prefix is
+   * released.
+   *
+   * @param prefix - The new prefix.
+   * @param prefix_len - The length of the new prefix.
+   * @param alloc - The allocator used for prefixes that don't fit inline.
+   */
+  template <class A>
+  void set_prefix(const char *prefix, int prefix_len, A &alloc);
+
+  /**
+   * Prepends the given prefix and partial key to the node's prefix, in
+   * place if the node's heap prefix has room for them.
+   * Used when a node is merged with its parent.
+   *
+   * @param prefix - The parent's prefix.
+   * @param prefix_len - The length of the parent's prefix.
+   * @param partial_key - The partial key of this node in the parent.
+   * @param alloc - The allocator used for prefixes that don't fit inline.
+   */
+  template <class A>
+  void prepend_prefix(const char *prefix, int prefix_len, char partial_key,
+                      A &alloc);
+
+  /**
+   * Prepends the parent's prefix and the partial key to the node's prefix,
+   * like prepend_prefix, but takes over the parent's heap prefix if the
+   * node's own one has no room and the parent's one does. The parent is
+   * left with an empty prefix in that case.
+   */
+  template <class A>
+  void prepend_prefix(node<T> &parent, char partial_key, A &alloc);
+
+  /**
+   * Splits the prefix at the given length: the first prefix_len bytes
+   * become the prefix of the given parent, which must have an empty prefix,
+   * the next byte is dropped (it becomes this node's partial key in the
+   * parent) and the node keeps the rest. Used when a key diverges within
+   * the prefix. If the parent's part doesn't fit inline, the parent takes
+   * over the heap prefix, so that a later prepend_prefix(parent, ...)
+   * merges both parts back in place.
+   */
+  template <class A>
+  void split_prefix(node<T> &parent, int prefix_len, A &alloc);
+
+  /**
+   * Takes over the prefix of the given node, leaving the given node with an
+   * empty prefix. Used when a node is replaced by a node of another type.
+   * This node must not have a prefix.
+   */
+  void move_prefix(node<T> &other);
+
+  /**
+   * Releases the prefix, leaving the node with an empty prefix.
+   *
+   * @param alloc - The allocator the prefix was created with.
+   */
+  template <class A> void free_prefix(A &alloc);
+
+  /**
+   * Moves a heap prefix to the given new allocator, without slack, and
+   * releases it in the allocator it was created with. Used when a node is
+   * moved to another allocator, see inner_node::relocate.
+   */
+  template <class A, class B> void relocate_prefix(A &alloc, B &new_alloc);
+
+  node_type type_;
+
+private:
+  /* unused bytes at the end of the heap prefix, fills the header padding */
+  uint8_t heap_prefix_slack_ = 0;
+
+public:
   uint16_t prefix_len_ = 0;
+
+  /* version lock, only used by concurrent trees */
+  optimistic_lock lock_;
+
+protected:
+  explicit node(node_type type);
+
+private:
+  static const int max_heap_prefix_slack = UINT8_MAX;
+
+  char *heap_prefix() const;
+  void set_heap_prefix(char *heap_prefix);
+
+  /**
+   * Stores the given heap prefix of size bytes, whose first prefix_len
+   * bytes are the prefix. The previous prefix must have been released.
+   */
+  void set_heap_prefix(char *heap_prefix, int size, int prefix_len);
+
+  /* inline prefix or (unaligned) pointer to the heap prefix */
+  char prefix_[max_inline_prefix_len];
 };
 
+template <class T> node<T>::node(node_type type) : type_(type) {}
+
+template <class T> bool node<T>::is_leaf() const {
+  return type_ == node_type::leaf;
+}
+
 template <class T>
-int node<T>::check_prefix(const char *key, int /* key_len */) const {
-  // TODO(rafaelkallis): && i < key_len ??
-  for (int i = 0; i < prefix_len_; ++i) {
-    if (prefix_[i] != key[i]) {
+int node<T>::check_prefix(const char *key, int key_len) const {
+  const char *p = prefix();
+  int len = std::min<int>(prefix_len_, key_len), i = 0;
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  /* compare a word at a time, the first mismatching byte is the lowest one */
+  for (; i + 8 <= len; i += 8) {
+    uint64_t prefix_word, key_word;
+    std::memcpy(&prefix_word, p + i, 8);
+    std::memcpy(&key_word, key + i, 8);
+    if (prefix_word != key_word) {
+      return i + __builtin_ctzll(prefix_word ^ key_word) / 8;
+    }
+  }
+#endif
+  for (; i < len; ++i) {
+    if (p[i] != key[i]) {
       return i;
     }
   }
-  return prefix_len_;
+  return len;
+}
+
+template <class T> bool node<T>::is_prefix_inline() const {
+  return prefix_len_ <= max_inline_prefix_len;
+}
+
+template <class T> char *node<T>::prefix() {
+  return is_prefix_inline() ? prefix_ : heap_prefix();
+}
+
+template <class T> const char *node<T>::prefix() const {
+  return is_prefix_inline() ? prefix_ : heap_prefix();
+}
+
+template <class T> char *node<T>::heap_prefix() const {
+  char *heap_prefix;
+  std::memcpy(&heap_prefix, prefix_, sizeof(char *));
+  return heap_prefix;
+}
+
+template <class T> void node<T>::set_heap_prefix(char *heap_prefix) {
+  std::memcpy(prefix_, &heap_prefix, sizeof(char *));
+}
+
+template <class T>
+void node<T>::set_heap_prefix(char *heap_prefix, int size, int prefix_len) {
+  set_heap_prefix(heap_prefix);
+  heap_prefix_slack_ = size - prefix_len;
+  prefix_len_ = prefix_len;
+}
+
+template <class T> int node<T>::heap_prefix_size() const {
+  return is_prefix_inline() ? 0 : prefix_len_ + heap_prefix_slack_;
+}
+
+template <class T>
+template <class A>
+void node<T>::set_prefix(const char *prefix, int prefix_len, A &alloc) {
+  char *old_heap = is_prefix_inline() ? nullptr : heap_prefix();
+  int old_size = heap_prefix_size();
+  if (prefix_len <= max_inline_prefix_len) {
+    std::memmove(prefix_, prefix, prefix_len);
+    prefix_len_ = prefix_len;
+  } else if (old_size >= prefix_len &&
+             old_size - prefix_len <= max_heap_prefix_slack) {
+    /* e.g. the node's prefix is split, shift the rest to the front */
+    std::memmove(old_heap, prefix, prefix_len);
+    set_heap_prefix(old_heap, old_size, prefix_len);
+    return;
+  } else {
+    char *heap = static_cast<char *>(alloc.allocate(prefix_len));
+    std::memcpy(heap, prefix, prefix_len);
+    set_heap_prefix(heap, prefix_len, prefix_len);
+  }
+  if (old_heap != nullptr) {
+    alloc.deallocate(old_heap, old_size);
+  }
+}
+
+template <class T>
+template <class A>
+void node<T>::prepend_prefix(const char *prefix, int prefix_len,
+                             char partial_key, A &alloc) {
+  int new_prefix_len = prefix_len + 1 + prefix_len_;
+  if (heap_prefix_size() >= new_prefix_len) {
+    /* shift the node's prefix back, where the parent's prefix goes */
+    char *heap = heap_prefix();
+    std::memmove(heap + prefix_len + 1, heap, prefix_len_);
+    std::memcpy(heap, prefix, prefix_len);
+    heap[prefix_len] = partial_key;
+    set_heap_prefix(heap, heap_prefix_size(), new_prefix_len);
+    return;
+  }
+  char inline_prefix[max_inline_prefix_len];
+  char *new_prefix = new_prefix_len <= max_inline_prefix_len
+                         ? inline_prefix
+                         : static_cast<char *>(alloc.allocate(new_prefix_len));
+  std::memcpy(new_prefix + prefix_len + 1, this->prefix(), prefix_len_);
+  std::memcpy(new_prefix, prefix, prefix_len);
+  new_prefix[prefix_len] = partial_key;
+  free_prefix(alloc);
+  if (new_prefix == inline_prefix) {
+    std::memcpy(prefix_, inline_prefix, new_prefix_len);
+    prefix_len_ = new_prefix_len;
+  } else {
+    set_heap_prefix(new_prefix, new_prefix_len, new_prefix_len);
+  }
+}
+
+template <class T>
+template <class A>
+void node<T>::prepend_prefix(node<T> &parent, char partial_key, A &alloc) {
+  int new_prefix_len = parent.prefix_len_ + 1 + prefix_len_;
+  int parent_size = parent.heap_prefix_size();
+  if (heap_prefix_size() >= new_prefix_len || parent_size < new_prefix_len) {
+    prepend_prefix(parent.prefix(), parent.prefix_len_, partial_key, alloc);
+    return;
+  }
+  /* the parent's prefix is already in place, append the node's prefix */
+  char *heap = parent.heap_prefix();
+  heap[parent.prefix_len_] = partial_key;
+  std::memcpy(heap + parent.prefix_len_ + 1, prefix(), prefix_len_);
+  parent.prefix_len_ = 0;
+  free_prefix(alloc);
+  set_heap_prefix(heap, parent_size, new_prefix_len);
+}
+
+template <class T>
+template <class A>
+void node<T>::split_prefix(node<T> &parent, int prefix_len, A &alloc) {
+  int rest_len = prefix_len_ - prefix_len - 1, size = heap_prefix_size();
+  if (prefix_len <= max_inline_prefix_len ||
+      size - prefix_len > max_heap_prefix_slack) {
+    parent.set_prefix(prefix(), prefix_len, alloc);
+    set_prefix(prefix() + prefix_len + 1, rest_len, alloc);
+    return;
+  }
+  char *heap = heap_prefix();
+  if (rest_len <= max_inline_prefix_len) {
+    std::memcpy(prefix_, heap + prefix_len + 1, rest_len);
+    prefix_len_ = rest_len;
+  } else {
+    char *rest = static_cast<char *>(alloc.allocate(rest_len));
+    std::memcpy(rest, heap + prefix_len + 1, rest_len);
+    set_heap_prefix(rest, rest_len, rest_len);
+  }
+  parent.set_heap_prefix(heap, size, prefix_len);
+}
+
+template <class T> void node<T>::move_prefix(node<T> &other) {
+  std::memcpy(prefix_, other.prefix_, max_inline_prefix_len);
+  prefix_len_ = other.prefix_len_;
+  heap_prefix_slack_ = other.heap_prefix_slack_;
+  other.prefix_len_ = 0;
+}
+
+template <class T> template <class A> void node<T>::free_prefix(A &alloc) {
+  if (!is_prefix_inline()) {
+    alloc.deallocate(heap_prefix(), heap_prefix_size());
+  }
+  prefix_len_ = 0;
+}
+
+template <class T>
+template <class A, class B>
+void node<T>::relocate_prefix(A &alloc, B &new_alloc) {
+  if (is_prefix_inline()) {
+    return;
+  }
+  char *old_heap = heap_prefix();
+  char *heap = static_cast<char *>(new_alloc.allocate(prefix_len_));
+  std::memcpy(heap, old_heap, prefix_len_);
+  alloc.deallocate(old_heap, heap_prefix_size());
+  set_heap_prefix(heap, prefix_len_, prefix_len_);
+}
+
+/*
+ * Trees with a key extractor don't allocate leaf nodes. Their leaves are
+ * the value pointers themselves, stored in the parent's child slot with the
+ * lowest bit set. Node allocations are at least 8 byte aligned, so the bit
+ * is never set for a real node.
+ */
+
+/**
+ * Determines if the given child is a tagged value pointer.
+ */
+template <class T> bool is_tagged(const node<T> *n) {
+  return (reinterpret_cast<std::uintptr_t>(n) & 1) != 0;
+}
+
+/**
+ * Stores the given value pointer as a tagged leaf.
+ */
+template <class T> node<T> *tag_leaf(T *value) {
+  return reinterpret_cast<node<T> *>(reinterpret_cast<std::uintptr_t>(value) |
+                                     1);
+}
+
+/**
+ * Restores the value pointer of a tagged leaf.
+ */
+template <class T> T *untag_leaf(const node<T> *n) {
+  return reinterpret_cast<T *>(reinterpret_cast<std::uintptr_t>(n) &
+                               ~static_cast<std::uintptr_t>(1));
+}
+
+/**
+ * Determines if the given child is a leaf, either a tagged value pointer or
+ * a leaf_node<T> instance.
+ */
+template <class T> bool is_leaf(const node<T> *n) {
+  return is_tagged(n) || n->is_leaf();
 }
 
 } // namespace art
@@ -6,6 +6,7 @@
 #ifndef ART_NODE_16_HPP
 #define ART_NODE_16_HPP
 
+#include "allocator.hpp"
 #include "inner_node.hpp"
 #include <array>
 #include <cstdlib>
@@ -13,7 +14,16 @@
 #include <utility>
 
 #if defined(__i386__) || defined(__amd64__)
+#define ART_NODE_16_SSE2
 #include <emmintrin.h>
+#elif defined(__aarch64__) && defined(__ARM_NEON)
+#define ART_NODE_16_NEON
+#include <arm_neon.h>
+#endif
+
+/* children left when a node_16 shrinks, see inner_node::is_underfull */
+#ifndef ART_NODE_16_SHRINK_THRESHOLD
+#define ART_NODE_16_SHRINK_THRESHOLD 3
 #endif
 
 namespace art {
@@ -21,37 +31,124 @@ namespace art {
 template <class T> class node_4;
 template <class T> class node_48;
 
+/**
+ * Inner node with up to 16 children, whose partial keys are sorted.
+ *
+ * Layout: the header, the number of children and the keys fill the first
+ * bytes of the cache line the node is allocated at, so that finding a
+ * child's index reads one line, followed by the children.
+ */
 template <class T> class node_16 : public inner_node<T> {
 friend class node_4<T>;
 friend class node_48<T>;
 public:
-  node<T> **find_child(char partial_key) override;
-  void set_child(char partial_key, node<T> *child) override;
-  node<T> *del_child(char partial_key) override;
-  inner_node<T> *grow() override;
-  inner_node<T> *shrink() override;
-  bool is_full() const override;
-  bool is_underfull() const override;
+  node_16();
+
+  static const int shrink_threshold = ART_NODE_16_SHRINK_THRESHOLD;
+  static_assert(shrink_threshold >= 2 && shrink_threshold <= 4,
+                "a node_16 shrinks at 2 to 4 children");
+
+  node<T> **find_child(char partial_key);
+  void set_child(char partial_key, node<T> *child);
+  node<T> *del_child(char partial_key);
+  template <class A> inner_node<T> *grow(A &alloc);
+  template <class A> inner_node<T> *shrink(A &alloc);
+  bool is_full() const;
+  bool is_underfull() const;
 
-  char next_partial_key(char partial_key) const override;
+  char next_partial_key(char partial_key) const;
 
-  char prev_partial_key(char partial_key) const override;
+  char prev_partial_key(char partial_key) const;
 
-  int n_children() const override;
+  int n_children() const;
+
+  int n_slots() const;
+  int next_slot(int slot) const;
+  int prev_slot(int slot) const;
+  char slot_partial_key(int slot) const;
+  node<T> **slot_child(int slot);
 
 private:
+#if defined(ART_NODE_16_SSE2) || defined(ART_NODE_16_NEON)
+  /*
+   * Bit i of the returned masks is set if keys_[i] is equal to, less than or
+   * greater than the partial key, for the first n_children_ keys.
+   */
+  unsigned eq_mask(char partial_key) const;
+  unsigned lt_mask(char partial_key) const;
+  unsigned gt_mask(char partial_key) const;
+#endif
+
   uint8_t n_children_ = 0;
   char keys_[16];
   node<T> *children_[16];
 };
 
+/* inner nodes start at a cache line, see allocation_alignment */
+template <class T>
+struct allocation_alignment<node_16<T>>
+    : std::integral_constant<std::size_t, cache_line_size> {};
+
+template <class T>
+node_16<T>::node_16() : inner_node<T>(node_type::node_16) {
+  static_assert(sizeof(inner_node<T>) + sizeof(n_children_) +
+                        sizeof(keys_) <=
+                    cache_line_size,
+                "the header and keys of a node_16 fit in one cache line");
+  static_assert(sizeof(node_16<T>) <= 3 * cache_line_size,
+                "a node_16 spans at most three cache lines");
+}
+
+#if defined(ART_NODE_16_SSE2)
+template <class T> unsigned node_16<T>::eq_mask(char partial_key) const {
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(partial_key),
+                                          _mm_loadu_si128((__m128i *)keys_))) &
+         ((1u << n_children_) - 1);
+}
+
+template <class T> unsigned node_16<T>::lt_mask(char partial_key) const {
+  return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_set1_epi8(partial_key),
+                                          _mm_loadu_si128((__m128i *)keys_))) &
+         ((1u << n_children_) - 1);
+}
+
+template <class T> unsigned node_16<T>::gt_mask(char partial_key) const {
+  return _mm_movemask_epi8(_mm_cmpgt_epi8(_mm_loadu_si128((__m128i *)keys_),
+                                          _mm_set1_epi8(partial_key))) &
+         ((1u << n_children_) - 1);
+}
+#elif defined(ART_NODE_16_NEON)
+/* NEON has no movemask, weigh each lane with its bit and add them up */
+inline unsigned node_16_movemask(uint8x16_t cmp) {
+  static const uint8_t weights[16] = {1, 2, 4, 8, 16, 32, 64, 128,
+                                      1, 2, 4, 8, 16, 32, 64, 128};
+  uint8x16_t bits = vandq_u8(cmp, vld1q_u8(weights));
+  return vaddv_u8(vget_low_u8(bits)) | (vaddv_u8(vget_high_u8(bits)) << 8);
+}
+
+template <class T> unsigned node_16<T>::eq_mask(char partial_key) const {
+  int8x16_t keys = vld1q_s8(reinterpret_cast<const int8_t *>(keys_));
+  return node_16_movemask(vceqq_s8(keys, vdupq_n_s8(partial_key))) &
+         ((1u << n_children_) - 1);
+}
+
+template <class T> unsigned node_16<T>::lt_mask(char partial_key) const {
+  int8x16_t keys = vld1q_s8(reinterpret_cast<const int8_t *>(keys_));
+  return node_16_movemask(vcltq_s8(keys, vdupq_n_s8(partial_key))) &
+         ((1u << n_children_) - 1);
+}
+
+template <class T> unsigned node_16<T>::gt_mask(char partial_key) const {
+  int8x16_t keys = vld1q_s8(reinterpret_cast<const int8_t *>(keys_));
+  return node_16_movemask(vcgtq_s8(keys, vdupq_n_s8(partial_key))) &
+         ((1u << n_children_) - 1);
+}
+#endif
+
 template <class T> node<T> **node_16<T>::find_child(char partial_key) {
-#if defined(__i386__) || defined(__amd64__)
-  int bitfield =
-      _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(partial_key),
-                                       _mm_loadu_si128((__m128i *)keys_))) &
-      ((1 << n_children_) - 1);
-  return (bool)bitfield ? &children_[__builtin_ctz(bitfield)] : nullptr;
+#if defined(ART_NODE_16_SSE2) || defined(ART_NODE_16_NEON)
+  unsigned bitfield = eq_mask(partial_key);
+  return bitfield != 0 ? &children_[__builtin_ctz(bitfield)] : nullptr;
 #else
   int lo, mid, hi;
   lo = 0;
@@ -108,26 +205,32 @@ template <class T> node<T> *node_16<T>::del_child(char partial_key) {
   return child_to_delete;
 }
 
-template <class T> inner_node<T> *node_16<T>::grow() {
-  auto new_node = new node_48<T>();
-  new_node->prefix_ = this->prefix_;
-  new_node->prefix_len_ = this->prefix_len_;
+template <class T>
+template <class A>
+inner_node<T> *node_16<T>::grow(A &alloc) {
+  auto new_node = make<node_48<T>>(alloc);
+  new_node->move_prefix(*this);
+  new_node->copy_n_leaves(*this);
+  new_node->n_children_ = this->n_children_;
   std::copy(this->children_, this->children_ + this->n_children_, new_node->children_);
   for (int i = 0; i < n_children_; ++i) {
-    new_node->indexes_[(uint8_t) this->keys_[i]] = i;
+    new_node->indexes_[128 + this->keys_[i]] = i;
+    new_node->present_.set(128 + this->keys_[i]);
   }
-  delete this;
+  ::art::destroy(alloc, this);
   return new_node;
 }
 
-template <class T> inner_node<T> *node_16<T>::shrink() {
-  auto new_node = new node_4<T>();
-  new_node->prefix_ = this->prefix_;
-  new_node->prefix_len_ = this->prefix_len_;
+template <class T>
+template <class A>
+inner_node<T> *node_16<T>::shrink(A &alloc) {
+  auto new_node = make<node_4<T>>(alloc);
+  new_node->move_prefix(*this);
+  new_node->copy_n_leaves(*this);
   new_node->n_children_ = this->n_children_;
   std::copy(this->keys_, this->keys_ + this->n_children_, new_node->keys_);
   std::copy(this->children_, this->children_ + this->n_children_, new_node->children_);
-  delete this;
+  ::art::destroy(alloc, this);
   return new_node;
 }
 
@@ -136,29 +239,65 @@ template <class T> bool node_16<T>::is_full() const {
 }
 
 template <class T> bool node_16<T>::is_underfull() const {
-  return n_children_ == 4;
+  return n_children_ <= shrink_threshold;
 }
 
+template <class T> const int node_16<T>::shrink_threshold;
+
 template <class T> char node_16<T>::next_partial_key(char partial_key) const {
+#if defined(ART_NODE_16_SSE2) || defined(ART_NODE_16_NEON)
+  /* keys are sorted, the first key not less than the partial key */
+  unsigned bitfield = ~lt_mask(partial_key) & ((1u << n_children_) - 1);
+  if (bitfield != 0) {
+    return keys_[__builtin_ctz(bitfield)];
+  }
+#else
   for (int i = 0; i < n_children_; ++i) {
     if (keys_[i] >= partial_key) {
       return keys_[i];
     }
   }
+#endif
   throw std::out_of_range("provided partial key does not have a successor");
 }
 
 template <class T> char node_16<T>::prev_partial_key(char partial_key) const {
+#if defined(ART_NODE_16_SSE2) || defined(ART_NODE_16_NEON)
+  /* the last key not greater than the partial key */
+  unsigned bitfield = ~gt_mask(partial_key) & ((1u << n_children_) - 1);
+  if (bitfield != 0) {
+    return keys_[31 - __builtin_clz(bitfield)];
+  }
+#else
   for (int i = n_children_ - 1; i >= 0; --i) {
     if (keys_[i] <= partial_key) {
       return keys_[i];
     }
   }
+#endif
   throw std::out_of_range("provided partial key does not have a predecessor");
 }
 
 template <class T> int node_16<T>::n_children() const { return n_children_; }
 
+template <class T> int node_16<T>::n_slots() const { return n_children_; }
+
+template <class T> int node_16<T>::next_slot(int slot) const {
+  return slot + 1;
+}
+
+template <class T> int node_16<T>::prev_slot(int slot) const {
+  return slot - 1;
+}
+
+template <class T> char node_16<T>::slot_partial_key(int slot) const {
+  return keys_[slot];
+}
+
+template <class T> node<T> **node_16<T>::slot_child(int slot) {
+  return &children_[slot];
+}
+
 } // namespace art
 
 #endif
@@ -6,39 +6,79 @@
 #ifndef ART_NODE_256_HPP
 #define ART_NODE_256_HPP
 
+#include "allocator.hpp"
+#include "bitmap.hpp"
 #include "inner_node.hpp"
 #include <array>
 #include <stdexcept>
 
+/* children left when a node_256 shrinks, see inner_node::is_underfull */
+#ifndef ART_NODE_256_SHRINK_THRESHOLD
+#define ART_NODE_256_SHRINK_THRESHOLD 37
+#endif
+
 namespace art {
 
 template <class T> class node_48;
 
+/**
+ * Inner node with a child slot for every partial key.
+ *
+ * Layout: the header, the number of children and the presence bitmap share
+ * the cache line the node is allocated at, followed by the children.
+ */
 template <class T> class node_256 : public inner_node<T> {
 friend class node_48<T>;
 public:
   node_256();
 
-  node<T> **find_child(char partial_key) override;
-  void set_child(char partial_key, node<T> *child) override;
-  node<T> *del_child(char partial_key) override;
-  inner_node<T> *grow() override;
-  inner_node<T> *shrink() override;
-  bool is_full() const override;
-  bool is_underfull() const override;
+  static const int shrink_threshold = ART_NODE_256_SHRINK_THRESHOLD;
+  static_assert(shrink_threshold >= 2 && shrink_threshold <= 48,
+                "a node_256 shrinks at 2 to 48 children");
 
-  char next_partial_key(char partial_key) const override;
+  node<T> **find_child(char partial_key);
+  void set_child(char partial_key, node<T> *child);
+  node<T> *del_child(char partial_key);
+  template <class A> inner_node<T> *grow(A &alloc);
+  template <class A> inner_node<T> *shrink(A &alloc);
+  bool is_full() const;
+  bool is_underfull() const;
 
-  char prev_partial_key(char partial_key) const override;
+  char next_partial_key(char partial_key) const;
 
-  int n_children() const override;
+  char prev_partial_key(char partial_key) const;
+
+  int n_children() const;
+
+  int n_slots() const;
+  int next_slot(int slot) const;
+  int prev_slot(int slot) const;
+  char slot_partial_key(int slot) const;
+  node<T> **slot_child(int slot);
 
 private:
   uint16_t n_children_ = 0;
+  bitmap present_;
   std::array<node<T> *, 256> children_;
 };
 
-template <class T> node_256<T>::node_256() { children_.fill(nullptr); }
+/* inner nodes start at a cache line, see allocation_alignment */
+template <class T>
+struct allocation_alignment<node_256<T>>
+    : std::integral_constant<std::size_t, cache_line_size> {};
+
+template <class T>
+node_256<T>::node_256() : inner_node<T>(node_type::node_256) {
+  static_assert(sizeof(inner_node<T>) + alignof(bitmap) +
+                        sizeof(bitmap) <=
+                    cache_line_size,
+                "the header and bitmap of a node_256 fit in one cache line");
+  static_assert(sizeof(node_256<T>) == sizeof(inner_node<T>) +
+                                           alignof(bitmap) + sizeof(bitmap) +
+                                           sizeof(children_),
+                "a node_256 has no padding before its children");
+  children_.fill(nullptr);
+}
 
 template <class T> node<T> **node_256<T>::find_child(char partial_key) {
   return children_[128 + partial_key] != nullptr ? &children_[128 + partial_key]
@@ -48,32 +88,38 @@ template <class T> node<T> **node_256<T>::find_child(char partial_key) {
 template <class T>
 void node_256<T>::set_child(char partial_key, node<T> *child) {
   children_[128 + partial_key] = child;
+  present_.set(128 + partial_key);
   ++n_children_;
 }
 
 template <class T> node<T> *node_256<T>::del_child(char partial_key) {
   node<T> *child_to_delete = children_[128 + partial_key];
-  if (child_to_delete != nullptr) {
+  if (present_.test(128 + partial_key)) {
     children_[128 + partial_key] = nullptr;
+    present_.reset(128 + partial_key);
     --n_children_;
   }
   return child_to_delete;
 }
 
-template <class T> inner_node<T> *node_256<T>::grow() {
+template <class T>
+template <class A>
+inner_node<T> *node_256<T>::grow(A & /* alloc */) {
   throw std::runtime_error("node_256 cannot grow");
 }
 
-template <class T> inner_node<T> *node_256<T>::shrink() {
-  auto new_node = new node_48<T>();
-  new_node->prefix_ = this->prefix_;
-  new_node->prefix_len_ = this->prefix_len_;
-  for (int partial_key = 0; partial_key < 256; ++partial_key) {
+template <class T>
+template <class A>
+inner_node<T> *node_256<T>::shrink(A &alloc) {
+  auto new_node = make<node_48<T>>(alloc);
+  new_node->move_prefix(*this);
+  new_node->copy_n_leaves(*this);
+  for (int partial_key = -128; partial_key < 128; ++partial_key) {
     if (children_[128 + partial_key] != nullptr) {
       new_node->set_child(partial_key, children_[128 + partial_key]);
     }
   }
-  delete this;
+  ::art::destroy(alloc, this);
   return new_node;
 }
 
@@ -82,36 +128,49 @@ template <class T> bool node_256<T>::is_full() const {
 }
 
 template <class T> bool node_256<T>::is_underfull() const {
-  return n_children_ == 48;
+  return n_children_ <= shrink_threshold;
 }
 
+template <class T> const int node_256<T>::shrink_threshold;
+
 template <class T> char node_256<T>::next_partial_key(char partial_key) const {
-  while (true) {
-    if (children_[128 + partial_key] != nullptr) {
-      return partial_key;
-    }
-    if (partial_key == 127) {
-      throw std::out_of_range("provided partial key does not have a successor");
-    }
-    ++partial_key;
+  int i = present_.next(128 + partial_key);
+  if (i < 0) {
+    throw std::out_of_range("provided partial key does not have a successor");
   }
+  return i - 128;
 }
 
 template <class T> char node_256<T>::prev_partial_key(char partial_key) const {
-  while (true) {
-    if (children_[128 + partial_key] != nullptr) {
-      return partial_key;
-    }
-    if (partial_key == -128) {
-      throw std::out_of_range(
-          "provided partial key does not have a predecessor");
-    }
-    --partial_key;
+  int i = present_.prev(128 + partial_key);
+  if (i < 0) {
+    throw std::out_of_range(
+        "provided partial key does not have a predecessor");
   }
+  return i - 128;
 }
 
 template <class T> int node_256<T>::n_children() const { return n_children_; }
 
+template <class T> int node_256<T>::n_slots() const { return 256; }
+
+template <class T> int node_256<T>::next_slot(int slot) const {
+  int next = slot < 255 ? present_.next(slot + 1) : -1;
+  return next >= 0 ? next : 256;
+}
+
+template <class T> int node_256<T>::prev_slot(int slot) const {
+  return slot > 0 ? present_.prev(slot - 1) : -1;
+}
+
+template <class T> char node_256<T>::slot_partial_key(int slot) const {
+  return slot - 128;
+}
+
+template <class T> node<T> **node_256<T>::slot_child(int slot) {
+  return &children_[slot];
+}
+
 } // namespace art
 
 #endif
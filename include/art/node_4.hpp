@@ -6,6 +6,7 @@
 #ifndef ART_NODE_4_HPP
 #define ART_NODE_4_HPP
 
+#include "allocator.hpp"
 #include "inner_node.hpp"
 #include <algorithm>
 #include <array>
@@ -18,24 +19,38 @@ namespace art {
 template <class T> class node_0;
 template <class T> class node_16;
 
+/**
+ * Inner node with up to 4 children, whose partial keys are sorted.
+ *
+ * Layout: the header, the number of children, the keys and the children,
+ * which together fit in the cache line the node is allocated at.
+ */
 template <class T> class node_4 : public inner_node<T> {
   friend class node_0<T>;
   friend class node_16<T>;
 
 public:
-  node<T> **find_child(char partial_key) override;
-  void set_child(char partial_key, node<T> *child) override;
-  node<T> *del_child(char partial_key) override;
-  inner_node<T> *grow() override;
-  inner_node<T> *shrink() override;
-  bool is_full() const override;
-  bool is_underfull() const override;
+  node_4();
+
+  node<T> **find_child(char partial_key);
+  void set_child(char partial_key, node<T> *child);
+  node<T> *del_child(char partial_key);
+  template <class A> inner_node<T> *grow(A &alloc);
+  template <class A> inner_node<T> *shrink(A &alloc);
+  bool is_full() const;
+  bool is_underfull() const;
+
+  char next_partial_key(char partial_key) const;
 
-  char next_partial_key(char partial_key) const override;
+  char prev_partial_key(char partial_key) const;
 
-  char prev_partial_key(char partial_key) const override;
+  int n_children() const;
 
-  int n_children() const override;
+  int n_slots() const;
+  int next_slot(int slot) const;
+  int prev_slot(int slot) const;
+  char slot_partial_key(int slot) const;
+  node<T> **slot_child(int slot);
 
 private:
   uint8_t n_children_ = 0;
@@ -43,6 +58,16 @@ private:
   node<T> *children_[4];
 };
 
+/* inner nodes start at a cache line, see allocation_alignment */
+template <class T>
+struct allocation_alignment<node_4<T>>
+    : std::integral_constant<std::size_t, cache_line_size> {};
+
+template <class T> node_4<T>::node_4() : inner_node<T>(node_type::node_4) {
+  static_assert(sizeof(node_4<T>) <= cache_line_size,
+                "a node_4 fits in one cache line");
+}
+
 template <class T> node<T> **node_4<T>::find_child(char partial_key) {
   for (int i = 0; i < n_children_; ++i) {
     if (keys_[i] == partial_key) {
@@ -84,18 +109,22 @@ template <class T> node<T> *node_4<T>::del_child(char partial_key) {
   return child_to_delete;
 }
 
-template <class T> inner_node<T> *node_4<T>::grow() {
-  auto new_node = new node_16<T>();
-  new_node->prefix_ = this->prefix_;
-  new_node->prefix_len_ = this->prefix_len_;
+template <class T>
+template <class A>
+inner_node<T> *node_4<T>::grow(A &alloc) {
+  auto new_node = make<node_16<T>>(alloc);
+  new_node->move_prefix(*this);
+  new_node->copy_n_leaves(*this);
   new_node->n_children_ = this->n_children_;
   std::copy(this->keys_, this->keys_ + this->n_children_, new_node->keys_);
   std::copy(this->children_, this->children_ + this->n_children_, new_node->children_);
-  delete this;
+  ::art::destroy(alloc, this);
   return new_node;
 }
 
-template <class T> inner_node<T> *node_4<T>::shrink() {
+template <class T>
+template <class A>
+inner_node<T> *node_4<T>::shrink(A & /* alloc */) {
   throw std::runtime_error("node_4 cannot shrink");
 }
 
@@ -129,6 +158,24 @@ template <class T> int node_4<T>::n_children() const {
   return this->n_children_;
 }
 
+template <class T> int node_4<T>::n_slots() const { return n_children_; }
+
+template <class T> int node_4<T>::next_slot(int slot) const {
+  return slot + 1;
+}
+
+template <class T> int node_4<T>::prev_slot(int slot) const {
+  return slot - 1;
+}
+
+template <class T> char node_4<T>::slot_partial_key(int slot) const {
+  return keys_[slot];
+}
+
+template <class T> node<T> **node_4<T>::slot_child(int slot) {
+  return &children_[slot];
+}
+
 } // namespace art
 
 #endif
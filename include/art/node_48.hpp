@@ -6,17 +6,34 @@
 #ifndef ART_NODE_48_HPP
 #define ART_NODE_48_HPP
 
+#include "allocator.hpp"
+#include "bitmap.hpp"
 #include "inner_node.hpp"
 #include <algorithm>
 #include <array>
 #include <stdexcept>
 #include <utility>
 
+/* children left when a node_48 shrinks, see inner_node::is_underfull */
+#ifndef ART_NODE_48_SHRINK_THRESHOLD
+#define ART_NODE_48_SHRINK_THRESHOLD 12
+#endif
+
 namespace art {
 
 template <class T> class node_16;
 template <class T> class node_256;
 
+/**
+ * Inner node with up to 48 children, found through the index of their
+ * partial key.
+ *
+ * Layout: the header, the number of children and the presence bitmap,
+ * which is read when iterating, share the cache line the node is allocated
+ * at. They are followed by the indexes and the children, so that finding a
+ * child reads one line of indexes and one line of children besides the
+ * header's.
+ */
 template <class T> class node_48 : public inner_node<T> {
   friend class node_16<T>;
   friend class node_256<T>;
@@ -24,28 +41,53 @@ template <class T> class node_48 : public inner_node<T> {
 public:
   node_48();
 
-  node<T> **find_child(char partial_key) override;
-  void set_child(char partial_key, node<T> *child) override;
-  node<T> *del_child(char partial_key) override;
-  inner_node<T> *grow() override;
-  inner_node<T> *shrink() override;
-  bool is_full() const override;
-  bool is_underfull() const override;
+  static const int shrink_threshold = ART_NODE_48_SHRINK_THRESHOLD;
+  static_assert(shrink_threshold >= 2 && shrink_threshold <= 16,
+                "a node_48 shrinks at 2 to 16 children");
 
-  char next_partial_key(char partial_key) const override;
-  char prev_partial_key(char partial_key) const override;
+  node<T> **find_child(char partial_key);
+  void set_child(char partial_key, node<T> *child);
+  node<T> *del_child(char partial_key);
+  template <class A> inner_node<T> *grow(A &alloc);
+  template <class A> inner_node<T> *shrink(A &alloc);
+  bool is_full() const;
+  bool is_underfull() const;
 
-  int n_children() const override;
+  char next_partial_key(char partial_key) const;
+  char prev_partial_key(char partial_key) const;
+
+  int n_children() const;
+
+  int n_slots() const;
+  int next_slot(int slot) const;
+  int prev_slot(int slot) const;
+  char slot_partial_key(int slot) const;
+  node<T> **slot_child(int slot);
 
 private:
   static const char EMPTY;
 
   uint8_t n_children_ = 0;
+  bitmap present_;
   char indexes_[256];
   node<T> *children_[48];
 };
 
-template <class T> node_48<T>::node_48() {
+/* inner nodes start at a cache line, see allocation_alignment */
+template <class T>
+struct allocation_alignment<node_48<T>>
+    : std::integral_constant<std::size_t, cache_line_size> {};
+
+template <class T>
+node_48<T>::node_48() : inner_node<T>(node_type::node_48) {
+  static_assert(sizeof(inner_node<T>) + alignof(bitmap) +
+                        sizeof(bitmap) <=
+                    cache_line_size,
+                "the header and bitmap of a node_48 fit in one cache line");
+  static_assert(sizeof(node_48<T>) == sizeof(inner_node<T>) +
+                                          alignof(bitmap) + sizeof(bitmap) +
+                                          sizeof(indexes_) + sizeof(children_),
+                "a node_48 has no padding between its indexes and children");
   std::fill(this->indexes_, this->indexes_ + 256, node_48::EMPTY);
   std::fill(this->children_, this->children_ + 48, nullptr);
 }
@@ -67,6 +109,7 @@ void node_48<T>::set_child(char partial_key, node<T> *child) {
   for (int i = 0; i < 48; ++i) {
     if (children_[i] == nullptr) {
       indexes_[128 + partial_key] = (uint8_t) i;
+      present_.set(128 + partial_key);
       children_[i] = child;
       break;
     }
@@ -80,39 +123,44 @@ template <class T> node<T> *node_48<T>::del_child(char partial_key) {
   if (index != node_48::EMPTY) {
     child_to_delete = children_[index];
     indexes_[128 + partial_key] = node_48::EMPTY;
+    present_.reset(128 + partial_key);
     children_[index] = nullptr;
     --n_children_;
   }
   return child_to_delete;
 }
 
-template <class T> inner_node<T> *node_48<T>::grow() {
-  auto new_node = new node_256<T>();
-  new_node->prefix_ = this->prefix_;
-  new_node->prefix_len_ = this->prefix_len_;
+template <class T>
+template <class A>
+inner_node<T> *node_48<T>::grow(A &alloc) {
+  auto new_node = make<node_256<T>>(alloc);
+  new_node->move_prefix(*this);
+  new_node->copy_n_leaves(*this);
   uint8_t index;
-  for (int partial_key = -128; partial_key < 127; ++partial_key) {
+  for (int partial_key = -128; partial_key < 128; ++partial_key) {
     index = indexes_[128 + partial_key];
     if (index != node_48::EMPTY) {
       new_node->set_child(partial_key, children_[index]);
     }
   }
-  delete this;
+  ::art::destroy(alloc, this);
   return new_node;
 }
 
-template <class T> inner_node<T> *node_48<T>::shrink() {
-  auto new_node = new node_16<T>();
-  new_node->prefix_ = this->prefix_;
-  new_node->prefix_len_ = this->prefix_len_;
+template <class T>
+template <class A>
+inner_node<T> *node_48<T>::shrink(A &alloc) {
+  auto new_node = make<node_16<T>>(alloc);
+  new_node->move_prefix(*this);
+  new_node->copy_n_leaves(*this);
   uint8_t index;
-  for (int partial_key = -128; partial_key < 127; ++partial_key) {
+  for (int partial_key = -128; partial_key < 128; ++partial_key) {
     index = indexes_[128 + partial_key];
     if (index != node_48::EMPTY) {
       new_node->set_child(partial_key, children_[index]);
     }
   }
-  delete this;
+  ::art::destroy(alloc, this);
   return new_node;
 }
 
@@ -121,38 +169,51 @@ template <class T> bool node_48<T>::is_full() const {
 }
 
 template <class T> bool node_48<T>::is_underfull() const {
-  return n_children_ == 16;
+  return n_children_ <= shrink_threshold;
 }
 
+template <class T> const int node_48<T>::shrink_threshold;
+
 template <class T> const char node_48<T>::EMPTY = 48;
 
 template <class T> char node_48<T>::next_partial_key(char partial_key) const {
-  while (true) {
-    if (indexes_[128 + partial_key] != node_48<T>::EMPTY) {
-      return partial_key;
-    }
-    if (partial_key == 127) {
-      throw std::out_of_range("provided partial key does not have a successor");
-    }
-    ++partial_key;
+  int i = present_.next(128 + partial_key);
+  if (i < 0) {
+    throw std::out_of_range("provided partial key does not have a successor");
   }
+  return i - 128;
 }
 
 template <class T> char node_48<T>::prev_partial_key(char partial_key) const {
-  while (true) {
-    if (indexes_[128 + partial_key] != node_48<T>::EMPTY) {
-      return partial_key;
-    }
-    if (partial_key == -128) {
-      throw std::out_of_range(
-          "provided partial key does not have a predecessor");
-    }
-    --partial_key;
+  int i = present_.prev(128 + partial_key);
+  if (i < 0) {
+    throw std::out_of_range(
+        "provided partial key does not have a predecessor");
   }
+  return i - 128;
 }
 
 template <class T> int node_48<T>::n_children() const { return n_children_; }
 
+template <class T> int node_48<T>::n_slots() const { return 256; }
+
+template <class T> int node_48<T>::next_slot(int slot) const {
+  int next = slot < 255 ? present_.next(slot + 1) : -1;
+  return next >= 0 ? next : 256;
+}
+
+template <class T> int node_48<T>::prev_slot(int slot) const {
+  return slot > 0 ? present_.prev(slot - 1) : -1;
+}
+
+template <class T> char node_48<T>::slot_partial_key(int slot) const {
+  return slot - 128;
+}
+
+template <class T> node<T> **node_48<T>::slot_child(int slot) {
+  return &children_[static_cast<uint8_t>(indexes_[slot])];
+}
+
 } // namespace art
 
 #endif
@@ -0,0 +1,624 @@
+/**
+ * @file concurrent adaptive radix tree with optimistic lock coupling
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_OLC_ART_HPP
+#define ART_OLC_ART_HPP
+
+#include "allocator.hpp"
+#include "boxed_leaves.hpp"
+#include "epoch_allocator.hpp"
+#include "inner_node.hpp"
+#include "leaf_node.hpp"
+#include "node.hpp"
+#include "node_4.hpp"
+#include "optimistic_lock.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <stack>
+#include <stdexcept>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace art {
+
+/**
+ * Adaptive radix tree that may be used by many threads at once, using
+ * optimistic lock coupling (Leis et al., The ART of Practical
+ * Synchronization).
+ *
+ * Every inner node carries an optimistic_lock in its header, the root slot
+ * has a lock of its own. Leaves are protected by the lock of their parent.
+ * Lookups don't acquire any lock: they validate the version of each node
+ * after reading it and before following a child, and restart from the root
+ * if a writer interfered. Writers traverse the same way and only lock the
+ * nodes they modify, i.e. the node receiving a child, the parent and node
+ * of a prefix split or a grow, and the grandparent and parent of a delete,
+ * which also locks the merged sibling. Locks are acquired top-down, so
+ * writers can't deadlock.
+ *
+ * A reader may still be reading a node that a writer replaced or released,
+ * so nodes, prefixes and leaves are deallocated through an epoch_allocator
+ * and only handed back to A once no operation can reach them anymore. Every
+ * operation runs inside an epoch guard.
+ *
+ * Keys follow the rules of art, values are stored in boxed leaves and are
+ * owned by the caller. Iteration isn't supported.
+ *
+ * @tparam T - The type of the values, which are stored by pointer.
+ * @tparam A - The allocator used for nodes and prefixes, which must be
+ * thread-safe.
+ */
+template <class T, class A = heap_allocator> class olc_art {
+public:
+  olc_art(std::function<void(T *)> free_fn = nullptr) : free_(free_fn) {}
+  olc_art(const olc_art<T, A> &other) = delete;
+  olc_art<T, A> &operator=(const olc_art<T, A> &other) = delete;
+  ~olc_art();
+
+  /**
+   * Finds the value associated with the given key.
+   *
+   * @return the value associated with the key or a nullptr.
+   */
+  T *get(const char *key) const;
+  T *get(const char *key, std::size_t key_len) const;
+
+  /**
+   * Associates the given key with the given value.
+   *
+   * @return a nullptr if no other value is associated with the key or the
+   * previously associated value.
+   * @throws std::invalid_argument if the key is a proper prefix of a key in
+   * the tree or the other way around, the tree is left unchanged.
+   */
+  T *set(const char *key, T *value);
+  T *set(const char *key, std::size_t key_len, T *value);
+
+  /**
+   * Deletes the given key and returns it's associated value.
+   *
+   * @return the value associated with the key or a nullptr otherwise.
+   */
+  T *del(const char *key);
+  T *del(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  T *get(std::string_view key) const;
+  T *set(std::string_view key, T *value);
+  T *del(std::string_view key);
+#endif
+
+  /**
+   * Number of deallocated nodes, prefixes and leaves that some operation
+   * may still be reading and are therefore not yet released.
+   */
+  std::size_t n_retired() const;
+
+private:
+  /*
+   * Single attempts of get, set and del. They set need_restart if a
+   * concurrent writer interfered, in which case nothing was modified.
+   */
+  T *try_get(const char *key, int key_len, bool &need_restart) const;
+  T *try_set(const char *key, int key_len, T *value, bool &need_restart);
+  T *try_del(const char *key, int key_len, bool &need_restart);
+
+  void destroy_node(node<T> *n);
+
+  node<T> *root_ = nullptr;
+  optimistic_lock root_lock_;
+  std::function<void(T *)> free_;
+  mutable epoch_allocator<A> alloc_;
+  boxed_leaves<T> leaves_;
+};
+
+template <class T, class A> olc_art<T, A>::~olc_art() {
+  if (root_ == nullptr) {
+    return;
+  }
+  std::stack<node<T> *> node_stack;
+  node_stack.push(root_);
+  node<T> *cur;
+  inner_node<T> *cur_inner;
+  while (!node_stack.empty()) {
+    cur = node_stack.top();
+    node_stack.pop();
+    if (!is_leaf(cur)) {
+      cur_inner = static_cast<inner_node<T> *>(cur);
+      for (int slot = cur_inner->next_slot(-1), n_slots = cur_inner->n_slots();
+           slot < n_slots; slot = cur_inner->next_slot(slot)) {
+        node_stack.push(*cur_inner->slot_child(slot));
+      }
+    } else if (free_) {
+      free_(leaf_value(cur));
+    }
+    destroy_node(cur);
+  }
+}
+
+template <class T, class A> void olc_art<T, A>::destroy_node(node<T> *n) {
+  if (is_leaf(n)) {
+    leaves_.destroy(n, alloc_);
+  } else {
+    n->free_prefix(alloc_);
+    static_cast<inner_node<T> *>(n)->destroy(alloc_);
+  }
+}
+
+template <class T, class A> T *olc_art<T, A>::get(const char *key) const {
+  return get(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+T *olc_art<T, A>::get(const char *key, std::size_t key_len) const {
+  typename epoch_allocator<A>::guard guard(alloc_);
+  bool need_restart;
+  T *value;
+  do {
+    need_restart = false;
+    value = try_get(key, key_len, need_restart);
+  } while (need_restart);
+  return value;
+}
+
+template <class T, class A>
+T *olc_art<T, A>::set(const char *key, T *value) {
+  return set(key, std::strlen(key) + 1, value);
+}
+
+template <class T, class A>
+T *olc_art<T, A>::set(const char *key, std::size_t key_len, T *value) {
+  typename epoch_allocator<A>::guard guard(alloc_);
+  bool need_restart;
+  T *old_value;
+  do {
+    need_restart = false;
+    old_value = try_set(key, key_len, value, need_restart);
+  } while (need_restart);
+  return old_value;
+}
+
+template <class T, class A> T *olc_art<T, A>::del(const char *key) {
+  return del(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+T *olc_art<T, A>::del(const char *key, std::size_t key_len) {
+  typename epoch_allocator<A>::guard guard(alloc_);
+  bool need_restart;
+  T *value;
+  do {
+    need_restart = false;
+    value = try_del(key, key_len, need_restart);
+  } while (need_restart);
+  return value;
+}
+
+template <class T, class A>
+T *olc_art<T, A>::try_get(const char *key, int key_len,
+                          bool &need_restart) const {
+  const optimistic_lock *par_lock = &root_lock_;
+  uint32_t par_version = root_lock_.read_lock(need_restart), version;
+  if (need_restart) {
+    return nullptr;
+  }
+  node<T> *cur = root_, **child;
+  root_lock_.check(par_version, need_restart);
+  if (need_restart) {
+    return nullptr;
+  }
+
+  const char *prefix;
+  int depth = 0, prefix_len;
+  bool is_match;
+  T *value;
+
+  /* cur is always validated before it is dereferenced */
+  while (true) {
+    if (cur == nullptr) {
+      return nullptr;
+    }
+    if (is_leaf(cur)) {
+      prefix = leaves_.key(cur, depth, prefix_len);
+      value = leaf_value(cur);
+      par_lock->check(par_version, need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      is_match = prefix_len == key_len - depth &&
+                 std::memcmp(prefix, key + depth, prefix_len) == 0;
+      par_lock->check(par_version, need_restart);
+      return is_match ? value : nullptr;
+    }
+
+    version = cur->lock_.read_lock(need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+    /* cur was still the child when its version was read */
+    par_lock->check(par_version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+
+    prefix = cur->prefix();
+    prefix_len = cur->prefix_len_;
+    cur->lock_.check(version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+    if (prefix_len >= key_len - depth ||
+        std::memcmp(prefix, key + depth, prefix_len) != 0) {
+      /* prefix mismatch or the key ends in an inner node */
+      cur->lock_.check(version, need_restart);
+      return nullptr;
+    }
+
+    depth += prefix_len;
+    child = static_cast<inner_node<T> *>(cur)->find_child(key[depth]);
+    node<T> *next = child != nullptr ? *child : nullptr;
+    cur->lock_.check(version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+
+    ++depth;
+    par_lock = &cur->lock_;
+    par_version = version;
+    cur = next;
+  }
+}
+
+template <class T, class A>
+T *olc_art<T, A>::try_set(const char *key, int key_len, T *value,
+                          bool &need_restart) {
+  optimistic_lock *par_lock = &root_lock_, *cur_lock;
+  uint32_t par_version = root_lock_.read_lock(need_restart), version = 0,
+           cur_version = 0;
+  if (need_restart) {
+    return nullptr;
+  }
+  node<T> **slot = &root_, *cur = root_, **child;
+  root_lock_.check(par_version, need_restart);
+  if (need_restart) {
+    return nullptr;
+  }
+
+  inner_node<T> *cur_inner;
+  const char *prefix;
+  int depth = 0, prefix_len, match_len;
+  bool is_leaf_node;
+  char partial_key;
+
+  while (true) {
+    if (cur == nullptr) {
+      /* empty tree */
+      par_lock->upgrade_to_write_lock(par_version, need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      *slot = leaves_.make(key, key_len, value, alloc_);
+      par_lock->write_unlock();
+      return nullptr;
+    }
+
+    is_leaf_node = is_leaf(cur);
+    if (is_leaf_node) {
+      /* leaves are protected by their parent's lock */
+      cur_lock = par_lock;
+      cur_version = par_version;
+      prefix = leaves_.key(cur, depth, prefix_len);
+    } else {
+      version = cur->lock_.read_lock(need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      par_lock->check(par_version, need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      cur_lock = &cur->lock_;
+      cur_version = version;
+      prefix = cur->prefix();
+      prefix_len = cur->prefix_len_;
+    }
+    cur_lock->check(cur_version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+
+    /* number of bytes of the current node's prefix that match the key */
+    match_len = 0;
+    while (match_len < prefix_len && match_len < key_len - depth &&
+           prefix[match_len] == key[depth + match_len]) {
+      ++match_len;
+    }
+    cur_lock->check(cur_version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+
+    if (is_leaf_node && match_len == prefix_len &&
+        prefix_len == key_len - depth) {
+      /* exact match, replace the value */
+      par_lock->upgrade_to_write_lock(par_version, need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      T *old_value = leaf_value(cur);
+      leaves_.set_value(*slot, value);
+      par_lock->write_unlock();
+      return old_value;
+    }
+
+    if (match_len == std::min(prefix_len, key_len - depth) &&
+        (is_leaf_node || prefix_len >= key_len - depth)) {
+      /* one of the keys is a proper prefix of the other */
+      throw std::invalid_argument("keys must be prefix-free");
+    }
+
+    if (match_len < prefix_len) {
+      /* prefix mismatch, the new parent replaces cur in its slot */
+      par_lock->upgrade_to_write_lock(par_version, need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      if (!is_leaf_node) {
+        cur->lock_.upgrade_to_write_lock(version, need_restart);
+        if (need_restart) {
+          par_lock->write_unlock();
+          return nullptr;
+        }
+      }
+
+      auto new_parent = make<node_4<T>>(alloc_);
+      new_parent->set_prefix(key + depth, match_len, alloc_);
+      new_parent->set_child(prefix[match_len], cur);
+      if (is_leaf_node) {
+        leaves_.trim(cur, match_len + 1, alloc_);
+      } else {
+        cur->set_prefix(prefix + match_len + 1, prefix_len - match_len - 1,
+                        alloc_);
+      }
+      auto new_node = leaves_.make(key + depth + match_len + 1,
+                                   key_len - depth - match_len - 1, value,
+                                   alloc_);
+      new_parent->set_child(key[depth + match_len], new_node);
+      *slot = new_parent;
+
+      if (!is_leaf_node) {
+        cur->lock_.write_unlock();
+      }
+      par_lock->write_unlock();
+      return nullptr;
+    }
+
+    cur_inner = static_cast<inner_node<T> *>(cur);
+    depth += prefix_len;
+    partial_key = key[depth];
+    child = cur_inner->find_child(partial_key);
+    node<T> *next = child != nullptr ? *child : nullptr;
+    cur->lock_.check(version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+
+    if (next == nullptr) {
+      /* no child associated with the next partial key */
+      if (cur_inner->is_full()) {
+        /* the grown node replaces cur in its slot */
+        par_lock->upgrade_to_write_lock(par_version, need_restart);
+        if (need_restart) {
+          return nullptr;
+        }
+        cur->lock_.upgrade_to_write_lock(version, need_restart);
+        if (need_restart) {
+          par_lock->write_unlock();
+          return nullptr;
+        }
+        /* readers of cur restart from now on */
+        cur->lock_.write_unlock_obsolete();
+        auto new_node = cur_inner->grow(alloc_);
+        new_node->set_child(partial_key,
+                            leaves_.make(key + depth + 1, key_len - depth - 1,
+                                         value, alloc_));
+        *slot = new_node;
+        par_lock->write_unlock();
+        return nullptr;
+      }
+
+      cur->lock_.upgrade_to_write_lock(version, need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      cur_inner->set_child(partial_key,
+                           leaves_.make(key + depth + 1, key_len - depth - 1,
+                                        value, alloc_));
+      cur->lock_.write_unlock();
+      return nullptr;
+    }
+
+    ++depth;
+    par_lock = &cur->lock_;
+    par_version = version;
+    slot = child;
+    cur = next;
+  }
+}
+
+template <class T, class A>
+T *olc_art<T, A>::try_del(const char *key, int key_len, bool &need_restart) {
+  optimistic_lock *gpar_lock = nullptr, *par_lock = &root_lock_;
+  uint32_t gpar_version = 0, version,
+           par_version = root_lock_.read_lock(need_restart);
+  if (need_restart) {
+    return nullptr;
+  }
+  node<T> **par_slot = nullptr, **slot = &root_, *cur = root_, **child;
+  root_lock_.check(par_version, need_restart);
+  if (need_restart) {
+    return nullptr;
+  }
+
+  inner_node<T> *par = nullptr;
+  const char *prefix;
+  int depth = 0, prefix_len;
+  char cur_partial_key = 0;
+  bool is_match;
+
+  while (true) {
+    if (cur == nullptr) {
+      return nullptr;
+    }
+
+    if (is_leaf(cur)) {
+      prefix = leaves_.key(cur, depth, prefix_len);
+      T *value = leaf_value(cur);
+      par_lock->check(par_version, need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      is_match = prefix_len == key_len - depth &&
+                 std::memcmp(prefix, key + depth, prefix_len) == 0;
+      par_lock->check(par_version, need_restart);
+      if (need_restart || !is_match) {
+        return nullptr;
+      }
+
+      if (par == nullptr) {
+        /* the leaf is the root */
+        root_lock_.upgrade_to_write_lock(par_version, need_restart);
+        if (need_restart) {
+          return nullptr;
+        }
+        root_ = nullptr;
+        root_lock_.write_unlock();
+        destroy_node(cur);
+        return value;
+      }
+
+      /* the parent may be replaced in the grandparent's slot */
+      gpar_lock->upgrade_to_write_lock(gpar_version, need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      par->lock_.upgrade_to_write_lock(par_version, need_restart);
+      if (need_restart) {
+        gpar_lock->write_unlock();
+        return nullptr;
+      }
+
+      if (par->n_children() == 2) {
+        /* replace the parent with the sibling */
+        auto sibling_partial_key = par->next_partial_key(-128);
+        if (sibling_partial_key == cur_partial_key) {
+          sibling_partial_key = par->next_partial_key(cur_partial_key + 1);
+        }
+        auto sibling = *par->find_child(sibling_partial_key);
+
+        if (is_leaf(sibling)) {
+          leaves_.prepend(sibling, par->prefix(), par->prefix_len_,
+                          sibling_partial_key, alloc_);
+        } else {
+          /* readers inside the sibling must notice the new prefix */
+          sibling->lock_.write_lock(need_restart);
+          if (need_restart) {
+            par->lock_.write_unlock();
+            gpar_lock->write_unlock();
+            return nullptr;
+          }
+          sibling->prepend_prefix(par->prefix(), par->prefix_len_,
+                                  sibling_partial_key, alloc_);
+          sibling->lock_.write_unlock();
+        }
+        *par_slot = sibling;
+        par->lock_.write_unlock_obsolete();
+        gpar_lock->write_unlock();
+        destroy_node(cur);
+        destroy_node(par);
+      } else {
+        par->del_child(cur_partial_key);
+        if (par->is_underfull()) {
+          par->lock_.write_unlock_obsolete();
+          *par_slot = par->shrink(alloc_);
+        } else {
+          par->lock_.write_unlock();
+        }
+        gpar_lock->write_unlock();
+        destroy_node(cur);
+      }
+      return value;
+    }
+
+    version = cur->lock_.read_lock(need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+    par_lock->check(par_version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+
+    prefix = cur->prefix();
+    prefix_len = cur->prefix_len_;
+    cur->lock_.check(version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+    if (prefix_len >= key_len - depth ||
+        std::memcmp(prefix, key + depth, prefix_len) != 0) {
+      /* prefix mismatch or the key ends in an inner node */
+      cur->lock_.check(version, need_restart);
+      return nullptr;
+    }
+
+    depth += prefix_len;
+    cur_partial_key = key[depth];
+    child = static_cast<inner_node<T> *>(cur)->find_child(cur_partial_key);
+    node<T> *next = child != nullptr ? *child : nullptr;
+    cur->lock_.check(version, need_restart);
+    if (need_restart) {
+      return nullptr;
+    }
+
+    ++depth;
+    gpar_lock = par_lock;
+    gpar_version = par_version;
+    par_lock = &cur->lock_;
+    par_version = version;
+    par_slot = slot;
+    par = static_cast<inner_node<T> *>(cur);
+    slot = child;
+    cur = next;
+  }
+}
+
+template <class T, class A> std::size_t olc_art<T, A>::n_retired() const {
+  return alloc_.n_retired();
+}
+
+#if __cplusplus >= 201703L
+template <class T, class A>
+T *olc_art<T, A>::get(std::string_view key) const {
+  return get(key.data(), key.size());
+}
+
+template <class T, class A>
+T *olc_art<T, A>::set(std::string_view key, T *value) {
+  return set(key.data(), key.size(), value);
+}
+
+template <class T, class A> T *olc_art<T, A>::del(std::string_view key) {
+  return del(key.data(), key.size());
+}
+#endif
+
+} // namespace art
+
+#endif
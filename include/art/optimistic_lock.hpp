@@ -0,0 +1,126 @@
+/**
+ * @file optimistic lock header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_OPTIMISTIC_LOCK_HPP
+#define ART_OPTIMISTIC_LOCK_HPP
+
+#include <atomic>
+#include <cstdint>
+
+namespace art {
+
+/**
+ * Version lock used for optimistic lock coupling, see olc_art.
+ *
+ * Readers don't write to the lock: they remember the version before reading
+ * the protected data and check that it is unchanged afterwards, otherwise
+ * they restart. Writers exclude each other by setting the locked bit and
+ * bump the version on unlock. A lock that is marked obsolete belongs to a
+ * node that was replaced and can never be locked again.
+ *
+ * Every method that can fail sets need_restart and leaves it untouched
+ * otherwise.
+ */
+class optimistic_lock {
+public:
+  optimistic_lock() = default;
+  /* a copied node is a new node, it does not take over the lock state */
+  optimistic_lock(const optimistic_lock & /* other */) {}
+  optimistic_lock &operator=(const optimistic_lock & /* other */) {
+    return *this;
+  }
+
+  /**
+   * Returns the current version, fails if the lock is held or obsolete.
+   */
+  uint32_t read_lock(bool &need_restart) const;
+
+  /**
+   * Fails if the version changed since read_lock returned the given version,
+   * i.e. if the data read in between may be inconsistent.
+   */
+  void check(uint32_t version, bool &need_restart) const;
+
+  /**
+   * Acquires the lock, fails if the version changed since read_lock
+   * returned the given version.
+   */
+  void upgrade_to_write_lock(uint32_t version, bool &need_restart);
+
+  /**
+   * Acquires the lock, waiting while another writer holds it. Fails if the
+   * lock is obsolete.
+   */
+  void write_lock(bool &need_restart);
+
+  void write_unlock();
+
+  /**
+   * Releases the lock and marks it obsolete.
+   */
+  void write_unlock_obsolete();
+
+private:
+  static const uint32_t obsolete_bit = 1;
+  static const uint32_t locked_bit = 2;
+
+  std::atomic<uint32_t> version_{0};
+};
+
+inline uint32_t optimistic_lock::read_lock(bool &need_restart) const {
+  uint32_t version = version_.load(std::memory_order_acquire);
+  if ((version & (locked_bit | obsolete_bit)) != 0) {
+    need_restart = true;
+  }
+  return version;
+}
+
+inline void optimistic_lock::check(uint32_t version,
+                                   bool &need_restart) const {
+  /* the reads of the protected data must not move past the check */
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (version != version_.load(std::memory_order_relaxed)) {
+    need_restart = true;
+  }
+}
+
+inline void optimistic_lock::upgrade_to_write_lock(uint32_t version,
+                                                   bool &need_restart) {
+  if (!version_.compare_exchange_strong(version, version + locked_bit,
+                                        std::memory_order_acquire)) {
+    need_restart = true;
+    return;
+  }
+  /* readers that see any of the following writes must see the lock */
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+inline void optimistic_lock::write_lock(bool &need_restart) {
+  uint32_t version;
+  do {
+    version = version_.load(std::memory_order_relaxed);
+    while ((version & locked_bit) != 0) {
+      version = version_.load(std::memory_order_relaxed);
+    }
+    if ((version & obsolete_bit) != 0) {
+      need_restart = true;
+      return;
+    }
+  } while (!version_.compare_exchange_weak(version, version + locked_bit,
+                                           std::memory_order_acquire));
+  std::atomic_thread_fence(std::memory_order_release);
+}
+
+inline void optimistic_lock::write_unlock() {
+  version_.fetch_add(locked_bit, std::memory_order_release);
+}
+
+inline void optimistic_lock::write_unlock_obsolete() {
+  version_.fetch_add(locked_bit + obsolete_bit, std::memory_order_release);
+}
+
+} // namespace art
+
+#endif
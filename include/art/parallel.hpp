@@ -0,0 +1,228 @@
+/**
+ * @file parallel traversal header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_PARALLEL_HPP
+#define ART_PARALLEL_HPP
+
+#include "inner_node.hpp"
+#include "node.hpp"
+#include <atomic>
+#include <cstddef>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace art {
+
+/**
+ * Visits every node of a tree with several threads, see parallel_walk.
+ *
+ * Subtrees are tasks. Every thread owns a deque of tasks, from whose back
+ * it takes the task to work on next, and idle threads steal tasks from
+ * the front of the other deques, where the oldest and therefore largest
+ * subtrees are. The children of the inner nodes of the first split_levels
+ * levels, e.g. the root's node_256, are pushed as tasks, deeper subtrees
+ * are walked recursively by the thread that took them. Whenever a thread
+ * is idle, the working threads push the children of the next inner node
+ * they reach instead, so that a skewed subtree is split further until
+ * every thread has work again.
+ */
+template <class T, bool Keys, class Leaf, class Inner> class parallel_walker {
+public:
+  static const int split_levels = 1;
+
+  parallel_walker(unsigned n_threads, Leaf &on_leaf, Inner &on_inner);
+
+  void run(node<T> *root);
+
+private:
+  struct task {
+    node<T> *node_;
+    int depth_;
+    int level_;
+    /* the depth_ key bytes above the node's prefix, if Keys is set */
+    std::string path_;
+  };
+
+  struct queue {
+    std::mutex mutex_;
+    std::deque<task> tasks_;
+  };
+
+  void work(unsigned worker);
+  bool pop(unsigned worker, task &t);
+  bool steal(unsigned worker, task &t);
+
+  /**
+   * Visits the subtree n, whose prefix starts at the given depth. path
+   * holds the first depth bytes of the keys of the subtree.
+   */
+  void walk(unsigned worker, node<T> *n, int depth, int level,
+            std::string &path);
+
+  unsigned n_threads_;
+  Leaf &on_leaf_;
+  Inner &on_inner_;
+  std::unique_ptr<queue[]> queues_;
+  /* tasks that were pushed, but not finished yet */
+  std::atomic<std::size_t> n_pending_;
+  /* threads looking for a task */
+  std::atomic<unsigned> n_idle_;
+};
+
+/**
+ * Visits every node of the tree rooted at root with n_threads threads, of
+ * which the calling thread is one.
+ *
+ * Calls on_leaf(worker, leaf, depth, path) for every leaf and
+ * on_inner(worker, inner_node) for every inner node once its children were
+ * read, so it may destroy the node. worker is the index of the calling
+ * thread in [0, n_threads). If Keys is set, path is a std::string holding
+ * the first depth bytes of the leaf's key, which on_leaf may append to.
+ * The callbacks are called concurrently by different workers, in no
+ * particular order, and must not throw.
+ */
+template <bool Keys, class T, class Leaf, class Inner>
+void parallel_walk(node<T> *root, unsigned n_threads, Leaf on_leaf,
+                   Inner on_inner) {
+  parallel_walker<T, Keys, Leaf, Inner>(n_threads, on_leaf, on_inner)
+      .run(root);
+}
+
+template <class T, bool Keys, class Leaf, class Inner>
+const int parallel_walker<T, Keys, Leaf, Inner>::split_levels;
+
+template <class T, bool Keys, class Leaf, class Inner>
+parallel_walker<T, Keys, Leaf, Inner>::parallel_walker(unsigned n_threads,
+                                                      Leaf &on_leaf,
+                                                      Inner &on_inner)
+    : n_threads_(n_threads == 0 ? 1 : n_threads), on_leaf_(on_leaf),
+      on_inner_(on_inner), queues_(new queue[n_threads_]), n_pending_(0),
+      n_idle_(0) {}
+
+template <class T, bool Keys, class Leaf, class Inner>
+void parallel_walker<T, Keys, Leaf, Inner>::run(node<T> *root) {
+  if (root == nullptr) {
+    return;
+  }
+  n_pending_ = 1;
+  queues_[0].tasks_.push_back(task{root, 0, 0, std::string()});
+  std::vector<std::thread> threads;
+  for (unsigned w = 1; w < n_threads_; ++w) {
+    threads.emplace_back(&parallel_walker::work, this, w);
+  }
+  work(0);
+  for (std::thread &t : threads) {
+    t.join();
+  }
+}
+
+template <class T, bool Keys, class Leaf, class Inner>
+void parallel_walker<T, Keys, Leaf, Inner>::work(unsigned worker) {
+  task t;
+  std::string path;
+  bool idle = false;
+  while (true) {
+    if (pop(worker, t) || steal(worker, t)) {
+      if (idle) {
+        n_idle_.fetch_sub(1, std::memory_order_relaxed);
+        idle = false;
+      }
+      path = std::move(t.path_);
+      walk(worker, t.node_, t.depth_, t.level_, path);
+      n_pending_.fetch_sub(1, std::memory_order_acq_rel);
+    } else if (n_pending_.load(std::memory_order_acquire) == 0) {
+      break;
+    } else {
+      if (!idle) {
+        n_idle_.fetch_add(1, std::memory_order_relaxed);
+        idle = true;
+      }
+      std::this_thread::yield();
+    }
+  }
+  if (idle) {
+    n_idle_.fetch_sub(1, std::memory_order_relaxed);
+  }
+}
+
+template <class T, bool Keys, class Leaf, class Inner>
+bool parallel_walker<T, Keys, Leaf, Inner>::pop(unsigned worker, task &t) {
+  queue &q = queues_[worker];
+  std::lock_guard<std::mutex> lock(q.mutex_);
+  if (q.tasks_.empty()) {
+    return false;
+  }
+  t = std::move(q.tasks_.back());
+  q.tasks_.pop_back();
+  return true;
+}
+
+template <class T, bool Keys, class Leaf, class Inner>
+bool parallel_walker<T, Keys, Leaf, Inner>::steal(unsigned worker, task &t) {
+  for (unsigned i = 1; i < n_threads_; ++i) {
+    queue &q = queues_[(worker + i) % n_threads_];
+    std::lock_guard<std::mutex> lock(q.mutex_);
+    if (!q.tasks_.empty()) {
+      t = std::move(q.tasks_.front());
+      q.tasks_.pop_front();
+      return true;
+    }
+  }
+  return false;
+}
+
+template <class T, bool Keys, class Leaf, class Inner>
+void parallel_walker<T, Keys, Leaf, Inner>::walk(unsigned worker,
+                                                 node<T> *n, int depth,
+                                                 int level,
+                                                 std::string &path) {
+  if (is_leaf(n)) {
+    on_leaf_(worker, n, depth, path);
+    return;
+  }
+  auto inner = static_cast<inner_node<T> *>(n);
+  int prefix_len = n->prefix_len_, n_slots = inner->n_slots(), slot;
+  if (Keys) {
+    path.resize(depth);
+    path.append(n->prefix(), prefix_len);
+  }
+  if (level < split_levels ||
+      n_idle_.load(std::memory_order_relaxed) > 0) {
+    /* the children are counted before the parent task finishes */
+    n_pending_.fetch_add(inner->n_children(), std::memory_order_relaxed);
+    queue &q = queues_[worker];
+    std::lock_guard<std::mutex> lock(q.mutex_);
+    for (slot = inner->next_slot(-1); slot < n_slots;
+         slot = inner->next_slot(slot)) {
+      if (Keys) {
+        path.resize(depth + prefix_len);
+        path.push_back(inner->slot_partial_key(slot));
+      }
+      q.tasks_.push_back(task{*inner->slot_child(slot),
+                              depth + prefix_len + 1, level + 1,
+                              Keys ? path : std::string()});
+    }
+  } else {
+    for (slot = inner->next_slot(-1); slot < n_slots;
+         slot = inner->next_slot(slot)) {
+      if (Keys) {
+        path.resize(depth + prefix_len);
+        path.push_back(inner->slot_partial_key(slot));
+      }
+      walk(worker, *inner->slot_child(slot), depth + prefix_len + 1,
+           level + 1, path);
+    }
+  }
+  on_inner_(worker, inner);
+}
+
+} // namespace art
+
+#endif
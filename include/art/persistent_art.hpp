@@ -0,0 +1,463 @@
+/**
+ * @file adaptive radix tree with copy-on-write versions
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_PERSISTENT_ART_HPP
+#define ART_PERSISTENT_ART_HPP
+
+#include "allocator.hpp"
+#include "boxed_leaves.hpp"
+#include "inner_node.hpp"
+#include "leaf_node.hpp"
+#include "node.hpp"
+#include "node_16.hpp"
+#include "node_256.hpp"
+#include "node_4.hpp"
+#include "node_48.hpp"
+#include "shared_allocator.hpp"
+#include "tree_it.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstring>
+#include <iosfwd>
+#include <memory>
+#include <stdexcept>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace art {
+
+/**
+ * Adaptive radix tree whose versions share their nodes.
+ *
+ * snapshot() returns a version that keeps the current contents in O(1),
+ * by sharing the root. Nodes and leaves carry a reference count, see
+ * shared_allocator. set and del copy the shared nodes on the path they
+ * modify (path copying) and modify the nodes that only the version itself
+ * refers to in place, so after a snapshot every modification copies at
+ * most one root-to-leaf path, and other versions never observe it.
+ *
+ * Every version may be modified, iterated and released independently,
+ * also by different threads, as long as every single version is used by
+ * one thread at a time. Values are owned by the caller and must outlive
+ * every version containing them.
+ *
+ * @tparam T - The type of the values, which are stored by pointer.
+ * @tparam A - The allocator used for nodes and prefixes, which must be
+ * thread-safe if versions are used by different threads.
+ */
+template <class T, class A = heap_allocator> class persistent_art {
+public:
+  persistent_art();
+
+  /**
+   * Creates a version with the contents of the other one, see snapshot.
+   */
+  persistent_art(const persistent_art<T, A> &other);
+  persistent_art(persistent_art<T, A> &&other) noexcept;
+  persistent_art<T, A> &operator=(const persistent_art<T, A> &other);
+  persistent_art<T, A> &operator=(persistent_art<T, A> &&other) noexcept;
+  ~persistent_art();
+
+  /**
+   * Returns a version with the current contents, which is unaffected by
+   * later modifications of this version and the other way around.
+   */
+  persistent_art<T, A> snapshot() const;
+
+  /**
+   * Finds the value associated with the given key.
+   *
+   * @return the value associated with the key or a nullptr.
+   */
+  T *get(const char *key) const;
+  T *get(const char *key, std::size_t key_len) const;
+
+  /**
+   * Associates the given key with the given value.
+   *
+   * @return a nullptr if no other value is associated with the key or the
+   * previously associated value.
+   * @throws std::invalid_argument if the key is a proper prefix of a key in
+   * the tree or the other way around, the contents are left unchanged.
+   */
+  T *set(const char *key, T *value);
+  T *set(const char *key, std::size_t key_len, T *value);
+
+  /**
+   * Deletes the given key and returns it's associated value.
+   *
+   * @return the value associated with the key or a nullptr otherwise.
+   */
+  T *del(const char *key);
+  T *del(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  T *get(std::string_view key) const;
+  T *set(std::string_view key, T *value);
+  T *del(std::string_view key);
+#endif
+
+  /**
+   * Forward iterator that traverses the version in lexicographic order.
+   * The iterator stays valid until the version is modified or released,
+   * snapshots are never modified.
+   */
+  tree_it<T> begin() const;
+
+  /**
+   * Forward iterator starting from the first key not less than the given
+   * key, see art::begin(const char *).
+   */
+  tree_it<T> begin(const char *key) const;
+  tree_it<T> begin(const char *key, std::size_t key_len) const;
+
+  tree_it<T> end() const;
+
+private:
+  template <class U, class B>
+  friend void serialize(const persistent_art<U, B> &tree, std::ostream &out);
+
+  using allocator_type = shared_allocator<A>;
+
+  /**
+   * Makes the node in the given slot exclusive to this version, by
+   * replacing it with a copy if it is shared.
+   *
+   * @return the exclusive node.
+   */
+  node<T> *unshare(node<T> **slot);
+
+  /**
+   * Drops this version's reference to the given node, the node and its
+   * unreferenced descendants are destroyed if it was the last one.
+   */
+  void release(node<T> *n);
+
+  /**
+   * Destroys the given node, but not its children.
+   */
+  void destroy_node(node<T> *n);
+
+  node<T> *root_ = nullptr;
+  /* shared by all versions */
+  std::shared_ptr<allocator_type> alloc_;
+  boxed_leaves<T> leaves_;
+};
+
+template <class T, class A>
+persistent_art<T, A>::persistent_art()
+    : alloc_(std::make_shared<allocator_type>()) {}
+
+template <class T, class A>
+persistent_art<T, A>::persistent_art(const persistent_art<T, A> &other)
+    : root_(other.root_), alloc_(other.alloc_) {
+  if (root_ != nullptr) {
+    allocator_type::acquire(root_);
+  }
+}
+
+template <class T, class A>
+persistent_art<T, A>::persistent_art(persistent_art<T, A> &&other) noexcept
+    : root_(other.root_), alloc_(other.alloc_) {
+  other.root_ = nullptr;
+}
+
+template <class T, class A>
+persistent_art<T, A> &
+persistent_art<T, A>::operator=(const persistent_art<T, A> &other) {
+  if (other.root_ != nullptr) {
+    allocator_type::acquire(other.root_);
+  }
+  release(root_);
+  root_ = other.root_;
+  alloc_ = other.alloc_;
+  return *this;
+}
+
+template <class T, class A>
+persistent_art<T, A> &
+persistent_art<T, A>::operator=(persistent_art<T, A> &&other) noexcept {
+  std::swap(root_, other.root_);
+  std::swap(alloc_, other.alloc_);
+  return *this;
+}
+
+template <class T, class A> persistent_art<T, A>::~persistent_art() {
+  release(root_);
+}
+
+template <class T, class A>
+persistent_art<T, A> persistent_art<T, A>::snapshot() const {
+  return *this;
+}
+
+template <class T, class A>
+void persistent_art<T, A>::destroy_node(node<T> *n) {
+  if (is_leaf(n)) {
+    leaves_.destroy(n, *alloc_);
+  } else {
+    n->free_prefix(*alloc_);
+    static_cast<inner_node<T> *>(n)->destroy(*alloc_);
+  }
+}
+
+template <class T, class A> void persistent_art<T, A>::release(node<T> *n) {
+  if (n == nullptr || !allocator_type::release(n)) {
+    return;
+  }
+  if (!is_leaf(n)) {
+    auto inner = static_cast<inner_node<T> *>(n);
+    for (int slot = inner->next_slot(-1), n_slots = inner->n_slots();
+         slot < n_slots; slot = inner->next_slot(slot)) {
+      release(*inner->slot_child(slot));
+    }
+  }
+  destroy_node(n);
+}
+
+template <class T, class A>
+node<T> *persistent_art<T, A>::unshare(node<T> **slot) {
+  node<T> *n = *slot;
+  if (!allocator_type::is_shared(n)) {
+    return n;
+  }
+  node<T> *copy;
+  if (is_leaf(n)) {
+    copy = leaves_.make(n->prefix(), n->prefix_len_, leaf_value(n), *alloc_);
+  } else {
+    auto inner = static_cast<inner_node<T> *>(n);
+    inner_node<T> *inner_copy;
+    switch (n->type_) {
+    case node_type::node_4:
+      inner_copy = make<node_4<T>>(*alloc_);
+      break;
+    case node_type::node_16:
+      inner_copy = make<node_16<T>>(*alloc_);
+      break;
+    case node_type::node_48:
+      inner_copy = make<node_48<T>>(*alloc_);
+      break;
+    default:
+      inner_copy = make<node_256<T>>(*alloc_);
+      break;
+    }
+    inner_copy->set_prefix(n->prefix(), n->prefix_len_, *alloc_);
+    node<T> *child;
+    for (int slot = inner->next_slot(-1), n_slots = inner->n_slots();
+         slot < n_slots; slot = inner->next_slot(slot)) {
+      /* the children are now shared by the node and its copy */
+      child = *inner->slot_child(slot);
+      allocator_type::acquire(child);
+      inner_copy->set_child(inner->slot_partial_key(slot), child);
+    }
+    copy = inner_copy;
+  }
+  *slot = copy;
+  /* the other versions may have released the node in the meantime */
+  release(n);
+  return copy;
+}
+
+template <class T, class A>
+T *persistent_art<T, A>::get(const char *key) const {
+  return get(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+T *persistent_art<T, A>::get(const char *key, std::size_t len) const {
+  node<T> *cur = root_, **child;
+  int depth = 0, key_len = len;
+  while (cur != nullptr) {
+    if (is_leaf(cur)) {
+      return leaves_.matches(cur, key, depth, key_len) ? leaf_value(cur)
+                                                       : nullptr;
+    }
+    if (cur->prefix_len_ >= key_len - depth ||
+        cur->check_prefix(key + depth, key_len - depth) != cur->prefix_len_) {
+      /* prefix mismatch or the key ends in an inner node */
+      return nullptr;
+    }
+    depth += cur->prefix_len_;
+    child = static_cast<inner_node<T> *>(cur)->find_child(key[depth]);
+    cur = child != nullptr ? *child : nullptr;
+    ++depth;
+  }
+  return nullptr;
+}
+
+template <class T, class A>
+T *persistent_art<T, A>::set(const char *key, T *value) {
+  return set(key, std::strlen(key) + 1, value);
+}
+
+template <class T, class A>
+T *persistent_art<T, A>::set(const char *key, std::size_t len, T *value) {
+  int key_len = len, depth = 0, prefix_len, match_len;
+  if (root_ == nullptr) {
+    root_ = leaves_.make(key, key_len, value, *alloc_);
+    return nullptr;
+  }
+
+  node<T> **slot = &root_, **child, *cur;
+  inner_node<T> *cur_inner;
+  const char *prefix;
+  char partial_key;
+  bool is_leaf_node;
+
+  while (true) {
+    /* every node on the path may be modified */
+    cur = unshare(slot);
+    is_leaf_node = is_leaf(cur);
+    prefix = cur->prefix();
+    prefix_len = cur->prefix_len_;
+    match_len = cur->check_prefix(key + depth, key_len - depth);
+
+    if (is_leaf_node && match_len == prefix_len &&
+        prefix_len == key_len - depth) {
+      /* exact match, replace the value */
+      T *old_value = leaf_value(cur);
+      leaves_.set_value(*slot, value);
+      return old_value;
+    }
+
+    if (match_len == std::min(prefix_len, key_len - depth) &&
+        (is_leaf_node || prefix_len >= key_len - depth)) {
+      /* one of the keys is a proper prefix of the other */
+      throw std::invalid_argument("keys must be prefix-free");
+    }
+
+    if (match_len < prefix_len) {
+      /* prefix mismatch, a new parent holds cur and the new leaf */
+      auto new_parent = make<node_4<T>>(*alloc_);
+      new_parent->set_child(prefix[match_len], cur);
+      /* the new parent may take over cur's prefix */
+      if (is_leaf_node) {
+        leaves_.split(cur, *new_parent, prefix, match_len, *alloc_);
+      } else {
+        cur->split_prefix(*new_parent, match_len, *alloc_);
+      }
+      new_parent->set_child(key[depth + match_len],
+                            leaves_.make(key + depth + match_len + 1,
+                                         key_len - depth - match_len - 1,
+                                         value, *alloc_));
+      *slot = new_parent;
+      return nullptr;
+    }
+
+    cur_inner = static_cast<inner_node<T> *>(cur);
+    depth += prefix_len;
+    partial_key = key[depth];
+    child = cur_inner->find_child(partial_key);
+    if (child == nullptr) {
+      if (cur_inner->is_full()) {
+        cur_inner = cur_inner->grow(*alloc_);
+        *slot = cur_inner;
+      }
+      cur_inner->set_child(partial_key,
+                           leaves_.make(key + depth + 1, key_len - depth - 1,
+                                        value, *alloc_));
+      return nullptr;
+    }
+    ++depth;
+    slot = child;
+  }
+}
+
+template <class T, class A>
+T *persistent_art<T, A>::del(const char *key) {
+  return del(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+T *persistent_art<T, A>::del(const char *key, std::size_t len) {
+  /* nothing is copied for keys that aren't there */
+  T *value = get(key, len);
+  if (value == nullptr) {
+    return nullptr;
+  }
+
+  int depth = 0;
+  node<T> **par_slot = nullptr, **slot = &root_, *cur = root_;
+  inner_node<T> *par = nullptr;
+  char partial_key = 0;
+  while (!is_leaf(cur)) {
+    /* the key is there, so the prefixes match */
+    par = static_cast<inner_node<T> *>(unshare(slot));
+    depth += par->prefix_len_;
+    partial_key = key[depth];
+    ++depth;
+    par_slot = slot;
+    slot = par->find_child(partial_key);
+    cur = *slot;
+  }
+
+  if (par == nullptr) {
+    root_ = nullptr;
+  } else if (par->n_children() == 2) {
+    /* replace the parent with the sibling */
+    char sibling_partial_key = par->next_partial_key(-128);
+    if (sibling_partial_key == partial_key) {
+      sibling_partial_key = par->next_partial_key(partial_key + 1);
+    }
+    node<T> *sibling = unshare(par->find_child(sibling_partial_key));
+    /* the sibling may take over the parent's prefix */
+    if (is_leaf(sibling)) {
+      leaves_.prepend(sibling, *par, sibling_partial_key, *alloc_);
+    } else {
+      sibling->prepend_prefix(*par, sibling_partial_key, *alloc_);
+    }
+    *par_slot = sibling;
+    /* the sibling moved up, the leaf is released below */
+    destroy_node(par);
+  } else {
+    par->del_child(partial_key);
+    if (par->is_underfull()) {
+      *par_slot = par->shrink(*alloc_);
+    }
+  }
+  release(cur);
+  return value;
+}
+
+template <class T, class A> tree_it<T> persistent_art<T, A>::begin() const {
+  return tree_it<T>::min(root_, leaves_);
+}
+
+template <class T, class A>
+tree_it<T> persistent_art<T, A>::begin(const char *key) const {
+  return begin(key, std::strlen(key));
+}
+
+template <class T, class A>
+tree_it<T> persistent_art<T, A>::begin(const char *key,
+                                       std::size_t key_len) const {
+  return tree_it<T>::greater_equal(root_, key, key_len, leaves_);
+}
+
+template <class T, class A> tree_it<T> persistent_art<T, A>::end() const {
+  return tree_it<T>();
+}
+
+#if __cplusplus >= 201703L
+template <class T, class A>
+T *persistent_art<T, A>::get(std::string_view key) const {
+  return get(key.data(), key.size());
+}
+
+template <class T, class A>
+T *persistent_art<T, A>::set(std::string_view key, T *value) {
+  return set(key.data(), key.size(), value);
+}
+
+template <class T, class A>
+T *persistent_art<T, A>::del(std::string_view key) {
+  return del(key.data(), key.size());
+}
+#endif
+
+} // namespace art
+
+#endif
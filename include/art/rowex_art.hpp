@@ -0,0 +1,669 @@
+/**
+ * @file concurrent adaptive radix tree with read-optimized write exclusion
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_ROWEX_ART_HPP
+#define ART_ROWEX_ART_HPP
+
+#include "allocator.hpp"
+#include "boxed_leaves.hpp"
+#include "epoch_allocator.hpp"
+#include "inner_node.hpp"
+#include "leaf_node.hpp"
+#include "node.hpp"
+#include "node_16.hpp"
+#include "node_256.hpp"
+#include "node_4.hpp"
+#include "node_48.hpp"
+#include "optimistic_lock.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstring>
+#include <functional>
+#include <stack>
+#include <stdexcept>
+#include <string>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace art {
+
+/**
+ * Adaptive radix tree that may be used by many threads at once, using read
+ * optimized write exclusion (Leis et al., The ART of Practical
+ * Synchronization).
+ *
+ * Lookups never lock, wait or restart. Writers exclude each other with the
+ * lock in the header of every inner node, which they acquire top-down, and
+ * only publish nodes that are never modified in a way a concurrent reader
+ * could observe half-way:
+ *
+ * - a child is added to a node_48 or node_256 in place, by storing the
+ *   pointer into a free slot, and removed from a node_256 in place, by
+ *   clearing its slot, unless the node_256 shrinks.
+ * - every other change, i.e. adding or removing a child of a node_4 or
+ *   node_16, removing a child of a node_48, growing, shrinking, splitting or
+ *   merging prefixes and replacing values, builds a new node or leaf, which
+ *   replaces the old one with a single pointer store into its parent's slot.
+ *   The old node is marked obsolete, so writers waiting for its lock
+ *   restart, and is retired.
+ *
+ * Child pointers are published with release stores and read with acquire
+ * loads, so readers see either the old or the new node, both complete.
+ * Replaced nodes, prefixes and leaves are deallocated through an
+ * epoch_allocator and only handed back to A once no lookup can reach them
+ * anymore.
+ *
+ * Compared to olc_art lookups are cheaper under contention, writes copy
+ * more. Keys follow the rules of art, values are stored in boxed leaves and
+ * are owned by the caller. Iteration isn't supported.
+ *
+ * @tparam T - The type of the values, which are stored by pointer.
+ * @tparam A - The allocator used for nodes and prefixes, which must be
+ * thread-safe.
+ */
+template <class T, class A = heap_allocator> class rowex_art {
+public:
+  rowex_art(std::function<void(T *)> free_fn = nullptr) : free_(free_fn) {}
+  rowex_art(const rowex_art<T, A> &other) = delete;
+  rowex_art<T, A> &operator=(const rowex_art<T, A> &other) = delete;
+  ~rowex_art();
+
+  /**
+   * Finds the value associated with the given key.
+   *
+   * @return the value associated with the key or a nullptr.
+   */
+  T *get(const char *key) const;
+  T *get(const char *key, std::size_t key_len) const;
+
+  /**
+   * Associates the given key with the given value.
+   *
+   * @return a nullptr if no other value is associated with the key or the
+   * previously associated value.
+   * @throws std::invalid_argument if the key is a proper prefix of a key in
+   * the tree or the other way around, the tree is left unchanged.
+   */
+  T *set(const char *key, T *value);
+  T *set(const char *key, std::size_t key_len, T *value);
+
+  /**
+   * Deletes the given key and returns it's associated value.
+   *
+   * @return the value associated with the key or a nullptr otherwise.
+   */
+  T *del(const char *key);
+  T *del(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  T *get(std::string_view key) const;
+  T *set(std::string_view key, T *value);
+  T *del(std::string_view key);
+#endif
+
+  /**
+   * Number of deallocated nodes, prefixes and leaves that some operation
+   * may still be reading and are therefore not yet released.
+   */
+  std::size_t n_retired() const;
+
+private:
+  /* partial key that never matches, see copy */
+  static const int no_partial_key = 256;
+
+  static node<T> *load(node<T> *const *slot);
+  static void store(node<T> **slot, node<T> *n);
+
+  /**
+   * Returns the child associated with the given partial key or a nullptr.
+   */
+  static node<T> *child(inner_node<T> *n, char partial_key);
+
+  /**
+   * Type of the smallest node that holds the given number of children.
+   */
+  static node_type fitting_type(int n_children);
+
+  /*
+   * Single attempts of set and del. They set need_restart if a concurrent
+   * writer interfered, in which case nothing was modified.
+   */
+  T *try_set(const char *key, int key_len, T *value, bool &need_restart);
+  T *try_del(const char *key, int key_len, bool &need_restart);
+
+  /**
+   * Creates a node of the given type with the given prefix and the children
+   * of n, except the one associated with skip_partial_key. n is not
+   * modified and must be locked.
+   */
+  inner_node<T> *copy(inner_node<T> *n, node_type type, const char *prefix,
+                      int prefix_len, int skip_partial_key = no_partial_key);
+
+  /**
+   * Deallocates a node that was replaced, without modifying it, since
+   * lookups may still be reading it.
+   */
+  void retire(node<T> *n);
+
+  void destroy_node(node<T> *n);
+
+  node<T> *root_ = nullptr;
+  optimistic_lock root_lock_;
+  std::function<void(T *)> free_;
+  mutable epoch_allocator<A> alloc_;
+  boxed_leaves<T> leaves_;
+};
+
+template <class T, class A> rowex_art<T, A>::~rowex_art() {
+  if (root_ == nullptr) {
+    return;
+  }
+  std::stack<node<T> *> node_stack;
+  node_stack.push(root_);
+  node<T> *cur;
+  inner_node<T> *cur_inner;
+  while (!node_stack.empty()) {
+    cur = node_stack.top();
+    node_stack.pop();
+    if (!is_leaf(cur)) {
+      cur_inner = static_cast<inner_node<T> *>(cur);
+      for (int slot = cur_inner->next_slot(-1), n_slots = cur_inner->n_slots();
+           slot < n_slots; slot = cur_inner->next_slot(slot)) {
+        node_stack.push(*cur_inner->slot_child(slot));
+      }
+    } else if (free_) {
+      free_(leaf_value(cur));
+    }
+    destroy_node(cur);
+  }
+}
+
+template <class T, class A>
+node<T> *rowex_art<T, A>::load(node<T> *const *slot) {
+#if defined(__GNUC__)
+  return __atomic_load_n(slot, __ATOMIC_ACQUIRE);
+#else
+  return reinterpret_cast<const std::atomic<node<T> *> *>(slot)->load(
+      std::memory_order_acquire);
+#endif
+}
+
+template <class T, class A>
+void rowex_art<T, A>::store(node<T> **slot, node<T> *n) {
+#if defined(__GNUC__)
+  __atomic_store_n(slot, n, __ATOMIC_RELEASE);
+#else
+  reinterpret_cast<std::atomic<node<T> *> *>(slot)->store(
+      n, std::memory_order_release);
+#endif
+}
+
+template <class T, class A>
+node<T> *rowex_art<T, A>::child(inner_node<T> *n, char partial_key) {
+  node<T> **slot = n->find_child(partial_key);
+  return slot != nullptr ? load(slot) : nullptr;
+}
+
+template <class T, class A>
+node_type rowex_art<T, A>::fitting_type(int n_children) {
+  return n_children <= 4    ? node_type::node_4
+         : n_children <= 16 ? node_type::node_16
+         : n_children <= 48 ? node_type::node_48
+                            : node_type::node_256;
+}
+
+template <class T, class A>
+inner_node<T> *rowex_art<T, A>::copy(inner_node<T> *n, node_type type,
+                                     const char *prefix, int prefix_len,
+                                     int skip_partial_key) {
+  inner_node<T> *c;
+  switch (type) {
+  case node_type::node_4:
+    c = make<node_4<T>>(alloc_);
+    break;
+  case node_type::node_16:
+    c = make<node_16<T>>(alloc_);
+    break;
+  case node_type::node_48:
+    c = make<node_48<T>>(alloc_);
+    break;
+  default:
+    c = make<node_256<T>>(alloc_);
+    break;
+  }
+  c->set_prefix(prefix, prefix_len, alloc_);
+  char partial_key;
+  for (int slot = n->next_slot(-1), n_slots = n->n_slots(); slot < n_slots;
+       slot = n->next_slot(slot)) {
+    partial_key = n->slot_partial_key(slot);
+    if (partial_key != skip_partial_key) {
+      c->set_child(partial_key, *n->slot_child(slot));
+    }
+  }
+  return c;
+}
+
+template <class T, class A> void rowex_art<T, A>::retire(node<T> *n) {
+  if (!n->is_prefix_inline()) {
+    alloc_.deallocate(n->prefix(), n->heap_prefix_size());
+  }
+  if (is_leaf(n)) {
+    ::art::destroy(alloc_, static_cast<leaf_node<T> *>(n));
+  } else {
+    static_cast<inner_node<T> *>(n)->destroy(alloc_);
+  }
+}
+
+template <class T, class A> void rowex_art<T, A>::destroy_node(node<T> *n) {
+  if (is_leaf(n)) {
+    leaves_.destroy(n, alloc_);
+  } else {
+    n->free_prefix(alloc_);
+    static_cast<inner_node<T> *>(n)->destroy(alloc_);
+  }
+}
+
+template <class T, class A> T *rowex_art<T, A>::get(const char *key) const {
+  return get(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+T *rowex_art<T, A>::get(const char *key, std::size_t key_len) const {
+  typename epoch_allocator<A>::guard guard(alloc_);
+  node<T> *cur = load(&root_);
+  int depth = 0, len = key_len;
+  while (cur != nullptr) {
+    if (is_leaf(cur)) {
+      return leaves_.matches(cur, key, depth, len) ? leaf_value(cur)
+                                                   : nullptr;
+    }
+    if (cur->prefix_len_ >= len - depth ||
+        cur->check_prefix(key + depth, len - depth) != cur->prefix_len_) {
+      /* prefix mismatch or the key ends in an inner node */
+      return nullptr;
+    }
+    depth += cur->prefix_len_;
+    cur = child(static_cast<inner_node<T> *>(cur), key[depth]);
+    ++depth;
+  }
+  return nullptr;
+}
+
+template <class T, class A>
+T *rowex_art<T, A>::set(const char *key, T *value) {
+  return set(key, std::strlen(key) + 1, value);
+}
+
+template <class T, class A>
+T *rowex_art<T, A>::set(const char *key, std::size_t key_len, T *value) {
+  typename epoch_allocator<A>::guard guard(alloc_);
+  bool need_restart;
+  T *old_value;
+  do {
+    need_restart = false;
+    old_value = try_set(key, key_len, value, need_restart);
+  } while (need_restart);
+  return old_value;
+}
+
+template <class T, class A> T *rowex_art<T, A>::del(const char *key) {
+  return del(key, std::strlen(key) + 1);
+}
+
+template <class T, class A>
+T *rowex_art<T, A>::del(const char *key, std::size_t key_len) {
+  typename epoch_allocator<A>::guard guard(alloc_);
+  bool need_restart;
+  T *value;
+  do {
+    need_restart = false;
+    value = try_del(key, key_len, need_restart);
+  } while (need_restart);
+  return value;
+}
+
+template <class T, class A>
+T *rowex_art<T, A>::try_set(const char *key, int key_len, T *value,
+                            bool &need_restart) {
+  /* the lock guarding slot, i.e. the parent's or the root's */
+  optimistic_lock *par_lock = &root_lock_;
+  node<T> **slot = &root_, *cur = load(&root_), **child_slot;
+  inner_node<T> *cur_inner;
+  const char *prefix;
+  int depth = 0, prefix_len, match_len;
+  bool is_leaf_node, is_match;
+  char partial_key;
+
+  /*
+   * The tree is traversed like a lookup, every decision is validated again
+   * once the nodes it depends on are locked.
+   */
+  while (true) {
+    if (cur == nullptr) {
+      /* empty tree */
+      par_lock->write_lock(need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      if (load(slot) != nullptr) {
+        par_lock->write_unlock();
+        need_restart = true;
+        return nullptr;
+      }
+      store(slot, leaves_.make(key, key_len, value, alloc_));
+      par_lock->write_unlock();
+      return nullptr;
+    }
+
+    is_leaf_node = is_leaf(cur);
+    if (is_leaf_node) {
+      prefix = leaves_.key(cur, depth, prefix_len);
+    } else {
+      prefix = cur->prefix();
+      prefix_len = cur->prefix_len_;
+    }
+
+    /* number of bytes of the current node's prefix that match the key */
+    match_len = cur->check_prefix(key + depth, key_len - depth);
+    is_match = is_leaf_node && match_len == prefix_len &&
+               prefix_len == key_len - depth;
+
+    if (!is_match && match_len == std::min(prefix_len, key_len - depth) &&
+        (is_leaf_node || prefix_len >= key_len - depth)) {
+      /* one of the keys is a proper prefix of the other */
+      throw std::invalid_argument("keys must be prefix-free");
+    }
+
+    if (is_leaf_node || match_len < prefix_len) {
+      /* cur is replaced in its slot */
+      par_lock->write_lock(need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      if (load(slot) != cur) {
+        par_lock->write_unlock();
+        need_restart = true;
+        return nullptr;
+      }
+
+      if (is_match) {
+        /* exact match, replace the leaf */
+        T *old_value = leaf_value(cur);
+        store(slot, leaves_.make(prefix, prefix_len, value, alloc_));
+        par_lock->write_unlock();
+        retire(cur);
+        return old_value;
+      }
+
+      /* prefix mismatch, a new parent holds the shortened cur and the key */
+      node<T> *shortened;
+      if (is_leaf_node) {
+        shortened = leaves_.make(prefix + match_len + 1,
+                                 prefix_len - match_len - 1, leaf_value(cur),
+                                 alloc_);
+      } else {
+        /* writers adding a child in place must be done */
+        cur->lock_.write_lock(need_restart);
+        if (need_restart) {
+          par_lock->write_unlock();
+          return nullptr;
+        }
+        cur_inner = static_cast<inner_node<T> *>(cur);
+        shortened = copy(cur_inner, cur->type_, prefix + match_len + 1,
+                         prefix_len - match_len - 1);
+      }
+      auto new_parent = make<node_4<T>>(alloc_);
+      new_parent->set_prefix(key + depth, match_len, alloc_);
+      new_parent->set_child(prefix[match_len], shortened);
+      new_parent->set_child(key[depth + match_len],
+                            leaves_.make(key + depth + match_len + 1,
+                                         key_len - depth - match_len - 1,
+                                         value, alloc_));
+      store(slot, new_parent);
+      if (!is_leaf_node) {
+        cur->lock_.write_unlock_obsolete();
+      }
+      par_lock->write_unlock();
+      retire(cur);
+      return nullptr;
+    }
+
+    cur_inner = static_cast<inner_node<T> *>(cur);
+    depth += prefix_len;
+    partial_key = key[depth];
+    child_slot = cur_inner->find_child(partial_key);
+    node<T> *next = child_slot != nullptr ? load(child_slot) : nullptr;
+
+    if (next == nullptr) {
+      /* no child associated with the next partial key */
+      node<T> *new_leaf;
+      if ((cur->type_ == node_type::node_48 ||
+           cur->type_ == node_type::node_256) &&
+          !cur_inner->is_full()) {
+        /* add the child in place */
+        cur->lock_.write_lock(need_restart);
+        if (need_restart) {
+          return nullptr;
+        }
+        if (child(cur_inner, partial_key) != nullptr || cur_inner->is_full()) {
+          cur->lock_.write_unlock();
+          need_restart = true;
+          return nullptr;
+        }
+        new_leaf = leaves_.make(key + depth + 1, key_len - depth - 1, value,
+                                alloc_);
+        /* reserve the slot, lookups see the leaf once it is published */
+        cur_inner->set_child(partial_key, nullptr);
+        store(cur_inner->slot_child(128 + partial_key), new_leaf);
+        cur->lock_.write_unlock();
+        return nullptr;
+      }
+
+      /* a copy with the child, grown if needed, replaces cur in its slot */
+      par_lock->write_lock(need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      if (load(slot) != cur) {
+        par_lock->write_unlock();
+        need_restart = true;
+        return nullptr;
+      }
+      cur->lock_.write_lock(need_restart);
+      if (need_restart) {
+        par_lock->write_unlock();
+        return nullptr;
+      }
+      if (child(cur_inner, partial_key) != nullptr) {
+        cur->lock_.write_unlock();
+        par_lock->write_unlock();
+        need_restart = true;
+        return nullptr;
+      }
+      auto new_node = copy(cur_inner, fitting_type(cur_inner->n_children() + 1),
+                           prefix, prefix_len);
+      new_node->set_child(partial_key,
+                          leaves_.make(key + depth + 1, key_len - depth - 1,
+                                       value, alloc_));
+      store(slot, new_node);
+      cur->lock_.write_unlock_obsolete();
+      par_lock->write_unlock();
+      retire(cur);
+      return nullptr;
+    }
+
+    ++depth;
+    par_lock = &cur->lock_;
+    slot = child_slot;
+    cur = next;
+  }
+}
+
+template <class T, class A>
+T *rowex_art<T, A>::try_del(const char *key, int key_len, bool &need_restart) {
+  optimistic_lock *gpar_lock = nullptr, *par_lock = &root_lock_;
+  node<T> **par_slot = nullptr, **slot = &root_, *cur = load(&root_),
+          **child_slot;
+  inner_node<T> *par = nullptr;
+  int depth = 0;
+  char cur_partial_key = 0;
+
+  while (true) {
+    if (cur == nullptr) {
+      return nullptr;
+    }
+
+    if (is_leaf(cur)) {
+      if (!leaves_.matches(cur, key, depth, key_len)) {
+        return nullptr;
+      }
+      T *value = leaf_value(cur);
+
+      if (par == nullptr) {
+        /* the leaf is the root */
+        root_lock_.write_lock(need_restart);
+        if (need_restart) {
+          return nullptr;
+        }
+        if (load(&root_) != cur) {
+          root_lock_.write_unlock();
+          need_restart = true;
+          return nullptr;
+        }
+        store(&root_, nullptr);
+        root_lock_.write_unlock();
+        retire(cur);
+        return value;
+      }
+
+      if (par->type_ == node_type::node_256 &&
+          par->n_children() - 1 > node_256<T>::shrink_threshold) {
+        /* clear the slot in place */
+        par->lock_.write_lock(need_restart);
+        if (need_restart) {
+          return nullptr;
+        }
+        if (load(slot) != cur ||
+            par->n_children() - 1 <= node_256<T>::shrink_threshold) {
+          par->lock_.write_unlock();
+          need_restart = true;
+          return nullptr;
+        }
+        /* unpublish the leaf, then drop it from the count and bitmap */
+        store(slot, nullptr);
+        par->del_child(cur_partial_key);
+        par->lock_.write_unlock();
+        retire(cur);
+        return value;
+      }
+
+      /* a copy without the leaf replaces the parent in its slot */
+      gpar_lock->write_lock(need_restart);
+      if (need_restart) {
+        return nullptr;
+      }
+      if (load(par_slot) != par) {
+        gpar_lock->write_unlock();
+        need_restart = true;
+        return nullptr;
+      }
+      par->lock_.write_lock(need_restart);
+      if (need_restart) {
+        gpar_lock->write_unlock();
+        return nullptr;
+      }
+      if (load(slot) != cur) {
+        par->lock_.write_unlock();
+        gpar_lock->write_unlock();
+        need_restart = true;
+        return nullptr;
+      }
+
+      node<T> *sibling = nullptr, *new_node;
+      if (par->n_children() == 2) {
+        /* replace the parent with the sibling and its prefix */
+        auto sibling_partial_key = par->next_partial_key(-128);
+        if (sibling_partial_key == cur_partial_key) {
+          sibling_partial_key = par->next_partial_key(cur_partial_key + 1);
+        }
+        sibling = load(par->find_child(sibling_partial_key));
+        std::string merged_prefix(par->prefix(), par->prefix_len_);
+        merged_prefix.push_back(sibling_partial_key);
+        merged_prefix.append(sibling->prefix(), sibling->prefix_len_);
+        if (is_leaf(sibling)) {
+          new_node = leaves_.make(merged_prefix.data(), merged_prefix.size(),
+                                  leaf_value(sibling), alloc_);
+        } else {
+          sibling->lock_.write_lock(need_restart);
+          if (need_restart) {
+            par->lock_.write_unlock();
+            gpar_lock->write_unlock();
+            return nullptr;
+          }
+          new_node = copy(static_cast<inner_node<T> *>(sibling),
+                          sibling->type_, merged_prefix.data(),
+                          merged_prefix.size());
+          sibling->lock_.write_unlock_obsolete();
+        }
+      } else {
+        new_node = copy(par, fitting_type(par->n_children() - 1),
+                        par->prefix(), par->prefix_len_, cur_partial_key);
+      }
+      store(par_slot, new_node);
+      par->lock_.write_unlock_obsolete();
+      gpar_lock->write_unlock();
+      retire(cur);
+      retire(par);
+      if (sibling != nullptr) {
+        retire(sibling);
+      }
+      return value;
+    }
+
+    if (cur->prefix_len_ >= key_len - depth ||
+        cur->check_prefix(key + depth, key_len - depth) != cur->prefix_len_) {
+      /* prefix mismatch or the key ends in an inner node */
+      return nullptr;
+    }
+
+    depth += cur->prefix_len_;
+    cur_partial_key = key[depth];
+    child_slot =
+        static_cast<inner_node<T> *>(cur)->find_child(cur_partial_key);
+    ++depth;
+    gpar_lock = par_lock;
+    par_lock = &cur->lock_;
+    par_slot = slot;
+    par = static_cast<inner_node<T> *>(cur);
+    slot = child_slot;
+    cur = child_slot != nullptr ? load(child_slot) : nullptr;
+  }
+}
+
+template <class T, class A> std::size_t rowex_art<T, A>::n_retired() const {
+  return alloc_.n_retired();
+}
+
+#if __cplusplus >= 201703L
+template <class T, class A>
+T *rowex_art<T, A>::get(std::string_view key) const {
+  return get(key.data(), key.size());
+}
+
+template <class T, class A>
+T *rowex_art<T, A>::set(std::string_view key, T *value) {
+  return set(key.data(), key.size(), value);
+}
+
+template <class T, class A> T *rowex_art<T, A>::del(std::string_view key) {
+  return del(key.data(), key.size());
+}
+#endif
+
+} // namespace art
+
+#endif
@@ -0,0 +1,370 @@
+/**
+ * @file adaptive radix tree partitioned into independently locked shards
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_SHARDED_ART_HPP
+#define ART_SHARDED_ART_HPP
+
+#include "allocator.hpp"
+#include "art.hpp"
+#include "tree_it.hpp"
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace art {
+
+/**
+ * Adaptive radix tree that may be used by many threads at once, partitioned
+ * into N independent art<T, A> trees.
+ *
+ * A key is routed by a hash of its bytes, so that keys spread evenly across
+ * the shards even if they share their first bytes, like decimal numbers or
+ * words do. Every shard has its own mutex and allocator, so operations on
+ * different shards don't contend. Iteration merges the shards' iterators
+ * and yields every key in the tree's lexicographic order.
+ *
+ * Since keys that are prefixes of each other are mostly routed to different
+ * shards, a key is only checked against the keys of its own shard for being
+ * a prefix. Keys that are prefix-free anyway, like the NUL-terminated or
+ * fixed-length ones, are unaffected.
+ *
+ * Iterators are not synchronized: no thread may modify the tree while it
+ * is iterated.
+ *
+ * @tparam T - The type of the values, which are stored by pointer.
+ * @tparam N - The number of shards.
+ * @tparam A - The allocator of every shard, see allocator. It is only used
+ * under the shard's lock, so it doesn't need to be thread-safe.
+ */
+template <class T, std::size_t N, class A = pool_allocator>
+class sharded_art {
+  static_assert(N >= 1, "there is at least one shard");
+
+public:
+  static const std::size_t n_shards = N;
+
+  /**
+   * Forward iterator over the shards' leaves in lexicographic key order,
+   * which merges an iterator of every shard.
+   */
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = T *;
+    using difference_type = int;
+    using pointer = value_type *;
+
+    iterator() = default;
+
+    value_type operator*();
+    pointer operator->();
+    iterator &operator++();
+    iterator operator++(int);
+    bool operator==(const iterator &rhs) const;
+    bool operator!=(const iterator &rhs) const;
+
+    /**
+     * Returns the key of the current leaf, see tree_it::key().
+     */
+    const std::string &key();
+
+  private:
+    friend class sharded_art<T, N, A>;
+
+    /**
+     * Orders the shards that aren't at their end by their current key.
+     */
+    void make_heap();
+
+    /* whether shard a's key comes after shard b's, the heap's order */
+    bool after(std::size_t a, std::size_t b);
+
+    /* the shards' iterators */
+    std::vector<tree_it<T>> its_;
+    /* min-heap of the shards that aren't at their end, empty at the end */
+    std::vector<std::size_t> heap_;
+  };
+
+  sharded_art(std::function<void(T *)> free_fn = nullptr);
+  sharded_art(const sharded_art<T, N, A> &other) = delete;
+  sharded_art<T, N, A> &operator=(const sharded_art<T, N, A> &other) = delete;
+
+  /**
+   * Finds the value associated with the given key.
+   *
+   * @return the value associated with the key or a nullptr.
+   */
+  T *get(const char *key) const;
+  T *get(const char *key, std::size_t key_len) const;
+
+  /**
+   * Associates the given key with the given value.
+   *
+   * @return a nullptr if no other value is associated with the key or the
+   * previously associated value.
+   * @throws std::invalid_argument if the key is a proper prefix of a key in
+   * its shard or the other way around, the tree is left unchanged.
+   */
+  T *set(const char *key, T *value);
+  T *set(const char *key, std::size_t key_len, T *value);
+
+  /**
+   * Deletes the given key and returns it's associated value.
+   *
+   * @return the value associated with the key or a nullptr otherwise.
+   */
+  T *del(const char *key);
+  T *del(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  T *get(std::string_view key) const;
+  T *set(std::string_view key, T *value);
+  T *del(std::string_view key);
+#endif
+
+  /**
+   * Forward iterator that traverses all shards in ascending key order.
+   */
+  iterator begin();
+
+  /**
+   * Forward iterator that traverses all shards in ascending key order
+   * starting from the first key not less than the given key, see
+   * art::begin(const char *).
+   */
+  iterator begin(const char *key);
+  iterator begin(const char *key, std::size_t key_len);
+
+  /**
+   * Iterator to the end of the key order.
+   */
+  iterator end();
+
+  /**
+   * Returns the shard the given key is routed to.
+   */
+  static std::size_t shard_of(const char *key, std::size_t key_len);
+
+private:
+  /**
+   * Compares keys in the order of the tree, i.e., bytes as signed chars.
+   */
+  static bool key_less(const std::string &a, const std::string &b);
+
+  struct shard {
+    explicit shard(std::function<void(T *)> free_fn) : tree_(free_fn) {}
+
+    mutable std::mutex mutex_;
+    art<T, A> tree_;
+  };
+
+  /* separately allocated, so that the shards' locks don't share cache lines */
+  std::unique_ptr<shard> shards_[N];
+};
+
+template <class T, std::size_t N, class A>
+sharded_art<T, N, A>::sharded_art(std::function<void(T *)> free_fn) {
+  for (auto &s : shards_) {
+    s.reset(new shard(free_fn));
+  }
+}
+
+template <class T, std::size_t N, class A>
+std::size_t sharded_art<T, N, A>::shard_of(const char *key,
+                                           std::size_t key_len) {
+  /* FNV-1a, whose low bits are mixed by the finalizer of MurmurHash3 */
+  uint64_t h = 14695981039346656037ull;
+  for (std::size_t i = 0; i < key_len; ++i) {
+    h = (h ^ static_cast<unsigned char>(key[i])) * 1099511628211ull;
+  }
+  h ^= h >> 33;
+  h *= 0xff51afd7ed558ccdull;
+  h ^= h >> 33;
+  return static_cast<std::size_t>(h % N);
+}
+
+template <class T, std::size_t N, class A>
+bool sharded_art<T, N, A>::key_less(const std::string &a,
+                                    const std::string &b) {
+  std::size_t n = std::min(a.size(), b.size());
+  for (std::size_t i = 0; i < n; ++i) {
+    if (a[i] != b[i]) {
+      return static_cast<signed char>(a[i]) < static_cast<signed char>(b[i]);
+    }
+  }
+  return a.size() < b.size();
+}
+
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::get(const char *key) const {
+  return get(key, std::strlen(key) + 1);
+}
+
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::get(const char *key, std::size_t key_len) const {
+  const shard &s = *shards_[shard_of(key, key_len)];
+  std::lock_guard<std::mutex> guard(s.mutex_);
+  return s.tree_.get(key, key_len);
+}
+
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::set(const char *key, T *value) {
+  return set(key, std::strlen(key) + 1, value);
+}
+
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::set(const char *key, std::size_t key_len,
+                             T *value) {
+  shard &s = *shards_[shard_of(key, key_len)];
+  std::lock_guard<std::mutex> guard(s.mutex_);
+  return s.tree_.set(key, key_len, value);
+}
+
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::del(const char *key) {
+  return del(key, std::strlen(key) + 1);
+}
+
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::del(const char *key, std::size_t key_len) {
+  shard &s = *shards_[shard_of(key, key_len)];
+  std::lock_guard<std::mutex> guard(s.mutex_);
+  return s.tree_.del(key, key_len);
+}
+
+template <class T, std::size_t N, class A>
+typename sharded_art<T, N, A>::iterator sharded_art<T, N, A>::begin() {
+  iterator it;
+  it.its_.reserve(N);
+  for (auto &s : shards_) {
+    it.its_.push_back(s->tree_.begin());
+  }
+  it.make_heap();
+  return it;
+}
+
+template <class T, std::size_t N, class A>
+typename sharded_art<T, N, A>::iterator
+sharded_art<T, N, A>::begin(const char *key) {
+  return begin(key, std::strlen(key));
+}
+
+template <class T, std::size_t N, class A>
+typename sharded_art<T, N, A>::iterator
+sharded_art<T, N, A>::begin(const char *key, std::size_t key_len) {
+  iterator it;
+  it.its_.reserve(N);
+  for (auto &s : shards_) {
+    it.its_.push_back(s->tree_.begin(key, key_len));
+  }
+  it.make_heap();
+  return it;
+}
+
+template <class T, std::size_t N, class A>
+typename sharded_art<T, N, A>::iterator sharded_art<T, N, A>::end() {
+  return iterator();
+}
+
+template <class T, std::size_t N, class A>
+void sharded_art<T, N, A>::iterator::make_heap() {
+  for (std::size_t s = 0; s < its_.size(); ++s) {
+    if (its_[s] != tree_it<T>()) {
+      heap_.push_back(s);
+    }
+  }
+  std::make_heap(heap_.begin(), heap_.end(),
+                 [this](std::size_t a, std::size_t b) { return after(a, b); });
+}
+
+template <class T, std::size_t N, class A>
+bool sharded_art<T, N, A>::iterator::after(std::size_t a, std::size_t b) {
+  return key_less(its_[b].key(), its_[a].key());
+}
+
+template <class T, std::size_t N, class A>
+typename sharded_art<T, N, A>::iterator::value_type
+sharded_art<T, N, A>::iterator::operator*() {
+  return *its_[heap_.front()];
+}
+
+template <class T, std::size_t N, class A>
+typename sharded_art<T, N, A>::iterator::pointer
+sharded_art<T, N, A>::iterator::operator->() {
+  return its_[heap_.front()].operator->();
+}
+
+template <class T, std::size_t N, class A>
+typename sharded_art<T, N, A>::iterator &
+sharded_art<T, N, A>::iterator::operator++() {
+  auto order = [this](std::size_t a, std::size_t b) { return after(a, b); };
+  /* the least shard moves to the back, steps and is ordered again */
+  std::pop_heap(heap_.begin(), heap_.end(), order);
+  tree_it<T> &it = its_[heap_.back()];
+  if (++it == tree_it<T>()) {
+    heap_.pop_back();
+  } else {
+    std::push_heap(heap_.begin(), heap_.end(), order);
+  }
+  return *this;
+}
+
+template <class T, std::size_t N, class A>
+typename sharded_art<T, N, A>::iterator
+sharded_art<T, N, A>::iterator::operator++(int) {
+  auto old = *this;
+  operator++();
+  return old;
+}
+
+template <class T, std::size_t N, class A>
+bool sharded_art<T, N, A>::iterator::operator==(const iterator &rhs) const {
+  if (heap_.empty() || rhs.heap_.empty()) {
+    return heap_.empty() == rhs.heap_.empty();
+  }
+  return heap_.front() == rhs.heap_.front() &&
+         its_[heap_.front()] == rhs.its_[rhs.heap_.front()];
+}
+
+template <class T, std::size_t N, class A>
+bool sharded_art<T, N, A>::iterator::operator!=(const iterator &rhs) const {
+  return !(*this == rhs);
+}
+
+template <class T, std::size_t N, class A>
+const std::string &sharded_art<T, N, A>::iterator::key() {
+  return its_[heap_.front()].key();
+}
+
+#if __cplusplus >= 201703L
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::get(std::string_view key) const {
+  return get(key.data(), key.size());
+}
+
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::set(std::string_view key, T *value) {
+  return set(key.data(), key.size(), value);
+}
+
+template <class T, std::size_t N, class A>
+T *sharded_art<T, N, A>::del(std::string_view key) {
+  return del(key.data(), key.size());
+}
+#endif
+
+} // namespace art
+
+#endif
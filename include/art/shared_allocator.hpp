@@ -0,0 +1,96 @@
+/**
+ * @file reference counting allocator header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_SHARED_ALLOCATOR_HPP
+#define ART_SHARED_ALLOCATOR_HPP
+
+#include "allocator.hpp"
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace art {
+
+/**
+ * Allocator adapter that keeps a reference count in front of every block,
+ * for trees whose nodes are shared by several versions, see persistent_art.
+ *
+ * A block starts with one reference. The counts are atomic, so versions
+ * sharing blocks may be used and released by different threads, which
+ * requires A::allocate and A::deallocate to be thread-safe, e.g.
+ * heap_allocator.
+ */
+template <class A> class shared_allocator {
+public:
+  static const bool bulk_release = false;
+
+  void *allocate(std::size_t size);
+  void deallocate(void *p, std::size_t size);
+
+  /**
+   * Adds a reference to the given block.
+   */
+  static void acquire(const void *p);
+
+  /**
+   * Drops a reference to the given block.
+   *
+   * @return true if it was the last reference, the block may then be
+   * deallocated.
+   */
+  static bool release(const void *p);
+
+  /**
+   * Determines if the given block has more than one reference.
+   */
+  static bool is_shared(const void *p);
+
+private:
+  /* keeps the blocks 8 byte aligned */
+  static const std::size_t header_size = 8;
+
+  static std::atomic<uint32_t> &count(const void *p);
+
+  A alloc_;
+};
+
+template <class A>
+struct is_thread_safe_allocator<shared_allocator<A>>
+    : is_thread_safe_allocator<A> {};
+
+template <class A>
+std::atomic<uint32_t> &shared_allocator<A>::count(const void *p) {
+  return *reinterpret_cast<std::atomic<uint32_t> *>(
+      const_cast<char *>(static_cast<const char *>(p)) - header_size);
+}
+
+template <class A> void *shared_allocator<A>::allocate(std::size_t size) {
+  char *block = static_cast<char *>(alloc_.allocate(size + header_size));
+  new (block) std::atomic<uint32_t>(1);
+  return block + header_size;
+}
+
+template <class A>
+void shared_allocator<A>::deallocate(void *p, std::size_t size) {
+  alloc_.deallocate(static_cast<char *>(p) - header_size, size + header_size);
+}
+
+template <class A> void shared_allocator<A>::acquire(const void *p) {
+  count(p).fetch_add(1, std::memory_order_relaxed);
+}
+
+template <class A> bool shared_allocator<A>::release(const void *p) {
+  /* the last owner must see every write of the previous owners */
+  return count(p).fetch_sub(1, std::memory_order_acq_rel) == 1;
+}
+
+template <class A> bool shared_allocator<A>::is_shared(const void *p) {
+  return count(p).load(std::memory_order_acquire) > 1;
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,694 @@
+/**
+ * @file serialized snapshots and read-only views of trees
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_SNAPSHOT_HPP
+#define ART_SNAPSHOT_HPP
+
+#include "art.hpp"
+#include "inner_node.hpp"
+#include "leaf_node.hpp"
+#include "node.hpp"
+#include "persistent_art.hpp"
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <iterator>
+#include <ostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace art {
+
+/*
+ * Snapshot layout, all integers in the byte order of the writer and every
+ * record aligned to 8 bytes:
+ *
+ *   header  "ARTSNAP1" | uint32 version | uint32 sizeof(T)
+ *   records leaves and inner nodes, children before their parents
+ *   footer  uint64 offset of the root, 0 if empty | uint64 number of keys
+ *
+ * A leaf is uint8 0 | 3 bytes padding | uint32 key_len | the remaining
+ * key_len bytes of its key | padding | the bytes of the value.
+ *
+ * An inner node is uint8 1 | uint8 padding | uint16 n_children |
+ * uint32 prefix_len | the prefix_len bytes of its prefix | the n_children
+ * partial keys in ascending order | padding | n_children uint64 offsets of
+ * the children in the same order.
+ *
+ * Records refer to each other by offsets from the start of the snapshot,
+ * so a snapshot can be used wherever it is mapped.
+ */
+namespace snapshot_format {
+
+static const char magic[8] = {'A', 'R', 'T', 'S', 'N', 'A', 'P', '1'};
+static const uint32_t version = 1;
+static const std::size_t header_size = 16;
+static const std::size_t footer_size = 16;
+static const uint8_t leaf_kind = 0;
+static const uint8_t inner_kind = 1;
+
+inline std::size_t align(std::size_t offset) { return (offset + 7) & ~7; }
+
+template <class I> I read(const char *p) {
+  I i;
+  std::memcpy(&i, p, sizeof(I));
+  return i;
+}
+
+} // namespace snapshot_format
+
+/**
+ * Writes a snapshot of the given tree to the given stream, see art_view.
+ *
+ * The values are copied byte by byte, so T must be trivially copyable and
+ * must not point to other memory. The stream should be opened in binary
+ * mode.
+ *
+ * @throws std::invalid_argument if a value is a nullptr.
+ */
+template <class T, class A, class K>
+void serialize(const art<T, A, K> &tree, std::ostream &out);
+
+/**
+ * Writes a snapshot of the given version of a persistent_art, like the
+ * overload above. Other versions may be modified while it is written.
+ */
+template <class T, class A>
+void serialize(const persistent_art<T, A> &tree, std::ostream &out);
+
+/**
+ * Read-only tree over a snapshot written by serialize, which is used in
+ * place, e.g. straight from a mapped_file, without deserializing it.
+ *
+ * Lookups and iteration follow art, but values are returned as pointers
+ * into the snapshot. The snapshot must outlive the view and its iterators.
+ *
+ * @tparam T - The type of the values, which must be trivially copyable.
+ */
+template <class T> class art_view {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "values of snapshots must be trivially copyable");
+  static_assert(alignof(T) <= 8, "values of snapshots are 8 byte aligned");
+
+public:
+  /**
+   * Forward iterator over the keys of the snapshot in lexicographic order.
+   */
+  class iterator {
+  public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = const T *;
+    using difference_type = int;
+    using pointer = value_type *;
+
+    iterator() = default;
+
+    value_type operator*() const;
+    iterator &operator++();
+    iterator operator++(int);
+    bool operator==(const iterator &rhs) const;
+    bool operator!=(const iterator &rhs) const;
+
+    /**
+     * Returns the key of the current leaf, see tree_it::key().
+     */
+    const std::string &key() const;
+
+  private:
+    friend class art_view<T>;
+
+    struct frame {
+      uint64_t node_;
+      /* index of the child on the path */
+      int child_;
+      /* number of key bytes above the node's prefix */
+      int depth_;
+    };
+
+    explicit iterator(const art_view<T> *view);
+
+    void push(uint64_t node, int child, int depth);
+
+    /**
+     * Moves the iterator to the smallest leaf of the subtree at the given
+     * offset, whose prefix starts at the given depth.
+     */
+    void descend_min(uint64_t node, int depth);
+
+    /**
+     * Moves the iterator to the smallest leaf following the subtree of the
+     * deepest frame's current child, or to the end.
+     */
+    void next();
+
+    const art_view<T> *view_ = nullptr;
+    std::vector<frame> frames_;
+    /* 0 at the end */
+    uint64_t leaf_ = 0;
+    std::string key_;
+  };
+
+  /**
+   * @param data - The snapshot, 8 byte aligned.
+   * @param size - The number of bytes of the snapshot.
+   * @throws std::runtime_error if the data is no snapshot of values of type
+   * T.
+   */
+  art_view(const char *data, std::size_t size);
+
+  /**
+   * Finds the value associated with the given key.
+   *
+   * @return the value associated with the key or a nullptr.
+   */
+  const T *get(const char *key) const;
+  const T *get(const char *key, std::size_t key_len) const;
+
+#if __cplusplus >= 201703L
+  const T *get(std::string_view key) const;
+#endif
+
+  /**
+   * Forward iterator that traverses the snapshot in lexicographic order.
+   */
+  iterator begin() const;
+
+  /**
+   * Forward iterator starting from the first key not less than the given
+   * key, see art::begin(const char *).
+   */
+  iterator begin(const char *key) const;
+  iterator begin(const char *key, std::size_t key_len) const;
+
+  iterator end() const;
+
+  /**
+   * Visits every key starting with the given prefix, see art::scan_prefix.
+   * The visitor is called as `bool visitor(const std::string &key,
+   * const T *value)`.
+   */
+  template <class F>
+  void scan_prefix(const char *prefix, std::size_t prefix_len,
+                   F visitor) const;
+  template <class F> void scan_prefix(const char *prefix, F visitor) const;
+
+  /**
+   * Number of keys of the snapshot.
+   */
+  std::size_t size() const;
+
+private:
+  uint8_t kind(uint64_t node) const;
+  uint32_t len(uint64_t node) const;
+  /* prefix of an inner node or remaining key of a leaf */
+  const char *bytes(uint64_t node) const;
+  uint16_t n_children(uint64_t node) const;
+  const char *partial_keys(uint64_t node) const;
+  uint64_t child(uint64_t node, int i) const;
+  const T *value(uint64_t leaf) const;
+
+  /**
+   * Index of the first child whose partial key is not less than the given
+   * partial key, or n_children.
+   */
+  int lower_bound(uint64_t node, char partial_key) const;
+
+  const char *data_;
+  std::size_t size_;
+  uint64_t root_;
+  uint64_t n_keys_;
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+/**
+ * Read-only memory mapping of a whole file, e.g. of a snapshot. Processes
+ * mapping the same file share its pages.
+ */
+class mapped_file {
+public:
+  /**
+   * @throws std::runtime_error if the file can't be opened or mapped.
+   */
+  explicit mapped_file(const char *path);
+  mapped_file(const mapped_file &other) = delete;
+  mapped_file &operator=(const mapped_file &other) = delete;
+  ~mapped_file();
+
+  const char *data() const;
+  std::size_t size() const;
+
+private:
+  void *data_ = nullptr;
+  std::size_t size_ = 0;
+};
+
+inline mapped_file::mapped_file(const char *path) {
+  int fd = ::open(path, O_RDONLY);
+  if (fd < 0) {
+    throw std::runtime_error(std::string("can't open ") + path);
+  }
+  struct stat st;
+  if (::fstat(fd, &st) != 0) {
+    ::close(fd);
+    throw std::runtime_error(std::string("can't stat ") + path);
+  }
+  size_ = st.st_size;
+  if (size_ > 0) {
+    data_ = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  ::close(fd);
+  if (data_ == MAP_FAILED) {
+    data_ = nullptr;
+    throw std::runtime_error(std::string("can't map ") + path);
+  }
+}
+
+inline mapped_file::~mapped_file() {
+  if (data_ != nullptr) {
+    ::munmap(data_, size_);
+  }
+}
+
+inline const char *mapped_file::data() const {
+  return static_cast<const char *>(data_);
+}
+
+inline std::size_t mapped_file::size() const { return size_; }
+#endif
+
+namespace snapshot_format {
+
+/**
+ * Writes the records of a tree in post-order, so that the offsets of the
+ * children are known when their parent is written.
+ */
+template <class T, class L> class writer {
+public:
+  writer(std::ostream &out, const L &leaves) : out_(out), leaves_(leaves) {}
+
+  void write_header() {
+    uint32_t value_size = sizeof(T);
+    out_.write(magic, sizeof(magic));
+    write_int(version);
+    write_int(value_size);
+    offset_ = header_size;
+  }
+
+  void write_footer(uint64_t root) {
+    write_int(root);
+    write_int(n_keys_);
+  }
+
+  /**
+   * Writes the subtree n, whose prefix starts at the given depth, and
+   * returns the offset of its record.
+   */
+  uint64_t write(node<T> *n, int depth) {
+    if (is_leaf(n)) {
+      return write_leaf(n, depth);
+    }
+    auto inner = static_cast<inner_node<T> *>(n);
+    std::vector<char> partial_keys;
+    std::vector<uint64_t> children;
+    for (int slot = inner->next_slot(-1), n_slots = inner->n_slots();
+         slot < n_slots; slot = inner->next_slot(slot)) {
+      partial_keys.push_back(inner->slot_partial_key(slot));
+      children.push_back(write(*inner->slot_child(slot),
+                               depth + inner->prefix_len_ + 1));
+    }
+    uint64_t offset = offset_;
+    uint8_t kind = inner_kind, pad = 0;
+    uint16_t n_children = children.size();
+    uint32_t prefix_len = inner->prefix_len_;
+    write_int(kind);
+    write_int(pad);
+    write_int(n_children);
+    write_int(prefix_len);
+    write_bytes(inner->prefix(), prefix_len);
+    write_bytes(partial_keys.data(), partial_keys.size());
+    write_padding();
+    for (uint64_t child : children) {
+      write_int(child);
+    }
+    return offset;
+  }
+
+private:
+  uint64_t write_leaf(node<T> *leaf, int depth) {
+    T *value = leaf_value(leaf);
+    if (value == nullptr) {
+      throw std::invalid_argument("values of snapshots must not be null");
+    }
+    int key_len;
+    const char *key = leaves_.key(leaf, depth, key_len);
+    uint64_t offset = offset_;
+    uint8_t kind = leaf_kind;
+    char pad[3] = {0, 0, 0};
+    uint32_t len = key_len;
+    write_int(kind);
+    write_bytes(pad, sizeof(pad));
+    write_int(len);
+    write_bytes(key, key_len);
+    write_padding();
+    write_bytes(reinterpret_cast<const char *>(value), sizeof(T));
+    write_padding();
+    ++n_keys_;
+    return offset;
+  }
+
+  template <class I> void write_int(I i) {
+    write_bytes(reinterpret_cast<const char *>(&i), sizeof(I));
+  }
+
+  void write_bytes(const char *bytes, std::size_t n) {
+    out_.write(bytes, n);
+    offset_ += n;
+  }
+
+  void write_padding() {
+    static const char zeros[8] = {0};
+    write_bytes(zeros, align(offset_) - offset_);
+  }
+
+  std::ostream &out_;
+  const L &leaves_;
+  uint64_t offset_ = 0;
+  uint64_t n_keys_ = 0;
+};
+
+} // namespace snapshot_format
+
+template <class T, class A, class K>
+void serialize(const art<T, A, K> &tree, std::ostream &out) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "values of snapshots must be trivially copyable");
+  snapshot_format::writer<T, typename art<T, A, K>::leaves_type> w(
+      out, tree.leaves_);
+  w.write_header();
+  uint64_t root = tree.root_ != nullptr ? w.write(tree.root_, 0) : 0;
+  w.write_footer(root);
+}
+
+template <class T, class A>
+void serialize(const persistent_art<T, A> &tree, std::ostream &out) {
+  static_assert(std::is_trivially_copyable<T>::value,
+                "values of snapshots must be trivially copyable");
+  snapshot_format::writer<T, boxed_leaves<T>> w(out, tree.leaves_);
+  w.write_header();
+  uint64_t root = tree.root_ != nullptr ? w.write(tree.root_, 0) : 0;
+  w.write_footer(root);
+}
+
+template <class T>
+art_view<T>::art_view(const char *data, std::size_t size)
+    : data_(data), size_(size) {
+  using namespace snapshot_format;
+  if (reinterpret_cast<std::uintptr_t>(data) % 8 != 0) {
+    throw std::runtime_error("snapshots must be 8 byte aligned");
+  }
+  if (size < header_size + footer_size ||
+      std::memcmp(data, magic, sizeof(magic)) != 0 ||
+      read<uint32_t>(data + 8) != version) {
+    throw std::runtime_error("not a snapshot");
+  }
+  if (read<uint32_t>(data + 12) != sizeof(T)) {
+    throw std::runtime_error("snapshot of values of another size");
+  }
+  root_ = read<uint64_t>(data + size - footer_size);
+  n_keys_ = read<uint64_t>(data + size - 8);
+  if (root_ >= size - footer_size) {
+    throw std::runtime_error("corrupt snapshot");
+  }
+}
+
+template <class T> uint8_t art_view<T>::kind(uint64_t node) const {
+  return static_cast<uint8_t>(data_[node]);
+}
+
+template <class T> uint32_t art_view<T>::len(uint64_t node) const {
+  return snapshot_format::read<uint32_t>(data_ + node + 4);
+}
+
+template <class T> const char *art_view<T>::bytes(uint64_t node) const {
+  return data_ + node + 8;
+}
+
+template <class T> uint16_t art_view<T>::n_children(uint64_t node) const {
+  return snapshot_format::read<uint16_t>(data_ + node + 2);
+}
+
+template <class T>
+const char *art_view<T>::partial_keys(uint64_t node) const {
+  return bytes(node) + len(node);
+}
+
+template <class T> uint64_t art_view<T>::child(uint64_t node, int i) const {
+  std::size_t children = snapshot_format::align(node + 8 + len(node) +
+                                                n_children(node));
+  return snapshot_format::read<uint64_t>(data_ + children + 8 * i);
+}
+
+template <class T> const T *art_view<T>::value(uint64_t leaf) const {
+  return reinterpret_cast<const T *>(
+      data_ + snapshot_format::align(leaf + 8 + len(leaf)));
+}
+
+template <class T>
+int art_view<T>::lower_bound(uint64_t node, char partial_key) const {
+  const char *keys = partial_keys(node);
+  int lo = 0, hi = n_children(node), mid;
+  while (lo < hi) {
+    mid = (lo + hi) / 2;
+    if (keys[mid] < partial_key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+template <class T> const T *art_view<T>::get(const char *key) const {
+  return get(key, std::strlen(key) + 1);
+}
+
+template <class T>
+const T *art_view<T>::get(const char *key, std::size_t key_len) const {
+  if (root_ == 0) {
+    return nullptr;
+  }
+  uint64_t cur = root_;
+  int depth = 0, n = key_len, prefix_len, i;
+  while (true) {
+    prefix_len = len(cur);
+    if (kind(cur) == snapshot_format::leaf_kind) {
+      return prefix_len == n - depth &&
+                     std::memcmp(bytes(cur), key + depth, prefix_len) == 0
+                 ? value(cur)
+                 : nullptr;
+    }
+    if (prefix_len >= n - depth ||
+        std::memcmp(bytes(cur), key + depth, prefix_len) != 0) {
+      /* prefix mismatch or the key ends in an inner node */
+      return nullptr;
+    }
+    depth += prefix_len;
+    i = lower_bound(cur, key[depth]);
+    if (i == n_children(cur) || partial_keys(cur)[i] != key[depth]) {
+      return nullptr;
+    }
+    cur = child(cur, i);
+    ++depth;
+  }
+}
+
+template <class T>
+typename art_view<T>::iterator art_view<T>::begin() const {
+  iterator it(this);
+  if (root_ != 0) {
+    it.descend_min(root_, 0);
+  }
+  return it;
+}
+
+template <class T>
+typename art_view<T>::iterator art_view<T>::begin(const char *key) const {
+  return begin(key, std::strlen(key));
+}
+
+template <class T>
+typename art_view<T>::iterator art_view<T>::begin(const char *key,
+                                                  std::size_t key_len) const {
+  iterator it(this);
+  if (root_ == 0) {
+    return it;
+  }
+  uint64_t cur = root_;
+  int depth = 0, n = key_len, prefix_len, i;
+  const char *prefix;
+  while (true) {
+    prefix = bytes(cur);
+    prefix_len = len(cur);
+    for (i = 0; i < prefix_len; ++i) {
+      if (depth + i == n || prefix[i] > key[depth + i]) {
+        /* every key of the subtree is greater or equal */
+        it.descend_min(cur, depth);
+        return it;
+      }
+      if (prefix[i] < key[depth + i]) {
+        /* every key of the subtree is less */
+        it.next();
+        return it;
+      }
+    }
+    if (depth + prefix_len == n) {
+      it.descend_min(cur, depth);
+      return it;
+    }
+    if (kind(cur) == snapshot_format::leaf_kind) {
+      /* the leaf's key is a proper prefix of the key */
+      it.next();
+      return it;
+    }
+    i = lower_bound(cur, key[depth + prefix_len]);
+    if (i == n_children(cur)) {
+      /* every child is less */
+      it.next();
+      return it;
+    }
+    it.push(cur, i, depth);
+    depth += prefix_len + 1;
+    if (partial_keys(cur)[i] != key[depth - 1]) {
+      /* the first greater child */
+      it.descend_min(child(cur, i), depth);
+      return it;
+    }
+    cur = child(cur, i);
+  }
+}
+
+template <class T>
+typename art_view<T>::iterator art_view<T>::end() const {
+  return iterator();
+}
+
+template <class T>
+template <class F>
+void art_view<T>::scan_prefix(const char *prefix, std::size_t prefix_len,
+                              F visitor) const {
+  for (auto it = begin(prefix, prefix_len), it_end = end(); it != it_end;
+       ++it) {
+    const std::string &key = it.key();
+    if (key.size() < prefix_len ||
+        std::memcmp(key.data(), prefix, prefix_len) != 0) {
+      /* past the keys starting with the prefix */
+      return;
+    }
+    if (!visitor(key, *it)) {
+      return;
+    }
+  }
+}
+
+template <class T>
+template <class F>
+void art_view<T>::scan_prefix(const char *prefix, F visitor) const {
+  scan_prefix(prefix, std::strlen(prefix), visitor);
+}
+
+template <class T> std::size_t art_view<T>::size() const { return n_keys_; }
+
+#if __cplusplus >= 201703L
+template <class T> const T *art_view<T>::get(std::string_view key) const {
+  return get(key.data(), key.size());
+}
+#endif
+
+template <class T>
+art_view<T>::iterator::iterator(const art_view<T> *view) : view_(view) {}
+
+template <class T>
+void art_view<T>::iterator::push(uint64_t node, int child, int depth) {
+  frames_.push_back(frame{node, child, depth});
+  key_.resize(depth);
+  key_.append(view_->bytes(node), view_->len(node));
+  key_.push_back(view_->partial_keys(node)[child]);
+}
+
+template <class T>
+void art_view<T>::iterator::descend_min(uint64_t node, int depth) {
+  while (view_->kind(node) != snapshot_format::leaf_kind) {
+    push(node, 0, depth);
+    depth += view_->len(node) + 1;
+    node = view_->child(node, 0);
+  }
+  key_.resize(depth);
+  key_.append(view_->bytes(node), view_->len(node));
+  leaf_ = node;
+}
+
+template <class T> void art_view<T>::iterator::next() {
+  while (!frames_.empty()) {
+    frame &f = frames_.back();
+    if (++f.child_ < view_->n_children(f.node_)) {
+      int depth = f.depth_ + view_->len(f.node_);
+      key_.resize(depth);
+      key_.push_back(view_->partial_keys(f.node_)[f.child_]);
+      descend_min(view_->child(f.node_, f.child_), depth + 1);
+      return;
+    }
+    frames_.pop_back();
+  }
+  leaf_ = 0;
+}
+
+template <class T>
+typename art_view<T>::iterator::value_type
+art_view<T>::iterator::operator*() const {
+  return view_->value(leaf_);
+}
+
+template <class T>
+typename art_view<T>::iterator &art_view<T>::iterator::operator++() {
+  next();
+  return *this;
+}
+
+template <class T>
+typename art_view<T>::iterator art_view<T>::iterator::operator++(int) {
+  auto old = *this;
+  operator++();
+  return old;
+}
+
+template <class T>
+bool art_view<T>::iterator::operator==(const iterator &rhs) const {
+  return leaf_ == rhs.leaf_;
+}
+
+template <class T>
+bool art_view<T>::iterator::operator!=(const iterator &rhs) const {
+  return !(*this == rhs);
+}
+
+template <class T>
+const std::string &art_view<T>::iterator::key() const {
+  return key_;
+}
+
+} // namespace art
+
+#endif
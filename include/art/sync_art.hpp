@@ -0,0 +1,51 @@
+/**
+ * @file compile time selection of the tree's synchronization
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_SYNC_ART_HPP
+#define ART_SYNC_ART_HPP
+
+#include "allocator.hpp"
+#include "art.hpp"
+#include "olc_art.hpp"
+#include "rowex_art.hpp"
+
+namespace art {
+
+/**
+ * How a tree synchronizes concurrent operations.
+ */
+enum class sync {
+  /* single-threaded, see art */
+  none,
+  /* lookups restart when a writer interfered, see olc_art */
+  olc,
+  /* lookups never restart, writers copy nodes, see rowex_art */
+  rowex
+};
+
+template <class T, sync S> struct sync_art_type;
+
+template <class T> struct sync_art_type<T, sync::none> {
+  using type = art<T>;
+};
+
+template <class T> struct sync_art_type<T, sync::olc> {
+  using type = olc_art<T, heap_allocator>;
+};
+
+template <class T> struct sync_art_type<T, sync::rowex> {
+  using type = rowex_art<T, heap_allocator>;
+};
+
+/**
+ * Tree with the given synchronization. All of them provide get, set and
+ * del with the same signatures and semantics, so code can switch between
+ * them with a single template argument.
+ */
+template <class T, sync S> using sync_art = typename sync_art_type<T, S>::type;
+
+} // namespace art
+
+#endif
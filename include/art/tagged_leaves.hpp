@@ -0,0 +1,151 @@
+/**
+ * @file tagged leaves header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_TAGGED_LEAVES_HPP
+#define ART_TAGGED_LEAVES_HPP
+
+#include "node.hpp"
+#include <cstddef>
+#include <cstring>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace art {
+
+/**
+ * Leaf policy of trees with a key extractor (lazy expansion).
+ *
+ * Leaves are the value pointers themselves, tagged and stored directly in the
+ * parent's child slot, so inserting a value allocates no leaf. Leaves don't
+ * store any part of the key, it is obtained from the value when needed.
+ *
+ * @tparam K - Default constructible key extractor, called as
+ * `key_of(const T *value)`. It must return the key the value was inserted
+ * with for as long as the value is in the tree, either as a NUL-terminated
+ * `const char *`, whose terminator is part of the key like for the
+ * `const char *` overloads of art, or as a `std::string_view` (C++17).
+ */
+template <class T, class K> class tagged_leaves {
+  static_assert(alignof(T) >= 2,
+                "tagged leaves need the lowest bit of value pointers");
+
+public:
+  static const bool trivially_destructible = true;
+
+  template <class A>
+  node<T> *make(const char *key, int key_len, T *value, A &alloc) const;
+  bool matches(const node<T> *leaf, const char *key, int depth,
+               int key_len) const;
+  const char *key(const node<T> *leaf, int depth, int &len) const;
+  template <class A> void trim(node<T> *leaf, int n, A &alloc) const;
+  template <class A>
+  void split(node<T> *leaf, node<T> &parent, const char *prefix,
+             int prefix_len, A &alloc) const;
+  template <class A>
+  void prepend(node<T> *leaf, const char *prefix, int prefix_len,
+               char partial_key, A &alloc) const;
+  template <class A>
+  void prepend(node<T> *leaf, node<T> &parent, char partial_key,
+               A &alloc) const;
+  void set_value(node<T> *&slot, T *value) const;
+  std::size_t size(const node<T> *leaf) const;
+  template <class A> void destroy(node<T> *leaf, A &alloc) const;
+
+private:
+  static const char *key_bytes(const char *key, int &len);
+#if __cplusplus >= 201703L
+  static const char *key_bytes(std::string_view key, int &len);
+#endif
+
+  K key_of_;
+};
+
+template <class T, class K>
+const bool tagged_leaves<T, K>::trivially_destructible;
+
+template <class T, class K>
+template <class A>
+node<T> *tagged_leaves<T, K>::make(const char * /* key */, int /* key_len */,
+                                   T *value, A & /* alloc */) const {
+  return tag_leaf(value);
+}
+
+template <class T, class K>
+bool tagged_leaves<T, K>::matches(const node<T> *leaf, const char *key,
+                                  int depth, int key_len) const {
+  int len;
+  const char *leaf_key = key_bytes(key_of_(untag_leaf(leaf)), len);
+  /* the first depth bytes were matched on the way down */
+  return len == key_len &&
+         std::memcmp(leaf_key + depth, key + depth, len - depth) == 0;
+}
+
+template <class T, class K>
+const char *tagged_leaves<T, K>::key(const node<T> *leaf, int depth,
+                                     int &len) const {
+  const char *key = key_bytes(key_of_(untag_leaf(leaf)), len);
+  len -= depth;
+  return key + depth;
+}
+
+template <class T, class K>
+template <class A>
+void tagged_leaves<T, K>::trim(node<T> * /* leaf */, int /* n */,
+                               A & /* alloc */) const {}
+
+template <class T, class K>
+template <class A>
+void tagged_leaves<T, K>::split(node<T> * /* leaf */, node<T> &parent,
+                                const char *prefix, int prefix_len,
+                                A &alloc) const {
+  parent.set_prefix(prefix, prefix_len, alloc);
+}
+
+template <class T, class K>
+template <class A>
+void tagged_leaves<T, K>::prepend(node<T> * /* leaf */,
+                                  const char * /* prefix */,
+                                  int /* prefix_len */, char /* partial_key */,
+                                  A & /* alloc */) const {}
+
+template <class T, class K>
+template <class A>
+void tagged_leaves<T, K>::prepend(node<T> * /* leaf */, node<T> & /* parent */,
+                                  char /* partial_key */,
+                                  A & /* alloc */) const {}
+
+template <class T, class K>
+void tagged_leaves<T, K>::set_value(node<T> *&slot, T *value) const {
+  slot = tag_leaf(value);
+}
+
+template <class T, class K>
+std::size_t tagged_leaves<T, K>::size(const node<T> * /* leaf */) const {
+  return 0;
+}
+
+template <class T, class K>
+template <class A>
+void tagged_leaves<T, K>::destroy(node<T> * /* leaf */,
+                                  A & /* alloc */) const {}
+
+template <class T, class K>
+const char *tagged_leaves<T, K>::key_bytes(const char *key, int &len) {
+  len = std::strlen(key) + 1;
+  return key;
+}
+
+#if __cplusplus >= 201703L
+template <class T, class K>
+const char *tagged_leaves<T, K>::key_bytes(std::string_view key, int &len) {
+  len = key.size();
+  return key.data();
+}
+#endif
+
+} // namespace art
+
+#endif
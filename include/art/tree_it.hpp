@@ -6,28 +6,76 @@
 #ifndef ART_TREE_IT_HPP
 #define ART_TREE_IT_HPP
 
-#include "child_it.hpp"
-#include <cassert>
-#include <cstring>
-#include <iostream>
+#include "leaf_node.hpp"
+#include "node.hpp"
+#include <cstddef>
 #include <iterator>
-#include <stack>
+#include <string>
+#include <vector>
 
 namespace art {
 
-template <class T> class node;
 template <class T> class inner_node;
-template <class T> class leaf_node;
 
+/**
+ * Bidirectional iterator over the leaves of a tree in lexicographic key
+ * order.
+ *
+ * The iterator keeps the path from the root to the current leaf as a stack
+ * of (inner node, child slot) frames and walks the tree in-order by stepping
+ * the slot of the deepest frame, so no siblings are pushed and stepping
+ * doesn't allocate. Stepping past the first or the last leaf yields the
+ * end, and decrementing (incrementing) the end yields the last (first)
+ * leaf, so the leaves are visited in descending order by decrementing an
+ * iterator from max or less_equal until it equals the end.
+ *
+ * The first max_depth frames are stored inline, deeper paths, which need
+ * keys with more than max_depth branching points, spill onto the heap.
+ *
+ * The bytes of the current leaf's key are reconstructed from the prefixes
+ * and partial keys of the path, see key().
+ */
 template <class T> class tree_it {
 public:
+  static const int max_depth = 32;
+
   tree_it() = default;
-  explicit tree_it(std::stack<node<T> *> traversal_stack);
 
-  static tree_it<T> min(node<T> *root);
-  static tree_it<T> greater_equal(node<T> *root, const char *key);
+  /**
+   * @param leaves - The leaf policy of the tree, used for reading the keys
+   * of leaves.
+   */
+  template <class L> static tree_it<T> min(node<T> *root, const L &leaves);
+
+  /**
+   * @param key_len - The number of bytes of the key.
+   * @param leaves - The leaf policy of the tree, used for reading the keys
+   * of leaves.
+   */
+  template <class L>
+  static tree_it<T> greater_equal(node<T> *root, const char *key,
+                                  int key_len, const L &leaves);
+
+  /**
+   * Returns an iterator at the last leaf, see min.
+   */
+  template <class L> static tree_it<T> max(node<T> *root, const L &leaves);
+
+  /**
+   * Returns an iterator at the last leaf whose key is not greater than the
+   * given key, see greater_equal.
+   */
+  template <class L>
+  static tree_it<T> less_equal(node<T> *root, const char *key, int key_len,
+                               const L &leaves);
 
-  using iterator_category = std::forward_iterator_tag;
+  /**
+   * Returns the end of the tree, which can be decremented to the last
+   * leaf, unlike a default constructed iterator.
+   */
+  template <class L> static tree_it<T> end(node<T> *root, const L &leaves);
+
+  using iterator_category = std::bidirectional_iterator_tag;
   using value_type = T *;
   using difference_type = int;
   using pointer = value_type *;
@@ -38,111 +86,358 @@ public:
   pointer operator->();
   tree_it<T> &operator++();
   tree_it<T> operator++(int);
+  tree_it<T> &operator--();
+  tree_it<T> operator--(int);
   bool operator==(const tree_it<T> &rhs) const;
   bool operator!=(const tree_it<T> &rhs) const;
 
+  /**
+   * Returns the key of the current leaf.
+   *
+   * The key is assembled in a buffer owned by the iterator, which is reused
+   * for every leaf and is only valid until the iterator is advanced. Keys
+   * inserted through the `const char *` overloads include their terminator.
+   */
+  const std::string &key();
+
 private:
-  std::stack<node<T> *> traversal_stack_;
+  struct frame {
+    inner_node<T> *node_;
+    /* slot of the child on the path */
+    int slot_;
+    /* number of key bytes above the node's prefix */
+    int depth_;
+  };
+
+  using leaf_key_fn = const char *(*)(const void *leaves, const node<T> *leaf,
+                                      int depth, int &len);
+
+  template <class L>
+  static const char *leaf_key(const void *leaves, const node<T> *leaf,
+                              int depth, int &len);
+
+  template <class L> tree_it(node<T> *root, const L &leaves);
+
+  frame &at(int i);
+  void push(inner_node<T> *n, int slot, int depth);
+
+  /**
+   * Moves the iterator to the smallest leaf of the subtree rooted at n,
+   * whose prefix starts at the given depth.
+   */
+  void descend_min(node<T> *n, int depth);
+
+  /**
+   * Moves the iterator to the greatest leaf of the subtree rooted at n.
+   */
+  void descend_max(node<T> *n, int depth);
+
+  /**
+   * Moves the iterator to the smallest leaf following the subtree of the
+   * deepest frame's current child, or to the end.
+   */
+  void next();
+
+  /**
+   * Moves the iterator to the greatest leaf preceding the subtree of the
+   * deepest frame's current child, or to the end.
+   */
+  void prev();
+
+  frame frames_[max_depth];
+  std::vector<frame> deep_frames_;
+  int n_frames_ = 0;
+
+  /* decrementing the end starts over from the root */
+  node<T> *root_ = nullptr;
+  /* nullptr at the end */
+  node<T> *leaf_ = nullptr;
+  /* number of key bytes above the leaf's prefix */
+  int leaf_depth_ = 0;
+
+  /* bytes of the path, the leaf's own bytes are appended by key() */
+  std::string key_;
+
+  const void *leaves_ = nullptr;
+  leaf_key_fn leaf_key_ = nullptr;
+
+  /* tagged leaves have no value_ member to point to */
+  value_type cur_value_ = nullptr;
 };
 
 template <class T>
-tree_it<T>::tree_it(std::stack<node<T> *> traversal_stack)
-    : traversal_stack_(traversal_stack) {
+template <class L>
+const char *tree_it<T>::leaf_key(const void *leaves, const node<T> *leaf,
+                                 int depth, int &len) {
+  return static_cast<const L *>(leaves)->key(leaf, depth, len);
+}
+
+template <class T>
+template <class L>
+tree_it<T>::tree_it(node<T> *root, const L &leaves)
+    : root_(root), leaves_(&leaves), leaf_key_(&tree_it<T>::leaf_key<L>) {}
+
+template <class T> typename tree_it<T>::frame &tree_it<T>::at(int i) {
+  return i < max_depth ? frames_[i] : deep_frames_[i - max_depth];
+}
+
+template <class T>
+void tree_it<T>::push(inner_node<T> *n, int slot, int depth) {
+  if (n_frames_ >= max_depth &&
+      n_frames_ - max_depth == static_cast<int>(deep_frames_.size())) {
+    deep_frames_.push_back(frame());
+  }
+  frame &f = at(n_frames_++);
+  f.node_ = n;
+  f.slot_ = slot;
+  f.depth_ = depth;
+  key_.resize(depth);
+  key_.append(n->prefix(), n->prefix_len_);
+  key_.push_back(n->slot_partial_key(slot));
+}
+
+template <class T> void tree_it<T>::descend_min(node<T> *n, int depth) {
+  inner_node<T> *cur;
+  int slot;
+  while (!is_leaf(n)) {
+    cur = static_cast<inner_node<T> *>(n);
+    slot = cur->next_slot(-1);
+    push(cur, slot, depth);
+    depth += cur->prefix_len_ + 1;
+    n = *cur->slot_child(slot);
+  }
+  leaf_ = n;
+  leaf_depth_ = depth;
+}
+
+template <class T> void tree_it<T>::descend_max(node<T> *n, int depth) {
   inner_node<T> *cur;
-  char child_partial_key;
-  node<T> *child;
-  std::reverse_iterator<child_it<T>> child_it, child_it_end;
-
-  /* preorder-traverse until leaf node found or no nodes are left */
-  while (!traversal_stack_.empty() && !traversal_stack_.top()->is_leaf()) {
-    cur = static_cast<inner_node<T> *>(traversal_stack_.top());
-    traversal_stack_.pop();
-    child_it = cur->rbegin();
-    child_it_end = cur->rend();
-    for (; child_it != child_it_end; ++child_it) {
-      child_partial_key = *child_it;
-      child = *cur->find_child(child_partial_key);
-      traversal_stack_.push(child);
+  int slot;
+  while (!is_leaf(n)) {
+    cur = static_cast<inner_node<T> *>(n);
+    slot = cur->prev_slot(cur->n_slots());
+    push(cur, slot, depth);
+    depth += cur->prefix_len_ + 1;
+    n = *cur->slot_child(slot);
+  }
+  leaf_ = n;
+  leaf_depth_ = depth;
+}
+
+template <class T> void tree_it<T>::next() {
+  int slot;
+  while (n_frames_ > 0) {
+    frame &f = at(n_frames_ - 1);
+    slot = f.node_->next_slot(f.slot_);
+    if (slot < f.node_->n_slots()) {
+      f.slot_ = slot;
+      key_.resize(f.depth_ + f.node_->prefix_len_);
+      key_.push_back(f.node_->slot_partial_key(slot));
+      descend_min(*f.node_->slot_child(slot),
+                  f.depth_ + f.node_->prefix_len_ + 1);
+      return;
     }
+    --n_frames_;
   }
+  leaf_ = nullptr;
 }
 
-template <class T> tree_it<T> tree_it<T>::min(node<T> *root) {
-  return tree_it<T>::greater_equal(root, "");
+template <class T> void tree_it<T>::prev() {
+  int slot;
+  while (n_frames_ > 0) {
+    frame &f = at(n_frames_ - 1);
+    slot = f.node_->prev_slot(f.slot_);
+    if (slot >= 0) {
+      f.slot_ = slot;
+      key_.resize(f.depth_ + f.node_->prefix_len_);
+      key_.push_back(f.node_->slot_partial_key(slot));
+      descend_max(*f.node_->slot_child(slot),
+                  f.depth_ + f.node_->prefix_len_ + 1);
+      return;
+    }
+    --n_frames_;
+  }
+  leaf_ = nullptr;
 }
 
 template <class T>
-tree_it<T> tree_it<T>::greater_equal(node<T> *root, const char *key) {
-  if (root == nullptr) {
-    return tree_it<T>();
+template <class L>
+tree_it<T> tree_it<T>::min(node<T> *root, const L &leaves) {
+  tree_it<T> it(root, leaves);
+  if (root != nullptr) {
+    it.descend_min(root, 0);
   }
+  return it;
+}
 
-  int cur_depth, key_len = std::strlen(key), i;
-  node<T> *cur;
-  std::reverse_iterator<child_it<T>> child_it, child_it_end;
-  char partial_key;
-  std::stack<node<T> *> node_stack;
-  std::stack<int> depth_stack;
+template <class T>
+template <class L>
+tree_it<T> tree_it<T>::greater_equal(node<T> *root, const char *key,
+                                     int key_len, const L &leaves) {
+  tree_it<T> it(root, leaves);
+  if (root == nullptr) {
+    return it;
+  }
 
-  node_stack.push(root);
-  depth_stack.push(0);
+  int depth = 0, i, prefix_len, slot, n_slots;
+  node<T> *cur = root;
+  inner_node<T> *cur_inner;
+  const char *prefix;
+  char partial_key, key_partial_key;
 
   while (true) {
-    cur = node_stack.top();
-    cur_depth = depth_stack.top();
-
-    if (cur_depth == key_len) {
-        return tree_it<T>(node_stack);
+    if (is_leaf(cur)) {
+      prefix = leaves.key(cur, depth, prefix_len);
+    } else {
+      prefix = cur->prefix();
+      prefix_len = cur->prefix_len_;
     }
-    for (i = 0; i < cur->prefix_len_; ++i) {
-      if (cur_depth + i == key_len) {
-        return tree_it<T>(node_stack);
+    for (i = 0; i < prefix_len; ++i) {
+      if (depth + i == key_len || prefix[i] > key[depth + i]) {
+        /* every key of the subtree is greater or equal */
+        it.descend_min(cur, depth);
+        return it;
       }
-      if (cur->prefix_[i] < key[cur_depth + i]) {
-        node_stack.pop();
-        /* optional because depth_stack is not used outside this method */
-        /* depth_stack.pop(); */
-        return tree_it<T>(node_stack);
+      if (prefix[i] < key[depth + i]) {
+        /* every key of the subtree is less */
+        it.next();
+        return it;
       }
     }
-    node_stack.pop();
-    depth_stack.pop();
-    if (cur->is_leaf()) {
-      continue;
-    }
-    child_it = static_cast<inner_node<T> *>(cur)->rbegin();
-    child_it_end = static_cast<inner_node<T> *>(cur)->rend();
-    for (; child_it != child_it_end; ++child_it) {
-      partial_key = *child_it;
-      if (partial_key < key[cur_depth + cur->prefix_len_]) {
-        break;
+    if (depth + prefix_len == key_len) {
+      it.descend_min(cur, depth);
+      return it;
+    }
+    if (is_leaf(cur)) {
+      /* the leaf's key is a proper prefix of the key */
+      it.next();
+      return it;
+    }
+    cur_inner = static_cast<inner_node<T> *>(cur);
+    key_partial_key = key[depth + prefix_len];
+    n_slots = cur_inner->n_slots();
+    slot = cur_inner->next_slot(-1);
+    while (slot < n_slots &&
+           cur_inner->slot_partial_key(slot) < key_partial_key) {
+      slot = cur_inner->next_slot(slot);
+    }
+    if (slot == n_slots) {
+      /* every child is less */
+      it.next();
+      return it;
+    }
+    partial_key = cur_inner->slot_partial_key(slot);
+    it.push(cur_inner, slot, depth);
+    depth += prefix_len + 1;
+    cur = *cur_inner->slot_child(slot);
+    if (partial_key > key_partial_key) {
+      /* the first greater child */
+      it.descend_min(cur, depth);
+      return it;
+    }
+  }
+}
+
+template <class T>
+template <class L>
+tree_it<T> tree_it<T>::max(node<T> *root, const L &leaves) {
+  tree_it<T> it(root, leaves);
+  if (root != nullptr) {
+    it.descend_max(root, 0);
+  }
+  return it;
+}
+
+template <class T>
+template <class L>
+tree_it<T> tree_it<T>::less_equal(node<T> *root, const char *key,
+                                  int key_len, const L &leaves) {
+  tree_it<T> it(root, leaves);
+  if (root == nullptr) {
+    return it;
+  }
+
+  int depth = 0, i, prefix_len, slot;
+  node<T> *cur = root;
+  inner_node<T> *cur_inner;
+  const char *prefix;
+  char partial_key, key_partial_key;
+
+  while (true) {
+    if (is_leaf(cur)) {
+      prefix = leaves.key(cur, depth, prefix_len);
+    } else {
+      prefix = cur->prefix();
+      prefix_len = cur->prefix_len_;
+    }
+    for (i = 0; i < prefix_len; ++i) {
+      if (depth + i == key_len || prefix[i] > key[depth + i]) {
+        /* every key of the subtree is greater */
+        it.prev();
+        return it;
       }
-      node_stack.push(*static_cast<inner_node<T> *>(cur)->find_child(partial_key));
-      depth_stack.push(cur_depth + cur->prefix_len_ + 1);
+      if (prefix[i] < key[depth + i]) {
+        /* every key of the subtree is less */
+        it.descend_max(cur, depth);
+        return it;
+      }
+    }
+    if (is_leaf(cur)) {
+      /* the leaf's key equals the key or is a proper prefix of it */
+      it.descend_max(cur, depth);
+      return it;
+    }
+    if (depth + prefix_len == key_len) {
+      /* the key is a proper prefix of every key of the subtree */
+      it.prev();
+      return it;
+    }
+    cur_inner = static_cast<inner_node<T> *>(cur);
+    key_partial_key = key[depth + prefix_len];
+    slot = cur_inner->prev_slot(cur_inner->n_slots());
+    while (slot >= 0 && cur_inner->slot_partial_key(slot) > key_partial_key) {
+      slot = cur_inner->prev_slot(slot);
+    }
+    if (slot < 0) {
+      /* every child is greater */
+      it.prev();
+      return it;
+    }
+    partial_key = cur_inner->slot_partial_key(slot);
+    it.push(cur_inner, slot, depth);
+    depth += prefix_len + 1;
+    cur = *cur_inner->slot_child(slot);
+    if (partial_key < key_partial_key) {
+      /* the last smaller child */
+      it.descend_max(cur, depth);
+      return it;
     }
   }
 }
 
+template <class T>
+template <class L>
+tree_it<T> tree_it<T>::end(node<T> *root, const L &leaves) {
+  return tree_it<T>(root, leaves);
+}
+
 template <class T> typename tree_it<T>::value_type tree_it<T>::operator*() {
-  return static_cast<leaf_node<T> *>(traversal_stack_.top())->value_;
+  return leaf_value(leaf_);
 }
 
 template <class T> typename tree_it<T>::pointer tree_it<T>::operator->() {
-  return &static_cast<leaf_node<T> *>(traversal_stack_.top())->value_;
+  cur_value_ = leaf_value(leaf_);
+  return &cur_value_;
 }
 
 template <class T> tree_it<T> &tree_it<T>::operator++() {
-  inner_node<T> *cur;
-  std::reverse_iterator<child_it<T>> it, it_end;
-
-  traversal_stack_.pop();
-  while (!traversal_stack_.empty() && !traversal_stack_.top()->is_leaf()) {
-    cur = static_cast<inner_node<T> *>(traversal_stack_.top());
-    traversal_stack_.pop();
-    for (it = cur->rbegin(), it_end = cur->rend(); it != it_end; ++it) {
-      traversal_stack_.push(*cur->find_child(*it));
+  if (leaf_ == nullptr) {
+    if (root_ != nullptr) {
+      descend_min(root_, 0);
     }
-  };
+  } else {
+    next();
+  }
   return *this;
 }
 
@@ -152,10 +447,33 @@ template <class T> tree_it<T> tree_it<T>::operator++(int) {
   return old;
 }
 
+template <class T> tree_it<T> &tree_it<T>::operator--() {
+  if (leaf_ == nullptr) {
+    if (root_ != nullptr) {
+      descend_max(root_, 0);
+    }
+  } else {
+    prev();
+  }
+  return *this;
+}
+
+template <class T> tree_it<T> tree_it<T>::operator--(int) {
+  auto old = *this;
+  operator--();
+  return old;
+}
+
+template <class T> const std::string &tree_it<T>::key() {
+  int len;
+  const char *bytes = leaf_key_(leaves_, leaf_, leaf_depth_, len);
+  key_.resize(leaf_depth_);
+  key_.append(bytes, len);
+  return key_;
+}
+
 template <class T> bool tree_it<T>::operator==(const tree_it<T> &rhs) const {
-  return (traversal_stack_.empty() && rhs.traversal_stack_.empty()) ||
-         (!traversal_stack_.empty() && !rhs.traversal_stack_.empty() &&
-          traversal_stack_.top() == rhs.traversal_stack_.top());
+  return leaf_ == rhs.leaf_;
 }
 
 template <class T> bool tree_it<T>::operator!=(const tree_it<T> &rhs) const {
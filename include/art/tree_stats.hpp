@@ -0,0 +1,99 @@
+/**
+ * @file tree statistics header
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_TREE_STATS_HPP
+#define ART_TREE_STATS_HPP
+
+#include <cstddef>
+
+namespace art {
+
+/**
+ * Shape and memory usage of a tree, see art::stats.
+ *
+ * The tree updates the statistics as it is modified, so reading them
+ * doesn't visit any node.
+ */
+struct tree_stats {
+  std::size_t n_node_4 = 0;
+  std::size_t n_node_16 = 0;
+  std::size_t n_node_48 = 0;
+  std::size_t n_node_256 = 0;
+
+  /* leaf buckets of a bucket_art, whose keys are counted in n_leaves */
+  std::size_t n_buckets = 0;
+
+  /* number of keys */
+  std::size_t n_leaves = 0;
+
+  /* bytes of the inner nodes' prefixes */
+  std::size_t prefix_bytes = 0;
+
+  /* bytes requested from the allocator for nodes, leaves and prefixes */
+  std::size_t memory_bytes = 0;
+
+  /*
+   * Sum of the depths of all leaves, in key bytes consumed by the inner
+   * nodes above the leaf, i.e. their prefixes and partial keys.
+   */
+  std::size_t depth_sum = 0;
+
+  /* fan_out[i] is the number of inner nodes with i children */
+  std::size_t fan_out[257] = {};
+
+  /* events since the tree was created */
+  std::size_t n_grows = 0;
+  std::size_t n_shrinks = 0;
+  /* inner node prefixes split by set */
+  std::size_t n_prefix_splits = 0;
+  /* full leaf buckets replaced by inner nodes by set */
+  std::size_t n_bursts = 0;
+
+  std::size_t n_inner_nodes() const;
+
+  /**
+   * Average depth of the leaves, see depth_sum.
+   */
+  double average_depth() const;
+
+  double bytes_per_key() const;
+
+  /**
+   * Adds the shape and memory usage of another tree, but not its events,
+   * e.g. of a tree merged into this one.
+   */
+  void add_shape(const tree_stats &other);
+};
+
+inline std::size_t tree_stats::n_inner_nodes() const {
+  return n_node_4 + n_node_16 + n_node_48 + n_node_256;
+}
+
+inline double tree_stats::average_depth() const {
+  return n_leaves == 0 ? 0 : static_cast<double>(depth_sum) / n_leaves;
+}
+
+inline double tree_stats::bytes_per_key() const {
+  return n_leaves == 0 ? 0 : static_cast<double>(memory_bytes) / n_leaves;
+}
+
+inline void tree_stats::add_shape(const tree_stats &other) {
+  n_node_4 += other.n_node_4;
+  n_node_16 += other.n_node_16;
+  n_node_48 += other.n_node_48;
+  n_node_256 += other.n_node_256;
+  n_buckets += other.n_buckets;
+  n_leaves += other.n_leaves;
+  prefix_bytes += other.prefix_bytes;
+  memory_bytes += other.memory_bytes;
+  depth_sum += other.depth_sum;
+  for (int i = 0; i < 257; ++i) {
+    fan_out[i] += other.fan_out[i];
+  }
+}
+
+} // namespace art
+
+#endif
@@ -0,0 +1,248 @@
+/**
+ * @file adaptive radix tree storing values by value
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_VALUE_ART_HPP
+#define ART_VALUE_ART_HPP
+
+#include "allocator.hpp"
+#include "art.hpp"
+#include "inline_leaves.hpp"
+#include "leaf_node.hpp"
+#include "node.hpp"
+#include "tree_it.hpp"
+#include "tree_stats.hpp"
+#include <cstddef>
+#include <cstring>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#if __cplusplus >= 201703L
+#include <string_view>
+#endif
+
+namespace art {
+
+/**
+ * Adaptive radix tree that owns its values.
+ *
+ * Every value is moved into its leaf, see inline_leaf, so that a lookup
+ * finds the value on the cache line of the leaf instead of behind another
+ * pointer, and no separately allocated value has to outlive the tree.
+ * Values are destroyed with their leaves; if V is trivially destructible
+ * and the allocator releases in bulk, destroying the tree visits no node.
+ *
+ * Keys are the same as for art.
+ *
+ * @tparam V - The type of the values, which must be move constructible and
+ * move assignable.
+ * @tparam A - The allocator used for leaves, nodes and prefixes.
+ */
+template <class V, class A = pool_allocator> class value_art {
+public:
+  /**
+   * Finds the value associated with the given key.
+   *
+   * @return a pointer to the value in the tree, valid until the key is
+   * deleted, or a nullptr.
+   */
+  V *get(const char *key) const;
+  V *get(const char *key, std::size_t key_len) const;
+
+  /**
+   * Associates the given key with the given value, which is moved into the
+   * tree or assigned to the previously associated value.
+   *
+   * @return true if the key was inserted.
+   * @throws std::invalid_argument if the key is a proper prefix of a key in
+   * the tree or the other way around, the tree is left unchanged.
+   */
+  bool set(const char *key, V value);
+  bool set(const char *key, std::size_t key_len, V value);
+
+  /**
+   * Inserts a value constructed from the given arguments unless the key
+   * exists, in which case nothing is constructed.
+   *
+   * @return the value associated with the key and true if it was inserted.
+   */
+  template <class... Args>
+  std::pair<V *, bool> try_emplace(const char *key, std::size_t key_len,
+                                   Args &&... args);
+
+  /**
+   * Deletes the given key and destroys its value.
+   *
+   * @return true if the key existed.
+   */
+  bool del(const char *key);
+  bool del(const char *key, std::size_t key_len);
+
+#if __cplusplus >= 201703L
+  V *get(std::string_view key) const;
+  bool set(std::string_view key, V value);
+  bool del(std::string_view key);
+#endif
+
+  /**
+   * Iterators over the values in key order, see art::begin and art::last.
+   */
+  tree_it<V> begin();
+  tree_it<V> begin(const char *key);
+  tree_it<V> begin(const char *key, std::size_t key_len);
+  tree_it<V> last();
+  tree_it<V> last(const char *key);
+  tree_it<V> last(const char *key, std::size_t key_len);
+  tree_it<V> end();
+
+  /**
+   * Returns the shape and memory usage of the tree, see art::stats.
+   */
+  const tree_stats &stats() const;
+
+  /**
+   * Deletes every key and destroys the values in parallel, see
+   * art::parallel_clear.
+   */
+  void parallel_clear(unsigned n_threads = std::thread::hardware_concurrency());
+
+  /**
+   * Moves the leaves, values and nodes to a new allocator in depth-first
+   * order, see art::compact.
+   */
+  std::size_t compact();
+
+private:
+  art<V, A, inline_values> tree_;
+};
+
+template <class V, class A> V *value_art<V, A>::get(const char *key) const {
+  return tree_.get(key);
+}
+
+template <class V, class A>
+V *value_art<V, A>::get(const char *key, std::size_t key_len) const {
+  return tree_.get(key, key_len);
+}
+
+template <class V, class A>
+bool value_art<V, A>::set(const char *key, V value) {
+  return set(key, std::strlen(key) + 1, std::move(value));
+}
+
+template <class V, class A>
+bool value_art<V, A>::set(const char *key, std::size_t key_len, V value) {
+  bool inserted;
+  node<V> **slot = tree_.upsert(
+      key, key_len, [&value]() { return &value; }, inserted);
+  if (!inserted) {
+    tree_.leaves_.set_value(*slot, &value);
+  }
+  return inserted;
+}
+
+template <class V, class A>
+template <class... Args>
+std::pair<V *, bool> value_art<V, A>::try_emplace(const char *key,
+                                                  std::size_t key_len,
+                                                  Args &&... args) {
+  /* the value is constructed here and moved into the leaf */
+  typename std::aligned_storage<sizeof(V), alignof(V)>::type buf;
+  V *tmp = nullptr;
+  bool inserted;
+  node<V> **slot;
+  try {
+    slot = tree_.upsert(key, key_len,
+                        [&]() {
+                          tmp = new (&buf) V(std::forward<Args>(args)...);
+                          return tmp;
+                        },
+                        inserted);
+  } catch (...) {
+    if (tmp != nullptr) {
+      tmp->~V();
+    }
+    throw;
+  }
+  if (tmp != nullptr) {
+    tmp->~V();
+  }
+  return std::make_pair(leaf_value(*slot), inserted);
+}
+
+template <class V, class A> bool value_art<V, A>::del(const char *key) {
+  return del(key, std::strlen(key) + 1);
+}
+
+template <class V, class A>
+bool value_art<V, A>::del(const char *key, std::size_t key_len) {
+  return tree_.erase(key, key_len, nullptr);
+}
+
+#if __cplusplus >= 201703L
+template <class V, class A>
+V *value_art<V, A>::get(std::string_view key) const {
+  return get(key.data(), key.size());
+}
+
+template <class V, class A>
+bool value_art<V, A>::set(std::string_view key, V value) {
+  return set(key.data(), key.size(), std::move(value));
+}
+
+template <class V, class A> bool value_art<V, A>::del(std::string_view key) {
+  return del(key.data(), key.size());
+}
+#endif
+
+template <class V, class A> tree_it<V> value_art<V, A>::begin() {
+  return tree_.begin();
+}
+
+template <class V, class A>
+tree_it<V> value_art<V, A>::begin(const char *key) {
+  return tree_.begin(key);
+}
+
+template <class V, class A>
+tree_it<V> value_art<V, A>::begin(const char *key, std::size_t key_len) {
+  return tree_.begin(key, key_len);
+}
+
+template <class V, class A> tree_it<V> value_art<V, A>::last() {
+  return tree_.last();
+}
+
+template <class V, class A>
+tree_it<V> value_art<V, A>::last(const char *key) {
+  return tree_.last(key);
+}
+
+template <class V, class A>
+tree_it<V> value_art<V, A>::last(const char *key, std::size_t key_len) {
+  return tree_.last(key, key_len);
+}
+
+template <class V, class A> tree_it<V> value_art<V, A>::end() {
+  return tree_.end();
+}
+
+template <class V, class A>
+const tree_stats &value_art<V, A>::stats() const {
+  return tree_.stats();
+}
+
+template <class V, class A>
+void value_art<V, A>::parallel_clear(unsigned n_threads) {
+  tree_.parallel_clear(n_threads);
+}
+
+template <class V, class A> std::size_t value_art<V, A>::compact() {
+  return tree_.compact();
+}
+
+} // namespace art
+
+#endif
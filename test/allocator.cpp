@@ -0,0 +1,210 @@
+/**
+ * @file allocator tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <new>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace art;
+
+using std::mt19937_64;
+using std::string;
+using std::to_string;
+using std::vector;
+
+TEST_SUITE("allocator") {
+
+  TEST_CASE("pool allocator") {
+    pool_allocator pool;
+
+    SUBCASE("freed blocks are reused by their size class") {
+      void *p0 = pool.allocate(24);
+      void *p1 = pool.allocate(24);
+      REQUIRE(p0 != p1);
+      pool.deallocate(p0, 24);
+      REQUIRE_EQ(p0, pool.allocate(17));
+      pool.deallocate(p1, 24);
+      REQUIRE(p1 != pool.allocate(32));
+      REQUIRE_EQ(p1, pool.allocate(24));
+    }
+
+    SUBCASE("allocations are 8 byte aligned and disjoint") {
+      vector<char *> blocks;
+      for (int i = 1; i <= 512; ++i) {
+        char *p = static_cast<char *>(pool.allocate(i));
+        REQUIRE_EQ(0u, reinterpret_cast<uintptr_t>(p) % 8);
+        std::fill(p, p + i, static_cast<char>(i));
+        blocks.push_back(p);
+      }
+      for (int i = 1; i <= 512; ++i) {
+        char *p = blocks[i - 1];
+        for (int j = 0; j < i; ++j) {
+          REQUIRE_EQ(static_cast<char>(i), p[j]);
+        }
+      }
+    }
+
+    SUBCASE("large allocations") {
+      char *p0 = static_cast<char *>(pool.allocate(pool_allocator::max_size + 1));
+      char *p1 = static_cast<char *>(pool.allocate(3 * pool_allocator::chunk_size));
+      std::fill(p0, p0 + pool_allocator::max_size + 1, 'a');
+      std::fill(p1, p1 + 3 * pool_allocator::chunk_size, 'b');
+      pool.deallocate(p0, pool_allocator::max_size + 1);
+      REQUIRE_EQ(0u, pool.n_chunks());
+    }
+
+    SUBCASE("aligned allocations") {
+      vector<char *> blocks;
+      for (int i = 1; i <= 512; ++i) {
+        /* interleaved with unaligned ones */
+        pool.allocate(i % 64 + 1);
+        char *p = static_cast<char *>(pool.allocate(i, cache_line_size));
+        REQUIRE_EQ(0u, reinterpret_cast<uintptr_t>(p) % cache_line_size);
+        std::fill(p, p + i, static_cast<char>(i));
+        blocks.push_back(p);
+      }
+      for (int i = 1; i <= 512; ++i) {
+        char *p = blocks[i - 1];
+        for (int j = 0; j < i; ++j) {
+          REQUIRE_EQ(static_cast<char>(i), p[j]);
+        }
+      }
+
+      /* freed aligned blocks only serve aligned requests */
+      pool.deallocate(blocks[167], 168, cache_line_size);
+      REQUIRE(blocks[167] != pool.allocate(168));
+      REQUIRE_EQ(blocks[167], pool.allocate(168, cache_line_size));
+
+      void *large = pool.allocate(pool_allocator::max_size + 1, 16);
+      REQUIRE_EQ(0u, reinterpret_cast<uintptr_t>(large) % cache_line_size);
+      pool.deallocate(large, pool_allocator::max_size + 1, 16);
+
+      REQUIRE_THROWS_AS(pool.allocate(8, 2 * cache_line_size), std::bad_alloc);
+    }
+
+    SUBCASE("release") {
+      for (int i = 0; i < 10000; ++i) {
+        pool.allocate(64);
+      }
+      REQUIRE(pool.n_chunks() > 1);
+      pool.release();
+      REQUIRE_EQ(0u, pool.n_chunks());
+      REQUIRE(pool.allocate(64) != nullptr);
+      REQUIRE_EQ(1u, pool.n_chunks());
+    }
+
+    SUBCASE("move & reserved bytes") {
+      /* a copy, the constants are not defined out of the class */
+      std::size_t chunk_size = pool_allocator::chunk_size;
+      void *small = pool.allocate(64);
+      void *large = pool.allocate(pool_allocator::max_size + 1);
+      std::size_t reserved = pool.reserved_bytes();
+      REQUIRE_GT(reserved, chunk_size + pool_allocator::max_size);
+      pool.deallocate(large, pool_allocator::max_size + 1);
+      REQUIRE_EQ(chunk_size, pool.reserved_bytes());
+
+      pool_allocator other(std::move(pool));
+      REQUIRE_EQ(0u, pool.reserved_bytes());
+      REQUIRE_EQ(1u, other.n_chunks());
+      /* the freed block moved along */
+      other.deallocate(small, 64);
+      REQUIRE_EQ(small, other.allocate(64));
+      pool = std::move(other);
+      REQUIRE_EQ(chunk_size, pool.reserved_bytes());
+      REQUIRE_EQ(0u, other.n_chunks());
+      REQUIRE_EQ(chunk_size,
+                 reserved_bytes(pool, 0, 0));
+      REQUIRE_EQ(42u, reserved_bytes(heap_allocator(), 42, 0));
+    }
+
+    SUBCASE("adopt") {
+      std::size_t chunk_size = pool_allocator::chunk_size;
+      pool_allocator other;
+      void *mine = pool.allocate(64);
+      void *theirs = other.allocate(64);
+      void *freed = other.allocate(32);
+      void *large = other.allocate(pool_allocator::max_size + 1);
+      other.deallocate(freed, 32);
+      std::size_t reserved = pool.reserved_bytes() + other.reserved_bytes();
+
+      REQUIRE(adopt(pool, other, 0));
+      REQUIRE_EQ(0u, other.reserved_bytes());
+      REQUIRE_EQ(reserved, pool.reserved_bytes());
+      REQUIRE_EQ(2u, pool.n_chunks());
+      /* the other pool's freed block and blocks are this pool's now */
+      REQUIRE_EQ(freed, pool.allocate(32));
+      pool.deallocate(theirs, 64);
+      pool.deallocate(large, pool_allocator::max_size + 1);
+      REQUIRE_EQ(2 * chunk_size, pool.reserved_bytes());
+      REQUIRE_EQ(theirs, pool.allocate(64));
+      pool.deallocate(mine, 64);
+
+      /* the empty pool is usable */
+      REQUIRE(other.allocate(64) != nullptr);
+      REQUIRE_EQ(1u, other.n_chunks());
+      heap_allocator heap;
+      REQUIRE(adopt(heap, heap, 0));
+    }
+  }
+
+  TEST_CASE("inner nodes are allocated at cache lines") {
+    pool_allocator pool;
+    heap_allocator heap;
+    for (int i = 0; i < 100; ++i) {
+      /* leaves in between */
+      pool.allocate(24);
+      auto n4 = make<node_4<int>>(pool);
+      auto n16 = make<node_16<int>>(pool);
+      auto n48 = make<node_48<int>>(heap);
+      auto n256 = make<node_256<int>>(heap);
+      REQUIRE_EQ(0u, reinterpret_cast<uintptr_t>(n4) % cache_line_size);
+      REQUIRE_EQ(0u, reinterpret_cast<uintptr_t>(n16) % cache_line_size);
+      REQUIRE_EQ(0u, reinterpret_cast<uintptr_t>(n48) % cache_line_size);
+      REQUIRE_EQ(0u, reinterpret_cast<uintptr_t>(n256) % cache_line_size);
+      destroy(pool, n16);
+      destroy(heap, n48);
+      destroy(heap, n256);
+      /* n4 is released with the pool */
+    }
+  }
+
+  TEST_CASE("art with allocators") {
+    const int n = 10000;
+    vector<string> keys;
+    vector<int> values(n);
+    mt19937_64 rng(0);
+    for (int i = 0; i < n; ++i) {
+      keys.push_back(to_string(rng()));
+      values[i] = i;
+    }
+
+    SUBCASE("heap allocator") {
+      ::art::art<int, heap_allocator> m;
+      for (int i = 0; i < n; ++i) {
+        REQUIRE(m.set(keys[i].c_str(), &values[i]) == nullptr);
+      }
+      for (int i = 0; i < n; i += 2) {
+        REQUIRE_EQ(&values[i], m.del(keys[i].c_str()));
+      }
+      for (int i = 0; i < n; ++i) {
+        REQUIRE_EQ(i % 2 == 0 ? nullptr : &values[i], m.get(keys[i].c_str()));
+      }
+    }
+
+    SUBCASE("pool allocator frees values on teardown") {
+      int n_freed = 0;
+      {
+        ::art::art<int, pool_allocator> m([&n_freed](int *) { ++n_freed; });
+        for (int i = 0; i < n; ++i) {
+          m.set(keys[i].c_str(), &values[i]);
+        }
+      }
+      REQUIRE_EQ(n, n_freed);
+    }
+  }
+}
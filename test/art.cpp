@@ -4,13 +4,17 @@
  */
 
 #include "art.hpp"
+#include "counting_allocator.hpp"
 #include "doctest.h"
 #include <algorithm>
 #include <array>
+#include <map>
 #include <random>
+#include <stdexcept>
 #include <string>
 #include <vector>
 
+using art_test::counting_allocator;
 using std::array;
 using std::hash;
 using std::mt19937;
@@ -19,6 +23,20 @@ using std::random_device;
 using std::shuffle;
 using std::string;
 using std::to_string;
+using std::vector;
+
+namespace {
+
+struct record {
+  string key;
+  int value;
+};
+
+struct record_key {
+  const char *operator()(const record *r) const { return r->key.c_str(); }
+};
+
+} // namespace
 
 TEST_SUITE("art") {
 
@@ -478,4 +496,747 @@ TEST_SUITE("art") {
       }
     }
   }
+
+  TEST_CASE("tagged leaves") {
+    using tagged_art = art::art<record, art::pool_allocator, record_key>;
+
+    SUBCASE("set, get & delete") {
+      record r0{"aa", 0}, r1{"aaaaa", 1}, r2{"aab", 2}, r3{"aa", 3};
+      tagged_art m;
+      REQUIRE_EQ(nullptr, m.get("aa"));
+      REQUIRE_EQ(nullptr, m.set(r0.key.c_str(), &r0));
+      REQUIRE_EQ(nullptr, m.set(r1.key.c_str(), &r1));
+      REQUIRE_EQ(nullptr, m.set(r2.key.c_str(), &r2));
+      REQUIRE_EQ(&r0, m.get("aa"));
+      REQUIRE_EQ(&r1, m.get("aaaaa"));
+      REQUIRE_EQ(&r2, m.get("aab"));
+      REQUIRE_EQ(nullptr, m.get("aaaab"));
+      REQUIRE_EQ(nullptr, m.get("a"));
+
+      REQUIRE_EQ(&r0, m.set(r3.key.c_str(), &r3));
+      REQUIRE_EQ(&r3, m.get("aa"));
+
+      REQUIRE_EQ(nullptr, m.del("aaaab"));
+      REQUIRE_EQ(&r1, m.del("aaaaa"));
+      REQUIRE_EQ(nullptr, m.get("aaaaa"));
+      REQUIRE_EQ(&r3, m.get("aa"));
+      REQUIRE_EQ(&r2, m.get("aab"));
+      REQUIRE_EQ(&r3, m.del("aa"));
+      REQUIRE_EQ(&r2, m.del("aab"));
+      REQUIRE_EQ(nullptr, m.get("aab"));
+      REQUIRE(m.begin() == m.end());
+    }
+
+    SUBCASE("monte carlo") {
+      const int n = 1000;
+      mt19937_64 g(0);
+      std::vector<record> records(n);
+      std::map<string, record *> expected;
+      tagged_art m;
+      for (int i = 0; i < n; ++i) {
+        records[i].key = to_string(g() % 100000);
+        records[i].value = i;
+        auto old = m.set(records[i].key.c_str(), &records[i]);
+        auto it = expected.find(records[i].key);
+        REQUIRE_EQ(it == expected.end() ? nullptr : it->second, old);
+        expected[records[i].key] = &records[i];
+      }
+      for (auto &e : expected) {
+        REQUIRE_EQ(e.second, m.get(e.first.c_str()));
+      }
+
+      auto expected_it = expected.begin();
+      for (auto it = m.begin(); it != m.end(); ++it, ++expected_it) {
+        REQUIRE(expected_it != expected.end());
+        REQUIRE_EQ(expected_it->second, *it);
+      }
+      REQUIRE(expected_it == expected.end());
+
+      auto lower = expected.lower_bound("5");
+      REQUIRE(lower != expected.end());
+      REQUIRE_EQ(lower->second, *m.begin("5"));
+
+      for (int i = 0; i < n; i += 2) {
+        auto it = expected.find(records[i].key);
+        auto value = m.del(records[i].key.c_str());
+        REQUIRE_EQ(it == expected.end() ? nullptr : it->second, value);
+        if (it != expected.end()) {
+          expected.erase(it);
+        }
+      }
+      for (int i = 0; i < n; ++i) {
+        auto it = expected.find(records[i].key);
+        REQUIRE_EQ(it == expected.end() ? nullptr : it->second,
+                   m.get(records[i].key.c_str()));
+      }
+    }
+  }
+
+  TEST_CASE("binary keys") {
+    int int0, int1, int2;
+
+    SUBCASE("embedded zeros") {
+      art::art<int> m;
+      const char key0[] = {'a', 0, 'b', 0};
+      const char key1[] = {'a', 0, 'c', 0};
+      m.set(key0, sizeof(key0), &int0);
+      m.set(key1, sizeof(key1), &int1);
+      REQUIRE_EQ(&int0, m.get(key0, sizeof(key0)));
+      REQUIRE_EQ(&int1, m.get(key1, sizeof(key1)));
+      REQUIRE_EQ(nullptr, m.get("a"));
+      REQUIRE_EQ(nullptr, m.get(key0, 3));
+      REQUIRE_EQ(&int0, m.del(key0, sizeof(key0)));
+      REQUIRE_EQ(nullptr, m.get(key0, sizeof(key0)));
+      REQUIRE_EQ(&int1, m.get(key1, sizeof(key1)));
+    }
+
+    SUBCASE("c strings are terminated keys") {
+      art::art<int> m;
+      m.set("abc", &int0);
+      REQUIRE_EQ(&int0, m.get("abc", 4));
+      REQUIRE_EQ(nullptr, m.get("abc", 3));
+      REQUIRE_EQ(nullptr, m.del("abc", 3));
+      REQUIRE_EQ(&int0, m.del("abc", 4));
+    }
+
+    SUBCASE("keys must be prefix-free") {
+      art::art<int> m;
+      m.set("abcd", 4, &int0);
+      m.set("abce", 4, &int1);
+      REQUIRE_THROWS_AS(m.set("ab", 2, &int2), std::invalid_argument);
+      REQUIRE_THROWS_AS(m.set("abc", 3, &int2), std::invalid_argument);
+      REQUIRE_THROWS_AS(m.set("abcdx", 5, &int2), std::invalid_argument);
+      REQUIRE_EQ(nullptr, m.get("ab", 2));
+      REQUIRE_EQ(nullptr, m.get("abc", 3));
+      REQUIRE_EQ(nullptr, m.get("abcdx", 5));
+      REQUIRE_EQ(&int0, m.get("abcd", 4));
+      REQUIRE_EQ(&int1, m.get("abce", 4));
+      REQUIRE_EQ(nullptr, m.del("abc", 3));
+      REQUIRE_EQ(&int0, m.del("abcd", 4));
+    }
+
+    SUBCASE("monte carlo big-endian integers") {
+      const int n = 10000;
+      mt19937_64 g(0);
+      std::vector<array<char, 8>> keys(n);
+      std::vector<int> values(n);
+      art::art<int> m;
+      for (int i = 0; i < n; ++i) {
+        /* few distinct bytes, so that keys share prefixes and contain zeros */
+        for (auto &b : keys[i]) {
+          b = static_cast<char>(g() % 4);
+        }
+        m.set(keys[i].data(), keys[i].size(), &values[i]);
+      }
+      for (int i = n - 1; i >= 0; --i) {
+        auto value = m.get(keys[i].data(), keys[i].size());
+        /* a later duplicate key might have replaced the value */
+        REQUIRE(value != nullptr);
+        REQUIRE(value >= &values[i]);
+      }
+
+      std::sort(keys.begin(), keys.end());
+      keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+      int n_keys = 0;
+      for (auto it = m.begin(); it != m.end(); ++it) {
+        ++n_keys;
+      }
+      REQUIRE_EQ(static_cast<int>(keys.size()), n_keys);
+
+      /* keys at [start, end) */
+      size_t start = keys.size() / 3, end = 2 * keys.size() / 3;
+      auto it = m.begin(keys[start].data(), keys[start].size());
+      auto it_end = m.begin(keys[end].data(), keys[end].size());
+      for (size_t i = start; i < end; ++i, ++it) {
+        REQUIRE(it != it_end);
+        REQUIRE_EQ(m.get(keys[i].data(), keys[i].size()), *it);
+      }
+      REQUIRE(it == it_end);
+
+      for (auto &key : keys) {
+        REQUIRE(m.del(key.data(), key.size()) != nullptr);
+        REQUIRE_EQ(nullptr, m.get(key.data(), key.size()));
+      }
+      REQUIRE(m.begin() == m.end());
+    }
+
+#if __cplusplus >= 201703L
+    SUBCASE("string_view") {
+      art::art<int> m;
+      std::string_view key("ab\0cd", 5);
+      m.set(key, &int0);
+      REQUIRE_EQ(&int0, m.get(key));
+      REQUIRE_EQ(&int0, m.get(key.data(), key.size()));
+      REQUIRE_EQ(nullptr, m.get(std::string_view("ab")));
+      REQUIRE_EQ(&int0, *m.begin(std::string_view("ab")));
+      REQUIRE_EQ(&int0, m.del(key));
+    }
+#endif
+  }
+
+  TEST_CASE("scans") {
+    art::art<int> m;
+    int int0;
+    std::map<string, int *> expected;
+    mt19937_64 g(0);
+    auto random_key = [&](int max_len) {
+      string key(1 + g() % max_len, 'a');
+      for (char &c : key) {
+        c = static_cast<char>('a' + g() % 4);
+      }
+      return key;
+    };
+    for (int i = 0; i < 5000; ++i) {
+      string key = random_key(8);
+      m.set(key.c_str(), &int0);
+      expected[key + '\0'] = &int0;
+    }
+
+    SUBCASE("prefix") {
+      for (int i = 0; i < 500; ++i) {
+        string prefix = i == 0 ? string() : random_key(5);
+        auto expected_it = expected.lower_bound(prefix);
+        std::size_t n = 0;
+        m.scan_prefix(prefix.c_str(),
+                      [&](const string &key, int *value) {
+                        REQUIRE(expected_it != expected.end());
+                        REQUIRE_EQ(expected_it->first, key);
+                        REQUIRE_EQ(expected_it->second, value);
+                        ++expected_it;
+                        ++n;
+                        return true;
+                      });
+        REQUIRE((expected_it == expected.end() ||
+                 expected_it->first.compare(0, prefix.size(), prefix) != 0));
+        REQUIRE_EQ(n, m.count_prefix(prefix.c_str()));
+      }
+      REQUIRE_EQ(expected.size(), m.count_prefix(""));
+    }
+
+    SUBCASE("range") {
+      for (int i = 0; i < 500; ++i) {
+        string lo = random_key(5), hi = random_key(5);
+        auto expected_it = expected.lower_bound(lo);
+        auto expected_end = expected.lower_bound(hi);
+        std::size_t n = 0;
+        m.scan_range(lo.c_str(), hi.c_str(),
+                     [&](const string &key, int *value) {
+                       REQUIRE(expected_it != expected_end);
+                       REQUIRE_EQ(expected_it->first, key);
+                       REQUIRE_EQ(expected_it->second, value);
+                       ++expected_it;
+                       ++n;
+                       return true;
+                     });
+        REQUIRE((lo >= hi || expected_it == expected_end));
+        REQUIRE_EQ(n, m.count_range(lo.c_str(), hi.c_str()));
+        /* bounds are keys of the tree */
+        string lo_key = lo + '\0', hi_key = hi + '\0';
+        std::size_t expected_n =
+            lo_key < hi_key ? std::distance(expected.lower_bound(lo_key),
+                                            expected.lower_bound(hi_key))
+                            : 0;
+        REQUIRE_EQ(expected_n,
+                   m.count_range(lo_key.data(), lo_key.size(), hi_key.data(),
+                                 hi_key.size()));
+      }
+    }
+
+    SUBCASE("rank & select") {
+      std::size_t i = 0;
+      for (const auto &entry : expected) {
+        REQUIRE_EQ(i, m.rank(entry.first.data(), entry.first.size()));
+        auto it = m.select(i);
+        REQUIRE(it != m.end());
+        REQUIRE_EQ(entry.first, it.key());
+        ++i;
+      }
+      REQUIRE(m.select(expected.size()) == m.end());
+      REQUIRE_EQ(0u, m.rank(""));
+      REQUIRE_EQ(expected.size(), m.rank("e"));
+    }
+
+    SUBCASE("early termination") {
+      std::size_t n = 0;
+      m.scan_range("a", "d", [&](const string &, int *) {
+        return ++n < 10;
+      });
+      REQUIRE_EQ(10u, n);
+    }
+  }
+
+  TEST_CASE("multi_get & multi_set") {
+    art::art<int> m;
+    std::vector<int> values(1000);
+    std::vector<string> keys;
+    for (int i = 0; i < 1000; ++i) {
+      keys.push_back(to_string(i * 7919));
+    }
+    /* every key twice, the second set of a key returns the first value */
+    std::vector<const char *> key_ptrs;
+    std::vector<int *> value_ptrs;
+    for (int round = 0; round < 2; ++round) {
+      for (int i = 0; i < 1000; i += 2) {
+        key_ptrs.push_back(keys[i].c_str());
+        value_ptrs.push_back(&values[i + round]);
+      }
+    }
+    std::vector<int *> old_values(key_ptrs.size());
+    m.multi_set(key_ptrs.data(), key_ptrs.size(), value_ptrs.data(),
+                old_values.data());
+    for (std::size_t j = 0; j < key_ptrs.size(); ++j) {
+      REQUIRE_EQ(j < 500 ? nullptr : value_ptrs[j - 500], old_values[j]);
+    }
+
+    key_ptrs.clear();
+    std::vector<std::size_t> key_lens;
+    for (const string &k : keys) {
+      key_ptrs.push_back(k.c_str());
+      key_lens.push_back(k.size() + 1);
+    }
+    /* a key that ends in an inner node */
+    key_ptrs.push_back("1");
+    key_lens.push_back(1);
+    std::vector<int *> found(key_ptrs.size()), found_lens(key_ptrs.size());
+    m.multi_get(key_ptrs.data(), key_ptrs.size(), found.data());
+    m.multi_get(key_ptrs.data(), key_lens.data(), key_ptrs.size(),
+                found_lens.data());
+    for (std::size_t i = 0; i < key_ptrs.size(); ++i) {
+      REQUIRE_EQ(m.get(key_ptrs[i]), found[i]);
+      REQUIRE_EQ(m.get(key_ptrs[i], key_lens[i]), found_lens[i]);
+      REQUIRE_EQ(i < 1000 && i % 2 == 0 ? &values[i + 1] : nullptr, found[i]);
+    }
+
+    art::art<int> empty;
+    empty.multi_get(key_ptrs.data(), key_ptrs.size(), found.data());
+    for (int *v : found) {
+      REQUIRE_EQ(nullptr, v);
+    }
+  }
+
+  TEST_CASE("bulk load") {
+    std::vector<int> values(10000);
+    /* binary keys with long shared prefixes and every fan-out */
+    std::map<string, int *, bool (*)(const string &, const string &)> sorted(
+        [](const string &a, const string &b) {
+          return std::lexicographical_compare(
+              a.begin(), a.end(), b.begin(), b.end(),
+              [](char x, char y) {
+                return static_cast<signed char>(x) <
+                       static_cast<signed char>(y);
+              });
+        });
+    mt19937_64 g(0);
+    for (int i = 0; i < 10000; ++i) {
+      string k(12, 'x');
+      k[0] = static_cast<char>(g() % (i % 3 == 0 ? 2 : 256));
+      k[11] = static_cast<char>(g());
+      k[5] = static_cast<char>(g() % 60);
+      sorted[k] = &values[i];
+    }
+
+    art::art<int> m(sorted.begin(), sorted.end());
+    art::art<int> expected;
+    for (const auto &e : sorted) {
+      expected.set(e.first.data(), e.first.size(), e.second);
+    }
+    auto it = m.begin(), expected_it = expected.begin();
+    for (; expected_it != expected.end(); ++it, ++expected_it) {
+      REQUIRE(it != m.end());
+      REQUIRE_EQ(expected_it.key(), it.key());
+      REQUIRE_EQ(*expected_it, *it);
+    }
+    REQUIRE(it == m.end());
+    for (const auto &e : sorted) {
+      REQUIRE_EQ(e.second, m.get(e.first.data(), e.first.size()));
+    }
+    /* the tree stays modifiable */
+    for (const auto &e : sorted) {
+      REQUIRE_EQ(e.second, m.del(e.first.data(), e.first.size()));
+    }
+    REQUIRE(m.begin() == m.end());
+
+    int int0;
+    std::vector<std::pair<const char *, int *>> terminated = {
+        {"a", &int0}, {"aa", &int0}, {"ab", &int0}, {"b", &int0}};
+    art::art<int> t(terminated.begin(), terminated.end());
+    REQUIRE_EQ(&int0, t.get("aa"));
+    REQUIRE_EQ(nullptr, t.get("aaa"));
+    REQUIRE_THROWS_AS(t.bulk_load(terminated.begin(), terminated.end()),
+                      std::logic_error);
+
+    std::vector<std::pair<string, int *>> unsorted = {{"b", &int0},
+                                                      {"a", &int0}};
+    std::vector<std::pair<string, int *>> duplicate = {{"a", &int0},
+                                                       {"a", &int0}};
+    std::vector<std::pair<string, int *>> prefix = {{"a", &int0},
+                                                    {"ab", &int0}};
+    art::art<int> u;
+    REQUIRE_THROWS_AS(u.bulk_load(unsorted.begin(), unsorted.end()),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(u.bulk_load(duplicate.begin(), duplicate.end()),
+                      std::invalid_argument);
+    REQUIRE_THROWS_AS(u.bulk_load(prefix.begin(), prefix.end()),
+                      std::invalid_argument);
+    REQUIRE(u.begin() == u.end());
+  }
+
+  TEST_CASE("stats") {
+    art::art<int> m;
+    REQUIRE_EQ(0u, m.stats().n_leaves);
+    REQUIRE_EQ(0u, m.stats().n_inner_nodes());
+    REQUIRE_EQ(0.0, m.stats().average_depth());
+
+    int int0 = 0;
+    m.set("aa", &int0);
+    m.set("ab", &int0);
+    /* "a" -> {"a\0", "b\0"} */
+    REQUIRE_EQ(2u, m.stats().n_leaves);
+    REQUIRE_EQ(1u, m.stats().n_node_4);
+    REQUIRE_EQ(1u, m.stats().fan_out[2]);
+    REQUIRE_EQ(1u, m.stats().prefix_bytes);
+    REQUIRE_EQ(2.0, m.stats().average_depth());
+
+    /* the statistics match those of the same keys loaded in bulk, since
+     * the shape of the tree only depends on its keys, except for the
+     * node types */
+    std::size_t n_live_bytes = counting_allocator::n_live_bytes;
+    {
+      art::art<int, counting_allocator> t;
+      std::map<string, int *> expected;
+      mt19937_64 g(0);
+      for (int i = 0; i < 20000; ++i) {
+        string k = to_string(g() % (i < 10000 ? 100000 : 1000));
+        if (g() % 2 == 0) {
+          t.set(k.c_str(), &int0);
+          expected[k] = &int0;
+        } else {
+          t.del(k.c_str());
+          expected.erase(k);
+        }
+      }
+      std::vector<std::pair<const char *, int *>> sorted;
+      for (const auto &e : expected) {
+        sorted.emplace_back(e.first.c_str(), e.second);
+      }
+      art::art<int> bulk(sorted.begin(), sorted.end());
+
+      const art::tree_stats &s = t.stats(), &b = bulk.stats();
+      REQUIRE_EQ(expected.size(), s.n_leaves);
+      REQUIRE_EQ(b.n_leaves, s.n_leaves);
+      REQUIRE_EQ(b.n_inner_nodes(), s.n_inner_nodes());
+      REQUIRE_EQ(b.prefix_bytes, s.prefix_bytes);
+      REQUIRE_EQ(b.depth_sum, s.depth_sum);
+      for (int i = 0; i <= 256; ++i) {
+        REQUIRE_EQ(b.fan_out[i], s.fan_out[i]);
+      }
+      REQUIRE_EQ(counting_allocator::n_live_bytes - n_live_bytes,
+                 s.memory_bytes);
+      REQUIRE_GT(s.n_grows, 0u);
+      REQUIRE_GT(s.n_shrinks, 0u);
+      REQUIRE_GT(s.n_prefix_splits, 0u);
+      REQUIRE_EQ(0u, b.n_grows);
+    }
+    REQUIRE_EQ(n_live_bytes, counting_allocator::n_live_bytes.load());
+  }
+
+  TEST_CASE("shrink hysteresis") {
+    art::art<int> m;
+    int int0 = 0;
+    char key[2] = {'a', 0};
+    for (key[1] = 0; key[1] < 4; ++key[1]) {
+      m.set(key, 2, &int0);
+    }
+    /* a node_4 that alternates between 4 and 5 children grows once */
+    key[1] = 4;
+    for (int i = 0; i < 100; ++i) {
+      m.set(key, 2, &int0);
+      m.del(key, 2);
+    }
+    REQUIRE_EQ(1u, m.stats().n_grows);
+    REQUIRE_EQ(0u, m.stats().n_shrinks);
+    REQUIRE_EQ(1u, m.stats().n_node_16);
+
+    key[1] = 3;
+    m.del(key, 2);
+    REQUIRE_EQ(art::node_16<int>::shrink_threshold, 3);
+    REQUIRE_EQ(1u, m.stats().n_shrinks);
+    REQUIRE_EQ(1u, m.stats().n_node_4);
+    REQUIRE_EQ(0u, m.stats().n_node_16);
+  }
+
+  TEST_CASE("compact") {
+    mt19937_64 g(0);
+    std::map<string, int *> expected;
+    vector<int> values(50000);
+    SUBCASE("pool allocator") {
+      art::art<int> m;
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        string key = to_string(g());
+        m.set(key.c_str(), &values[i]);
+        expected[key + '\0'] = &values[i];
+      }
+      /* churn leaves most of the pool unused */
+      for (auto it = expected.begin(); it != expected.end();) {
+        if (g() % 10 != 0) {
+          m.del(it->first.c_str());
+          it = expected.erase(it);
+        } else {
+          ++it;
+        }
+      }
+      art::tree_stats before = m.stats();
+      REQUIRE_GT(m.compact(), before.memory_bytes);
+
+      std::map<string, int *> actual;
+      for (auto it = m.begin(); it != m.end(); ++it) {
+        actual[it.key()] = *it;
+      }
+      REQUIRE(expected == actual);
+      const art::tree_stats &after = m.stats();
+      REQUIRE_EQ(before.n_leaves, after.n_leaves);
+      REQUIRE_EQ(before.n_inner_nodes(), after.n_inner_nodes());
+      REQUIRE_EQ(before.depth_sum, after.depth_sum);
+      REQUIRE_LE(after.memory_bytes, before.memory_bytes);
+
+      /* the tree is modified as usual afterwards */
+      m.set("k", &values[0]);
+      REQUIRE_EQ(&values[0], m.get("k"));
+    }
+
+    SUBCASE("counted allocator") {
+      std::size_t n_live_bytes = counting_allocator::n_live_bytes;
+      {
+        art::art<int, counting_allocator> m;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+          m.set(to_string(g()).c_str(), &values[i]);
+        }
+        m.compact();
+        REQUIRE_EQ(counting_allocator::n_live_bytes - n_live_bytes,
+                   m.stats().memory_bytes);
+      }
+      REQUIRE_EQ(n_live_bytes, counting_allocator::n_live_bytes.load());
+    }
+
+    SUBCASE("tagged leaves") {
+      vector<record> records;
+      for (int i = 0; i < 1000; ++i) {
+        records.push_back(record{to_string(g()), i});
+      }
+      art::art<record, art::pool_allocator, record_key> m;
+      for (record &r : records) {
+        m.set(r.key.c_str(), &r);
+      }
+      m.compact();
+      for (record &r : records) {
+        REQUIRE_EQ(&r, m.get(r.key.c_str()));
+      }
+    }
+  }
+
+  TEST_CASE("merge") {
+    mt19937_64 g(0);
+    vector<int> values(20000);
+    std::map<string, int *> expected;
+    int n_conflicts = 0;
+    /* keeps the smaller value of a key in both trees */
+    auto keep_min = [&n_conflicts](int *mine, int *theirs) {
+      ++n_conflicts;
+      return mine < theirs ? mine : theirs;
+    };
+    /* keys of a few lengths share prefixes of every length */
+    auto random_key = [&g]() { return to_string(g() % 100000 * 7919); };
+
+    SUBCASE("overlapping keys") {
+      art::art<int> mine, theirs;
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        string key = random_key();
+        art::art<int> &m = i % 2 == 0 ? mine : theirs;
+        if (m.get(key.c_str()) != nullptr) {
+          continue;
+        }
+        m.set(key.c_str(), &values[i]);
+        int *&value = expected[key + '\0'];
+        value = value == nullptr ? &values[i] : std::min(value, &values[i]);
+      }
+      std::size_t n_mine = mine.stats().n_leaves, n_theirs = theirs.stats().n_leaves;
+      mine.merge(std::move(theirs), keep_min);
+
+      REQUIRE_EQ(n_mine + n_theirs - n_conflicts, expected.size());
+      REQUIRE_GT(n_conflicts, 0);
+      std::map<string, int *> actual;
+      for (auto it = mine.begin(); it != mine.end(); ++it) {
+        actual[it.key()] = *it;
+      }
+      REQUIRE(expected == actual);
+      REQUIRE(theirs.begin() == theirs.end());
+
+      /* the statistics match those of a tree built by set */
+      art::art<int> built;
+      for (auto &entry : expected) {
+        built.set(entry.first.c_str(), entry.second);
+      }
+      const art::tree_stats &stats = mine.stats(), &built_stats = built.stats();
+      REQUIRE_EQ(built_stats.n_leaves, stats.n_leaves);
+      REQUIRE_EQ(built_stats.depth_sum, stats.depth_sum);
+      REQUIRE_EQ(built_stats.prefix_bytes, stats.prefix_bytes);
+      REQUIRE_EQ(built_stats.n_inner_nodes(), stats.n_inner_nodes());
+      REQUIRE_EQ(0u, theirs.stats().n_leaves);
+      REQUIRE_EQ(0u, theirs.stats().memory_bytes);
+      REQUIRE_EQ(0u, theirs.stats().n_inner_nodes());
+
+      /* both trees are modified as usual afterwards */
+      for (auto &entry : expected) {
+        REQUIRE_EQ(entry.second, mine.del(entry.first.c_str()));
+      }
+      REQUIRE(mine.begin() == mine.end());
+      REQUIRE_EQ(0u, mine.stats().memory_bytes);
+      theirs.set("k", &values[0]);
+      REQUIRE_EQ(&values[0], theirs.get("k"));
+    }
+
+    SUBCASE("disjoint and empty trees") {
+      art::art<int> mine, theirs, empty;
+      for (int i = 0; i < 1000; ++i) {
+        mine.set(("a" + to_string(g())).c_str(), &values[i]);
+        theirs.set(("b" + to_string(g())).c_str(), &values[i]);
+      }
+      mine.merge(std::move(empty), keep_min);
+      REQUIRE_EQ(1000u, mine.stats().n_leaves);
+      empty.merge(std::move(theirs), keep_min);
+      REQUIRE_EQ(1000u, empty.stats().n_leaves);
+      mine.merge(std::move(empty), keep_min);
+      REQUIRE_EQ(2000u, mine.stats().n_leaves);
+      REQUIRE_EQ(0, n_conflicts);
+      std::size_t n_b = 0;
+      for (auto it = mine.begin("b"); it != mine.end(); ++it) {
+        ++n_b;
+      }
+      REQUIRE_EQ(1000u, n_b);
+    }
+
+    SUBCASE("nodes grow to their final type") {
+      art::art<int> mine, theirs;
+      for (int i = 0; i < 200; ++i) {
+        string key(1, static_cast<char>(i - 100));
+        (i % 20 == 0 ? mine : theirs).set(key.data(), 1, &values[i]);
+      }
+      std::size_t n_grows = mine.stats().n_grows;
+      mine.merge(std::move(theirs), keep_min);
+      REQUIRE_EQ(n_grows + 1, mine.stats().n_grows);
+      REQUIRE_EQ(1u, mine.stats().n_node_256);
+      REQUIRE_EQ(200u, mine.stats().n_leaves);
+    }
+
+    SUBCASE("keys that are prefixes of each other") {
+      art::art<int> mine, theirs;
+      mine.set("ab", 2, &values[0]);
+      mine.set("ac", 2, &values[1]);
+      theirs.set("abc", 3, &values[2]);
+      theirs.set("b", 1, &values[3]);
+      REQUIRE_THROWS_AS(mine.merge(std::move(theirs), keep_min),
+                        std::invalid_argument);
+      /* neither tree changed */
+      REQUIRE_EQ(2u, mine.stats().n_leaves);
+      REQUIRE_EQ(&values[0], mine.get("ab", 2));
+      REQUIRE_EQ(2u, theirs.stats().n_leaves);
+      REQUIRE_EQ(&values[2], theirs.get("abc", 3));
+
+      art::art<int> shorter;
+      shorter.set("a", 1, &values[4]);
+      REQUIRE_THROWS_AS(mine.merge(std::move(shorter), keep_min),
+                        std::invalid_argument);
+      REQUIRE_EQ(&values[4], shorter.get("a", 1));
+    }
+
+    SUBCASE("counted allocator") {
+      std::size_t n_live_bytes = counting_allocator::n_live_bytes;
+      {
+        /* the nodes of theirs are copied, as the allocator can't adopt */
+        art::art<int, counting_allocator> mine, theirs;
+        for (std::size_t i = 0; i < values.size(); ++i) {
+          (i % 2 == 0 ? mine : theirs)
+              .set(random_key().c_str(), &values[i]);
+        }
+        mine.merge(std::move(theirs), keep_min);
+        REQUIRE_EQ(0u, theirs.stats().memory_bytes);
+        REQUIRE_EQ(counting_allocator::n_live_bytes - n_live_bytes,
+                   mine.stats().memory_bytes);
+      }
+      REQUIRE_EQ(n_live_bytes, counting_allocator::n_live_bytes.load());
+    }
+
+    SUBCASE("heap allocator") {
+      art::art<int, art::heap_allocator> mine, theirs;
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        string key = random_key();
+        (i % 2 == 0 ? mine : theirs).set(key.c_str(), &values[i]);
+        expected.emplace(key, nullptr);
+      }
+      mine.merge(std::move(theirs), keep_min);
+      REQUIRE_EQ(expected.size(), mine.stats().n_leaves);
+      for (auto &entry : expected) {
+        REQUIRE_NE(nullptr, mine.get(entry.first.c_str()));
+      }
+    }
+
+    SUBCASE("tagged leaves") {
+      vector<record> records;
+      for (int i = 0; i < 2000; ++i) {
+        records.push_back(record{random_key(), i});
+      }
+      using tagged_art = art::art<record, art::pool_allocator, record_key>;
+      tagged_art mine, theirs;
+      for (record &r : records) {
+        tagged_art &m = r.value % 2 == 0 ? mine : theirs;
+        if (m.get(r.key.c_str()) == nullptr) {
+          m.set(r.key.c_str(), &r);
+        }
+      }
+      mine.merge(std::move(theirs),
+                 [](record *a, record *b) { return a->value < b->value ? a : b; });
+      for (record &r : records) {
+        REQUIRE_EQ(r.key, mine.get(r.key.c_str())->key);
+        REQUIRE_LE(mine.get(r.key.c_str())->value, r.value);
+      }
+    }
+  }
+
+  TEST_CASE("upserts") {
+    art::art<int> m;
+    int int0 = 0, int1 = 1;
+
+    int **slot = m.find_or_insert("counter");
+    REQUIRE_EQ(nullptr, *slot);
+    *slot = &int0;
+    REQUIRE_EQ(&int0, m.get("counter"));
+    REQUIRE_EQ(slot, m.find_or_insert("counter"));
+    REQUIRE_EQ(1u, m.stats().n_leaves);
+
+    REQUIRE_EQ(nullptr, m.insert_if_absent("a", &int0));
+    REQUIRE_EQ(&int0, m.insert_if_absent("a", &int1));
+    REQUIRE_EQ(&int0, m.get("a"));
+
+    std::vector<int> counts(3, 0);
+    auto increment = [&](int *count) {
+      return count == nullptr ? &counts[0] : count + 1;
+    };
+    REQUIRE_EQ(nullptr, m.update("b", increment));
+    REQUIRE_EQ(&counts[0], m.update("b", increment));
+    REQUIRE_EQ(&counts[1], m.update("b", increment));
+    REQUIRE_EQ(&counts[2], m.get("b"));
+
+    REQUIRE_THROWS_AS(m.find_or_insert("a", 1), std::invalid_argument);
+    REQUIRE_THROWS_AS(m.insert_if_absent("b", 1, &int0),
+                      std::invalid_argument);
+    REQUIRE_EQ(3u, m.stats().n_leaves);
+
+    /* the same single descent also works for tagged leaves */
+    art::art<record, art::pool_allocator, record_key> records;
+    record r0{"x", 0}, r1{"x", 1};
+    REQUIRE_EQ(nullptr, records.insert_if_absent("x", &r0));
+    REQUIRE_EQ(&r0, records.insert_if_absent("x", &r1));
+    REQUIRE_EQ(&r0, records.update("x", [&](record *) { return &r1; }));
+    REQUIRE_EQ(&r1, records.get("x"));
+  }
 }
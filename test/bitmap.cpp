@@ -0,0 +1,71 @@
+/**
+ * @file bitmap tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art/bitmap.hpp"
+#include "doctest.h"
+#include <random>
+#include <set>
+
+using art::bitmap;
+using std::mt19937;
+using std::set;
+
+TEST_SUITE("bitmap") {
+
+  TEST_CASE("set, reset & test") {
+    bitmap b;
+    for (int i = 0; i < 256; ++i) {
+      REQUIRE_FALSE(b.test(i));
+    }
+    b.set(0);
+    b.set(63);
+    b.set(64);
+    b.set(255);
+    REQUIRE(b.test(0));
+    REQUIRE(b.test(63));
+    REQUIRE(b.test(64));
+    REQUIRE(b.test(255));
+    REQUIRE_FALSE(b.test(1));
+    b.reset(63);
+    REQUIRE_FALSE(b.test(63));
+    REQUIRE(b.test(64));
+  }
+
+  TEST_CASE("next & prev") {
+    bitmap b;
+    REQUIRE_EQ(-1, b.next(0));
+    REQUIRE_EQ(-1, b.prev(255));
+
+    b.set(5);
+    b.set(200);
+    REQUIRE_EQ(5, b.next(0));
+    REQUIRE_EQ(5, b.next(5));
+    REQUIRE_EQ(200, b.next(6));
+    REQUIRE_EQ(-1, b.next(201));
+    REQUIRE_EQ(200, b.prev(255));
+    REQUIRE_EQ(200, b.prev(200));
+    REQUIRE_EQ(5, b.prev(199));
+    REQUIRE_EQ(-1, b.prev(4));
+  }
+
+  TEST_CASE("monte carlo") {
+    mt19937 g(0);
+    for (int experiment = 0; experiment < 100; ++experiment) {
+      bitmap b;
+      set<int> expected;
+      for (int i = 0; i < experiment; ++i) {
+        int index = g() % 256;
+        b.set(index);
+        expected.insert(index);
+      }
+      for (int i = 0; i < 256; ++i) {
+        auto next = expected.lower_bound(i);
+        REQUIRE_EQ(next == expected.end() ? -1 : *next, b.next(i));
+        auto prev = expected.upper_bound(i);
+        REQUIRE_EQ(prev == expected.begin() ? -1 : *--prev, b.prev(i));
+      }
+    }
+  }
+}
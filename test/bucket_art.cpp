@@ -0,0 +1,182 @@
+/**
+ * @file bucket_art tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "counting_allocator.hpp"
+#include "doctest.h"
+#include <cstddef>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using art_test::counting_allocator;
+using std::map;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+/* random strings of 8 to 39 letters */
+string random_key(std::mt19937_64 &g) {
+  string key(8 + g() % 32, 'a');
+  for (char &c : key) {
+    c = 'a' + g() % 26;
+  }
+  return key;
+}
+
+} // namespace
+
+TEST_SUITE("bucket_art") {
+
+  TEST_CASE("set, get & del") {
+    art::bucket_art<int> m;
+    int v0 = 0, v1 = 1, v2 = 2;
+    REQUIRE_EQ(nullptr, m.get("a"));
+    REQUIRE_EQ(nullptr, m.set("aa", &v0));
+    REQUIRE_EQ(nullptr, m.set("ab", &v1));
+    REQUIRE_EQ(&v0, m.get("aa"));
+    REQUIRE_EQ(&v1, m.get("ab"));
+    REQUIRE_EQ(nullptr, m.get("ac"));
+    REQUIRE_EQ(nullptr, m.get("a"));
+
+    /* both keys share one bucket */
+    REQUIRE_EQ(1u, m.stats().n_buckets);
+    REQUIRE_EQ(0u, m.stats().n_inner_nodes());
+
+    REQUIRE_EQ(&v1, m.set("ab", &v2));
+    REQUIRE_EQ(&v2, m.get("ab"));
+
+    REQUIRE_THROWS_AS(m.set("a", 1, &v0), std::invalid_argument);
+    REQUIRE_THROWS_AS(m.set("aa\0b", 4, &v0), std::invalid_argument);
+    REQUIRE_EQ(2u, m.stats().n_leaves);
+
+    REQUIRE_EQ(nullptr, m.del("ac"));
+    REQUIRE_EQ(&v0, m.del("aa"));
+    REQUIRE_EQ(nullptr, m.get("aa"));
+    REQUIRE_EQ(&v2, m.del("ab"));
+    REQUIRE_EQ(0u, m.stats().n_leaves);
+    REQUIRE_EQ(0u, m.stats().memory_bytes);
+  }
+
+  TEST_CASE("burst & merge") {
+    art::bucket_art<int, counting_allocator> m;
+    int v = 0;
+    vector<string> keys;
+    for (int i = 0; i <= art::leaf_bucket<int>::capacity; ++i) {
+      keys.push_back("prefix/" + to_string(i % 4) + "/" + to_string(i));
+    }
+    for (int i = 0; i < art::leaf_bucket<int>::capacity; ++i) {
+      m.set(keys[i].c_str(), &v);
+    }
+    REQUIRE_EQ(1u, m.stats().n_buckets);
+    REQUIRE_EQ(0u, m.stats().n_bursts);
+
+    /* the full bucket bursts at the first byte its keys differ in */
+    m.set(keys.back().c_str(), &v);
+    const art::tree_stats &s = m.stats();
+    REQUIRE_EQ(1u, s.n_bursts);
+    REQUIRE_EQ(1u, s.n_node_4);
+    REQUIRE_EQ(4u, s.n_buckets);
+    REQUIRE_EQ(keys.size(), s.n_leaves);
+    REQUIRE_EQ(7u, s.prefix_bytes);
+    REQUIRE_EQ(keys.size() * 8, s.depth_sum);
+    REQUIRE_EQ(counting_allocator::n_live_bytes.load(), s.memory_bytes);
+    for (const string &key : keys) {
+      REQUIRE_EQ(&v, m.get(key.c_str()));
+    }
+
+    /* the last bucket replaces its parent */
+    for (std::size_t i = 0; i < keys.size(); ++i) {
+      if (i % 4 != 0) {
+        REQUIRE_EQ(&v, m.del(keys[i].c_str()));
+      }
+    }
+    REQUIRE_EQ(1u, s.n_buckets);
+    REQUIRE_EQ(0u, s.n_inner_nodes());
+    REQUIRE_EQ(0u, s.depth_sum);
+    REQUIRE_EQ(counting_allocator::n_live_bytes.load(), s.memory_bytes);
+    for (std::size_t i = 0; i < keys.size(); i += 4) {
+      REQUIRE_EQ(&v, m.get(keys[i].c_str()));
+    }
+  }
+
+  TEST_CASE("monte carlo") {
+    std::size_t n_live_bytes = counting_allocator::n_live_bytes;
+    {
+      std::mt19937_64 g(0);
+      art::bucket_art<int, counting_allocator> m;
+      map<string, int *> expected;
+      vector<int> values(20000);
+      vector<string> keys;
+      for (int i = 0; i < 2000; ++i) {
+        /* a third shares a long prefix */
+        keys.push_back(i % 3 == 0 ? "shared/prefix/" + random_key(g)
+                                  : random_key(g));
+      }
+      for (std::size_t i = 0; i < values.size(); ++i) {
+        const string &key = keys[g() % keys.size()];
+        auto it = expected.find(key + '\0');
+        if (g() % 3 == 0) {
+          REQUIRE_EQ(it == expected.end() ? nullptr : it->second,
+                     m.del(key.c_str()));
+          if (it != expected.end()) {
+            expected.erase(it);
+          }
+        } else {
+          REQUIRE_EQ(it == expected.end() ? nullptr : it->second,
+                     m.set(key.c_str(), &values[i]));
+          expected[key + '\0'] = &values[i];
+        }
+      }
+      for (const string &key : keys) {
+        auto it = expected.find(key + '\0');
+        REQUIRE_EQ(it == expected.end() ? nullptr : it->second,
+                   m.get(key.c_str()));
+      }
+
+      /* keys are visited in order */
+      map<string, int *> visited;
+      string prev;
+      bool is_sorted = true;
+      m.scan([&](const string &key, int *value) {
+        is_sorted &= visited.empty() || prev < key;
+        prev = key;
+        visited[key] = value;
+        return true;
+      });
+      REQUIRE(is_sorted);
+      REQUIRE(expected == visited);
+
+      const art::tree_stats &s = m.stats();
+      REQUIRE_EQ(expected.size(), s.n_leaves);
+      REQUIRE_GT(s.n_bursts, 0u);
+      REQUIRE_EQ(counting_allocator::n_live_bytes - n_live_bytes,
+                 s.memory_bytes);
+    }
+    REQUIRE_EQ(n_live_bytes, counting_allocator::n_live_bytes.load());
+  }
+
+  TEST_CASE("sparse keys need less memory") {
+    std::mt19937_64 g(0);
+    art::art<int> tree;
+    art::bucket_art<int> buckets;
+    int v = 0;
+    string key;
+    for (int i = 0; i < 20000; ++i) {
+      key = random_key(g);
+      tree.set(key.c_str(), &v);
+      buckets.set(key.c_str(), &v);
+    }
+    REQUIRE_EQ(tree.stats().n_leaves, buckets.stats().n_leaves);
+    REQUIRE_LT(2 * buckets.stats().n_inner_nodes(),
+               tree.stats().n_inner_nodes());
+    REQUIRE_LT(buckets.stats().bytes_per_key(),
+               tree.stats().bytes_per_key());
+  }
+}
@@ -0,0 +1,157 @@
+/**
+ * @file checks shared by the tests of the concurrent trees
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_TEST_CONCURRENT_CHECKS_HPP
+#define ART_TEST_CONCURRENT_CHECKS_HPP
+
+#include "doctest.h"
+#include <atomic>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace art_test {
+
+/* set, get & delete on a tree M of int pointers */
+template <class M> void check_set_get_del() {
+  M m;
+  int int0, int1, int2;
+
+  REQUIRE_EQ(nullptr, m.get("aa"));
+  REQUIRE_EQ(nullptr, m.set("aa", &int0));
+  REQUIRE_EQ(nullptr, m.set("ab", &int1));
+  REQUIRE_EQ(nullptr, m.set("aaaaaaaaaaaaaaaa", &int2));
+  REQUIRE_EQ(&int0, m.get("aa"));
+  REQUIRE_EQ(&int1, m.get("ab"));
+  REQUIRE_EQ(&int2, m.get("aaaaaaaaaaaaaaaa"));
+  REQUIRE_EQ(nullptr, m.get("a"));
+  REQUIRE_EQ(&int0, m.set("aa", &int1));
+  REQUIRE_EQ(&int1, m.get("aa"));
+
+  const char key[] = {'a', 'a'};
+  REQUIRE_THROWS_AS(m.set(key, sizeof(key), &int0), std::invalid_argument);
+
+  REQUIRE_EQ(&int1, m.del("aa"));
+  REQUIRE_EQ(nullptr, m.del("aa"));
+  REQUIRE_EQ(nullptr, m.get("aa"));
+  REQUIRE_EQ(&int1, m.get("ab"));
+  REQUIRE_EQ(&int1, m.del("ab"));
+  REQUIRE_EQ(&int2, m.del("aaaaaaaaaaaaaaaa"));
+  REQUIRE_EQ(nullptr, m.get("aaaaaaaaaaaaaaaa"));
+}
+
+/* random sets and deletes, compared against std::map */
+template <class M> void check_monte_carlo() {
+  M m;
+  std::map<std::string, int *> expected;
+  std::vector<int> values(1000);
+  std::mt19937_64 g(0);
+  for (int i = 0; i < 100000; ++i) {
+    std::string key = std::to_string(g() % 20000);
+    int *value = &values[g() % values.size()];
+    auto it = expected.find(key);
+    if (g() % 3 == 0) {
+      REQUIRE_EQ(it == expected.end() ? nullptr : it->second,
+                 m.del(key.c_str()));
+      if (it != expected.end()) {
+        expected.erase(it);
+      }
+    } else {
+      REQUIRE_EQ(it == expected.end() ? nullptr : it->second,
+                 m.set(key.c_str(), value));
+      expected[key] = value;
+    }
+  }
+  for (int i = 0; i < 20000; ++i) {
+    std::string key = std::to_string(i);
+    auto it = expected.find(key);
+    REQUIRE_EQ(it == expected.end() ? nullptr : it->second,
+               m.get(key.c_str()));
+  }
+}
+
+/* writers insert interleaved keys and delete every other one */
+template <class M> void check_concurrent_writers() {
+  const int n_threads = 4, n_keys = 20000;
+  M m;
+  std::vector<int> values(n_threads * n_keys);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_threads; ++t) {
+    threads.emplace_back([&, t]() {
+      /* interleaved keys, so that the threads share nodes */
+      for (int i = 0; i < n_keys; ++i) {
+        int k = i * n_threads + t;
+        m.set(std::to_string(k).c_str(), &values[k]);
+      }
+      for (int i = 0; i < n_keys; i += 2) {
+        int k = i * n_threads + t;
+        m.del(std::to_string(k).c_str());
+      }
+    });
+  }
+  for (auto &th : threads) {
+    th.join();
+  }
+  for (int k = 0; k < n_threads * n_keys; ++k) {
+    int *expected = (k / n_threads) % 2 == 0 ? nullptr : &values[k];
+    REQUIRE_EQ(expected, m.get(std::to_string(k).c_str()));
+  }
+}
+
+/* readers never miss a stable key while writers churn the others */
+template <class M> void check_concurrent_readers_and_writers() {
+  const int n_readers = 3, n_writers = 2, n_keys = 20000;
+  M m;
+  std::vector<int> values(n_keys);
+  /* even keys are stable, odd keys are inserted and deleted */
+  for (int k = 0; k < n_keys; k += 2) {
+    m.set(std::to_string(k).c_str(), &values[k]);
+  }
+  std::atomic<bool> done(false);
+  std::atomic<int> n_misses(0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < n_writers; ++t) {
+    threads.emplace_back([&, t]() {
+      for (int round = 0; round < 4; ++round) {
+        for (int k = 1 + 2 * t; k < n_keys; k += 2 * n_writers) {
+          m.set(std::to_string(k).c_str(), &values[k]);
+        }
+        for (int k = 1 + 2 * t; k < n_keys; k += 2 * n_writers) {
+          m.del(std::to_string(k).c_str());
+        }
+      }
+    });
+  }
+  for (int t = 0; t < n_readers; ++t) {
+    threads.emplace_back([&, t]() {
+      std::mt19937_64 g(t);
+      while (!done) {
+        int k = 2 * (g() % (n_keys / 2));
+        if (m.get(std::to_string(k).c_str()) != &values[k]) {
+          ++n_misses;
+        }
+      }
+    });
+  }
+  for (int t = 0; t < n_writers; ++t) {
+    threads[t].join();
+  }
+  done = true;
+  for (int t = n_writers; t < n_writers + n_readers; ++t) {
+    threads[t].join();
+  }
+  REQUIRE_EQ(0, n_misses.load());
+  for (int k = 0; k < n_keys; ++k) {
+    REQUIRE_EQ(k % 2 == 0 ? &values[k] : nullptr,
+               m.get(std::to_string(k).c_str()));
+  }
+}
+
+} // namespace art_test
+
+#endif
@@ -0,0 +1,60 @@
+/**
+ * @file allocator shared by the tests that count the memory of a tree
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#ifndef ART_TEST_COUNTING_ALLOCATOR_HPP
+#define ART_TEST_COUNTING_ALLOCATOR_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+namespace art_test {
+
+/*
+ * Heap allocator that counts allocations, live blocks and live bytes. The
+ * counters are shared by all instances and atomic, so that concurrent trees
+ * may update them, tests compare them before and after. The class is a
+ * template only so that the header can define the counters.
+ */
+template <class Tag = void> struct basic_counting_allocator {
+  static const bool bulk_release = false;
+
+  void *allocate(std::size_t size);
+  void deallocate(void *p, std::size_t size);
+
+  static std::atomic<int> n_allocations;
+  static std::atomic<int> n_live;
+  static std::atomic<std::size_t> n_live_bytes;
+};
+
+using counting_allocator = basic_counting_allocator<>;
+
+template <class Tag>
+std::atomic<int> basic_counting_allocator<Tag>::n_allocations(0);
+
+template <class Tag> std::atomic<int> basic_counting_allocator<Tag>::n_live(0);
+
+template <class Tag>
+std::atomic<std::size_t> basic_counting_allocator<Tag>::n_live_bytes(0);
+
+template <class Tag>
+void *basic_counting_allocator<Tag>::allocate(std::size_t size) {
+  void *p = ::operator new(size);
+  ++n_allocations;
+  ++n_live;
+  n_live_bytes += size;
+  return p;
+}
+
+template <class Tag>
+void basic_counting_allocator<Tag>::deallocate(void *p, std::size_t size) {
+  --n_live;
+  n_live_bytes -= size;
+  ::operator delete(p);
+}
+
+} // namespace art_test
+
+#endif
@@ -0,0 +1,273 @@
+/**
+ * @file durable_art tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using std::map;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+/* new directory, removed with its files */
+class temp_dir {
+public:
+  temp_dir() {
+    char path[] = "/tmp/durable_art_XXXXXX";
+    if (::mkdtemp(path) == nullptr) {
+      throw std::runtime_error("can't create a directory");
+    }
+    path_ = path;
+  }
+
+  ~temp_dir() {
+    for (const string &name : files()) {
+      std::remove((path_ + "/" + name).c_str());
+    }
+    ::rmdir(path_.c_str());
+  }
+
+  const string &path() const { return path_; }
+
+  vector<string> files() const {
+    vector<string> names;
+    for (const string &name : art::log_format::list_dir(path_)) {
+      if (name != "." && name != "..") {
+        names.push_back(name);
+      }
+    }
+    std::sort(names.begin(), names.end());
+    return names;
+  }
+
+private:
+  string path_;
+};
+
+struct account {
+  int64_t balance;
+  int32_t id;
+};
+
+/* neither syncs nor checkpoints in the background */
+art::durability_options unsynced() {
+  art::durability_options options;
+  options.sync = false;
+  options.checkpoint_log_bytes = 0;
+  return options;
+}
+
+template <class M>
+void require_contents(const M &m, const map<string, int64_t> &expected,
+                      const vector<string> &deleted) {
+  REQUIRE_EQ(expected.size(), m.size());
+  account a;
+  for (const auto &entry : expected) {
+    REQUIRE(m.get(entry.first.c_str(), a));
+    REQUIRE_EQ(entry.second, a.balance);
+  }
+  for (const string &key : deleted) {
+    if (expected.count(key) == 0) {
+      REQUIRE_FALSE(m.get(key.c_str(), a));
+    }
+  }
+}
+
+} // namespace
+
+TEST_SUITE("durable_art") {
+
+  TEST_CASE("recovery") {
+    temp_dir dir;
+    std::mt19937_64 g(0);
+    map<string, int64_t> expected;
+    vector<string> deleted;
+    /* sets, replaces and deletes */
+    auto modify = [&](art::durable_art<account> &m, int n) {
+      string key;
+      for (int i = 0; i < n; ++i) {
+        key = to_string(g() % 2000);
+        if (g() % 4 == 0) {
+          REQUIRE_EQ(expected.erase(key) == 1, m.del(key.c_str()));
+          deleted.push_back(key);
+        } else {
+          account a{static_cast<int64_t>(g()), i};
+          m.set(key.c_str(), a);
+          expected[key] = a.balance;
+        }
+      }
+    };
+
+    SUBCASE("from the log") {
+      {
+        art::durable_art<account> m(dir.path(), unsynced());
+        REQUIRE_EQ(0u, m.size());
+        modify(m, 5000);
+        require_contents(m, expected, deleted);
+      }
+      art::durable_art<account> m(dir.path(), unsynced());
+      require_contents(m, expected, deleted);
+      /* every opening continues in a new segment */
+      REQUIRE(dir.files() == vector<string>{"log.1", "log.2"});
+    }
+
+    SUBCASE("from a checkpoint and the log after it") {
+      {
+        art::durable_art<account> m(dir.path(), unsynced());
+        modify(m, 5000);
+        m.checkpoint();
+        REQUIRE(dir.files() == vector<string>{"checkpoint.2", "log.2"});
+        modify(m, 1000);
+      }
+      {
+        art::durable_art<account> m(dir.path(), unsynced());
+        require_contents(m, expected, deleted);
+        modify(m, 1000);
+        m.checkpoint();
+        m.checkpoint();
+        REQUIRE(dir.files() == vector<string>{"checkpoint.5", "log.5"});
+      }
+      art::durable_art<account> m(dir.path(), unsynced());
+      require_contents(m, expected, deleted);
+    }
+
+    SUBCASE("synced") {
+      {
+        art::durable_art<account> m(dir.path());
+        modify(m, 100);
+        m.checkpoint();
+        modify(m, 100);
+      }
+      art::durable_art<account> m(dir.path());
+      require_contents(m, expected, deleted);
+    }
+
+    SUBCASE("a torn record is dropped") {
+      {
+        art::durable_art<account> m(dir.path(), unsynced());
+        m.set("a", account{1, 0});
+        m.set("b", account{2, 0});
+      }
+      /* the start of a record of "c" */
+      std::ofstream(dir.path() + "/log.1", std::ios::binary | std::ios::app)
+          .write("\x01\x02\x03\x04\x02\x00", 6);
+      {
+        art::durable_art<account> m(dir.path(), unsynced());
+        account a;
+        REQUIRE_EQ(2u, m.size());
+        REQUIRE(m.get("b", a));
+        REQUIRE_EQ(2, a.balance);
+        m.set("c", account{3, 0});
+      }
+      /* the torn record was truncated, the log continues after it */
+      art::durable_art<account> m(dir.path(), unsynced());
+      REQUIRE_EQ(3u, m.size());
+    }
+
+    SUBCASE("records after a corrupt one are dropped") {
+      {
+        art::durable_art<account> m(dir.path(), unsynced());
+        m.set("a", account{1, 0});
+        m.set("b", account{2, 0});
+      }
+      {
+        /* flip the key of "b", whose record is the last */
+        std::fstream f(dir.path() + "/log.1",
+                       std::ios::binary | std::ios::in | std::ios::out);
+        f.seekp(-static_cast<int>(sizeof(account) + 2), std::ios::end);
+        f.put('c');
+      }
+      art::durable_art<account> m(dir.path(), unsynced());
+      account a;
+      REQUIRE_EQ(1u, m.size());
+      REQUIRE_FALSE(m.get("b", a));
+      REQUIRE_FALSE(m.get("c", a));
+    }
+  }
+
+  TEST_CASE("failed operations are not logged") {
+    temp_dir dir;
+    {
+      art::durable_art<account> m(dir.path(), unsynced());
+      m.set("ab", 2, account{1, 0});
+      REQUIRE_THROWS_AS(m.set("a", 1, account{2, 0}), std::invalid_argument);
+      REQUIRE_FALSE(m.del("b", 1));
+    }
+    art::durable_art<account> m(dir.path(), unsynced());
+    account a;
+    REQUIRE_EQ(1u, m.size());
+    REQUIRE(m.get("ab", 2, a));
+    REQUIRE_EQ(1, a.balance);
+    REQUIRE_THROWS_AS(art::durable_art<int32_t>(dir.path(), unsynced()),
+                      std::runtime_error);
+    REQUIRE_THROWS_AS(art::durable_art<int32_t>("no/such/dir"),
+                      std::runtime_error);
+  }
+
+  TEST_CASE("concurrent writers and background checkpoints") {
+    temp_dir dir;
+    const int n_threads = 4, n = 2000;
+    art::durability_options options;
+    options.sync = false;
+    options.checkpoint_log_bytes = 16 * 1024;
+    SUBCASE("group commit") {}
+    SUBCASE("group commit with a delay") {
+      options.group_commit_delay = std::chrono::microseconds(100);
+    }
+    SUBCASE("without waiting for the sync") { options.wait_for_sync = false; }
+    {
+      art::durable_art<account> m(dir.path(), options);
+      vector<std::thread> threads;
+      for (int t = 0; t < n_threads; ++t) {
+        threads.emplace_back([&m, t] {
+          string key;
+          for (int i = 0; i < n; ++i) {
+            key = to_string(t) + "/" + to_string(i);
+            m.set(key.c_str(), account{i, t});
+            if (i % 2 == 1) {
+              m.del((to_string(t) + "/" + to_string(i - 1)).c_str());
+            }
+          }
+        });
+      }
+      for (std::thread &thread : threads) {
+        thread.join();
+      }
+      m.sync();
+      REQUIRE_EQ(static_cast<std::size_t>(n_threads * n / 2), m.size());
+    }
+    vector<string> files = dir.files();
+    REQUIRE(std::any_of(files.begin(), files.end(), [](const string &name) {
+      return name.compare(0, 11, "checkpoint.") == 0;
+    }));
+    art::durable_art<account> m(dir.path(), options);
+    REQUIRE_EQ(static_cast<std::size_t>(n_threads * n / 2), m.size());
+    account a;
+    for (int t = 0; t < n_threads; ++t) {
+      for (int i = 0; i < n; ++i) {
+        string key = to_string(t) + "/" + to_string(i);
+        REQUIRE_EQ(i % 2 == 1, m.get(key.c_str(), a));
+        if (i % 2 == 1) {
+          REQUIRE_EQ(i, a.balance);
+          REQUIRE_EQ(t, a.id);
+        }
+      }
+    }
+  }
+}
@@ -0,0 +1,129 @@
+/**
+ * @file epoch_allocator tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "counting_allocator.hpp"
+#include "doctest.h"
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace art;
+
+using art_test::counting_allocator;
+using std::atomic;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::vector;
+
+TEST_SUITE("epoch_allocator") {
+
+  TEST_CASE("retired blocks are freed two epochs later") {
+    const int n_live = counting_allocator::n_live;
+    epoch_allocator<counting_allocator> alloc;
+    void *p = alloc.allocate(16);
+    REQUIRE_EQ(n_live + 1, counting_allocator::n_live.load());
+    alloc.deallocate(p, 16);
+    REQUIRE_EQ(1u, alloc.n_retired());
+    REQUIRE_EQ(n_live + 1, counting_allocator::n_live.load());
+
+    uint64_t e = alloc.epoch();
+    alloc.collect();
+    REQUIRE_EQ(e + 1, alloc.epoch());
+    REQUIRE_EQ(1u, alloc.n_retired());
+    alloc.collect();
+    REQUIRE_EQ(e + 2, alloc.epoch());
+    REQUIRE_EQ(0u, alloc.n_retired());
+    REQUIRE_EQ(n_live, counting_allocator::n_live.load());
+  }
+
+  TEST_CASE("guards hold back reclamation") {
+    const int n_live = counting_allocator::n_live;
+    epoch_allocator<counting_allocator> alloc;
+    atomic<bool> entered(false), done(false);
+    thread reader([&]() {
+      epoch_allocator<counting_allocator>::guard guard(alloc);
+      entered = true;
+      while (!done) {
+        std::this_thread::yield();
+      }
+    });
+    while (!entered) {
+      std::this_thread::yield();
+    }
+
+    alloc.deallocate(alloc.allocate(16), 16);
+    for (int i = 0; i < 10; ++i) {
+      alloc.collect();
+    }
+    /* the reader announced an epoch at most one behind */
+    REQUIRE_EQ(1u, alloc.n_retired());
+
+    done = true;
+    reader.join();
+    alloc.collect();
+    alloc.collect();
+    REQUIRE_EQ(0u, alloc.n_retired());
+    REQUIRE_EQ(n_live, counting_allocator::n_live.load());
+  }
+
+  TEST_CASE("nested guards") {
+    epoch_allocator<counting_allocator> alloc;
+    {
+      epoch_allocator<counting_allocator>::guard outer(alloc);
+      {
+        epoch_allocator<counting_allocator>::guard inner(alloc);
+      }
+      alloc.deallocate(alloc.allocate(16), 16);
+      alloc.collect();
+      alloc.collect();
+      alloc.collect();
+      /* still inside the outer guard */
+      REQUIRE_EQ(1u, alloc.n_retired());
+    }
+    alloc.collect();
+    alloc.collect();
+    REQUIRE_EQ(0u, alloc.n_retired());
+  }
+
+  TEST_CASE("bounded backlog") {
+    const int n_live = counting_allocator::n_live;
+    {
+      olc_art<int, counting_allocator> m;
+      int int0;
+      vector<thread> threads;
+      for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&, t]() {
+          for (int round = 0; round < 20; ++round) {
+            for (int i = 0; i < 1000; ++i) {
+              m.set(to_string(i * 4 + t).c_str(), &int0);
+            }
+            for (int i = 0; i < 1000; ++i) {
+              m.del(to_string(i * 4 + t).c_str());
+            }
+          }
+        });
+      }
+      for (auto &th : threads) {
+        th.join();
+      }
+      /* collects the limbo lists of the exited threads, too */
+      for (int round = 0; round < 4; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+          m.set(to_string(i).c_str(), &int0);
+        }
+        for (int i = 0; i < 1000; ++i) {
+          m.del(to_string(i).c_str());
+        }
+      }
+      /* 84000 leaves were deleted, most of them are released */
+      REQUIRE(m.n_retired() <
+              4 * epoch_allocator<counting_allocator>::collect_threshold);
+    }
+    REQUIRE_EQ(n_live, counting_allocator::n_live.load());
+  }
+}
@@ -10,6 +10,7 @@
 #include <iostream>
 #include <memory>
 #include <random>
+#include <type_traits>
 #include <utility>
 #include <vector>
 
@@ -175,4 +176,88 @@ TEST_SUITE("inner_node") {
     REQUIRE(it != it_end);
     REQUIRE_EQ(127, (int) *it);
   }
+
+  TEST_CASE("type tag dispatch") {
+    heap_allocator alloc;
+    inner_node<void> *n = make<node_4<void>>(alloc);
+    leaf_node<void> child(nullptr);
+    REQUIRE_FALSE(std::is_polymorphic<inner_node<void>>::value);
+    REQUIRE(n->type_ == node_type::node_4);
+    REQUIRE_FALSE(n->is_leaf());
+    REQUIRE(child.is_leaf());
+
+    const node_type types[] = {node_type::node_4, node_type::node_16,
+                               node_type::node_48, node_type::node_256};
+    int type_i = 0;
+    for (int i = 0; i < 256; ++i) {
+      if (n->is_full()) {
+        n = n->grow(alloc);
+        ++type_i;
+      }
+      REQUIRE(n->type_ == types[type_i]);
+      n->set_child(i - 128, &child);
+      REQUIRE_EQ(i + 1, n->n_children());
+    }
+    REQUIRE(n->type_ == node_type::node_256);
+    for (int i = 0; i < 256; ++i) {
+      REQUIRE(n->find_child(i - 128) != nullptr);
+    }
+    REQUIRE_EQ(-128, n->next_partial_key(-128));
+    REQUIRE_EQ(127, n->prev_partial_key(127));
+
+    for (int i = 255; i >= 0; --i) {
+      REQUIRE_EQ(&child, n->del_child(i - 128));
+      if (n->is_underfull()) {
+        n = n->shrink(alloc);
+        --type_i;
+      }
+      REQUIRE(n->type_ == types[type_i]);
+      REQUIRE_EQ(i, n->n_children());
+    }
+    n->destroy(alloc);
+  }
+
+  TEST_CASE("slot iteration") {
+    heap_allocator alloc;
+    std::vector<leaf_node<void>> children;
+    children.reserve(256);
+    for (int i = 0; i < 256; ++i) {
+      children.emplace_back(nullptr);
+    }
+    inner_node<void> *n = make<node_4<void>>(alloc);
+    /* sparse children, grown to every node type */
+    const int partial_keys[] = {-128, -77, -1, 0, 3, 64, 100, 127};
+    int n_keys = 0;
+    for (int k = -128; k < 128; ++k) {
+      bool is_sparse = false;
+      for (int pk : partial_keys) {
+        is_sparse = is_sparse || pk == k;
+      }
+      if (!is_sparse && (k % 5 != 0 || n_keys > 60)) {
+        continue;
+      }
+      if (n->is_full()) {
+        n = n->grow(alloc);
+      }
+      n->set_child(k, &children[128 + k]);
+      ++n_keys;
+
+      int i = 0;
+      char prev = 0;
+      for (auto it = n->begin(); it != n->end(); ++it, ++i) {
+        REQUIRE(*it.child() == &children[128 + *it]);
+        REQUIRE((i == 0 || prev < *it));
+        prev = *it;
+      }
+      REQUIRE_EQ(n_keys, i);
+      for (auto it = n->rbegin(); it != n->rend(); ++it, --i) {
+        REQUIRE(*n->find_child(*it) == &children[128 + *it]);
+        REQUIRE((i == n_keys || prev > *it));
+        prev = *it;
+      }
+      REQUIRE_EQ(0, i);
+    }
+    REQUIRE(n->type_ == node_type::node_256);
+    n->destroy(alloc);
+  }
 }
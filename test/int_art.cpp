@@ -0,0 +1,126 @@
+/**
+ * @file int_art tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <vector>
+
+using std::map;
+using std::mt19937_64;
+using std::numeric_limits;
+using std::vector;
+
+TEST_SUITE("int_art") {
+
+  TEST_CASE("set, get & delete") {
+    art::int_art<uint64_t, int> m;
+    int int0, int1, int2;
+
+    REQUIRE_EQ(nullptr, m.get(0));
+    REQUIRE_EQ(nullptr, m.set(0, &int0));
+    REQUIRE_EQ(nullptr, m.set(1, &int1));
+    REQUIRE_EQ(nullptr, m.set(numeric_limits<uint64_t>::max(), &int2));
+    REQUIRE_EQ(&int0, m.get(0));
+    REQUIRE_EQ(&int1, m.get(1));
+    REQUIRE_EQ(&int2, m.get(numeric_limits<uint64_t>::max()));
+    REQUIRE_EQ(nullptr, m.get(256));
+
+    REQUIRE_EQ(&int0, m.set(0, &int2));
+    REQUIRE_EQ(&int2, m.get(0));
+
+    REQUIRE_EQ(&int2, m.del(0));
+    REQUIRE_EQ(nullptr, m.get(0));
+    REQUIRE_EQ(&int1, m.get(1));
+  }
+
+  TEST_CASE("encode") {
+    char bytes[4];
+    art::int_art<uint32_t, int>::encode(0x01020384, bytes);
+    REQUIRE_EQ(static_cast<char>(0x81), bytes[0]);
+    REQUIRE_EQ(static_cast<char>(0x82), bytes[1]);
+    REQUIRE_EQ(static_cast<char>(0x83), bytes[2]);
+    REQUIRE_EQ(static_cast<char>(0x04), bytes[3]);
+
+    /* the sign bit is flipped as well */
+    art::int_art<int32_t, int>::encode(0x01020384, bytes);
+    REQUIRE_EQ(static_cast<char>(0x01), bytes[0]);
+    REQUIRE_EQ(static_cast<char>(0x82), bytes[1]);
+    REQUIRE_EQ(static_cast<char>(0x83), bytes[2]);
+    REQUIRE_EQ(static_cast<char>(0x04), bytes[3]);
+  }
+
+  TEST_CASE("numeric order") {
+    SUBCASE("signed") {
+      art::int_art<int32_t, int> m;
+      vector<int32_t> keys = {numeric_limits<int32_t>::min(), -65536, -255,
+                              -1, 0, 1, 127, 128, 255, 256, 65536,
+                              numeric_limits<int32_t>::max()};
+      vector<int> values(keys.size());
+      for (size_t i = keys.size(); i-- > 0;) {
+        m.set(keys[i], &values[i]);
+      }
+      size_t i = 0;
+      for (auto it = m.begin(); it != m.end(); ++it, ++i) {
+        REQUIRE(i < keys.size());
+        REQUIRE_EQ(&values[i], *it);
+      }
+      REQUIRE_EQ(keys.size(), i);
+      REQUIRE_EQ(&values[3], *m.begin(-1));
+      REQUIRE_EQ(&values[7], *m.begin(128));
+      REQUIRE_EQ(&values[3], *m.last(-1));
+      REQUIRE_EQ(&values[6], *m.last(128 - 1));
+      REQUIRE(m.last(numeric_limits<int32_t>::min() + 1) != m.end());
+      REQUIRE_EQ(&values[0], *m.last(numeric_limits<int32_t>::min() + 1));
+      i = keys.size();
+      for (auto it = m.last(); it != m.end(); --it) {
+        REQUIRE_EQ(&values[--i], *it);
+      }
+      REQUIRE_EQ(0u, i);
+    }
+
+    SUBCASE("unsigned") {
+      art::int_art<uint16_t, int> m;
+      vector<int> values(1 << 16);
+      for (int k = (1 << 16) - 1; k >= 0; k -= 7) {
+        m.set(static_cast<uint16_t>(k), &values[k]);
+      }
+      int expected = 0xFFFF % 7;
+      for (auto it = m.begin(); it != m.end(); ++it, expected += 7) {
+        REQUIRE_EQ(&values[expected], *it);
+      }
+      REQUIRE_EQ(0xFFFF + 7, expected);
+    }
+  }
+
+  TEST_CASE("monte carlo") {
+    const int n = 10000;
+    mt19937_64 g(0);
+    map<int64_t, int *> expected;
+    vector<int> values(n);
+    art::int_art<int64_t, int> m;
+    for (int i = 0; i < n; ++i) {
+      /* mostly small keys, so that they share prefixes */
+      int64_t key = static_cast<int64_t>(g()) >> (g() % 64);
+      m.set(key, &values[i]);
+      expected[key] = &values[i];
+    }
+    auto it = m.begin();
+    for (auto &e : expected) {
+      REQUIRE(it != m.end());
+      REQUIRE_EQ(e.second, *it);
+      REQUIRE_EQ(e.second, m.get(e.first));
+      ++it;
+    }
+    REQUIRE(it == m.end());
+    for (auto &e : expected) {
+      REQUIRE_EQ(e.second, m.del(e.first));
+    }
+    REQUIRE(m.begin() == m.end());
+  }
+}
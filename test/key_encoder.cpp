@@ -0,0 +1,224 @@
+/**
+ * @file key_encoder tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <tuple>
+#include <vector>
+
+using std::numeric_limits;
+using std::string;
+using std::vector;
+
+namespace {
+
+/* the order of the tree, bytes compared as signed chars */
+bool tree_less(const string &a, const string &b) {
+  std::size_t n = std::min(a.size(), b.size());
+  for (std::size_t i = 0; i < n; ++i) {
+    if (a[i] != b[i]) {
+      return static_cast<signed char>(a[i]) < static_cast<signed char>(b[i]);
+    }
+  }
+  return a.size() < b.size();
+}
+
+template <class... Vs> string encoded(const Vs &... values) {
+  art::key_encoder<64> k;
+  k.encode(values...);
+  return string(k.data(), k.size());
+}
+
+/* every value is ordered before the next one */
+template <class V> void require_order(const vector<V> &values) {
+  for (std::size_t i = 0; i + 1 < values.size(); ++i) {
+    REQUIRE(tree_less(encoded(values[i]), encoded(values[i + 1])));
+  }
+}
+
+} // namespace
+
+TEST_SUITE("key_encoder") {
+
+  TEST_CASE("value order") {
+    SUBCASE("integers") {
+      require_order(vector<int64_t>{numeric_limits<int64_t>::min(), -256, -1,
+                                    0, 1, 255, 256,
+                                    numeric_limits<int64_t>::max()});
+      require_order(vector<int8_t>{-128, -1, 0, 1, 127});
+      require_order(vector<uint32_t>{0, 1, 255, 256, 0xffffffff});
+      REQUIRE_EQ(8u, encoded(int64_t(0)).size());
+      REQUIRE_EQ(2u, encoded(uint16_t(0)).size());
+
+      /* the bytes of int_art */
+      char bytes[8];
+      art::int_art<int64_t, int>::encode(-42, bytes);
+      REQUIRE_EQ(string(bytes, 8), encoded(int64_t(-42)));
+    }
+
+    SUBCASE("floats") {
+      const double inf = numeric_limits<double>::infinity();
+      require_order(vector<double>{-inf, -1e300, -1.5, -1e-300,
+                                   -numeric_limits<double>::denorm_min(), 0.0,
+                                   numeric_limits<double>::denorm_min(), 1e-300,
+                                   1.0, 1.5, 1e300, inf, std::nan("")});
+      require_order(vector<float>{-1.0f, 0.0f, 0.5f, 1.0f});
+      REQUIRE_EQ(encoded(0.0), encoded(-0.0));
+      REQUIRE_EQ(encoded(std::nan("")), encoded(-std::nan("1")));
+      REQUIRE_EQ(4u, encoded(1.0f).size());
+    }
+
+    SUBCASE("strings") {
+      require_order(vector<string>{"", string("\0", 1), string("\0\0", 2),
+                                   string("\0\x01", 2), "\x01", "a",
+                                   string("a\0", 2), string("a\0b", 3), "ab",
+                                   "b", "\x7f", "\x80", "\xff"});
+      REQUIRE_EQ(encoded("abc"), encoded(string("abc")));
+      art::key_encoder<8> k;
+      k.append("abcd", 3);
+      REQUIRE_EQ(encoded("abc"), string(k.data(), k.size()));
+#if __cplusplus >= 201703L
+      REQUIRE_EQ(encoded("abc"), encoded(std::string_view("abc")));
+#endif
+    }
+  }
+
+  TEST_CASE("composite keys") {
+    using tuple = std::tuple<int64_t, string, double>;
+    std::mt19937_64 g(0);
+    const vector<string> names = {"", "a", "ab", string("a\0", 2), "b", "ba"};
+    std::map<tuple, int> expected;
+    art::art<int, art::heap_allocator> m;
+    vector<int> values(2000);
+    art::key_encoder<32> k;
+    for (std::size_t i = 0; i < values.size(); ++i) {
+      values[i] = i;
+      tuple t(static_cast<int64_t>(g() % 20) - 10, names[g() % names.size()],
+              static_cast<double>(static_cast<int>(g() % 200) - 100) / 8);
+      k.encode(std::get<0>(t), std::get<1>(t), std::get<2>(t));
+      /* keys of the same types are prefix-free */
+      int *old = m.set(k.data(), k.size(), &values[i]);
+      auto it = expected.find(t);
+      REQUIRE_EQ(it == expected.end() ? nullptr : &values[it->second], old);
+      expected[t] = values[i];
+    }
+
+    /* the tree iterates in the order of the tuples */
+    REQUIRE_EQ(expected.size(), m.stats().n_leaves);
+    auto expected_it = expected.begin();
+    for (auto it = m.begin(); it != m.end(); ++it, ++expected_it) {
+      REQUIRE(expected_it != expected.end());
+      tuple t;
+      art::key_decoder d(it.key());
+      d.read(std::get<0>(t)).read(std::get<1>(t)).read(std::get<2>(t));
+      REQUIRE(d.done());
+      REQUIRE(t == expected_it->first);
+      REQUIRE_EQ(expected_it->second, **it);
+    }
+    REQUIRE(expected_it == expected.end());
+
+    /* a range scan over a prefix of the tuple */
+    k.encode(int64_t(3), "ab");
+    std::size_t n = 0;
+    const string prefix(k.data(), k.size());
+    for (auto it = m.begin(k.data(), k.size());
+         it != m.end() && it.key().compare(0, prefix.size(), prefix) == 0;
+         ++it) {
+      ++n;
+    }
+    std::size_t n_expected = 0;
+    for (const auto &entry : expected) {
+      n_expected +=
+          std::get<0>(entry.first) == 3 && std::get<1>(entry.first) == "ab";
+    }
+    REQUIRE(n_expected > 0);
+    REQUIRE_EQ(n_expected, n);
+  }
+
+  TEST_CASE("decoding") {
+    art::key_encoder<64> k;
+    k.encode(true, 'x', int16_t(-7), uint64_t(1) << 40, -2.5f, 1e-10,
+             string("a\0b", 3));
+    art::key_decoder d(k.data(), k.size());
+    bool b;
+    char c;
+    int16_t i;
+    uint64_t u;
+    float f;
+    double x;
+    string s;
+    d.read(b).read(c).read(i).read(u).read(f).read(x).read(s);
+    REQUIRE(d.done());
+    REQUIRE(b);
+    REQUIRE_EQ('x', c);
+    REQUIRE_EQ(-7, i);
+    REQUIRE_EQ(uint64_t(1) << 40, u);
+    REQUIRE_EQ(-2.5f, f);
+    REQUIRE_EQ(1e-10, x);
+    REQUIRE_EQ(string("a\0b", 3), s);
+    REQUIRE_THROWS_AS(d.read(b), std::invalid_argument);
+
+    k.encode(int32_t(1));
+    art::key_decoder truncated(k.data(), 3);
+    REQUIRE_THROWS_AS(truncated.read(i).read(i), std::invalid_argument);
+    k.encode("ab");
+    art::key_decoder unterminated(k.data(), k.size() - 1);
+    REQUIRE_THROWS_AS(unterminated.read(s), std::invalid_argument);
+  }
+
+  TEST_CASE("capacity") {
+    art::key_encoder<8> k;
+    k.encode(int32_t(1), "a");
+    REQUIRE_EQ(7u, k.size());
+    /* the key is unchanged by a value that does not fit */
+    REQUIRE_THROWS_AS(k.append(int16_t(1)), std::length_error);
+    REQUIRE_THROWS_AS(k.append(""), std::length_error);
+    REQUIRE_EQ(7u, k.size());
+    k.append(true);
+    REQUIRE_EQ(8u, k.size());
+    k.clear();
+    REQUIRE_EQ(0u, k.size());
+
+    art::key_batch<8, 2> batch;
+    batch.push(int64_t(1));
+    REQUIRE_THROWS_AS(batch.push(int64_t(1), true), std::length_error);
+    batch.push("abc");
+    REQUIRE(batch.full());
+    REQUIRE_THROWS_AS(batch.push(true), std::length_error);
+    REQUIRE_EQ(2u, batch.size());
+    REQUIRE_EQ(5u, batch.key_lens()[1]);
+  }
+
+  TEST_CASE("batches for multi_get") {
+    art::art<int> m;
+    vector<int> values(100);
+    art::key_encoder<16> k;
+    for (int i = 0; i < 100; ++i) {
+      values[i] = i;
+      k.encode(int32_t(i), i % 2 == 0);
+      m.set(k.data(), k.size(), &values[i]);
+    }
+    /* every seventh key, the last ones are missing */
+    art::key_batch<16> batch;
+    for (int i = 0; !batch.full(); ++i) {
+      batch.push(int32_t(i * 7), i % 2 == 0);
+    }
+    vector<int *> found(batch.size());
+    m.multi_get(batch.keys(), batch.key_lens(), batch.size(), found.data());
+    for (std::size_t i = 0; i < batch.size(); ++i) {
+      std::size_t j = i * 7;
+      bool present = j < values.size() && (i % 2 == 0) == (j % 2 == 0);
+      REQUIRE_EQ(present ? &values[j] : nullptr, found[i]);
+    }
+  }
+}
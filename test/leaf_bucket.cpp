@@ -0,0 +1,92 @@
+/**
+ * @file leaf_bucket tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <string>
+
+using namespace art;
+
+using std::string;
+
+namespace {
+
+string key_at(const leaf_bucket<int> *b, int i) {
+  int len;
+  const char *key = b->key(i, len);
+  return string(key, len);
+}
+
+} // namespace
+
+TEST_SUITE("leaf bucket") {
+
+  TEST_CASE("find, insert & erase") {
+    heap_allocator alloc;
+    int v0 = 0, v1 = 1, v2 = 2;
+    leaf_bucket<int>::entry entries[] = {{"xab", 3, &v0}, {"xac", 3, &v1}};
+    /* the first byte is dropped */
+    auto b = leaf_bucket<int>::make(entries, 2, nullptr, 0, 1, alloc);
+    REQUIRE_EQ(2, b->n_keys());
+    REQUIRE_EQ(0, b->find("ab", 2));
+    REQUIRE_EQ(1, b->find("ac", 2));
+    REQUIRE_EQ(-1, b->find("a", 1));
+    REQUIRE_EQ(-1, b->find("ad", 2));
+    REQUIRE_EQ(&v1, b->value(1));
+
+    /* keys are ordered by signed bytes */
+    char negative[] = {'a', -1};
+    REQUIRE_EQ(0, b->lower_bound(negative, 2));
+    REQUIRE_EQ(1, b->lower_bound("ac", 2));
+    REQUIRE_EQ(2, b->lower_bound("b", 1));
+    REQUIRE(b->is_prefix_related(0, "a", 1));
+    REQUIRE(b->is_prefix_related(1, "acd", 3));
+    REQUIRE_FALSE(b->is_prefix_related(1, "ac", 2));
+    REQUIRE_FALSE(b->is_prefix_related(2, "a", 1));
+
+    b = b->insert(1, "abc", 3, &v2, alloc);
+    REQUIRE_EQ(3, b->n_keys());
+    REQUIRE_EQ("ab", key_at(b, 0));
+    REQUIRE_EQ("abc", key_at(b, 1));
+    REQUIRE_EQ("ac", key_at(b, 2));
+    REQUIRE_EQ(1, b->find("abc", 3));
+    REQUIRE_EQ(&v2, b->value(1));
+
+    b = b->erase(0, alloc);
+    REQUIRE_EQ(2, b->n_keys());
+    REQUIRE_EQ(-1, b->find("ab", 2));
+    REQUIRE_EQ(0, b->find("abc", 3));
+
+    b = b->prepend("pq", 2, 'r', alloc);
+    REQUIRE_EQ("pqrabc", key_at(b, 0));
+    REQUIRE_EQ("pqrac", key_at(b, 1));
+    REQUIRE_EQ(1, b->find("pqrac", 5));
+    REQUIRE_EQ(sizeof(leaf_bucket<int>) + 2 * (sizeof(int *) + 4) + 11,
+               b->size());
+    b->destroy(alloc);
+  }
+
+  TEST_CASE("capacity") {
+    heap_allocator alloc;
+    int v = 0;
+    leaf_bucket<int>::entry e{"", 0, &v};
+    /* a bucket may hold an empty key */
+    auto b = leaf_bucket<int>::make(&e, 1, nullptr, 0, 0, alloc);
+    REQUIRE_EQ(0, b->find("", 0));
+    REQUIRE_EQ(-1, b->find("\0", 1));
+    b = b->erase(0, alloc);
+
+    char key[1];
+    for (int i = 0; i < leaf_bucket<int>::capacity; ++i) {
+      key[0] = 'a' + i;
+      b = b->insert(b->lower_bound(key, 1), key, 1, &v, alloc);
+    }
+    for (int i = 0; i < leaf_bucket<int>::capacity; ++i) {
+      key[0] = 'a' + i;
+      REQUIRE_EQ(i, b->find(key, 1));
+    }
+    b->destroy(alloc);
+  }
+}
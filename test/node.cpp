@@ -4,6 +4,7 @@
  */
 
 #include "art.hpp"
+#include "counting_allocator.hpp"
 #include "doctest.h"
 #include <algorithm>
 #include <array>
@@ -15,6 +16,7 @@
 
 using namespace ::art;
 
+using art_test::counting_allocator;
 using std::array;
 using std::make_pair;
 using std::make_shared;
@@ -34,8 +36,8 @@ TEST_SUITE("node") {
     string prefix = "0000";
     int prefix_len = prefix.length() + 1; // +1 for \0
 
-    node.prefix_ = (char *) prefix.c_str();
-    node.prefix_len_ = prefix_len;
+    heap_allocator alloc;
+    node.set_prefix(prefix.c_str(), prefix_len, alloc);
 
     CHECK_EQ(3, node.check_prefix(key.c_str() + 0, key_len - 0));
     CHECK_EQ(2, node.check_prefix(key.c_str() + 1, key_len - 1));
@@ -47,5 +49,128 @@ TEST_SUITE("node") {
     CHECK_EQ(1, node.check_prefix(key.c_str() + 7, key_len - 7));
     CHECK_EQ(0, node.check_prefix(key.c_str() + 8, key_len - 8));
     CHECK_EQ(0, node.check_prefix(key.c_str() + 9, key_len - 9));
+
+    /* no more than key_len bytes are compared */
+    CHECK_EQ(2, node.check_prefix(prefix.c_str(), 2));
+    CHECK_EQ(0, node.check_prefix(prefix.c_str(), 0));
+  }
+
+  TEST_CASE("prefix storage") {
+    heap_allocator alloc;
+    leaf_node<int> node(nullptr);
+    const char *bytes = "0123456789abcdefghij";
+    const int inline_len = node.max_inline_prefix_len;
+
+    SUBCASE("short prefix is stored inline") {
+      node.set_prefix(bytes, inline_len, alloc);
+      REQUIRE(node.is_prefix_inline());
+      REQUIRE(std::equal(bytes, bytes + inline_len, node.prefix()));
+      REQUIRE_EQ(inline_len, node.check_prefix(bytes, inline_len));
+    }
+
+    SUBCASE("long prefix is stored on the heap") {
+      node.set_prefix(bytes, 20, alloc);
+      REQUIRE_FALSE(node.is_prefix_inline());
+      REQUIRE(std::equal(bytes, bytes + 20, node.prefix()));
+      REQUIRE_EQ(20, node.check_prefix(bytes, 20));
+      node.free_prefix(alloc);
+      REQUIRE_EQ(0, node.prefix_len_);
+    }
+
+    SUBCASE("shift prefix inside the node") {
+      node.set_prefix(bytes, 20, alloc);
+      node.set_prefix(node.prefix() + 5, 15, alloc);
+      REQUIRE(std::equal(bytes + 5, bytes + 20, node.prefix()));
+      node.set_prefix(node.prefix() + 10, 5, alloc);
+      REQUIRE(node.is_prefix_inline());
+      REQUIRE(std::equal(bytes + 15, bytes + 20, node.prefix()));
+      node.set_prefix(node.prefix() + 1, 4, alloc);
+      REQUIRE(std::equal(bytes + 16, bytes + 20, node.prefix()));
+    }
+
+    node.free_prefix(alloc);
+  }
+
+  TEST_CASE("heap prefixes are reused") {
+    counting_allocator alloc;
+    const int n_allocations = alloc.n_allocations;
+    const std::size_t n_live_bytes = alloc.n_live_bytes;
+    const char *bytes = "0123456789abcdefghijklmnopqrstuvwxyz";
+
+    SUBCASE("splitting shifts the prefix in place") {
+      leaf_node<int> node(nullptr);
+      node.set_prefix(bytes, 30, alloc);
+      const char *heap = node.prefix();
+      node.set_prefix(node.prefix() + 10, 20, alloc);
+      REQUIRE_EQ(1, alloc.n_allocations - n_allocations);
+      REQUIRE_EQ(heap, node.prefix());
+      REQUIRE_EQ(30, node.heap_prefix_size());
+      REQUIRE(std::equal(bytes + 10, bytes + 30, node.prefix()));
+
+      /* and prepending shifts it back */
+      node.prepend_prefix(bytes, 9, bytes[9], alloc);
+      REQUIRE_EQ(1, alloc.n_allocations - n_allocations);
+      REQUIRE_EQ(heap, node.prefix());
+      REQUIRE_EQ(30, node.prefix_len_);
+      REQUIRE(std::equal(bytes, bytes + 30, node.prefix()));
+
+      /* unless it doesn't fit */
+      node.prepend_prefix(bytes, 0, 'x', alloc);
+      REQUIRE_EQ(2, alloc.n_allocations - n_allocations);
+      REQUIRE_EQ(31, node.heap_prefix_size());
+      REQUIRE_EQ('x', node.prefix()[0]);
+      node.free_prefix(alloc);
+      REQUIRE_EQ(n_live_bytes, alloc.n_live_bytes.load());
+    }
+
+    SUBCASE("merging takes over the parent's prefix") {
+      leaf_node<int> parent(nullptr), child(nullptr);
+      parent.set_prefix(bytes, 30, alloc);
+      parent.set_prefix(bytes, 12, alloc);
+      child.set_prefix(bytes + 13, 4, alloc);
+      const char *heap = parent.prefix();
+      child.prepend_prefix(parent, bytes[12], alloc);
+      REQUIRE_EQ(1, alloc.n_allocations - n_allocations);
+      REQUIRE_EQ(heap, child.prefix());
+      REQUIRE_EQ(0, parent.prefix_len_);
+      REQUIRE_EQ(17, child.prefix_len_);
+      REQUIRE(std::equal(bytes, bytes + 17, child.prefix()));
+      child.free_prefix(alloc);
+      REQUIRE_EQ(n_live_bytes, alloc.n_live_bytes.load());
+    }
+
+    SUBCASE("splitting hands the prefix to the parent") {
+      leaf_node<int> parent(nullptr), child(nullptr);
+      child.set_prefix(bytes, 30, alloc);
+      const char *heap = child.prefix();
+      child.split_prefix(parent, 21, alloc);
+      REQUIRE_EQ(1, alloc.n_allocations - n_allocations);
+      REQUIRE_EQ(heap, parent.prefix());
+      REQUIRE_EQ(21, parent.prefix_len_);
+      REQUIRE(std::equal(bytes, bytes + 21, parent.prefix()));
+      REQUIRE(child.is_prefix_inline());
+      REQUIRE_EQ(8, child.prefix_len_);
+      REQUIRE(std::equal(bytes + 22, bytes + 30, child.prefix()));
+
+      /* merging them again takes the parent's prefix back */
+      child.prepend_prefix(parent, bytes[21], alloc);
+      REQUIRE_EQ(1, alloc.n_allocations - n_allocations);
+      REQUIRE_EQ(heap, child.prefix());
+      REQUIRE(std::equal(bytes, bytes + 30, child.prefix()));
+      child.free_prefix(alloc);
+      REQUIRE_EQ(n_live_bytes, alloc.n_live_bytes.load());
+    }
+
+    SUBCASE("short prefixes move inline") {
+      leaf_node<int> node(nullptr);
+      node.set_prefix(bytes, 30, alloc);
+      /* gcc can't tell that the source is on the heap and checks it against
+       * the inline prefix, so it stays within the node's size */
+      node.set_prefix(node.prefix() + 10, 5, alloc);
+      REQUIRE(node.is_prefix_inline());
+      REQUIRE_EQ(0, node.heap_prefix_size());
+      REQUIRE(std::equal(bytes + 10, bytes + 15, node.prefix()));
+      REQUIRE_EQ(n_live_bytes, alloc.n_live_bytes.load());
+    }
   }
 }
@@ -0,0 +1,27 @@
+/**
+ * @file olc_art tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "concurrent_checks.hpp"
+#include "doctest.h"
+
+TEST_SUITE("olc_art") {
+
+  TEST_CASE("set, get & delete") {
+    art_test::check_set_get_del<art::olc_art<int>>();
+  }
+
+  TEST_CASE("monte carlo") {
+    art_test::check_monte_carlo<art::olc_art<int>>();
+  }
+
+  TEST_CASE("concurrent writers") {
+    art_test::check_concurrent_writers<art::olc_art<int>>();
+  }
+
+  TEST_CASE("concurrent readers and writers") {
+    art_test::check_concurrent_readers_and_writers<art::olc_art<int>>();
+  }
+}
@@ -0,0 +1,136 @@
+/**
+ * @file parallel traversal tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::atomic;
+using std::map;
+using std::mutex;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+/* uniform keys and keys that all share one child of the root */
+vector<string> make_keys(bool skewed) {
+  std::mt19937_64 g(0);
+  vector<string> keys;
+  for (int i = 0; i < 20000; ++i) {
+    string key = to_string(g());
+    keys.push_back(skewed && i % 100 != 0 ? "skewed/" + key : key);
+  }
+  return keys;
+}
+
+} // namespace
+
+TEST_SUITE("parallel") {
+
+  TEST_CASE("for_each, reduce & count") {
+    for (bool skewed : {false, true}) {
+      vector<string> keys = make_keys(skewed);
+      art::art<int> m;
+      vector<int> values(keys.size());
+      map<string, int *> expected;
+      long expected_sum = 0;
+      for (std::size_t i = 0; i < keys.size(); ++i) {
+        values[i] = static_cast<int>(i);
+        if (m.set(keys[i].c_str(), &values[i]) == nullptr) {
+          expected_sum += values[i];
+        } else {
+          expected_sum += values[i] - *expected[keys[i] + '\0'];
+        }
+        expected[keys[i] + '\0'] = &values[i];
+      }
+
+      for (unsigned n_threads : {1u, 2u, 8u}) {
+        map<string, int *> visited;
+        mutex visited_mutex;
+        bool duplicate = false;
+        m.parallel_for_each(
+            [&](const string &key, int *value) {
+              std::lock_guard<mutex> lock(visited_mutex);
+              duplicate |= !visited.emplace(key, value).second;
+            },
+            n_threads);
+        REQUIRE_FALSE(duplicate);
+        REQUIRE(expected == visited);
+
+        long sum = m.parallel_reduce(
+            0L, [](int *value) { return static_cast<long>(*value); },
+            [](long a, long b) { return a + b; }, n_threads);
+        REQUIRE_EQ(expected_sum, sum);
+
+        std::size_t n_even = m.parallel_count(
+            [](int *value) { return *value % 2 == 0; }, n_threads);
+        std::size_t expected_n_even = 0;
+        for (const auto &entry : expected) {
+          expected_n_even += *entry.second % 2 == 0;
+        }
+        REQUIRE_EQ(expected_n_even, n_even);
+      }
+    }
+
+    art::art<int> empty;
+    REQUIRE_EQ(0u, empty.parallel_count([](int *) { return true; }, 4));
+  }
+
+  TEST_CASE("clear") {
+    vector<string> keys = make_keys(true);
+    atomic<int> n_freed(0);
+    auto free_fn = [&n_freed](int *value) {
+      ++n_freed;
+      delete value;
+    };
+
+    SUBCASE("thread-safe allocator") {
+      art::art<int, art::heap_allocator> m(free_fn);
+      for (const string &key : keys) {
+        delete m.set(key.c_str(), new int(0));
+      }
+      std::size_t n = m.stats().n_leaves;
+      m.parallel_clear(8);
+      REQUIRE_EQ(n, static_cast<std::size_t>(n_freed.load()));
+      REQUIRE(m.begin() == m.end());
+      REQUIRE_EQ(0u, m.stats().n_leaves);
+      REQUIRE_EQ(0u, m.stats().memory_bytes);
+
+      /* the tree can be used again */
+      m.set("k", new int(1));
+      REQUIRE_EQ(1, *m.get("k"));
+    }
+
+    SUBCASE("bulk releasing allocator") {
+      art::art<int> m(free_fn);
+      for (const string &key : keys) {
+        delete m.set(key.c_str(), new int(0));
+      }
+      std::size_t n = m.stats().n_leaves;
+      m.parallel_clear(8);
+      REQUIRE_EQ(n, static_cast<std::size_t>(n_freed.load()));
+      REQUIRE(m.begin() == m.end());
+    }
+
+    SUBCASE("inline values") {
+      art::value_art<string, art::heap_allocator> m;
+      for (const string &key : keys) {
+        m.set(key.c_str(), key + " is long enough for the heap");
+      }
+      /* the strings are destroyed in parallel, or reported as leaks */
+      m.parallel_clear(8);
+      REQUIRE(m.begin() == m.end());
+      REQUIRE(art::is_thread_safe_allocator<art::heap_allocator>::value);
+      REQUIRE_FALSE(art::is_thread_safe_allocator<art::pool_allocator>::value);
+    }
+  }
+}
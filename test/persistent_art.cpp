@@ -0,0 +1,226 @@
+/**
+ * @file persistent_art tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "counting_allocator.hpp"
+#include "doctest.h"
+#include <atomic>
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace art;
+
+using art_test::counting_allocator;
+using std::atomic;
+using std::map;
+using std::string;
+using std::thread;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+template <class T, class A>
+map<string, T *> contents(const persistent_art<T, A> &tree) {
+  map<string, T *> m;
+  for (auto it = tree.begin(), it_end = tree.end(); it != it_end; ++it) {
+    m[it.key()] = *it;
+  }
+  return m;
+}
+
+} // namespace
+
+TEST_SUITE("persistent_art") {
+
+  TEST_CASE("set, get & del") {
+    persistent_art<int> trie;
+    int int0 = 0, int1 = 1, int2 = 2;
+
+    REQUIRE_EQ(nullptr, trie.set("aa", &int0));
+    REQUIRE_EQ(nullptr, trie.set("aaaaaaaaaaaaaaaaaaab", &int1));
+    REQUIRE_EQ(nullptr, trie.set("aaaaaaaaaaaaaaaaaaac", &int2));
+    REQUIRE_EQ(&int0, trie.get("aa"));
+    REQUIRE_EQ(&int1, trie.get("aaaaaaaaaaaaaaaaaaab"));
+    REQUIRE_EQ(&int2, trie.get("aaaaaaaaaaaaaaaaaaac"));
+    REQUIRE_EQ(nullptr, trie.get("aaaaaaaaaaaaaaaaaaad"));
+
+    REQUIRE_EQ(&int2, trie.set("aaaaaaaaaaaaaaaaaaac", &int1));
+    REQUIRE_EQ(&int1, trie.get("aaaaaaaaaaaaaaaaaaac"));
+
+    REQUIRE_THROWS_AS(trie.set("a", 1, &int0), std::invalid_argument);
+
+    REQUIRE_EQ(&int0, trie.del("aa"));
+    REQUIRE_EQ(nullptr, trie.del("aa"));
+    REQUIRE_EQ(nullptr, trie.get("aa"));
+    REQUIRE_EQ(&int1, trie.get("aaaaaaaaaaaaaaaaaaab"));
+    REQUIRE_EQ(&int1, trie.del("aaaaaaaaaaaaaaaaaaab"));
+    REQUIRE_EQ(&int1, trie.del("aaaaaaaaaaaaaaaaaaac"));
+    REQUIRE(trie.begin() == trie.end());
+  }
+
+  TEST_CASE("snapshots are isolated") {
+    persistent_art<int> trie;
+    int int0 = 0, int1 = 1;
+    for (int i = 0; i < 100; ++i) {
+      trie.set(to_string(i).c_str(), &int0);
+    }
+
+    auto snap = trie.snapshot();
+    /* grows, shrinks, splits prefixes and replaces nodes by siblings */
+    for (int i = 0; i < 100; i += 2) {
+      trie.del(to_string(i).c_str());
+    }
+    for (int i = 100; i < 300; ++i) {
+      trie.set(to_string(i).c_str(), &int1);
+    }
+    trie.set("1", &int1);
+
+    for (int i = 0; i < 100; ++i) {
+      REQUIRE_EQ(&int0, snap.get(to_string(i).c_str()));
+    }
+    REQUIRE_EQ(nullptr, snap.get("100"));
+    REQUIRE_EQ(nullptr, trie.get("0"));
+    REQUIRE_EQ(&int1, trie.get("1"));
+    REQUIRE_EQ(&int0, trie.get("3"));
+    REQUIRE_EQ(&int1, trie.get("299"));
+
+    /* and the other way around */
+    snap.set("0", &int1);
+    REQUIRE_EQ(&int1, snap.get("0"));
+    REQUIRE_EQ(nullptr, trie.get("0"));
+  }
+
+  TEST_CASE("monte carlo") {
+    const int n = 1000, n_versions = 10;
+    std::mt19937_64 g(0);
+    std::uniform_int_distribution<int> key_dist(0, 2 * n);
+    vector<int> values(2 * n + 1);
+
+    persistent_art<int> trie;
+    map<string, int *> expected;
+    vector<persistent_art<int>> versions;
+    vector<map<string, int *>> expected_versions;
+
+    for (int v = 0; v < n_versions; ++v) {
+      for (int i = 0; i < n; ++i) {
+        int k = key_dist(g);
+        /* NUL terminated, see art::begin */
+        string key = to_string(k);
+        key.push_back('\0');
+        if (g() % 3 == 0) {
+          auto it = expected.find(key);
+          REQUIRE_EQ(it == expected.end() ? nullptr : it->second,
+                     trie.del(key.c_str()));
+          if (it != expected.end()) {
+            expected.erase(it);
+          }
+        } else {
+          trie.set(key.c_str(), &values[k]);
+          expected[key] = &values[k];
+        }
+      }
+      versions.push_back(trie.snapshot());
+      expected_versions.push_back(expected);
+    }
+
+    for (int v = 0; v < n_versions; ++v) {
+      REQUIRE(expected_versions[v] == contents(versions[v]));
+    }
+    REQUIRE(expected == contents(trie));
+  }
+
+  TEST_CASE("modifications copy one path") {
+    int n_live = counting_allocator::n_live;
+    {
+      persistent_art<int, counting_allocator> trie;
+      int int0 = 0;
+      for (int i = 0; i < 1000; ++i) {
+        trie.set(to_string(i).c_str(), &int0);
+      }
+      int n_version = counting_allocator::n_live - n_live;
+
+      auto snap = trie.snapshot();
+      REQUIRE_EQ(n_version, counting_allocator::n_live - n_live);
+
+      int n_allocations = counting_allocator::n_allocations;
+      trie.set("500", &int0);
+      /* the root, two inner nodes and the leaf */
+      REQUIRE_LE(counting_allocator::n_allocations - n_allocations, 4);
+
+      n_allocations = counting_allocator::n_allocations;
+      trie.set("500", &int0);
+      /* the path is exclusive now */
+      REQUIRE_EQ(n_allocations, counting_allocator::n_allocations.load());
+
+      n_allocations = counting_allocator::n_allocations;
+      trie.del("nonexistent");
+      REQUIRE_EQ(n_allocations, counting_allocator::n_allocations.load());
+    }
+    REQUIRE_EQ(n_live, counting_allocator::n_live.load());
+  }
+
+  TEST_CASE("versions are released") {
+    int n_live = counting_allocator::n_live;
+    {
+      persistent_art<int, counting_allocator> trie;
+      int int0 = 0;
+      vector<persistent_art<int, counting_allocator>> versions;
+      for (int i = 0; i < 500; ++i) {
+        trie.set(to_string(i).c_str(), &int0);
+        if (i % 50 == 0) {
+          versions.push_back(trie.snapshot());
+        }
+      }
+      for (int i = 0; i < 500; i += 3) {
+        trie.del(to_string(i).c_str());
+        if (i % 50 == 0) {
+          versions.push_back(trie);
+        }
+      }
+      /* release the versions out of order */
+      for (std::size_t i = 1; i < versions.size(); i += 2) {
+        versions[i] = persistent_art<int, counting_allocator>();
+      }
+      trie = versions[0];
+    }
+    REQUIRE_EQ(n_live, counting_allocator::n_live.load());
+  }
+
+  TEST_CASE("snapshots are read while the tree is modified") {
+    persistent_art<int> trie;
+    int int0 = 0, int1 = 1;
+    for (int i = 0; i < 1000; ++i) {
+      trie.set(to_string(i).c_str(), &int0);
+    }
+
+    auto snap = trie.snapshot();
+    atomic<bool> failed(false);
+    thread reader([&]() {
+      for (int round = 0; round < 20; ++round) {
+        int n = 0;
+        for (auto it = snap.begin(), it_end = snap.end(); it != it_end; ++it) {
+          if (*it != &int0) {
+            failed = true;
+          }
+          ++n;
+        }
+        if (n != 1000) {
+          failed = true;
+        }
+      }
+    });
+    for (int i = 0; i < 1000; ++i) {
+      trie.set(to_string(i).c_str(), &int1);
+      trie.del(to_string(i / 2).c_str());
+    }
+    reader.join();
+    REQUIRE_FALSE(failed);
+  }
+}
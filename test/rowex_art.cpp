@@ -0,0 +1,92 @@
+/**
+ * @file rowex_art tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "concurrent_checks.hpp"
+#include "doctest.h"
+#include <atomic>
+#include <random>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using std::atomic;
+using std::mt19937_64;
+using std::string;
+using std::thread;
+using std::vector;
+
+static_assert(std::is_same<art::sync_art<int, art::sync::rowex>,
+                           art::rowex_art<int>>::value,
+              "sync::rowex selects rowex_art");
+
+TEST_SUITE("rowex_art") {
+
+  TEST_CASE("set, get & delete") {
+    art_test::check_set_get_del<art::rowex_art<int>>();
+  }
+
+  TEST_CASE("monte carlo") {
+    art_test::check_monte_carlo<art::rowex_art<int>>();
+  }
+
+  TEST_CASE("concurrent writers") {
+    art_test::check_concurrent_writers<art::rowex_art<int>>();
+  }
+
+  TEST_CASE("concurrent readers and writers") {
+    art_test::check_concurrent_readers_and_writers<art::rowex_art<int>>();
+  }
+
+  TEST_CASE("readers during grow, shrink and prefix changes") {
+    const int n_rounds = 200;
+    art::rowex_art<int> m;
+    vector<int> values(257);
+    /* long shared prefix, so that nodes carry heap prefixes */
+    vector<string> keys;
+    for (int i = 0; i < 256; ++i) {
+      keys.push_back(string(20, 'p') + static_cast<char>(i) + "\xff");
+    }
+    /* splits the shared prefix when inserted, merges it when deleted */
+    keys.push_back(string(10, 'p') + "q");
+    /* every 16th key is stable, the others grow the node up to 256 children
+     * and shrink it back */
+    auto is_stable = [](int i) { return i < 256 && i % 16 == 0; };
+    for (int i = 0; i < 256; i += 16) {
+      m.set(keys[i].data(), keys[i].size(), &values[i]);
+    }
+    atomic<bool> done(false);
+    atomic<int> n_misses(0);
+    thread writer([&]() {
+      for (int round = 0; round < n_rounds; ++round) {
+        for (int i = 0; i < 257; ++i) {
+          if (!is_stable(i)) {
+            m.set(keys[i].data(), keys[i].size(), &values[i]);
+          }
+        }
+        for (int i = 0; i < 257; ++i) {
+          if (!is_stable(i)) {
+            m.del(keys[i].data(), keys[i].size());
+          }
+        }
+      }
+      done = true;
+    });
+    mt19937_64 g(0);
+    while (!done) {
+      int i = 16 * (g() % 16);
+      if (m.get(keys[i].data(), keys[i].size()) != &values[i]) {
+        ++n_misses;
+      }
+    }
+    writer.join();
+    REQUIRE_EQ(0, n_misses.load());
+    for (int i = 0; i < 257; ++i) {
+      REQUIRE_EQ(is_stable(i) ? &values[i] : nullptr,
+                 m.get(keys[i].data(), keys[i].size()));
+    }
+  }
+}
@@ -0,0 +1,136 @@
+/**
+ * @file sharded_art tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "concurrent_checks.hpp"
+#include "doctest.h"
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::map;
+using std::mt19937_64;
+using std::string;
+using std::to_string;
+using std::vector;
+
+namespace {
+
+/* the order of the tree, partial keys are signed chars */
+struct signed_less {
+  bool operator()(const string &a, const string &b) const {
+    for (std::size_t i = 0; i < a.size() && i < b.size(); ++i) {
+      if (static_cast<signed char>(a[i]) != static_cast<signed char>(b[i])) {
+        return static_cast<signed char>(a[i]) < static_cast<signed char>(b[i]);
+      }
+    }
+    return a.size() < b.size();
+  }
+};
+
+} // namespace
+
+TEST_SUITE("sharded_art") {
+
+  TEST_CASE("set, get & delete") {
+    art::sharded_art<int, 16> m;
+    int int0, int1;
+
+    REQUIRE_EQ(nullptr, m.get("aa"));
+    REQUIRE_EQ(nullptr, m.set("aa", &int0));
+    REQUIRE_EQ(nullptr, m.set("zz", &int1));
+    REQUIRE_EQ(&int0, m.get("aa"));
+    REQUIRE_EQ(&int1, m.get("zz"));
+    REQUIRE_EQ(&int1, m.set("zz", &int0));
+    REQUIRE_EQ(&int0, m.del("aa"));
+    REQUIRE_EQ(nullptr, m.get("aa"));
+    REQUIRE_EQ(&int0, m.del("zz"));
+    REQUIRE(m.begin() == m.end());
+  }
+
+  TEST_CASE("routing spreads keys sharing their first bytes") {
+    using tree = art::sharded_art<int, 16>;
+    const std::size_t n_keys = 16000;
+    vector<string> decimal, words;
+    mt19937_64 g(0);
+    for (std::size_t i = 0; i < n_keys; ++i) {
+      decimal.push_back(to_string(i));
+      string word = "user";
+      for (int j = 0; j < 4; ++j) {
+        word.push_back(static_cast<char>('a' + g() % 26));
+      }
+      words.push_back(word);
+    }
+    for (const vector<string> &keys : {decimal, words}) {
+      vector<std::size_t> n(tree::n_shards);
+      for (const string &k : keys) {
+        std::size_t s = tree::shard_of(k.c_str(), k.size() + 1);
+        REQUIRE(s < tree::n_shards);
+        ++n[s];
+      }
+      /* every shard gets about n_keys / n_shards keys */
+      for (std::size_t count : n) {
+        REQUIRE(count > n_keys / tree::n_shards / 2);
+        REQUIRE(count < n_keys / tree::n_shards * 2);
+      }
+    }
+    REQUIRE_EQ(tree::shard_of("ab", 2), tree::shard_of("abc", 2));
+    REQUIRE(art::sharded_art<int, 1>::shard_of("ab", 2) == 0);
+  }
+
+  TEST_CASE("ordered iteration across shards") {
+    art::sharded_art<int, 7> m;
+    map<string, int *, signed_less> expected;
+    vector<int> values(10000);
+    mt19937_64 g(0);
+    for (int i = 0; i < 10000; ++i) {
+      /* binary keys of fixed length covering every first byte */
+      string k(4, '\0');
+      for (char &c : k) {
+        c = static_cast<char>(g());
+      }
+      if (i % 2 == 0) {
+        /* and terminated keys that are prefixes of each other's bytes */
+        k = to_string(i % 1000) + '\0';
+      }
+      m.set(k.data(), k.size(), &values[i]);
+      expected[k] = &values[i];
+    }
+
+    auto expected_it = expected.begin();
+    for (auto it = m.begin(); it != m.end(); ++it, ++expected_it) {
+      REQUIRE(expected_it != expected.end());
+      REQUIRE_EQ(expected_it->first, it.key());
+      REQUIRE_EQ(expected_it->second, *it);
+    }
+    REQUIRE(expected_it == expected.end());
+
+    auto it = m.begin();
+    auto old = it++;
+    REQUIRE(old == m.begin());
+    REQUIRE(old != it);
+    REQUIRE_EQ(std::next(expected.begin())->first, it.key());
+
+    for (int i = 0; i < 100; ++i) {
+      string k(2, '\0');
+      for (char &c : k) {
+        c = static_cast<char>(g());
+      }
+      auto lower = expected.lower_bound(k);
+      auto it = m.begin(k.data(), k.size());
+      if (lower == expected.end()) {
+        REQUIRE(it == m.end());
+      } else {
+        REQUIRE_EQ(lower->first, it.key());
+      }
+    }
+  }
+
+  TEST_CASE("concurrent writers") {
+    art_test::check_concurrent_writers<art::sharded_art<int, 16>>();
+  }
+}
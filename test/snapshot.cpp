@@ -0,0 +1,187 @@
+/**
+ * @file snapshot tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using std::mt19937_64;
+using std::string;
+using std::vector;
+
+namespace {
+
+/* values are copied into snapshots, so they can't own their key */
+struct record {
+  char key_[8];
+  int value_;
+};
+
+struct record_key {
+  const char *operator()(const record *r) const { return r->key_; }
+};
+
+/* copies the snapshot into 8 byte aligned memory */
+vector<uint64_t> aligned(const string &snapshot) {
+  vector<uint64_t> words((snapshot.size() + 7) / 8);
+  std::memcpy(words.data(), snapshot.data(), snapshot.size());
+  return words;
+}
+
+template <class T, class A, class K>
+string snapshot_of(const art::art<T, A, K> &tree) {
+  std::ostringstream out(std::ios::binary);
+  art::serialize(tree, out);
+  return out.str();
+}
+
+} // namespace
+
+TEST_SUITE("snapshot") {
+
+  TEST_CASE("lookups and iteration") {
+    art::art<uint32_t> m;
+    vector<uint32_t> values(20000);
+    mt19937_64 g(0);
+    for (uint32_t i = 0; i < values.size(); ++i) {
+      values[i] = i;
+      string k = std::to_string(g() % 100000);
+      if (i % 7 == 0) {
+        /* long prefixes */
+        k = string(20, 'k') + k;
+      }
+      m.set(k.c_str(), &values[i]);
+    }
+
+    string snapshot = snapshot_of(m);
+    auto words = aligned(snapshot);
+    art::art_view<uint32_t> view(reinterpret_cast<const char *>(words.data()),
+                                 snapshot.size());
+
+    std::size_t n = 0;
+    auto view_it = view.begin();
+    for (auto it = m.begin(); it != m.end(); ++it, ++view_it, ++n) {
+      REQUIRE(view_it != view.end());
+      REQUIRE_EQ(it.key(), view_it.key());
+      REQUIRE_EQ(**it, **view_it);
+      REQUIRE_EQ(**it, *view.get(it.key().data(), it.key().size()));
+    }
+    REQUIRE(view_it == view.end());
+    REQUIRE_EQ(n, view.size());
+
+    for (int i = 0; i < 1000; ++i) {
+      string k = std::to_string(g() % 100000);
+      uint32_t *expected = m.get(k.c_str());
+      const uint32_t *found = view.get(k.c_str());
+      REQUIRE_EQ(expected == nullptr, found == nullptr);
+      if (expected != nullptr) {
+        REQUIRE_EQ(*expected, *found);
+      }
+      auto it = m.begin(k.c_str());
+      auto v_it = view.begin(k.c_str());
+      REQUIRE_EQ(it == m.end(), v_it == view.end());
+      if (it != m.end()) {
+        REQUIRE_EQ(it.key(), v_it.key());
+      }
+    }
+
+    std::size_t n_expected = 0, n_found = 0;
+    m.scan_prefix("kkkkk", [&](const string &, uint32_t *) {
+      ++n_expected;
+      return true;
+    });
+    view.scan_prefix("kkkkk", [&](const string &k, const uint32_t *v) {
+      REQUIRE_EQ(*m.get(k.data(), k.size()), *v);
+      ++n_found;
+      return true;
+    });
+    REQUIRE(n_expected > 0);
+    REQUIRE_EQ(n_expected, n_found);
+  }
+
+  TEST_CASE("tagged leaves and empty trees") {
+    vector<record> records = {{"a", 1}, {"ab", 2}, {"b", 3}};
+    art::art<record, art::pool_allocator, record_key> m;
+    for (record &r : records) {
+      m.set(r.key_, &r);
+    }
+    string snapshot = snapshot_of(m);
+    auto words = aligned(snapshot);
+    art::art_view<record> view(reinterpret_cast<const char *>(words.data()),
+                               snapshot.size());
+    REQUIRE_EQ(2, view.get("ab")->value_);
+    REQUIRE_EQ(nullptr, view.get("abc"));
+    REQUIRE_EQ(3u, view.size());
+
+    art::art<int> empty;
+    snapshot = snapshot_of(empty);
+    words = aligned(snapshot);
+    art::art_view<int> empty_view(
+        reinterpret_cast<const char *>(words.data()), snapshot.size());
+    REQUIRE_EQ(nullptr, empty_view.get("a"));
+    REQUIRE(empty_view.begin() == empty_view.end());
+    REQUIRE(empty_view.begin("a") == empty_view.end());
+
+    REQUIRE_THROWS_AS(art::art_view<int64_t>(
+                          reinterpret_cast<const char *>(words.data()),
+                          snapshot.size()),
+                      std::runtime_error);
+    string garbage(64, 'x');
+    words = aligned(garbage);
+    REQUIRE_THROWS_AS(
+        art::art_view<int>(reinterpret_cast<const char *>(words.data()),
+                           garbage.size()),
+        std::runtime_error);
+  }
+
+  TEST_CASE("versions of a persistent_art") {
+    vector<int> values = {1, 2, 3};
+    art::persistent_art<int> m;
+    m.set("a", &values[0]);
+    m.set("b", &values[1]);
+    auto version = m.snapshot();
+    /* the version keeps its contents while the tree is modified */
+    m.set("c", &values[2]);
+    m.del("a");
+    std::ostringstream out(std::ios::binary);
+    art::serialize(version, out);
+    string snapshot = out.str();
+    auto words = aligned(snapshot);
+    art::art_view<int> view(reinterpret_cast<const char *>(words.data()),
+                            snapshot.size());
+    REQUIRE_EQ(2u, view.size());
+    REQUIRE_EQ(1, *view.get("a"));
+    REQUIRE_EQ(2, *view.get("b"));
+    REQUIRE_EQ(nullptr, view.get("c"));
+  }
+
+  TEST_CASE("mapped file") {
+    art::art<int> m;
+    vector<int> values = {1, 2, 3};
+    m.set("one", &values[0]);
+    m.set("two", &values[1]);
+    m.set("three", &values[2]);
+    const char *path = "snapshot_test.bin";
+    {
+      std::ofstream out(path, std::ios::binary);
+      art::serialize(m, out);
+    }
+    {
+      art::mapped_file file(path);
+      art::art_view<int> view(file.data(), file.size());
+      REQUIRE_EQ(2, *view.get("two"));
+      REQUIRE_EQ(nullptr, view.get("four"));
+    }
+    std::remove(path);
+    REQUIRE_THROWS_AS(art::mapped_file("no/such/file"), std::runtime_error);
+  }
+}
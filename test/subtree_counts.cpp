@@ -0,0 +1,151 @@
+/**
+ * @file subtree count tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+using std::map;
+using std::string;
+using std::vector;
+
+namespace {
+
+struct item {
+  int id;
+};
+
+static_assert(sizeof(art::inner_node<item>) > sizeof(art::node<item>),
+              "inner nodes hold a count");
+
+/* random strings of 1 to 12 characters, the first of 60 and the others of
+ * 5, so that some nodes are large and keys share prefixes */
+string random_key(std::mt19937_64 &g) {
+  string key(1 + g() % 12, 'a');
+  key[0] = static_cast<char>('0' + g() % 60);
+  for (std::size_t i = 1; i < key.size(); ++i) {
+    key[i] = static_cast<char>('a' + g() % 5);
+  }
+  return key;
+}
+
+template <class M>
+void require_counts(M &m, const map<string, item *> &expected,
+                    std::mt19937_64 &g) {
+  REQUIRE_EQ(expected.size(), m.count_range("", "~"));
+  std::size_t i = 0;
+  for (const auto &entry : expected) {
+    REQUIRE_EQ(i, m.rank(entry.first.data(), entry.first.size()));
+    auto it = m.select(i);
+    REQUIRE(it != m.end());
+    REQUIRE_EQ(entry.first, it.key());
+    REQUIRE_EQ(entry.second, *it);
+    ++i;
+  }
+  REQUIRE(m.select(expected.size()) == m.end());
+  string lo, hi;
+  for (int j = 0; j < 200; ++j) {
+    lo = random_key(g);
+    hi = random_key(g);
+    std::size_t n = lo < hi ? std::distance(expected.lower_bound(lo),
+                                            expected.lower_bound(hi))
+                            : 0;
+    REQUIRE_EQ(n, m.count_range(lo.c_str(), hi.c_str()));
+  }
+}
+
+} // namespace
+
+TEST_SUITE("subtree counts") {
+
+  TEST_CASE("inner nodes count their leaves") {
+    art::art<item> m;
+    item v{0};
+    m.set("aa", &v);
+    m.set("ab", &v);
+    m.set("b", &v);
+    REQUIRE_EQ(0u, m.rank("aa"));
+    REQUIRE_EQ(1u, m.rank("ab"));
+    REQUIRE_EQ(2u, m.rank("ac"));
+    REQUIRE_EQ(2u, m.rank("b"));
+    REQUIRE_EQ(3u, m.rank("c"));
+    REQUIRE_EQ(string("ab", 3), m.select(1).key());
+    REQUIRE_EQ(string("b", 2), m.select(2).key());
+    REQUIRE(m.select(3) == m.end());
+    REQUIRE_EQ(2u, m.count_range("a", "b"));
+
+    /* counts are unchanged by replacing a value or deleting a missing key */
+    m.set("ab", &v);
+    REQUIRE_EQ(nullptr, m.del("ac"));
+    REQUIRE_EQ(nullptr, m.del("a"));
+    REQUIRE_THROWS(m.set("a", 1, &v));
+    REQUIRE_EQ(3u, m.count_range("", "c"));
+    REQUIRE_EQ(&v, m.del("aa"));
+    REQUIRE_EQ(0u, m.rank("ab"));
+    REQUIRE_EQ(string("b", 2), m.select(1).key());
+    REQUIRE_EQ(2u, m.count_range("", "c"));
+  }
+
+  TEST_CASE("monte carlo") {
+    std::mt19937_64 g(0);
+    art::art<item, art::heap_allocator> m;
+    map<string, item *> expected;
+    vector<item> items(20000);
+    string key;
+    for (std::size_t i = 0; i < items.size(); ++i) {
+      items[i].id = i;
+      key = random_key(g) + '\0';
+      /* deletions make nodes shrink and parents merge with their child */
+      if (g() % 3 == 0) {
+        auto it = expected.lower_bound(key);
+        if (it == expected.end()) {
+          continue;
+        }
+        REQUIRE_EQ(it->second, m.del(it->first.data(), it->first.size()));
+        expected.erase(it);
+      } else {
+        m.set(key.c_str(), &items[i]);
+        expected[key] = &items[i];
+      }
+    }
+    require_counts(m, expected, g);
+
+    SUBCASE("compact") {
+      m.compact();
+      require_counts(m, expected, g);
+    }
+
+    SUBCASE("bulk load") {
+      vector<std::pair<string, item *>> pairs(expected.begin(),
+                                              expected.end());
+      art::art<item> loaded(pairs.begin(), pairs.end());
+      require_counts(loaded, expected, g);
+    }
+
+    SUBCASE("merge") {
+      art::art<item, art::heap_allocator> other;
+      vector<item> other_items(5000);
+      for (std::size_t i = 0; i < other_items.size(); ++i) {
+        key = random_key(g) + '\0';
+        if (other.get(key.c_str()) != nullptr) {
+          continue;
+        }
+        other.set(key.c_str(), &other_items[i]);
+        auto it = expected.emplace(key, &other_items[i]).first;
+        it->second = std::min(it->second, &other_items[i]);
+      }
+      m.merge(std::move(other),
+              [](item *mine, item *theirs) { return std::min(mine, theirs); });
+      require_counts(m, expected, g);
+    }
+  }
+}
@@ -0,0 +1,200 @@
+/**
+ * @file tree_it tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+using std::map;
+using std::mt19937_64;
+using std::string;
+using std::vector;
+
+namespace {
+
+struct record {
+  string key_;
+};
+
+struct record_key {
+  const char *operator()(const record *r) const { return r->key_.c_str(); }
+};
+
+} // namespace
+
+TEST_SUITE("tree_it") {
+
+  TEST_CASE("key reconstruction") {
+    art::art<int> m;
+    int int0;
+    vector<string> keys = {"a", "aa", "aaaaaaaaaaab", "ab", "b", "ba", "bab"};
+    for (const string &k : keys) {
+      m.set(k.c_str(), &int0);
+    }
+    auto expected = keys.begin();
+    for (auto it = m.begin(); it != m.end(); ++it, ++expected) {
+      /* the terminator is part of the key */
+      REQUIRE_EQ(*expected + '\0', it.key());
+    }
+    REQUIRE(expected == keys.end());
+
+    auto it = m.begin("aab");
+    REQUIRE_EQ(string("ab", 3), it.key());
+    it = m.begin("aaaaaaaaaaaa");
+    REQUIRE_EQ(string("aaaaaaaaaaab", 13), it.key());
+  }
+
+  TEST_CASE("binary keys") {
+    art::art<int> m;
+    int int0;
+    map<string, int *> expected;
+    mt19937_64 g(0);
+    for (int i = 0; i < 10000; ++i) {
+      string k(8, '\0');
+      for (char &c : k) {
+        c = static_cast<char>(g() % 4);
+      }
+      m.set(k.data(), k.size(), &int0);
+      expected[k] = &int0;
+    }
+    /* lexicographic order of signed bytes equals std::string order for
+     * non-negative bytes */
+    auto expected_it = expected.begin();
+    for (auto it = m.begin(); it != m.end(); ++it, ++expected_it) {
+      REQUIRE_EQ(expected_it->first, it.key());
+    }
+    REQUIRE(expected_it == expected.end());
+  }
+
+  TEST_CASE("tagged leaves") {
+    art::art<record, art::pool_allocator, record_key> m;
+    vector<record> records = {{"abc"}, {"abd"}, {"b"}, {"bcdefghijklmno"}};
+    for (record &r : records) {
+      m.set(r.key_.c_str(), &r);
+    }
+    auto r = records.begin();
+    for (auto it = m.begin(); it != m.end(); ++it, ++r) {
+      REQUIRE_EQ(&*r, *it);
+      REQUIRE_EQ(r->key_ + '\0', it.key());
+    }
+  }
+
+  TEST_CASE("deep paths") {
+    /* every key branches off at a different byte, so the path to the
+     * longest keys has more than max_depth inner nodes */
+    const int n = 3 * art::tree_it<int>::max_depth;
+    art::art<int> m;
+    vector<int> values(n + 1);
+    vector<string> keys;
+    for (int i = 0; i <= n; ++i) {
+      keys.push_back(string(i, 'a') + (i == n ? 'a' : 'b'));
+    }
+    for (int i = 0; i <= n; ++i) {
+      m.set(keys[i].c_str(), &values[i]);
+    }
+    /* "aa...ab" < "a...ab" for a shorter run of a's */
+    int i = n;
+    for (auto it = m.begin(); it != m.end(); ++it, --i) {
+      REQUIRE_EQ(&values[i], *it);
+      REQUIRE_EQ(keys[i] + '\0', it.key());
+    }
+    REQUIRE_EQ(-1, i);
+
+    auto it = m.begin(keys[n - 1].c_str());
+    REQUIRE_EQ(&values[n - 1], *it);
+    auto copy = it++;
+    REQUIRE_EQ(&values[n - 1], *copy);
+    REQUIRE_EQ(keys[n - 1] + '\0', copy.key());
+    REQUIRE_EQ(&values[n - 2], *it);
+  }
+
+  TEST_CASE("reverse iteration") {
+    art::art<int> m;
+    int int0;
+    REQUIRE(m.last() == m.end());
+    REQUIRE(--m.end() == m.end());
+
+    map<string, int *> expected;
+    mt19937_64 g(0);
+    for (int i = 0; i < 10000; ++i) {
+      string k(1 + g() % 8, '\0');
+      for (char &c : k) {
+        c = static_cast<char>('a' + g() % 4);
+      }
+      m.set(k.c_str(), &int0);
+      expected[k + '\0'] = &int0;
+    }
+    auto expected_it = expected.rbegin();
+    for (auto it = m.last(); it != m.end(); --it, ++expected_it) {
+      REQUIRE_EQ(expected_it->first, it.key());
+    }
+    REQUIRE(expected_it == expected.rend());
+
+    /* the end and the first key are each other's neighbours */
+    auto it = m.end();
+    --it;
+    REQUIRE_EQ(expected.rbegin()->first, it.key());
+    it = m.begin();
+    --it;
+    REQUIRE(it == m.end());
+    ++it;
+    REQUIRE(it != m.end());
+
+    /* back and forth */
+    it = m.begin();
+    auto it_next = it;
+    for (++it_next; it_next != m.end(); ++it, ++it_next) {
+      auto copy = it_next;
+      --copy;
+      REQUIRE_EQ(it.key(), copy.key());
+    }
+  }
+
+  TEST_CASE("less_equal") {
+    art::art<int> m;
+    int int0;
+    map<string, int *> expected;
+    mt19937_64 g(0);
+    for (int i = 0; i < 1000; ++i) {
+      string k(4, '\0');
+      for (char &c : k) {
+        c = static_cast<char>('b' + g() % 3);
+      }
+      m.set(k.data(), k.size(), &int0);
+      expected[k] = &int0;
+    }
+    for (int i = 0; i < 10000; ++i) {
+      /* shorter, equal and longer than the keys, below and above them */
+      string q(g() % 6, '\0');
+      for (char &c : q) {
+        c = static_cast<char>('a' + g() % 5);
+      }
+      auto it = m.last(q.data(), q.size());
+      auto expected_it = expected.upper_bound(q);
+      if (expected_it == expected.begin()) {
+        REQUIRE(it == m.end());
+      } else {
+        --expected_it;
+        REQUIRE(it != m.end());
+        REQUIRE_EQ(expected_it->first, it.key());
+        /* stepping on from the sought key */
+        ++it;
+        ++expected_it;
+        REQUIRE_EQ(expected_it == expected.end(), it == m.end());
+      }
+    }
+
+    /* the terminator of NUL-terminated keys is included */
+    art::art<int> names;
+    names.set("ab", &int0);
+    names.set("abc", &int0);
+    REQUIRE_EQ(string("ab", 3), names.last("ab").key());
+    REQUIRE_EQ(string("ab", 3), names.last("abb").key());
+    REQUIRE(names.last("aa") == names.end());
+  }
+}
@@ -0,0 +1,145 @@
+/**
+ * @file value_art tests
+ * @author Rafael Kallis <rk@rafaelkallis.com>
+ */
+
+#include "art.hpp"
+#include "doctest.h"
+#include <map>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+using namespace art;
+
+using std::map;
+using std::string;
+using std::to_string;
+
+namespace {
+
+/* counts its live instances */
+struct counted {
+  explicit counted(int value) : value_(value) { ++n_live; }
+  counted(const counted &other) : value_(other.value_) { ++n_live; }
+  counted(counted &&other) : value_(other.value_) { ++n_live; }
+  counted &operator=(const counted &other) = default;
+  counted &operator=(counted &&other) = default;
+  ~counted() { --n_live; }
+
+  int value_;
+  static int n_live;
+};
+
+int counted::n_live = 0;
+
+} // namespace
+
+TEST_SUITE("value_art") {
+
+  TEST_CASE("set, get & del") {
+    value_art<int> trie;
+
+    REQUIRE(trie.set("aa", 0));
+    REQUIRE(trie.set("aaaaaaaaaaaaaaaaaaab", 1));
+    REQUIRE(trie.set("aaaaaaaaaaaaaaaaaaac", 2));
+    REQUIRE_EQ(0, *trie.get("aa"));
+    REQUIRE_EQ(1, *trie.get("aaaaaaaaaaaaaaaaaaab"));
+    REQUIRE_EQ(2, *trie.get("aaaaaaaaaaaaaaaaaaac"));
+    REQUIRE_EQ(nullptr, trie.get("aaaaaaaaaaaaaaaaaaad"));
+
+    REQUIRE_FALSE(trie.set("aaaaaaaaaaaaaaaaaaac", 3));
+    REQUIRE_EQ(3, *trie.get("aaaaaaaaaaaaaaaaaaac"));
+
+    /* values are modified in place */
+    *trie.get("aa") = 4;
+    REQUIRE_EQ(4, *trie.get("aa"));
+
+    REQUIRE_THROWS_AS(trie.set("a", 1, 5), std::invalid_argument);
+
+    REQUIRE(trie.del("aa"));
+    REQUIRE_FALSE(trie.del("aa"));
+    REQUIRE_EQ(nullptr, trie.get("aa"));
+    REQUIRE_EQ(1, *trie.get("aaaaaaaaaaaaaaaaaaab"));
+    REQUIRE(trie.del("aaaaaaaaaaaaaaaaaaab"));
+    REQUIRE(trie.del("aaaaaaaaaaaaaaaaaaac"));
+    REQUIRE(trie.begin() == trie.end());
+  }
+
+  TEST_CASE("try_emplace") {
+    value_art<counted> trie;
+    auto r = trie.try_emplace("k", 2, 1);
+    REQUIRE(r.second);
+    REQUIRE_EQ(1, r.first->value_);
+    REQUIRE_EQ(1, counted::n_live);
+
+    /* the existing value is kept and nothing is constructed */
+    r = trie.try_emplace("k", 2, 2);
+    REQUIRE_FALSE(r.second);
+    REQUIRE_EQ(1, r.first->value_);
+    REQUIRE_EQ(r.first, trie.get("k"));
+    REQUIRE_EQ(1, counted::n_live);
+
+    REQUIRE_THROWS_AS(trie.try_emplace("k", 1, 3), std::invalid_argument);
+    REQUIRE_EQ(1, counted::n_live);
+    trie.del("k");
+    REQUIRE_EQ(0, counted::n_live);
+  }
+
+  TEST_CASE("values are destroyed") {
+    {
+      value_art<counted, heap_allocator> trie;
+      for (int i = 0; i < 1000; ++i) {
+        trie.set(to_string(i).c_str(), counted(i));
+      }
+      REQUIRE_EQ(1000, counted::n_live);
+    }
+    REQUIRE_EQ(0, counted::n_live);
+    {
+      /* the pool releases its memory at once, but not the values */
+      value_art<counted> trie;
+      for (int i = 0; i < 1000; ++i) {
+        trie.set(to_string(i).c_str(), counted(i));
+      }
+      for (int i = 0; i < 1000; i += 2) {
+        trie.del(to_string(i).c_str());
+      }
+      REQUIRE_EQ(500, counted::n_live);
+    }
+    REQUIRE_EQ(0, counted::n_live);
+  }
+
+  TEST_CASE("monte carlo") {
+    const int n = 10000;
+    std::mt19937_64 g(0);
+    std::uniform_int_distribution<int> key_dist(0, n / 2);
+    value_art<string> trie;
+    map<string, string> expected;
+    for (int i = 0; i < n; ++i) {
+      string key = to_string(key_dist(g));
+      if (g() % 3 == 0) {
+        REQUIRE_EQ(expected.erase(key) == 1, trie.del(key.c_str()));
+      } else {
+        /* long enough to be allocated on the heap */
+        string value = key + " is associated with " + to_string(i);
+        REQUIRE_EQ(expected.count(key) == 0, trie.set(key.c_str(), value));
+        expected[key] = value;
+      }
+    }
+    map<string, string> actual;
+    for (auto it = trie.begin(), it_end = trie.end(); it != it_end; ++it) {
+      string key = it.key();
+      key.pop_back();
+      actual[key] = **it;
+    }
+    REQUIRE(expected == actual);
+    REQUIRE_EQ(expected.size(), trie.stats().n_leaves);
+
+    /* the values are moved to the new leaves */
+    trie.compact();
+    for (const auto &entry : expected) {
+      REQUIRE_EQ(entry.second, *trie.get(entry.first.c_str()));
+    }
+  }
+}